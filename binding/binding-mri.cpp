@@ -41,6 +41,7 @@
 
 #include "binding-util.h"
 #include "binding.h"
+#include "iseq-cache.h"
 
 #include "sharedstate.h"
 #include "eventthread.h"
@@ -61,12 +62,16 @@ extern "C" {
 
 #include <assert.h>
 #include <string>
+#include <atomic>
+#include <memory>
+#include <thread>
 #include <zlib.h>
 
 #include <SDL_cpuinfo.h>
 #include <SDL_filesystem.h>
 #include <SDL_loadso.h>
 #include <SDL_power.h>
+#include <SDL_timer.h>
 
 extern const char module_rpg1[];
 extern const char module_rpg2[];
@@ -98,6 +103,8 @@ void audioBindingInit();
 void graphicsBindingInit();
 
 void fileIntBindingInit();
+void preloaderBindingInit();
+void rpgCacheBindingInit();
 
 #ifdef MKXPZ_MINIFFI
 void MiniFFIBindingInit();
@@ -179,6 +186,7 @@ void mriBindingInit() {
     graphicsBindingInit();
 
     fileIntBindingInit();
+    preloaderBindingInit();
 
 #ifdef MKXPZ_MINIFFI
     MiniFFIBindingInit();
@@ -209,8 +217,10 @@ void mriBindingInit() {
         _rb_define_module_function(rb_mKernel, "caller", _kernelCaller);
     }
 
-    if (rgssVer == 1)
+    if (rgssVer == 1) {
         rb_eval_string(module_rpg1);
+        rpgCacheBindingInit();
+    }
     else if (rgssVer == 2)
         rb_eval_string(module_rpg2);
     else if (rgssVer == 3)
@@ -891,6 +901,61 @@ bool evalScript(VALUE string, const char *filename)
 
 #define SCRIPT_SECTION_FMT (rgssVer >= 3 ? "{%04ld}" : "Section%03ld")
 
+struct ScriptSection {
+    /* Compressed source, owned by $RGSS_SCRIPTS */
+    const unsigned char *source = nullptr;
+    unsigned long sourceLen = 0;
+
+    std::string decoded;
+    int result = Z_OK;
+};
+
+static int inflateScript(ScriptSection &section) {
+    std::string &buffer = section.decoded;
+    buffer.resize(std::max<unsigned long>(0x1000, section.sourceLen * 4));
+
+    while (true) {
+        unsigned long bufferLen = buffer.size();
+
+        int result = uncompress(reinterpret_cast<unsigned char *>(&buffer[0]), &bufferLen,
+                                section.source, section.sourceLen);
+
+        if (result != Z_BUF_ERROR) {
+            buffer.resize(bufferLen);
+            return result;
+        }
+
+        buffer.resize(buffer.size() * 2);
+    }
+}
+
+/* Sections are independent zlib streams, so inflate them on
+ * all cores. The workers only touch memory that stays pinned
+ * while we hold on to the GVL and don't call into Ruby */
+static void inflateScripts(std::vector<ScriptSection> &sections) {
+    std::atomic<size_t> next(0);
+
+    auto worker = [&]() {
+        for (size_t i = next++; i < sections.size(); i = next++) {
+            if (sections[i].source)
+                sections[i].result = inflateScript(sections[i]);
+        }
+    };
+
+    unsigned int threadCount = std::max(1u, std::min(std::thread::hardware_concurrency(), 8u));
+    threadCount = std::min<size_t>(threadCount, std::max<size_t>(sections.size() / 16, 1));
+
+    std::vector<std::thread> threads;
+
+    for (unsigned int i = 1; i < threadCount; ++i)
+        threads.emplace_back(worker);
+
+    worker();
+
+    for (std::thread &t : threads)
+        t.join();
+}
+
 static void runRMXPScripts(BacktraceData &btData) {
     const Config &conf = shState->rtData().config;
     const std::string &scriptPack = conf.game.scripts;
@@ -925,8 +990,7 @@ static void runRMXPScripts(BacktraceData &btData) {
 
     long scriptCount = RARRAY_LEN(scriptArray);
 
-    std::string decodeBuffer;
-    decodeBuffer.resize(0x1000);
+    std::vector<ScriptSection> sections(scriptCount);
 
     for (long i = 0; i < scriptCount; ++i) {
         VALUE script = rb_ary_entry(scriptArray, i);
@@ -934,32 +998,29 @@ static void runRMXPScripts(BacktraceData &btData) {
         if (!RB_TYPE_P(script, RUBY_T_ARRAY))
             continue;
 
-        VALUE scriptName = rb_ary_entry(script, 1);
         VALUE scriptString = rb_ary_entry(script, 2);
 
-        int result = Z_OK;
-        unsigned long bufferLen;
-
-        while (true) {
-            unsigned char *bufferPtr = reinterpret_cast<unsigned char *>(
-                    const_cast<char *>(decodeBuffer.c_str()));
-            const unsigned char *sourcePtr =
-                    reinterpret_cast<const unsigned char *>(RSTRING_PTR(scriptString));
+        sections[i].source = reinterpret_cast<const unsigned char *>(RSTRING_PTR(scriptString));
+        sections[i].sourceLen = RSTRING_LEN(scriptString);
+    }
 
-            bufferLen = decodeBuffer.length();
+    uint64_t decodeStart = SDL_GetPerformanceCounter();
+    inflateScripts(sections);
 
-            result = uncompress(bufferPtr, &bufferLen, sourcePtr,
-                                RSTRING_LEN(scriptString));
+    if (conf.debugMode) {
+        double decodeMs = (SDL_GetPerformanceCounter() - decodeStart) * 1000.0 / SDL_GetPerformanceFrequency();
+        Debug() << "Decoded" << scriptCount << "script sections in" << decodeMs << "ms";
+    }
 
-            bufferPtr[bufferLen] = '\0';
+    for (long i = 0; i < scriptCount; ++i) {
+        if (!sections[i].source)
+            continue;
 
-            if (result != Z_BUF_ERROR)
-                break;
+        VALUE script = rb_ary_entry(scriptArray, i);
 
-            decodeBuffer.resize(decodeBuffer.size() * 2);
-        }
+        if (sections[i].result != Z_OK) {
+            VALUE scriptName = rb_ary_entry(script, 1);
 
-        if (result != Z_OK) {
             static char buffer[256];
             snprintf(buffer, sizeof(buffer), "Error decoding script %ld: '%s'", i,
                      RSTRING_PTR(scriptName));
@@ -969,8 +1030,49 @@ static void runRMXPScripts(BacktraceData &btData) {
             break;
         }
 
-        rb_ary_store(script, 3, rb_utf8_str_new_cstr(decodeBuffer.c_str()));
+        rb_ary_store(script, 3, rb_utf8_str_new_cstr(sections[i].decoded.c_str()));
+        sections[i].decoded = std::string();
+    }
+
+    /* Ruby visible file names of every section */
+    std::vector<std::string> fnames(scriptCount);
+
+    for (long i = 0; i < scriptCount; ++i) {
+        VALUE script = rb_ary_entry(scriptArray, i);
+
+        if (!RB_TYPE_P(script, RUBY_T_ARRAY))
+            continue;
+
+        const char *scriptName = RSTRING_PTR(rb_ary_entry(script, 1));
+        char buf[512];
+
+        if (conf.useScriptNames)
+            snprintf(buf, sizeof(buf), "%03ld:%s", i, scriptName);
+        else
+            snprintf(buf, sizeof(buf), SCRIPT_SECTION_FMT, i);
+
+        fnames[i] = buf;
+        btData.scriptNames.insert(buf, scriptName);
+    }
+
+#ifdef MKXPZ_ISEQ_CACHE
+    std::unique_ptr<ISeqCache> iseqCache;
+    std::vector<uint64_t> iseqKeys(scriptCount);
+
+    if (conf.scriptCache && !conf.customDataPath.empty()) {
+        for (long i = 0; i < scriptCount; ++i) {
+            VALUE scriptDecoded = rb_ary_entry(rb_ary_entry(scriptArray, i), 3);
+
+            if (!RB_TYPE_P(scriptDecoded, RUBY_T_STRING))
+                continue;
+
+            iseqKeys[i] = ISeqCache::makeKey(fnames[i].c_str(), RSTRING_PTR(scriptDecoded),
+                                             RSTRING_LEN(scriptDecoded));
+        }
+
+        iseqCache.reset(new ISeqCache(conf.customDataPath + "/scripts.iseqcache", iseqKeys));
     }
+#endif
 
     /* Execute preloaded scripts */
     for (std::vector<std::string>::const_iterator i = conf.preloadScripts.begin();
@@ -988,18 +1090,7 @@ static void runRMXPScripts(BacktraceData &btData) {
             VALUE string =
                     newStringUTF8(RSTRING_PTR(scriptDecoded), RSTRING_LEN(scriptDecoded));
 
-            VALUE fname;
-            const char *scriptName = RSTRING_PTR(rb_ary_entry(script, 1));
-            char buf[512];
-            int len;
-
-            if (conf.useScriptNames)
-                len = snprintf(buf, sizeof(buf), "%03ld:%s", i, scriptName);
-            else
-                len = snprintf(buf, sizeof(buf), SCRIPT_SECTION_FMT, i);
-
-            fname = newStringUTF8(buf, len);
-            btData.scriptNames.insert(buf, scriptName);
+            VALUE fname = newStringUTF8(fnames[i].c_str(), fnames[i].size());
 
 
             // if the script name starts with |s|, only execute
@@ -1028,6 +1119,17 @@ static void runRMXPScripts(BacktraceData &btData) {
 
             int state;
 
+#ifdef MKXPZ_ISEQ_CACHE
+            if (iseqCache) {
+                /* The last section normally runs the game loop */
+                if (conf.debugMode && i == scriptCount - 1)
+                    Debug() << "Script cache:" << iseqCache->hitCount() << "of"
+                            << scriptCount << "sections loaded precompiled";
+
+                iseqCache->eval(iseqKeys[i], string, fname, &state);
+            }
+            else
+#endif
             evalString(string, fname, &state);
             if (state)
                 break;
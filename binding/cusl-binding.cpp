@@ -1,36 +1,6 @@
 #ifdef MKXPZ_STEAM
 #include "binding-util.h"
-#include "steamshim_child.h"
-
-#define STEAMSHIM_GETV(t, v, d)                                                \
-  while (STEAMSHIM_alive()) {                                                  \
-    const STEAMSHIM_Event *e = STEAMSHIM_pump();                               \
-    if (e && e->type == t) {                                                   \
-      d = e->v;                                                                \
-      break;                                                                   \
-    }                                                                          \
-  }
-
-#define STEAMSHIM_GETV_EXP(t, exp)                                             \
-  while (STEAMSHIM_alive()) {                                                  \
-    const STEAMSHIM_Event *e = STEAMSHIM_pump();                               \
-    if (e && e->type == t) {                                                   \
-      exp;                                                                     \
-      break;                                                                   \
-    }                                                                          \
-  }
-
-#define STEAMSHIM_GET_OK(t, d) STEAMSHIM_GETV(t, okay, d)
-
-#define STEAMSHIM_GETV_AND_OK(t, v, dst, ok)                                   \
-  while (STEAMSHIM_alive()) {                                                  \
-    const STEAMSHIM_Event *e = STEAMSHIM_pump();                               \
-    if (e && e->type == t) {                                                   \
-      dst = e->v;                                                              \
-      ok = e->okay;                                                            \
-      break;                                                                   \
-    }                                                                          \
-  }
+#include "steamshimasync.h"
 
 RB_METHOD(CUSLSetStat) {
   RB_UNUSED_PARAM
@@ -39,13 +9,13 @@ RB_METHOD(CUSLSetStat) {
   rb_scan_args(argc, argv, "2", &name, &stat);
   SafeStringValue(name);
 
+  // Writes are sent off in the background, failures only get logged
   bool ret;
   if (RB_TYPE_P(stat, RUBY_T_FLOAT)) {
-    STEAMSHIM_setStatF(RSTRING_PTR(name), (float)RFLOAT_VALUE(stat));
-    STEAMSHIM_GET_OK(SHIMEVENT_SETSTATF, ret);
+    ret = SteamShimAsync::setStatF(RSTRING_PTR(name),
+                                   (float)RFLOAT_VALUE(stat));
   } else if (RB_TYPE_P(stat, RUBY_T_FIXNUM)) {
-    STEAMSHIM_setStatI(RSTRING_PTR(name), (int)NUM2INT(stat));
-    STEAMSHIM_GET_OK(SHIMEVENT_SETSTATI, ret);
+    ret = SteamShimAsync::setStatI(RSTRING_PTR(name), (int)NUM2INT(stat));
   } else {
     rb_raise(rb_eTypeError,
              "Statistic value must be either an integer or float.");
@@ -61,12 +31,8 @@ RB_METHOD(CUSLGetStatI) {
   SafeStringValue(name);
 
   int resi;
-  bool valid;
-
-  STEAMSHIM_getStatI(RSTRING_PTR(name));
-  STEAMSHIM_GETV_AND_OK(SHIMEVENT_GETSTATI, ivalue, resi, valid);
 
-  if (!valid)
+  if (!SteamShimAsync::getStatI(RSTRING_PTR(name), resi))
     return Qnil;
 
   return INT2NUM(resi);
@@ -80,12 +46,8 @@ RB_METHOD(CUSLGetStatF) {
   SafeStringValue(name);
 
   float resf;
-  bool valid;
 
-  STEAMSHIM_getStatI(RSTRING_PTR(name));
-  STEAMSHIM_GETV_AND_OK(SHIMEVENT_GETSTATI, fvalue, resf, valid);
-
-  if (!valid)
+  if (!SteamShimAsync::getStatF(RSTRING_PTR(name), resf))
     return Qnil;
 
   return rb_float_new(resf);
@@ -99,12 +61,8 @@ RB_METHOD(CUSLGetAchievement) {
   SafeStringValue(name);
 
   bool ret;
-  bool valid;
-
-  STEAMSHIM_getAchievement(RSTRING_PTR(name));
-  STEAMSHIM_GETV_AND_OK(SHIMEVENT_GETACHIEVEMENT, ivalue, ret, valid);
 
-  if (!valid)
+  if (!SteamShimAsync::getAchievement(RSTRING_PTR(name), ret))
     return Qnil;
 
   return rb_bool_new(ret);
@@ -117,10 +75,7 @@ RB_METHOD(CUSLSetAchievement) {
   rb_scan_args(argc, argv, "1", &name);
   SafeStringValue(name);
 
-  bool ret;
-  STEAMSHIM_setAchievement(RSTRING_PTR(name), true);
-  STEAMSHIM_GET_OK(SHIMEVENT_SETACHIEVEMENT, ret);
-  return rb_bool_new(ret);
+  return rb_bool_new(SteamShimAsync::setAchievement(RSTRING_PTR(name), true));
 }
 
 RB_METHOD(CUSLClearAchievement) {
@@ -131,10 +86,7 @@ RB_METHOD(CUSLClearAchievement) {
   rb_scan_args(argc, argv, "1", &name);
   SafeStringValue(name);
 
-  bool ret;
-  STEAMSHIM_setAchievement(RSTRING_PTR(name), false);
-  STEAMSHIM_GET_OK(SHIMEVENT_SETACHIEVEMENT, ret);
-  return rb_bool_new(ret);
+  return rb_bool_new(SteamShimAsync::setAchievement(RSTRING_PTR(name), false));
 }
 
 RB_METHOD(CUSLGetAchievementAndUnlockTime) {
@@ -146,17 +98,9 @@ RB_METHOD(CUSLGetAchievementAndUnlockTime) {
   SafeStringValue(name);
 
   bool achieved;
-  unsigned long long time;
-  bool valid;
-
-  STEAMSHIM_getAchievement(RSTRING_PTR(name));
-  STEAMSHIM_GETV_EXP(SHIMEVENT_GETACHIEVEMENT, {
-    valid = e->okay;
-    achieved = e->ivalue;
-    time = e->epochsecs;
-  });
+  uint64_t time;
 
-  if (!valid)
+  if (!SteamShimAsync::getAchievement(RSTRING_PTR(name), achieved, time))
     return Qnil;
 
   VALUE ret = rb_ary_new();
@@ -176,11 +120,8 @@ RB_METHOD(CUSLStoreStats) {
   RB_UNUSED_PARAM
 
   rb_check_argc(argc, 0);
-  bool ok;
 
-  STEAMSHIM_storeStats();
-  STEAMSHIM_GET_OK(SHIMEVENT_STATSSTORED, ok);
-  return rb_bool_new(ok);
+  return rb_bool_new(SteamShimAsync::storeStats());
 }
 
 RB_METHOD(CUSLResetAllStats) {
@@ -190,16 +131,12 @@ RB_METHOD(CUSLResetAllStats) {
 
   rb_get_args(argc, argv, "b", &achievementsToo);
 
-  STEAMSHIM_resetStats(achievementsToo);
-  STEAMSHIM_GET_OK(SHIMEVENT_RESETSTATS, achievementsToo);
-  return rb_bool_new(achievementsToo);
+  return rb_bool_new(SteamShimAsync::resetStats(achievementsToo));
 }
 
 void CUSLBindingInit() {
 
-  STEAMSHIM_requestStats();
-  bool ok;
-  STEAMSHIM_GET_OK(SHIMEVENT_STATSRECEIVED, ok);
+  SteamShimAsync::requestStats();
 
   VALUE mSteamLite = rb_define_module("SteamLite");
 
@@ -22,9 +22,11 @@
 #include "src/config.h"
 
 #include "binding-util.h"
+#include "marshal-reader.h"
 
 #include "filesystem.h"
 #include "sharedstate.h"
+#include "preloader.h"
 #include "src/util/util.h"
 
 #if RAPI_FULL > 187
@@ -166,19 +168,31 @@ VALUE
 kernelLoadDataInt(const char *filename, bool rubyExc, bool raw) {
     //rb_gc_start();
     
-    VALUE port = fileIntForPath(filename, rubyExc);
-    VALUE result;
-    if (!raw) {
-        VALUE marsh = rb_const_get(rb_cObject, rb_intern("Marshal"));
+    VALUE data;
+    
+    std::string preloaded;
+    if (!raw && shState->preloader().takeData(filename, preloaded)) {
+        data = rb_str_new(preloaded.data(), preloaded.size());
+    } else {
+        VALUE port = fileIntForPath(filename, rubyExc);
         
         // FIXME need to catch exceptions here with begin rescue
-        VALUE data = fileIntRead(0, 0, port);
-        result = rb_funcall2(marsh, rb_intern("load"), 1, &data);
-    } else {
-        result = fileIntRead(0, 0, port);
+        data = fileIntRead(0, 0, port);
+        
+        rb_funcall2(port, rb_intern("close"), 0, NULL);
+        
+        if (raw)
+            return data;
     }
     
-    rb_funcall2(port, rb_intern("close"), 0, NULL);
+    // Data files are almost always plain RPG:: object graphs,
+    // which we can read without going through Ruby per object
+    VALUE result = marshalLoadNative(data);
+    
+    if (result == Qundef) {
+        VALUE marsh = rb_const_get(rb_cObject, rb_intern("Marshal"));
+        result = rb_funcall2(marsh, rb_intern("load"), 1, &data);
+    }
     
     return result;
 }
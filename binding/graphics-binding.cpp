@@ -25,6 +25,10 @@
 #include "binding-util.h"
 #include "binding-types.h"
 #include "exception.h"
+#include "texpool.h"
+#include "bitmapatlas.h"
+#include "gl-util.h"
+#include "font.h"
 
 #if RAPI_MAJOR >= 2
 #include <ruby/thread.h>
@@ -359,6 +363,107 @@ RB_METHOD(graphicsScreenshot)
     return Qnil;
 }
 
+RB_METHOD(graphicsMemoryStats)
+{
+    RB_UNUSED_PARAM
+    
+    GFX_LOCK;
+    TexPool::Stats stats = shState->texPool().stats();
+    BitmapAtlas::Stats atlasStats = shState->bitmapAtlas().stats();
+    GFX_UNLOCK;
+    
+    SharedFontState::Stats fontStats = shState->fontState().stats();
+    
+    VALUE ret = rb_hash_new();
+    
+#define SET_STAT(key, value) rb_hash_aset(ret, ID2SYM(rb_intern(key)), ULL2NUM(value))
+    SET_STAT("live_bytes",      stats.liveBytes);
+    SET_STAT("peak_live_bytes", stats.peakLiveBytes);
+    SET_STAT("live_count",      stats.liveCount);
+    SET_STAT("cached_bytes",    stats.cachedBytes);
+    SET_STAT("cached_count",    stats.cachedCount);
+    SET_STAT("external_bytes",  stats.externalBytes);
+    SET_STAT("hits",            stats.hits);
+    SET_STAT("resized_hits",    stats.resizedHits);
+    SET_STAT("misses",          stats.misses);
+    SET_STAT("evictions",       stats.evictions);
+    SET_STAT("cache_budget",    stats.cacheBudget);
+    SET_STAT("vram_budget",     stats.vramBudget);
+    SET_STAT("font_open_count", fontStats.openFonts);
+    SET_STAT("font_data_bytes", fontStats.dataBytes);
+    SET_STAT("font_data_count", fontStats.dataCount);
+    SET_STAT("font_hits",       fontStats.hits);
+    SET_STAT("font_misses",     fontStats.misses);
+    SET_STAT("font_evictions",  fontStats.evictions);
+    SET_STAT("atlas_pages",     atlasStats.pageCount);
+    SET_STAT("atlas_bitmaps",   atlasStats.regionCount);
+    SET_STAT("atlas_bytes",     atlasStats.liveBytes);
+    SET_STAT("atlas_capacity",  atlasStats.pageBytes);
+    SET_STAT("atlas_repacks",   atlasStats.repacks);
+    SET_STAT("atlas_moves",     atlasStats.moves);
+#undef SET_STAT
+    
+    return ret;
+}
+
+static VALUE pacingStatsHash(const Graphics::PacingStats &stats)
+{
+    VALUE ret = rb_hash_new();
+    
+    rb_hash_aset(ret, ID2SYM(rb_intern("count")), ULL2NUM(stats.count));
+    rb_hash_aset(ret, ID2SYM(rb_intern("mean")), rb_float_new(stats.mean));
+    rb_hash_aset(ret, ID2SYM(rb_intern("p50")), rb_float_new(stats.p50));
+    rb_hash_aset(ret, ID2SYM(rb_intern("p99")), rb_float_new(stats.p99));
+    rb_hash_aset(ret, ID2SYM(rb_intern("max")), rb_float_new(stats.max));
+    
+    return ret;
+}
+
+RB_METHOD(graphicsFramePacingStats)
+{
+    RB_UNUSED_PARAM
+    
+    return pacingStatsHash(shState->graphics().pacingStats());
+}
+
+RB_METHOD(graphicsInputLatencyStats)
+{
+    RB_UNUSED_PARAM
+    
+    return pacingStatsHash(shState->graphics().inputLatencyStats());
+}
+
+RB_METHOD(graphicsGLStats)
+{
+    RB_UNUSED_PARAM
+    
+    GLCounters stats = shState->graphics().glStats();
+    
+    VALUE ret = rb_hash_new();
+    
+#define SET_STAT(key, value) rb_hash_aset(ret, ID2SYM(rb_intern(key)), UINT2NUM(value))
+    SET_STAT("draw_calls",         stats.drawCalls);
+    SET_STAT("texture_binds",      stats.textureBinds);
+    SET_STAT("framebuffer_binds",  stats.framebufferBinds);
+    SET_STAT("buffer_binds",       stats.bufferBinds);
+    SET_STAT("vertex_array_binds", stats.vertexArrayBinds);
+    SET_STAT("program_binds",      stats.programBinds);
+    SET_STAT("uniform_uploads",    stats.uniformUploads);
+    SET_STAT("skipped_calls",      stats.skippedCalls);
+#undef SET_STAT
+    
+    return ret;
+}
+
+RB_METHOD(graphicsResetFramePacingStats)
+{
+    RB_UNUSED_PARAM
+    
+    shState->graphics().resetPacingStats();
+    
+    return Qnil;
+}
+
 DEF_GRA_PROP_I(FrameRate)
 DEF_GRA_PROP_I(FrameCount)
 DEF_GRA_PROP_I(Brightness)
@@ -395,6 +500,11 @@ void graphicsBindingInit()
     INIT_GRA_PROP_BIND( FrameRate,  "frame_rate"  );
     INIT_GRA_PROP_BIND( FrameCount, "frame_count" );
     _rb_define_module_function(module, "average_frame_rate", graphicsAverageFrameRate);
+    _rb_define_module_function(module, "memory_stats", graphicsMemoryStats);
+    _rb_define_module_function(module, "frame_pacing_stats", graphicsFramePacingStats);
+    _rb_define_module_function(module, "input_latency_stats", graphicsInputLatencyStats);
+    _rb_define_module_function(module, "gl_stats", graphicsGLStats);
+    _rb_define_module_function(module, "reset_frame_pacing_stats", graphicsResetFramePacingStats);
 
     _rb_define_module_function(module, "width", graphicsWidth);
     _rb_define_module_function(module, "height", graphicsHeight);
@@ -306,6 +306,32 @@ RB_METHOD(inputRawKeyStates) {
     return ret;
 }
 
+RB_METHOD(inputEvents) {
+    RB_UNUSED_PARAM
+    
+    static const char *typeNames[] = {
+        "key_down", "key_up",
+        "controller_down", "controller_up",
+        "mouse_down", "mouse_up"
+    };
+    
+    const std::vector<Input::Event> &events = shState->input().events();
+    VALUE ret = rb_ary_new2(events.size());
+    
+    for (size_t i = 0; i < events.size(); i++) {
+        const Input::Event &ev = events[i];
+        VALUE hash = rb_hash_new();
+        
+        rb_hash_aset(hash, ID2SYM(rb_intern("type")), ID2SYM(rb_intern(typeNames[ev.type])));
+        rb_hash_aset(hash, ID2SYM(rb_intern("code")), INT2NUM(ev.code));
+        rb_hash_aset(hash, ID2SYM(rb_intern("time")), rb_float_new(ev.time));
+        
+        rb_ary_push(ret, hash);
+    }
+    
+    return ret;
+}
+
 #define M_SYMBOL(x) ID2SYM(rb_intern(x))
 #define POWERCASE(v, c)                                                        \
 case SDL_JOYSTICK_POWER_##c:                                                 \
@@ -355,7 +381,7 @@ RB_METHOD(inputControllerPowerLevel) {
 RB_METHOD(inputControllerGet##n##Axis) {\
 RB_UNUSED_PARAM; \
 VALUE ret = rb_ary_new(); \
-if (!shState->eThread().getControllerConnected()) {\
+if (!shState->input().getControllerConnected()) {\
 rb_ary_push(ret, rb_float_new(0)); rb_ary_push(ret, rb_float_new(0)); \
 }\
 rb_ary_push(ret, rb_float_new(shState->input().getControllerAxisValue(SDL_CONTROLLER_AXIS_##ax1) / 32767.0)); \
@@ -497,10 +523,8 @@ RB_METHOD(inputSetMode) {
 
 RB_METHOD(inputGets) {
     RB_UNUSED_PARAM
-    shState->eThread().lockText(true);
     VALUE ret = rb_utf8_str_new_cstr(shState->input().getText());
     shState->input().clearText();
-    shState->eThread().lockText(false);
     return ret;
 }
 
@@ -591,6 +615,7 @@ void inputBindingInit() {
     _rb_define_module_function(module, "mouse_in_window?", inputMouseInWindow);
     
     _rb_define_module_function(module, "raw_key_states", inputRawKeyStates);
+    _rb_define_module_function(module, "events", inputEvents);
     
     VALUE submod = rb_define_module_under(module, "Controller");
     _rb_define_module_function(submod, "connected?", inputControllerConnected);
@@ -0,0 +1,223 @@
+/*
+ ** iseq-cache.cpp
+ **
+ ** This file is part of mkxp.
+ **
+ ** mkxp is free software: you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation, either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** mkxp is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "iseq-cache.h"
+
+#ifdef MKXPZ_ISEQ_CACHE
+
+#include "debugwriter.h"
+#include "fnv1a.h"
+
+#include <string.h>
+
+#define ISEQ_CACHE_MAGIC "MKXPISQ1"
+
+/* Sanity limit for a single entry */
+#define ISEQ_MAX_ENTRY_SIZE (64 * 1024 * 1024)
+
+uint64_t ISeqCache::makeKey(const char *fname, const char *source, size_t sourceLen)
+{
+	uint64_t hash = fnv1aSeed;
+
+	/* Binaries are only loadable by the exact Ruby build that made them */
+	hash = fnv1a(hash, ruby_description, strlen(ruby_description) + 1);
+	hash = fnv1a(hash, fname, strlen(fname) + 1);
+	hash = fnv1a(hash, source, sourceLen);
+
+	return hash;
+}
+
+static VALUE iseqClass()
+{
+	return rb_path2class("RubyVM::InstructionSequence");
+}
+
+static VALUE iseqLoad(VALUE binary)
+{
+	return rb_funcall(iseqClass(), rb_intern("load_from_binary"), 1, binary);
+}
+
+static VALUE iseqCompile(VALUE arg)
+{
+	VALUE *args = reinterpret_cast<VALUE*>(arg);
+
+	/* source, file, path */
+	return rb_funcall(iseqClass(), rb_intern("compile"), 3, args[0], args[1], args[1]);
+}
+
+static VALUE iseqToBinary(VALUE iseq)
+{
+	return rb_funcall(iseq, rb_intern("to_binary"), 0);
+}
+
+static VALUE iseqEval(VALUE iseq)
+{
+	return rb_funcall(iseq, rb_intern("eval"), 0);
+}
+
+ISeqCache::ISeqCache(const std::string &path, const std::vector<uint64_t> &keys)
+    : path(path),
+      out(0),
+      hits(0)
+{
+	BoostSet<uint64_t> wanted;
+
+	for (size_t i = 0; i < keys.size(); ++i)
+		wanted.insert(keys[i]);
+
+	bool stale = true;
+	FILE *f = fopen(path.c_str(), "rb");
+
+	if (f)
+	{
+		char magic[8];
+
+		if (fread(magic, 1, sizeof(magic), f) == sizeof(magic) &&
+		    !memcmp(magic, ISEQ_CACHE_MAGIC, sizeof(magic)))
+		{
+			stale = false;
+
+			while (true)
+			{
+				uint64_t key;
+				uint32_t len;
+
+				if (fread(&key, sizeof(key), 1, f) < 1 ||
+				    fread(&len, sizeof(len), 1, f) < 1)
+					break;
+
+				if (len > ISEQ_MAX_ENTRY_SIZE)
+				{
+					stale = true;
+					break;
+				}
+
+				std::string binary(len, '\0');
+
+				if (len > 0 && fread(&binary[0], 1, len, f) < len)
+				{
+					stale = true;
+					break;
+				}
+
+				if (wanted.contains(key))
+					entries.insert(key, binary);
+				else
+					stale = true;
+			}
+		}
+
+		fclose(f);
+	}
+
+	if (stale)
+		rewrite();
+	else
+		out = fopen(path.c_str(), "ab");
+}
+
+ISeqCache::~ISeqCache()
+{
+	if (out)
+		fclose(out);
+}
+
+void ISeqCache::rewrite()
+{
+	if (out)
+		fclose(out);
+
+	out = fopen(path.c_str(), "wb");
+
+	if (!out)
+	{
+		Debug() << "Unable to write script cache" << path;
+		return;
+	}
+
+	fwrite(ISEQ_CACHE_MAGIC, 1, strlen(ISEQ_CACHE_MAGIC), out);
+
+	for (BoostHash<uint64_t, std::string>::const_iterator iter = entries.cbegin();
+	     iter != entries.cend(); ++iter)
+		append(iter->first, iter->second);
+}
+
+void ISeqCache::append(uint64_t key, const std::string &binary)
+{
+	if (!out)
+		return;
+
+	uint32_t len = binary.size();
+
+	fwrite(&key, sizeof(key), 1, out);
+	fwrite(&len, sizeof(len), 1, out);
+	fwrite(binary.data(), 1, len, out);
+
+	/* The last section usually never returns (it runs
+	 * the game loop), so don't hold anything back */
+	fflush(out);
+}
+
+VALUE ISeqCache::eval(uint64_t key, VALUE string, VALUE fname, int *state)
+{
+	int loadState = 0;
+
+	if (entries.contains(key))
+	{
+		const std::string &binary = entries[key];
+		VALUE iseq = rb_protect(iseqLoad, rb_str_new(binary.data(), binary.size()), &loadState);
+
+		if (!loadState)
+		{
+			++hits;
+			return rb_protect(iseqEval, iseq, state);
+		}
+
+		/* Corrupt or otherwise unloadable, drop it from
+		 * the file too and compile it anew */
+		rb_set_errinfo(Qnil);
+		entries.remove(key);
+		rewrite();
+	}
+
+	/* Syntax errors surface here just like they would from eval */
+	VALUE args[] = { string, fname };
+	VALUE iseq = rb_protect(iseqCompile, reinterpret_cast<VALUE>(args), state);
+
+	if (*state)
+		return Qnil;
+
+	VALUE binary = rb_protect(iseqToBinary, iseq, &loadState);
+
+	if (!loadState)
+	{
+		std::string data(RSTRING_PTR(binary), RSTRING_LEN(binary));
+		append(key, data);
+		entries.insert(key, data);
+	}
+	else
+	{
+		/* Not serializable, that's fine */
+		rb_set_errinfo(Qnil);
+	}
+
+	return rb_protect(iseqEval, iseq, state);
+}
+
+#endif // MKXPZ_ISEQ_CACHE
@@ -0,0 +1,71 @@
+/*
+ ** iseq-cache.h
+ **
+ ** This file is part of mkxp.
+ **
+ ** mkxp is free software: you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation, either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** mkxp is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ISEQ_CACHE_H
+#define ISEQ_CACHE_H
+
+#include "binding-util.h"
+#include "boost-hash.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+/* RubyVM::InstructionSequence#to_binary exists since 2.3,
+ * but wasn't reliable enough to persist before 2.5 */
+#if RAPI_FULL >= 250
+#define MKXPZ_ISEQ_CACHE
+#endif
+
+/* On-disk cache of compiled script sections.
+ *
+ * Entries are keyed by a hash over the Ruby build, the section's
+ * file name and its source, so a changed section (or a different
+ * Ruby) simply misses. The file only ever holds the entries of
+ * the most recently run script pack; stale ones are dropped when
+ * it is opened. */
+class ISeqCache
+{
+public:
+	static uint64_t makeKey(const char *fname, const char *source, size_t sourceLen);
+
+	/* "keys" are those of every section about to be run */
+	ISeqCache(const std::string &path, const std::vector<uint64_t> &keys);
+	~ISeqCache();
+
+	/* Like evaluating "string" with "fname" as file name, but
+	 * goes through the cache. Exceptions are reported through
+	 * "state" like rb_protect does */
+	VALUE eval(uint64_t key, VALUE string, VALUE fname, int *state);
+
+	size_t hitCount() const { return hits; }
+
+private:
+	void rewrite();
+	void append(uint64_t key, const std::string &binary);
+
+	std::string path;
+	BoostHash<uint64_t, std::string> entries;
+	FILE *out;
+
+	size_t hits;
+};
+
+#endif // ISEQ_CACHE_H
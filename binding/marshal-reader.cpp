@@ -0,0 +1,565 @@
+/*
+ ** marshal-reader.cpp
+ **
+ ** This file is part of mkxp.
+ **
+ ** mkxp is free software: you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation, either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** mkxp is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "marshal-reader.h"
+
+#if RAPI_FULL > 187
+
+#include "etc.h"
+#include "table.h"
+#include "util.h"
+
+#include "ruby/encoding.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#define MARSHAL_MAJOR 4
+#define MARSHAL_MINOR 8
+
+/* Thrown on anything outside the subset we handle,
+ * the whole load is then redone by Ruby's Marshal */
+struct Unsupported {};
+
+/* Everything Ruby allocates while reading is kept reachable
+ * through Ruby containers held on the stack, so that exceptions
+ * raised by Ruby (unknown classes, failing _load) can longjmp
+ * through here without leaking anything */
+struct MarshalReader
+{
+    const char *p;
+    const char *end;
+
+    VALUE symbols;
+    VALUE objects;
+    VALUE classes;
+
+    /* Our own serializable classes, and whether their
+     * _load is still the native one (Qnil = not checked yet) */
+    VALUE nativeClass[4];
+    VALUE nativeChecked[4];
+
+    ID idLoad;
+    ID idMarshalLoad;
+    ID idDefault;
+    ID idE;
+    ID idEncoding;
+
+    int utf8Idx;
+
+    unsigned char byte()
+    {
+        if (p >= end)
+            throw Unsupported();
+
+        return *p++;
+    }
+
+    long readLong()
+    {
+        signed char c = byte();
+
+        if (c == 0)
+            return 0;
+
+        if (c > 0)
+        {
+            if (c > 4)
+                return c - 5;
+
+            long x = 0;
+
+            for (int i = 0; i < c; ++i)
+                x |= (long) byte() << (8 * i);
+
+            return x;
+        }
+
+        if (c < -4)
+            return c + 5;
+
+        long x = -1;
+
+        for (int i = 0; i < -c; ++i)
+        {
+            x &= ~((long) 0xFF << (8 * i));
+            x |= (long) byte() << (8 * i);
+        }
+
+        return x;
+    }
+
+    const char *readBytes(long &len)
+    {
+        len = readLong();
+
+        if (len < 0 || len > end - p)
+            throw Unsupported();
+
+        const char *bytes = p;
+        p += len;
+
+        return bytes;
+    }
+
+    VALUE entry(VALUE obj)
+    {
+        rb_ary_push(objects, obj);
+
+        return obj;
+    }
+
+    int encodingIndex(ID id, VALUE value)
+    {
+        int idx = -1;
+
+        if (id == idE)
+            idx = RTEST(value) ? utf8Idx : rb_usascii_encindex();
+        else if (id == idEncoding && RB_TYPE_P(value, RUBY_T_STRING))
+            idx = rb_enc_find_index(StringValueCStr(value));
+
+        /* Marshal.load would turn binary strings into UTF-8 anyway */
+        if (idx == rb_ascii8bit_encindex())
+            idx = utf8Idx;
+
+        return idx;
+    }
+
+    VALUE symReal(bool ivar)
+    {
+        long len;
+        const char *bytes = readBytes(len);
+
+        /* The index is taken before any encoding ivars are read */
+        long index = RARRAY_LEN(symbols);
+        rb_ary_push(symbols, Qnil);
+
+        int encIdx = -1;
+
+        if (ivar)
+        {
+            long count = readLong();
+
+            while (count-- > 0)
+            {
+                ID id = SYM2ID(readSymbol());
+                encIdx = encodingIndex(id, readObject(0));
+            }
+        }
+
+        rb_encoding *enc = encIdx >= 0 ? rb_enc_from_index(encIdx) : rb_usascii_encoding();
+        VALUE sym = ID2SYM(rb_intern3(bytes, len, enc));
+        rb_ary_store(symbols, index, sym);
+
+        return sym;
+    }
+
+    VALUE symLink()
+    {
+        long index = readLong();
+
+        if (index < 0 || index >= RARRAY_LEN(symbols))
+            throw Unsupported();
+
+        return rb_ary_entry(symbols, index);
+    }
+
+    VALUE readSymbol()
+    {
+        unsigned char type = byte();
+        bool ivar = false;
+
+        if (type == 'I')
+        {
+            ivar = true;
+            type = byte();
+        }
+
+        switch (type)
+        {
+        case ':' :
+            return symReal(ivar);
+        case ';' :
+            if (!ivar)
+                return symLink();
+        }
+
+        throw Unsupported();
+    }
+
+    VALUE readClass()
+    {
+        VALUE sym = readSymbol();
+        VALUE klass = rb_hash_lookup2(classes, sym, Qundef);
+
+        if (klass == Qundef)
+        {
+            klass = rb_path_to_class(rb_id2str(SYM2ID(sym)));
+            rb_hash_aset(classes, sym, klass);
+        }
+
+        return klass;
+    }
+
+    void readIvars(VALUE obj)
+    {
+        long count = readLong();
+
+        while (count-- > 0)
+        {
+            ID id = SYM2ID(readSymbol());
+            VALUE value = readObject(0);
+
+            if (RB_TYPE_P(obj, RUBY_T_STRING) && (id == idE || id == idEncoding))
+            {
+                int idx = encodingIndex(id, value);
+
+                if (idx >= 0)
+                    rb_enc_associate_index(obj, idx);
+            }
+            else
+            {
+                rb_ivar_set(obj, id, value);
+            }
+        }
+    }
+
+    bool isNativeLoad(int i, VALUE klass)
+    {
+        if (klass != nativeClass[i])
+            return false;
+
+        /* Scripts are free to override _load, in which case
+         * it's no longer ours to skip. C methods have no
+         * source location */
+        if (NIL_P(nativeChecked[i]))
+        {
+            VALUE method = rb_funcall(klass, rb_intern("method"), 1, ID2SYM(idLoad));
+            VALUE location = rb_funcall(method, rb_intern("source_location"), 0);
+            nativeChecked[i] = NIL_P(location) ? Qtrue : Qfalse;
+        }
+
+        return RTEST(nativeChecked[i]);
+    }
+
+    template<class C>
+    VALUE loadNative(VALUE klass, const char *data, long len)
+    {
+        /* Matches objectLoad(), minus the intermediate string */
+        VALUE obj = rb_obj_alloc(klass);
+
+        C *c = 0;
+
+        GUARD_EXC(c = C::deserialize(data, len);)
+
+        setPrivateData(obj, c);
+
+        return obj;
+    }
+
+    VALUE readUserDef(bool *ivp)
+    {
+        VALUE klass = readClass();
+
+        long len;
+        const char *bytes = readBytes(len);
+
+        /* Ivars (string encoding) would apply to the data string,
+         * which only exists on the slow path */
+        if (!(ivp && *ivp))
+        {
+            if (isNativeLoad(0, klass))
+                return entry(loadNative<Table>(klass, bytes, len));
+            if (isNativeLoad(1, klass))
+                return entry(loadNative<Color>(klass, bytes, len));
+            if (isNativeLoad(2, klass))
+                return entry(loadNative<Tone>(klass, bytes, len));
+            if (isNativeLoad(3, klass))
+                return entry(loadNative<Rect>(klass, bytes, len));
+        }
+
+        VALUE data = rb_str_new(bytes, len);
+
+        if (ivp && *ivp)
+        {
+            readIvars(data);
+            *ivp = false;
+        }
+
+        return entry(rb_funcall2(klass, idLoad, 1, &data));
+    }
+
+    VALUE readFloat()
+    {
+        long len;
+        const char *bytes = readBytes(len);
+
+        char buf[64];
+
+        if (len >= (long) sizeof(buf))
+            throw Unsupported();
+
+        memcpy(buf, bytes, len);
+        buf[len] = '\0';
+
+        double d;
+
+        if (!strcmp(buf, "nan"))
+            d = NAN;
+        else if (!strcmp(buf, "inf"))
+            d = INFINITY;
+        else if (!strcmp(buf, "-inf"))
+            d = -INFINITY;
+        else
+            /* Stops at the NUL before any legacy mantissa bytes */
+            d = rb_cstr_to_dbl(buf, 0);
+
+        return entry(DBL2NUM(d));
+    }
+
+    VALUE readBignum()
+    {
+#if RAPI_FULL >= 210
+        unsigned char sign = byte();
+        long words = readLong();
+
+        if (words < 0 || words > (end - p) / 2)
+            throw Unsupported();
+
+        int flags = INTEGER_PACK_LITTLE_ENDIAN;
+
+        if (sign == '-')
+            flags |= INTEGER_PACK_NEGATIVE;
+
+        VALUE num = rb_integer_unpack(p, words * 2, 1, 0, flags);
+        p += words * 2;
+
+        return entry(num);
+#else
+        throw Unsupported();
+#endif
+    }
+
+    VALUE readObject(bool *ivp)
+    {
+        unsigned char type = byte();
+
+        switch (type)
+        {
+        case '0' :
+            return Qnil;
+        case 'T' :
+            return Qtrue;
+        case 'F' :
+            return Qfalse;
+        case 'i' :
+            return LONG2NUM(readLong());
+
+        case ':' :
+            if (ivp && *ivp)
+            {
+                *ivp = false;
+                return symReal(true);
+            }
+            return symReal(false);
+        case ';' :
+            return symLink();
+
+        case '@' :
+        {
+            long index = readLong();
+
+            if (index < 0 || index >= RARRAY_LEN(objects))
+                throw Unsupported();
+
+            return rb_ary_entry(objects, index);
+        }
+
+        case 'I' :
+        {
+            bool ivar = true;
+            VALUE obj = readObject(&ivar);
+
+            if (ivar)
+                readIvars(obj);
+
+            return obj;
+        }
+
+        case '"' :
+        {
+            long len;
+            const char *bytes = readBytes(len);
+
+            /* Encoding ivars, if any, adjust this afterwards */
+            return entry(rb_enc_str_new(bytes, len, rb_enc_from_index(utf8Idx)));
+        }
+
+        case 'f' :
+            return readFloat();
+        case 'l' :
+            return readBignum();
+
+        case '[' :
+        {
+            long len = readLong();
+
+            if (len < 0)
+                throw Unsupported();
+
+            VALUE ary = entry(rb_ary_new2(len));
+
+            for (long i = 0; i < len; ++i)
+                rb_ary_push(ary, readObject(0));
+
+            return ary;
+        }
+
+        case '{' :
+        case '}' :
+        {
+            long len = readLong();
+
+            if (len < 0)
+                throw Unsupported();
+
+            VALUE hash = entry(rb_hash_new());
+
+            for (long i = 0; i < len; ++i)
+            {
+                VALUE key = readObject(0);
+                VALUE value = readObject(0);
+                rb_hash_aset(hash, key, value);
+            }
+
+            if (type == '}')
+            {
+                VALUE ifnone = readObject(0);
+                rb_funcall2(hash, idDefault, 1, &ifnone);
+            }
+
+            return hash;
+        }
+
+        case 'o' :
+        {
+            VALUE klass = readClass();
+
+            if (!RB_TYPE_P(klass, RUBY_T_CLASS))
+                throw Unsupported();
+
+            VALUE obj = rb_obj_alloc(klass);
+
+            if (!RB_TYPE_P(obj, RUBY_T_OBJECT))
+                throw Unsupported();
+
+            entry(obj);
+            readIvars(obj);
+
+            return obj;
+        }
+
+        case 'u' :
+            return readUserDef(ivp);
+
+        case 'U' :
+        {
+            VALUE klass = readClass();
+            VALUE obj = entry(rb_obj_alloc(klass));
+            VALUE data = readObject(0);
+            rb_funcall2(obj, idMarshalLoad, 1, &data);
+
+            return obj;
+        }
+
+        case 'c' :
+        case 'm' :
+        {
+            long len;
+            const char *bytes = readBytes(len);
+
+            return entry(rb_path_to_class(rb_str_new(bytes, len)));
+        }
+        }
+
+        /* Extended objects, user classes, structs,
+         * regexps and data objects */
+        throw Unsupported();
+    }
+};
+
+VALUE marshalLoadNative(VALUE data)
+{
+    if (!RB_TYPE_P(data, RUBY_T_STRING))
+        return Qundef;
+
+    MarshalReader r;
+    r.p = RSTRING_PTR(data);
+    r.end = r.p + RSTRING_LEN(data);
+
+    r.symbols = rb_ary_new();
+    r.objects = rb_ary_new();
+    r.classes = rb_hash_new();
+
+    const char *names[] = { "Table", "Color", "Tone", "Rect" };
+
+    for (size_t i = 0; i < ARRAY_SIZE(names); ++i)
+    {
+        r.nativeClass[i] = rb_const_get(rb_cObject, rb_intern(names[i]));
+        r.nativeChecked[i] = Qnil;
+    }
+
+    r.idLoad = rb_intern("_load");
+    r.idMarshalLoad = rb_intern("marshal_load");
+    r.idDefault = rb_intern("default=");
+    r.idE = rb_intern("E");
+    r.idEncoding = rb_intern("encoding");
+    r.utf8Idx = rb_utf8_encindex();
+
+    VALUE result;
+
+    try
+    {
+        if (r.byte() != MARSHAL_MAJOR || r.byte() > MARSHAL_MINOR)
+            return Qundef;
+
+        result = r.readObject(0);
+    }
+    catch (const Unsupported &)
+    {
+        return Qundef;
+    }
+
+    RB_GC_GUARD(r.symbols);
+    RB_GC_GUARD(r.objects);
+    RB_GC_GUARD(r.classes);
+    RB_GC_GUARD(data);
+
+    return result;
+}
+
+#else
+
+VALUE marshalLoadNative(VALUE)
+{
+    return Qundef;
+}
+
+#endif // RAPI_FULL > 187
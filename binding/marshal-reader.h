@@ -0,0 +1,36 @@
+/*
+ ** marshal-reader.h
+ **
+ ** This file is part of mkxp.
+ **
+ ** mkxp is free software: you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation, either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** mkxp is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MARSHAL_READER_H
+#define MARSHAL_READER_H
+
+#include "binding-util.h"
+
+/* Native reader for the part of the Marshal format that RPG Maker
+ * data files are made of (plain objects, arrays, hashes, strings
+ * and the _dump'ed Table/Color/Tone/Rect). Strings without an
+ * explicit encoding come out as UTF-8, same as through our
+ * Marshal.load override.
+ *
+ * Returns Qundef when the data contains anything it doesn't
+ * handle, in which case the caller should hand the same data
+ * to Ruby's Marshal.load instead. */
+VALUE marshalLoadNative(VALUE data);
+
+#endif // MARSHAL_READER_H
@@ -0,0 +1,104 @@
+/*
+** preloader-binding.cpp
+**
+** This file is part of mkxp.
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "preloader.h"
+#include "sharedstate.h"
+#include "binding-util.h"
+#include "exception.h"
+
+#include <string.h>
+
+static Preloader::Kind getKindArg(VALUE kind)
+{
+	if (!SYMBOL_P(kind))
+		rb_raise(rb_eTypeError, "Preloader kind must be a Symbol");
+
+	const char *name = rb_id2name(SYM2ID(kind));
+
+	if (!strcmp(name, "image"))
+		return Preloader::Image;
+
+	if (!strcmp(name, "sound"))
+		return Preloader::Sound;
+
+	if (!strcmp(name, "data"))
+		return Preloader::Data;
+
+	if (!strcmp(name, "stream"))
+		return Preloader::Stream;
+
+	rb_raise(rb_eArgError, "%s is not a valid Preloader kind (image, sound, data, stream)", name);
+
+	return Preloader::Image;
+}
+
+static void requestPath(Preloader::Kind kind, VALUE path)
+{
+	SafeStringValue(path);
+
+	GUARD_EXC( shState->preloader().request(kind, RSTRING_PTR(path)); )
+}
+
+RB_METHOD(preloaderRequest)
+{
+	RB_UNUSED_PARAM
+
+	VALUE kind, paths;
+	rb_scan_args(argc, argv, "2", &kind, &paths);
+
+	Preloader::Kind k = getKindArg(kind);
+
+	if (RB_TYPE_P(paths, RUBY_T_ARRAY))
+	{
+		for (long i = 0; i < RARRAY_LEN(paths); ++i)
+			requestPath(k, rb_ary_entry(paths, i));
+	}
+	else
+	{
+		requestPath(k, paths);
+	}
+
+	return Qnil;
+}
+
+RB_METHOD(preloaderPending)
+{
+	RB_UNUSED_PARAM
+
+	return ULONG2NUM(shState->preloader().pending());
+}
+
+RB_METHOD(preloaderClear)
+{
+	RB_UNUSED_PARAM
+
+	shState->preloader().clear();
+
+	return Qnil;
+}
+
+void
+preloaderBindingInit()
+{
+	VALUE module = rb_define_module("Preloader");
+
+	_rb_define_module_function(module, "request", preloaderRequest);
+	_rb_define_module_function(module, "pending", preloaderPending);
+	_rb_define_module_function(module, "clear", preloaderClear);
+}
@@ -0,0 +1,368 @@
+/*
+** rpgcache-binding.cpp
+**
+** This file is part of mkxp.
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "bitmap.h"
+#include "sharedstate.h"
+#include "config.h"
+#include "binding-util.h"
+#include "binding-types.h"
+#include "boost-hash.h"
+#include "intrulist.h"
+
+#include <stdio.h>
+#include <string>
+
+/* Native RPG::Cache for RGSS1, replacing the Ruby one that
+ * kept every bitmap it ever loaded.
+ *
+ * Bitmaps are held on to in least recently used order until
+ * their total size exceeds 'bitmapCacheSize'. Bitmaps let go
+ * of that way are only forgotten, never disposed, so sprites
+ * still showing them are unaffected. They are remembered weakly
+ * though: if one is still alive when it's requested again, it
+ * is taken back instead of loading a second copy. */
+
+struct CacheEntry
+{
+	std::string key;
+	VALUE bitmap;
+	size_t bytes;
+
+	IntruListLink<CacheEntry> link;
+
+	CacheEntry()
+	    : bitmap(Qnil),
+	      bytes(0),
+	      link(this)
+	{}
+};
+
+static struct
+{
+	/* Most recently used first. Has to outlive the
+	 * entries linked into it */
+	IntruList<CacheEntry> lru;
+	BoostHash<std::string, CacheEntry*> entries;
+
+	size_t bytes;
+	size_t budget;
+
+	/* Keeps the held bitmaps from being collected */
+	VALUE refs;
+
+	/* ObjectSpace::WeakMap with the bitmaps let go of,
+	 * nil on Rubies that don't support symbol keys */
+	VALUE released;
+
+	uint64_t hits;
+	uint64_t revived;
+	uint64_t misses;
+	uint64_t evictions;
+} cache;
+
+static VALUE keyString(const std::string &key)
+{
+	return rb_str_new(key.c_str(), key.size());
+}
+
+#if RAPI_FULL >= 270
+/* Static symbols are never collected, so they work
+ * as keys that don't go away on their own */
+static VALUE keySymbol(const std::string &key)
+{
+	return ID2SYM(rb_intern2(key.c_str(), key.size()));
+}
+#endif
+
+static VALUE newReleasedMap()
+{
+#if RAPI_FULL >= 270
+	return rb_class_new_instance(0, 0, rb_path2class("ObjectSpace::WeakMap"));
+#else
+	return Qnil;
+#endif
+}
+
+static Bitmap *bitmapData(VALUE bitmap)
+{
+#if RAPI_FULL > 187
+	return static_cast<Bitmap*>(RTYPEDDATA_DATA(bitmap));
+#else
+	return static_cast<Bitmap*>(DATA_PTR(bitmap));
+#endif
+}
+
+static bool bitmapUsable(VALUE bitmap)
+{
+	Bitmap *b = bitmapData(bitmap);
+
+	return b && !b->isDisposed();
+}
+
+static size_t bitmapBytes(VALUE bitmap)
+{
+	Bitmap *b = bitmapData(bitmap);
+
+	return (size_t) b->width() * b->height() * 4;
+}
+
+static void cacheUnlink(CacheEntry *entry)
+{
+	cache.lru.remove(entry->link);
+	cache.entries.remove(entry->key);
+	cache.bytes -= entry->bytes;
+
+	rb_hash_delete(cache.refs, keyString(entry->key));
+
+	delete entry;
+}
+
+static void cacheEvict()
+{
+	if (cache.budget == 0)
+		return;
+
+	/* The most recent entry always stays */
+	while (cache.bytes > cache.budget && cache.lru.getSize() > 1)
+	{
+		CacheEntry *entry = cache.lru.tail();
+
+#if RAPI_FULL >= 270
+		if (bitmapUsable(entry->bitmap))
+			rb_funcall(cache.released, rb_intern("[]="), 2,
+			           keySymbol(entry->key), entry->bitmap);
+#endif
+
+		cacheUnlink(entry);
+		++cache.evictions;
+	}
+}
+
+static void cacheInsert(VALUE key, VALUE bitmap)
+{
+	CacheEntry *entry = new CacheEntry;
+	entry->key = std::string(RSTRING_PTR(key), RSTRING_LEN(key));
+	entry->bitmap = bitmap;
+	entry->bytes = bitmapBytes(bitmap);
+
+	cache.entries.insert(entry->key, entry);
+	cache.lru.prepend(entry->link);
+	cache.bytes += entry->bytes;
+
+	rb_hash_aset(cache.refs, keyString(entry->key), bitmap);
+
+	cacheEvict();
+}
+
+/* Returns nil if 'key' has to be loaded */
+static VALUE cacheFind(VALUE key)
+{
+	std::string k(RSTRING_PTR(key), RSTRING_LEN(key));
+	CacheEntry *entry = cache.entries.value(k, 0);
+
+	if (entry)
+	{
+		/* Disposed by the game */
+		if (!bitmapUsable(entry->bitmap))
+		{
+			cacheUnlink(entry);
+			return Qnil;
+		}
+
+		cache.lru.remove(entry->link);
+		cache.lru.prepend(entry->link);
+		++cache.hits;
+
+		return entry->bitmap;
+	}
+
+#if RAPI_FULL >= 270
+	VALUE sym = keySymbol(k);
+	VALUE bitmap = rb_funcall(cache.released, rb_intern("[]"), 1, sym);
+
+	if (NIL_P(bitmap))
+		return Qnil;
+
+	rb_funcall(cache.released, rb_intern("delete"), 1, sym);
+
+	if (!bitmapUsable(bitmap))
+		return Qnil;
+
+	++cache.revived;
+	cacheInsert(key, bitmap);
+
+	return bitmap;
+#else
+	return Qnil;
+#endif
+}
+
+static VALUE makeKey(const char *prefix, VALUE path)
+{
+	VALUE key = rb_str_new_cstr(prefix);
+	rb_str_cat(key, RSTRING_PTR(path), RSTRING_LEN(path));
+
+	return key;
+}
+
+static VALUE bitmapClass()
+{
+	return rb_const_get(rb_cObject, rb_intern("Bitmap"));
+}
+
+static VALUE loadBitmap(VALUE path, bool empty, int hue)
+{
+	VALUE key = makeKey(":", path);
+	VALUE bitmap = cacheFind(key);
+
+	if (NIL_P(bitmap))
+	{
+		++cache.misses;
+
+		if (empty)
+			bitmap = rb_funcall(bitmapClass(), rb_intern("new"), 2, INT2FIX(32), INT2FIX(32));
+		else
+			bitmap = rb_funcall(bitmapClass(), rb_intern("new"), 1, path);
+
+		cacheInsert(key, bitmap);
+	}
+
+	if (hue == 0)
+		return bitmap;
+
+	char prefix[32];
+	snprintf(prefix, sizeof(prefix), "h%d:", hue);
+
+	key = makeKey(prefix, path);
+	VALUE variant = cacheFind(key);
+
+	if (!NIL_P(variant))
+		return variant;
+
+	++cache.misses;
+
+	variant = rb_funcall(bitmap, rb_intern("clone"), 0);
+	rb_funcall(variant, rb_intern("hue_change"), 1, INT2NUM(hue));
+
+	cacheInsert(key, variant);
+
+	return variant;
+}
+
+RB_METHOD(rpgCacheLoadBitmap)
+{
+	RB_UNUSED_PARAM
+
+	VALUE folder, filename, hue = INT2FIX(0);
+	rb_scan_args(argc, argv, "21", &folder, &filename, &hue);
+
+	SafeStringValue(folder);
+	SafeStringValue(filename);
+
+	return loadBitmap(rb_str_plus(folder, filename),
+	                  RSTRING_LEN(filename) == 0, NUM2INT(hue));
+}
+
+RB_METHOD(rpgCacheTile)
+{
+	VALUE filename, tileId, hue;
+	rb_scan_args(argc, argv, "3", &filename, &tileId, &hue);
+
+	SafeStringValue(filename);
+
+	int id = NUM2INT(tileId);
+
+	char prefix[64];
+	snprintf(prefix, sizeof(prefix), "t%d,%d:", id, NUM2INT(hue));
+
+	VALUE key = makeKey(prefix, filename);
+	VALUE bitmap = cacheFind(key);
+
+	if (!NIL_P(bitmap))
+		return bitmap;
+
+	++cache.misses;
+
+	/* Goes through the module like the Ruby version
+	 * did, in case scripts redefine any of it */
+	VALUE tileset = rb_funcall(self, rb_intern("tileset"), 1, filename);
+	VALUE rect = rb_funcall(rb_const_get(rb_cObject, rb_intern("Rect")), rb_intern("new"), 4,
+	                        INT2FIX((id - 384) % 8 * 32), INT2FIX((id - 384) / 8 * 32),
+	                        INT2FIX(32), INT2FIX(32));
+
+	bitmap = rb_funcall(bitmapClass(), rb_intern("new"), 2, INT2FIX(32), INT2FIX(32));
+	rb_funcall(bitmap, rb_intern("blt"), 4, INT2FIX(0), INT2FIX(0), tileset, rect);
+	rb_funcall(bitmap, rb_intern("hue_change"), 1, hue);
+
+	cacheInsert(key, bitmap);
+
+	return bitmap;
+}
+
+RB_METHOD(rpgCacheClear)
+{
+	RB_UNUSED_PARAM
+
+	while (!cache.lru.isEmpty())
+		cacheUnlink(cache.lru.tail());
+
+	cache.released = newReleasedMap();
+
+	rb_gc_start();
+
+	return Qnil;
+}
+
+RB_METHOD(rpgCacheStats)
+{
+	RB_UNUSED_PARAM
+
+	VALUE ret = rb_hash_new();
+
+#define SET_STAT(key, value) rb_hash_aset(ret, ID2SYM(rb_intern(key)), ULL2NUM(value))
+	SET_STAT("cached_bytes", cache.bytes);
+	SET_STAT("cached_count", cache.lru.getSize());
+	SET_STAT("budget",       cache.budget);
+	SET_STAT("hits",         cache.hits);
+	SET_STAT("revived",      cache.revived);
+	SET_STAT("misses",       cache.misses);
+	SET_STAT("evictions",    cache.evictions);
+#undef SET_STAT
+
+	return ret;
+}
+
+void
+rpgCacheBindingInit()
+{
+	cache.budget = (size_t) shState->config().bitmapCacheSize * 1024 * 1024;
+
+	cache.refs = rb_hash_new();
+	rb_gc_register_address(&cache.refs);
+
+	cache.released = newReleasedMap();
+	rb_gc_register_address(&cache.released);
+
+	VALUE module = rb_define_module_under(rb_define_module("RPG"), "Cache");
+
+	_rb_define_module_function(module, "load_bitmap", rpgCacheLoadBitmap);
+	_rb_define_module_function(module, "tile", rpgCacheTile);
+	_rb_define_module_function(module, "clear", rpgCacheClear);
+	_rb_define_module_function(module, "stats", rpgCacheStats);
+}
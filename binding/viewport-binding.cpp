@@ -100,6 +100,8 @@ DEF_GFX_PROP_OBJ_VAL(Viewport, Tone, Tone, "tone")
 DEF_GFX_PROP_I(Viewport, OX)
 DEF_GFX_PROP_I(Viewport, OY)
 
+DEF_GFX_PROP_B(Viewport, Cache)
+
 void viewportBindingInit() {
     VALUE klass = rb_define_class("Viewport", rb_cObject);
 #if RAPI_FULL > 187
@@ -120,4 +122,5 @@ void viewportBindingInit() {
     INIT_PROP_BIND(Viewport, OY, "oy")
     INIT_PROP_BIND(Viewport, Color, "color")
     INIT_PROP_BIND(Viewport, Tone, "tone")
+    INIT_PROP_BIND(Viewport, Cache, "cache")
 }
@@ -4,6 +4,8 @@ uniform mat4 projMat;
 uniform mat4 spriteMat;
 
 uniform vec2 texSizeInv;
+/* Where the bitmap sits inside an atlas page */
+uniform vec2 texOffset;
 uniform vec2 patternSizeInv;
 uniform vec2 patternScroll;
 uniform vec2 patternZoom;
@@ -20,7 +22,7 @@ void main()
 {
 	gl_Position = projMat * spriteMat * vec4(position, 0, 1);
     
-    v_texCoord = texCoord * texSizeInv;
+    v_texCoord = (texCoord + texOffset) * texSizeInv;
     
     if (renderPattern) {
         if (patternTile) {
@@ -25,6 +25,7 @@
 #include "al-util.h"
 
 #include <memory>
+#include <vector>
 
 struct ALDataSource
 {
@@ -66,4 +67,34 @@ std::unique_ptr<ALDataSource> createVorbisSource(SDL_RWops &ops,
 std::unique_ptr<ALDataSource> createMidiSource(SDL_RWops &ops,
                                                bool looped);
 
+/* A whole track decoded up front */
+struct DecodedAudio
+{
+	std::vector<uint8_t> pcm;
+
+	ALenum alFormat;
+	int rate;
+	int frameSize;
+
+	/* In frames; only valid if 'loopEnd' is non-zero */
+	uint32_t loopStart;
+	uint32_t loopEnd;
+
+	uint32_t frameCount() const
+	{
+		return pcm.size() / frameSize;
+	}
+};
+
+/* Plays from memory, so seeking is free */
+std::unique_ptr<ALDataSource> createDecodedSource(std::shared_ptr<const DecodedAudio> audio,
+                                                  bool looped);
+
+/* These decode all of 'ops' (closing it) into 'out', but give up
+ * early and return false once the result would exceed 'maxBytes' */
+bool decodeVorbis(SDL_RWops &ops, size_t maxBytes, DecodedAudio &out);
+
+bool decodeSDLSound(SDL_RWops &ops, const char *extension,
+                    size_t maxBytes, DecodedAudio &out);
+
 #endif // ALDATASOURCE_H
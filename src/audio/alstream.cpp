@@ -27,6 +27,7 @@
 #include "filesystem.h"
 #include "exception.h"
 #include "aldatasource.h"
+#include "streamcache.h"
 #include "fluid-fun.h"
 #include "sdl-util.h"
 #include "debugwriter.h"
@@ -199,6 +200,31 @@ void ALStream::closeSource()
 	source = nullptr;
 }
 
+/* Picks the source by the file signature. All source constructors
+ * close 'ops' before throwing errors */
+static std::unique_ptr<ALDataSource> createSource(SDL_RWops &ops,
+                                                  const char *ext,
+                                                  bool looped)
+{
+	/* Try to read ogg file signature */
+	std::array<char, 5> sig = { 0 };
+	SDL_RWread(&ops, sig.data(), 1, 4);
+	SDL_RWseek(&ops, 0, RW_SEEK_SET);
+
+	if (!strcmp(sig.data(), "OggS"))
+		return createVorbisSource(ops, looped);
+
+	if (!strcmp(sig.data(), "MThd"))
+	{
+		shState->midiState().initIfNeeded(shState->config());
+
+		if (HAVE_FLUID)
+			return createMidiSource(ops, looped);
+	}
+
+	return createSDLSource(ops, ext, STREAM_BUF_SIZE, looped);
+}
+
 struct ALStreamOpenHandler : FileSystem::OpenHandler
 {
 	SDL_RWops *srcOps;
@@ -217,36 +243,12 @@ struct ALStreamOpenHandler : FileSystem::OpenHandler
 		 * as we will continue reading data from it later */
 		*srcOps = ops;
 
-		/* Try to read ogg file signature */
-		std::array<char, 5> sig = { 0 };
-		SDL_RWread(srcOps, sig.data(), 1, 4);
-		SDL_RWseek(srcOps, 0, RW_SEEK_SET);
-
 		try
 		{
-			if (!strcmp(sig.data(), "OggS"))
-			{
-				source = createVorbisSource(*srcOps, looped);
-				return true;
-			}
-
-			if (!strcmp(sig.data(), "MThd"))
-			{
-				shState->midiState().initIfNeeded(shState->config());
-
-				if (HAVE_FLUID)
-				{
-					source = createMidiSource(*srcOps, looped);
-					return true;
-				}
-			}
-
-			source = createSDLSource(*srcOps, ext, STREAM_BUF_SIZE, looped);
+			source = createSource(*srcOps, ext, looped);
 		}
 		catch (const Exception &e)
 		{
-			/* All source constructors will close the passed ops
-			 * before throwing errors */
 			errorMsg = e.msg;
 			return false;
 		}
@@ -257,16 +259,46 @@ struct ALStreamOpenHandler : FileSystem::OpenHandler
 
 void ALStream::openSource(const std::string &filename)
 {
-	ALStreamOpenHandler handler(srcOps, looped);
-	shState->fileSystem().openRead(handler, filename.c_str());
-	source = std::move(handler.source);
+	std::string errorMsg;
+	StreamCache &cache = shState->streamCache();
+
+	if (cache.enabled())
+	{
+		SDL_RWops *ops = 0;
+		std::string ext;
+		std::shared_ptr<const DecodedAudio> decoded = cache.open(filename, ops, ext);
+
+		if (decoded)
+		{
+			source = createDecodedSource(decoded, looped);
+		}
+		else if (ops)
+		{
+			try
+			{
+				source = createSource(*ops, ext.empty() ? 0 : ext.c_str(), looped);
+			}
+			catch (const Exception &e)
+			{
+				errorMsg = e.msg;
+			}
+		}
+	}
+	else
+	{
+		ALStreamOpenHandler handler(srcOps, looped);
+		shState->fileSystem().openRead(handler, filename.c_str());
+		source = std::move(handler.source);
+		errorMsg = handler.errorMsg;
+	}
+
 	needsRewind.clear();
 
 	if (!source)
 	{
 		char buf[512];
 		snprintf(buf, sizeof(buf), "Unable to decode audio stream: %s: %s",
-		         filename.c_str(), handler.errorMsg.c_str());
+		         filename.c_str(), errorMsg.c_str());
 
 		Debug() << buf;
 	}
@@ -0,0 +1,114 @@
+/*
+** decodedsource.cpp
+**
+** This file is part of mkxp.
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "aldatasource.h"
+
+#include <algorithm>
+
+struct DecodedSource : ALDataSource
+{
+	std::shared_ptr<const DecodedAudio> audio;
+	bool looped;
+
+	uint32_t currentFrame;
+
+	/* Where playback wraps around, or stops */
+	uint32_t endFrame;
+	uint32_t loopStart;
+
+	/* Same amount of data per buffer as VorbisSource */
+	uint32_t bufFrames;
+
+	DecodedSource(std::shared_ptr<const DecodedAudio> audio,
+	              bool looped)
+	    : audio(audio),
+	      looped(looped),
+	      currentFrame(0)
+	{
+		const uint32_t total = audio->frameCount();
+
+		bool loopValid = looped && audio->loopEnd > audio->loopStart
+		                        && audio->loopEnd <= total;
+
+		endFrame = loopValid ? audio->loopEnd : total;
+		loopStart = loopValid ? audio->loopStart : 0;
+
+		bufFrames = std::max<uint32_t>(STREAM_BUF_SIZE * sizeof(int16_t) / audio->frameSize, 1);
+	}
+
+	Status fillBuffer(AL::Buffer::ID alBuffer)
+	{
+		uint32_t frames = std::min(bufFrames, endFrame - std::min(currentFrame, endFrame));
+		const uint8_t *data = audio->pcm.data() + (size_t) currentFrame * audio->frameSize;
+
+		AL::Buffer::uploadData(alBuffer, audio->alFormat, data,
+		                       frames * audio->frameSize, audio->rate);
+
+		currentFrame += frames;
+
+		if (currentFrame < endFrame)
+			return ALDataSource::NoError;
+
+		if (!looped)
+			return ALDataSource::EndOfStream;
+
+		currentFrame = loopStart;
+
+		return ALDataSource::WrapAround;
+	}
+
+	int sampleRate()
+	{
+		return audio->rate;
+	}
+
+	void seekToOffset(float seconds)
+	{
+		if (seconds <= 0)
+		{
+			currentFrame = 0;
+			return;
+		}
+
+		currentFrame = seconds * audio->rate;
+
+		if (looped && currentFrame > endFrame)
+			currentFrame = loopStart;
+
+		/* Same as a failed seek in VorbisSource */
+		if (currentFrame >= endFrame)
+			currentFrame = 0;
+	}
+
+	uint32_t loopStartFrames()
+	{
+		return loopStart;
+	}
+
+	bool setPitch(float)
+	{
+		return false;
+	}
+};
+
+std::unique_ptr<ALDataSource> createDecodedSource(std::shared_ptr<const DecodedAudio> audio,
+                                                  bool looped)
+{
+	return std::make_unique<DecodedSource>(audio, looped);
+}
@@ -128,3 +128,45 @@ std::unique_ptr<ALDataSource> createSDLSource(SDL_RWops &ops,
 {
 	return std::make_unique<SDLSoundSource>(ops, extension, maxBufSize, looped);
 }
+
+bool decodeSDLSound(SDL_RWops &ops, const char *extension,
+                    size_t maxBytes, DecodedAudio &out)
+{
+	SDLSoundSource source(ops, extension, STREAM_BUF_SIZE, false);
+	Sound_Sample *sample = source.sample;
+
+	const int frameSize = source.sampleSize * sample->actual.channels;
+
+	/* Not every decoder knows the duration up front */
+	Sint32 duration = Sound_GetDuration(sample);
+
+	if (duration > 0 && (uint64_t) duration * source.alFreq / 1000 * frameSize > maxBytes)
+		return false;
+
+	while (!(sample->flags & SOUND_SAMPLEFLAG_EOF))
+	{
+		uint32_t decoded = Sound_Decode(sample);
+
+		if (sample->flags & SOUND_SAMPLEFLAG_ERROR)
+			return false;
+
+		if ((sample->flags & SOUND_SAMPLEFLAG_EAGAIN) && decoded == 0)
+			return false;
+
+		if (out.pcm.size() + decoded > maxBytes)
+			return false;
+
+		const uint8_t *data = static_cast<const uint8_t*>(sample->buffer);
+		out.pcm.insert(out.pcm.end(), data, data + decoded);
+	}
+
+	out.pcm.resize(out.pcm.size() / frameSize * frameSize);
+
+	out.alFormat = source.alFormat;
+	out.rate = source.alFreq;
+	out.frameSize = frameSize;
+	out.loopStart = 0;
+	out.loopEnd = 0;
+
+	return !out.pcm.empty();
+}
@@ -22,6 +22,7 @@
 #include "soundemitter.h"
 
 #include "sharedstate.h"
+#include "preloader.h"
 #include "filesystem.h"
 #include "exception.h"
 #include "config.h"
@@ -202,10 +203,27 @@ std::shared_ptr<SoundBuffer> SoundEmitter::allocateBuffer(const std::string &fil
 	}
 	else
 	{
-		/* Buffer not in cache, needs to be loaded */
-		SoundOpenHandler handler;
-		shState->fileSystem().openRead(handler, filename.c_str());
-		buffer = handler.buffer;
+		/* Buffer not in cache, needs to be loaded
+		 * unless it has been decoded ahead of time */
+		Preloader::SoundData preloaded;
+
+		if (shState->preloader().takeSound(filename, preloaded))
+		{
+			buffer = std::make_shared<SoundBuffer>();
+			buffer->bytes = preloaded.pcm.size();
+
+			uint8_t sampleSize = formatSampleSize(preloaded.format);
+			ALenum alFormat = chooseALFormat(sampleSize, preloaded.channels);
+
+			AL::Buffer::uploadData(buffer->alBuffer, alFormat, preloaded.pcm.data(),
+			                       buffer->bytes, preloaded.rate);
+		}
+		else
+		{
+			SoundOpenHandler handler;
+			shState->fileSystem().openRead(handler, filename.c_str());
+			buffer = handler.buffer;
+		}
 
 		if (!buffer)
 		{
@@ -0,0 +1,372 @@
+/*
+** streamcache.cpp
+**
+** This file is part of mkxp.
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "streamcache.h"
+
+#include "aldatasource.h"
+#include "sharedstate.h"
+#include "filesystem.h"
+#include "exception.h"
+#include "sdl-util.h"
+
+#include <string.h>
+#include <algorithm>
+
+struct StreamCache::Entry
+{
+	std::string key;
+
+	/* One of these is set */
+	std::shared_ptr<const std::string> file;
+	std::shared_ptr<const DecodedAudio> decoded;
+
+	std::string ext;
+	size_t bytes;
+
+	bool cached;
+	bool decodeScheduled;
+
+	IntruListLink<Entry> link;
+
+	Entry()
+	    : bytes(0),
+	      cached(false),
+	      decodeScheduled(false),
+	      link(this)
+	{}
+};
+
+/* Read-only ops over a file kept in memory, which hold
+ * on to the data until they're closed */
+
+struct MemOpsData
+{
+	std::shared_ptr<const std::string> data;
+	Sint64 pos;
+};
+
+static MemOpsData *memData(SDL_RWops *ops)
+{
+	return static_cast<MemOpsData*>(ops->hidden.unknown.data1);
+}
+
+static Sint64 memSize(SDL_RWops *ops)
+{
+	return memData(ops)->data->size();
+}
+
+static Sint64 memSeek(SDL_RWops *ops, Sint64 offset, int whence)
+{
+	MemOpsData *d = memData(ops);
+	const Sint64 size = d->data->size();
+	Sint64 base;
+
+	switch (whence)
+	{
+	default:
+	case RW_SEEK_SET :
+		base = 0;
+		break;
+	case RW_SEEK_CUR :
+		base = d->pos;
+		break;
+	case RW_SEEK_END :
+		base = size;
+		break;
+	}
+
+	if (base + offset < 0)
+		return -1;
+
+	d->pos = std::min(base + offset, size);
+
+	return d->pos;
+}
+
+static size_t memRead(SDL_RWops *ops, void *buffer, size_t size, size_t maxnum)
+{
+	MemOpsData *d = memData(ops);
+
+	if (size == 0)
+		return 0;
+
+	size_t avail = d->data->size() - d->pos;
+	size_t num = std::min(maxnum, avail / size);
+
+	memcpy(buffer, d->data->data() + d->pos, num * size);
+	d->pos += num * size;
+
+	return num;
+}
+
+static size_t memWrite(SDL_RWops *, const void *, size_t, size_t)
+{
+	return 0;
+}
+
+static int memClose(SDL_RWops *ops)
+{
+	delete memData(ops);
+	SDL_FreeRW(ops);
+
+	return 0;
+}
+
+static SDL_RWops *createMemOps(const std::shared_ptr<const std::string> &data)
+{
+	SDL_RWops *ops = SDL_AllocRW();
+
+	ops->size = memSize;
+	ops->seek = memSeek;
+	ops->read = memRead;
+	ops->write = memWrite;
+	ops->close = memClose;
+	ops->type = SDL_RWOPS_UNKNOWN;
+	ops->hidden.unknown.data1 = new MemOpsData { data, 0 };
+
+	return ops;
+}
+
+struct FileOpenHandler : FileSystem::OpenHandler
+{
+	std::string data;
+	std::string ext;
+
+	bool tryRead(SDL_RWops &ops, const char *ext)
+	{
+		Sint64 size = SDL_RWsize(&ops);
+
+		if (size > 0)
+		{
+			data.resize(size);
+
+			if (SDL_RWread(&ops, &data[0], 1, size) != (size_t) size)
+				data.clear();
+		}
+
+		SDL_RWclose(&ops);
+
+		if (data.empty())
+			return false;
+
+		if (ext)
+			this->ext = ext;
+
+		return true;
+	}
+};
+
+static bool decodeFile(const std::shared_ptr<const std::string> &file,
+                       const std::string &ext, size_t maxBytes,
+                       DecodedAudio &out)
+{
+	/* MIDI is synthesized live */
+	if (file->compare(0, 4, "MThd") == 0)
+		return false;
+
+	SDL_RWops *ops = createMemOps(file);
+
+	try
+	{
+		if (file->compare(0, 4, "OggS") == 0)
+			return decodeVorbis(*ops, maxBytes, out);
+
+		return decodeSDLSound(*ops, ext.empty() ? 0 : ext.c_str(), maxBytes, out);
+	}
+	catch (const Exception &)
+	{
+		/* Keeps being streamed */
+	}
+
+	return false;
+}
+
+StreamCache::StreamCache(size_t budget)
+    : budget(budget),
+      bytes(0),
+      quit(false),
+      decodeThread(0)
+{
+	mutex = SDL_CreateMutex();
+	decodeCond = SDL_CreateCond();
+}
+
+StreamCache::~StreamCache()
+{
+	SDL_LockMutex(mutex);
+	quit = true;
+	SDL_CondSignal(decodeCond);
+	SDL_UnlockMutex(mutex);
+
+	if (decodeThread)
+		SDL_WaitThread(decodeThread, 0);
+
+	SDL_DestroyCond(decodeCond);
+	SDL_DestroyMutex(mutex);
+}
+
+bool StreamCache::enabled() const
+{
+	return budget > 0;
+}
+
+std::shared_ptr<const DecodedAudio>
+StreamCache::open(const std::string &filename, SDL_RWops *&ops, std::string &ext)
+{
+	SDL_LockMutex(mutex);
+
+	EntryPtr entry = entries.value(filename, EntryPtr());
+
+	if (entry)
+	{
+		lru.remove(entry->link);
+		lru.prepend(entry->link);
+	}
+
+	SDL_UnlockMutex(mutex);
+
+	if (!entry)
+	{
+		FileOpenHandler handler;
+		shState->fileSystem().openRead(handler, filename.c_str());
+
+		if (handler.data.empty())
+		{
+			ops = 0;
+			return std::shared_ptr<const DecodedAudio>();
+		}
+
+		entry = std::make_shared<Entry>();
+		entry->key = filename;
+		entry->file = std::make_shared<const std::string>(std::move(handler.data));
+		entry->ext = handler.ext;
+		entry->bytes = entry->file->size();
+
+		SDL_LockMutex(mutex);
+		insert(entry);
+		SDL_UnlockMutex(mutex);
+	}
+
+	SDL_LockMutex(mutex);
+
+	std::shared_ptr<const DecodedAudio> decoded = entry->decoded;
+	std::shared_ptr<const std::string> file = entry->file;
+	ext = entry->ext;
+
+	if (!decoded && entry->cached && !entry->decodeScheduled)
+		scheduleDecode(entry);
+
+	SDL_UnlockMutex(mutex);
+
+	if (decoded)
+		return decoded;
+
+	ops = createMemOps(file);
+
+	return std::shared_ptr<const DecodedAudio>();
+}
+
+/* The following are called with the lock held */
+
+void StreamCache::insert(const EntryPtr &entry)
+{
+	entries.insert(entry->key, entry);
+	lru.prepend(entry->link);
+
+	entry->cached = true;
+	bytes += entry->bytes;
+
+	evict();
+}
+
+void StreamCache::remove(Entry &entry)
+{
+	/* Anything still playing from the entry keeps its data
+	 * alive. This might drop the last reference to 'entry' */
+	const std::string key = entry.key;
+
+	lru.remove(entry.link);
+	entry.cached = false;
+	bytes -= entry.bytes;
+
+	entries.remove(key);
+}
+
+void StreamCache::evict()
+{
+	while (bytes > budget && !lru.isEmpty())
+		remove(*lru.tail());
+}
+
+void StreamCache::scheduleDecode(const EntryPtr &entry)
+{
+	if (!decodeThread)
+		decodeThread = createSDLThread
+			<StreamCache, &StreamCache::decodeMain>(this, "stream_decode");
+
+	entry->decodeScheduled = true;
+	decodeQueue.push_back(entry);
+	SDL_CondSignal(decodeCond);
+}
+
+void StreamCache::decodeMain()
+{
+	SDL_LockMutex(mutex);
+
+	while (true)
+	{
+		while (decodeQueue.empty() && !quit)
+			SDL_CondWait(decodeCond, mutex);
+
+		if (quit)
+			break;
+
+		EntryPtr entry = decodeQueue.front();
+		decodeQueue.pop_front();
+
+		if (!entry->cached)
+			continue;
+
+		std::shared_ptr<const std::string> file = entry->file;
+		std::string ext = entry->ext;
+
+		SDL_UnlockMutex(mutex);
+
+		/* Leave room for a few other tracks */
+		auto decoded = std::make_shared<DecodedAudio>();
+		bool ok = decodeFile(file, ext, budget / 4, *decoded);
+
+		SDL_LockMutex(mutex);
+
+		if (!ok || !entry->cached)
+			continue;
+
+		bytes -= entry->bytes;
+
+		entry->decoded = decoded;
+		entry->file.reset();
+		entry->bytes = decoded->pcm.size();
+
+		bytes += entry->bytes;
+
+		evict();
+	}
+
+	SDL_UnlockMutex(mutex);
+}
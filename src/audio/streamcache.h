@@ -0,0 +1,88 @@
+/*
+** streamcache.h
+**
+** This file is part of mkxp.
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef STREAMCACHE_H
+#define STREAMCACHE_H
+
+#include "boost-hash.h"
+#include "intrulist.h"
+
+#include <SDL_rwops.h>
+#include <SDL_mutex.h>
+#include <SDL_thread.h>
+
+#include <deque>
+#include <memory>
+#include <string>
+
+struct DecodedAudio;
+
+/* Keeps recently played BGM/BGS/ME around so that switching
+ * back to them doesn't mean reading and parsing the file again.
+ *
+ * A track is first kept as the file's contents, streamed from
+ * memory. Tracks whose decoded form fits into a quarter of the
+ * budget are then decoded in the background, after which they
+ * can be started and seeked without any decoding at all. Least
+ * recently played tracks are dropped once the budget is used up. */
+class StreamCache
+{
+public:
+	/* A 'budget' of 0 disables the cache */
+	StreamCache(size_t budget);
+	~StreamCache();
+
+	bool enabled() const;
+
+	/* Returns the decoded track for 'filename' if there is one.
+	 * Otherwise, 'ops' is set up to read the file from memory
+	 * (reading it into the cache first), and closing it frees
+	 * it; it's null if the file couldn't be read. Throws like
+	 * FileSystem::openRead() */
+	std::shared_ptr<const DecodedAudio> open(const std::string &filename,
+	                                         SDL_RWops *&ops, std::string &ext);
+
+private:
+	struct Entry;
+	typedef std::shared_ptr<Entry> EntryPtr;
+
+	void insert(const EntryPtr &entry);
+	void remove(Entry &entry);
+	void evict();
+
+	void scheduleDecode(const EntryPtr &entry);
+	void decodeMain();
+
+	size_t budget;
+	size_t bytes;
+
+	/* Guarded by 'mutex', like all entries. The list
+	 * has to outlive the entries linked into it */
+	IntruList<Entry> lru;
+	BoostHash<std::string, EntryPtr> entries;
+
+	std::deque<EntryPtr> decodeQueue;
+	bool quit;
+
+	SDL_mutex *mutex;
+	SDL_cond *decodeCond;
+	SDL_Thread *decodeThread;
+};
+
+#endif // STREAMCACHE_H
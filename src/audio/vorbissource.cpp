@@ -287,3 +287,41 @@ std::unique_ptr<ALDataSource> createVorbisSource(SDL_RWops &ops,
 {
 	return std::make_unique<VorbisSource>(ops, looped);
 }
+
+bool decodeVorbis(SDL_RWops &ops, size_t maxBytes, DecodedAudio &out)
+{
+	/* Picks up the loop tags like a looped stream would */
+	VorbisSource source(ops, true);
+
+	ogg_int64_t frames = ov_pcm_total(&source.vf, -1);
+
+	if (frames <= 0 || (uint64_t) frames * source.info.frameSize > maxBytes)
+		return false;
+
+	out.pcm.resize(frames * source.info.frameSize);
+	size_t used = 0;
+
+	while (used < out.pcm.size())
+	{
+		long res = ov_read(&source.vf, reinterpret_cast<char*>(&out.pcm[used]),
+		                   out.pcm.size() - used, 0, sizeof(int16_t), 1, 0);
+
+		if (res < 0)
+			return false;
+
+		if (res == 0)
+			break;
+
+		used += res;
+	}
+
+	out.pcm.resize(used);
+
+	out.alFormat = source.info.alFormat;
+	out.rate = source.info.rate;
+	out.frameSize = source.info.frameSize;
+	out.loopStart = source.loopStartFrames();
+	out.loopEnd = source.loop.valid ? source.loop.end : 0;
+
+	return used > 0;
+}
@@ -131,6 +131,7 @@ void Config::read(int argc, char *argv[]) {
         {"debugMode", false},
         {"displayFPS", false},
         {"printFPS", false},
+        {"displayGLStats", false},
         {"winResizable", true},
         {"fullscreen", false},
         {"fixedAspectRatio", true},
@@ -146,6 +147,12 @@ void Config::read(int argc, char *argv[]) {
         {"fixedFramerate", 0},
         {"frameSkip", false},
         {"syncToRefreshrate", false},
+        {"framePacing", "latency"},
+        {"pipelinedRendering", false},
+        {"maxFramesInFlight", 2},
+        {"lateInputSampling", false},
+        {"headless", false},
+        {"virtualClock", false},
         {"solidFonts", json::array({})},
 #if defined(__APPLE__) && defined(__aarch64__)
         {"preferMetalRenderer", true},
@@ -161,6 +168,13 @@ void Config::read(int argc, char *argv[]) {
         {"integerScalingActive", false},
         {"integerScalingLastMile", true},
         {"maxTextureSize", 0},
+        {"texturePoolSize", 20},
+        {"vramBudget", 0},
+        {"bitmapCacheSize", 128},
+        {"bitmapAtlasMaxSize", 0},
+        {"preloadThreads", 0},
+        {"preloadUploadBudget", 2},
+        {"shaderCache", true},
         {"gameFolder", ""},
         {"anyAltToggleFS", false},
         {"enableReset", true},
@@ -175,12 +189,17 @@ void Config::read(int argc, char *argv[]) {
         {"midiReverb", false},
         {"SESourceCount", 6},
         {"BGMTrackCount", 1},
+        {"streamCacheSize", 32},
         {"customScript", ""},
         {"pathCache", true},
+        {"pathCacheIndex", true},
         {"useScriptNames", true},
+        {"scriptCache", true},
         {"preloadScript", json::array({})},
         {"RTP", json::array({})},
         {"fontSub", json::array({})},
+        {"fontCacheSize", 32},
+        {"fontIndex", true},
         {"rubyLoadpath", json::array({})},
         {"JITEnable", false},
         {"JITVerboseLevel", 0},
@@ -234,6 +253,7 @@ try { exp } catch (...) {}
     SET_STRINGOPT(execName, execName);
     SET_OPT(allowSymlinks, boolean);
     SET_OPT(pathCache, boolean);
+    SET_OPT(pathCacheIndex, boolean);
     SET_OPT_CUSTOMKEY(jit.enabled, JITEnable, boolean);
     SET_OPT_CUSTOMKEY(jit.verboseLevel, JITVerboseLevel, integer);
     SET_OPT_CUSTOMKEY(jit.maxCache, JITMaxCache, integer);
@@ -260,6 +280,7 @@ try { exp } catch (...) {}
     SET_OPT(debugMode, boolean);
     SET_OPT(displayFPS, boolean);
     SET_OPT(printFPS, boolean);
+    SET_OPT(displayGLStats, boolean);
     SET_OPT(fullscreen, boolean);
     SET_OPT(fixedAspectRatio, boolean);
     SET_OPT(smoothScaling, integer);
@@ -273,6 +294,12 @@ try { exp } catch (...) {}
     SET_OPT(fixedFramerate, integer);
     SET_OPT(frameSkip, boolean);
     SET_OPT(syncToRefreshrate, boolean);
+    SET_STRINGOPT(framePacing, framePacing);
+    SET_OPT(pipelinedRendering, boolean);
+    SET_OPT(maxFramesInFlight, integer);
+    SET_OPT(lateInputSampling, boolean);
+    SET_OPT(headless, boolean);
+    SET_OPT(virtualClock, boolean);
     fillStringVec(opts["solidFonts"], solidFonts);
     for (std::string & solidFont : solidFonts)
         std::transform(solidFont.begin(), solidFont.end(), solidFont.begin(),
@@ -285,6 +312,13 @@ try { exp } catch (...) {}
     SET_OPT_CUSTOMKEY(integerScaling.active, integerScalingActive, boolean);
     SET_OPT_CUSTOMKEY(integerScaling.lastMileScaling, integerScalingLastMile, boolean);
     SET_OPT(maxTextureSize, integer);
+    SET_OPT(texturePoolSize, integer);
+    SET_OPT(vramBudget, integer);
+    SET_OPT(bitmapCacheSize, integer);
+    SET_OPT(bitmapAtlasMaxSize, integer);
+    SET_OPT(preloadThreads, integer);
+    SET_OPT(preloadUploadBudget, integer);
+    SET_OPT(shaderCache, boolean);
     SET_OPT(anyAltToggleFS, boolean);
     SET_OPT(enableReset, boolean);
     SET_OPT(enableSettings, boolean);
@@ -293,8 +327,10 @@ try { exp } catch (...) {}
     SET_OPT_CUSTOMKEY(midi.reverb, midiReverb, boolean);
     SET_OPT_CUSTOMKEY(SE.sourceCount, SESourceCount, integer);
     SET_OPT_CUSTOMKEY(BGM.trackCount, BGMTrackCount, integer);
+    SET_OPT(streamCacheSize, integer);
     SET_STRINGOPT(customScript, customScript);
     SET_OPT(useScriptNames, boolean);
+    SET_OPT(scriptCache, boolean);
 
     fillStringVec(opts["preloadScript"], preloadScripts);
     fillStringVec(opts["RTP"], rtps);
@@ -302,6 +338,8 @@ try { exp } catch (...) {}
     for (std::string & fontSub : fontSubs)
         std::transform(fontSub.begin(), fontSub.end(), fontSub.begin(),
             [](unsigned char c) { return std::tolower(c); });
+    SET_OPT(fontCacheSize, integer);
+    SET_OPT(fontIndex, boolean);
     fillStringVec(opts["rubyLoadpath"], rubyLoadpaths);
 
     auto &bnames = opts["bindingNames"].as_object();
@@ -319,10 +357,24 @@ try { exp } catch (...) {}
     rgssVersion = clamp(rgssVersion, 0, 3);
     SE.sourceCount = clamp(SE.sourceCount, 1, 64);
     BGM.trackCount = clamp(BGM.trackCount, 1, 16);
+    streamCacheSize = std::max(streamCacheSize, 0);
+    texturePoolSize = std::max(texturePoolSize, 0);
+    vramBudget = std::max(vramBudget, 0);
+    bitmapCacheSize = std::max(bitmapCacheSize, 0);
+    bitmapAtlasMaxSize = clamp(bitmapAtlasMaxSize, 0, 1024);
+    preloadThreads = clamp(preloadThreads, 0, 16);
+    preloadUploadBudget = std::max(preloadUploadBudget, 0);
+    fontCacheSize = std::max(fontCacheSize, 0);
+    maxFramesInFlight = clamp(maxFramesInFlight, 1, 3);
 
     // Determine whether to open a console window on... Windows
     winConsole = getEnvironmentBool("MKXPZ_WINDOWS_CONSOLE", editor.debug);
 
+    // Headless / virtual clock runs are mostly driven from CI scripts,
+    // so let the environment override whatever the game ships with
+    headless = getEnvironmentBool("MKXPZ_HEADLESS", headless);
+    virtualClock = getEnvironmentBool("MKXPZ_VIRTUAL_CLOCK", virtualClock);
+
 #ifdef __APPLE__
     // Determine whether to use the Metal renderer on macOS
     // Environment variable takes priority over the json setting
@@ -39,6 +39,7 @@ struct Config {
     bool preferMetalRenderer;
     bool displayFPS;
     bool printFPS;
+    bool displayGLStats;
     
     bool winResizable;
     bool fullscreen;
@@ -57,6 +58,18 @@ struct Config {
     int fixedFramerate;
     bool frameSkip;
     bool syncToRefreshrate;
+    /* "latency" or "power", see FPSLimiter */
+    std::string framePacing;
+    /* Present frames from a separate thread */
+    bool pipelinedRendering;
+    int maxFramesInFlight;
+    bool lateInputSampling;
+    
+    /* Render to an offscreen surface without showing a window */
+    bool headless;
+    /* Advance Graphics/Input timers by exactly one frame per
+     * presented frame instead of following the wall clock */
+    bool virtualClock;
     
     std::vector<std::string> solidFonts;
     
@@ -64,6 +77,22 @@ struct Config {
     bool enableBlitting;
     int maxTextureSize;
     
+    /* In megabytes */
+    int texturePoolSize;
+    int vramBudget;
+    /* RPG::Cache (RGSS1), 0 = unlimited */
+    int bitmapCacheSize;
+    
+    /* Largest bitmap dimension put into the atlas, 0 = off */
+    int bitmapAtlasMaxSize;
+    
+    /* Preloader worker threads (0 = from the CPU count) */
+    int preloadThreads;
+    /* Milliseconds per frame spent uploading preloaded images */
+    int preloadUploadBudget;
+
+    bool shaderCache;
+    
     struct {
         bool active;
         bool lastMileScaling;
@@ -77,6 +106,7 @@ struct Config {
     bool enableSettings;
     bool allowSymlinks;
     bool pathCache;
+    bool pathCacheIndex;
     
     std::string dataPathOrg;
     std::string dataPathApp;
@@ -99,7 +129,11 @@ struct Config {
         int trackCount;
     } BGM;
     
+    /* In megabytes, for recently played BGM/BGS/ME */
+    int streamCacheSize;
+    
     bool useScriptNames;
+    bool scriptCache;
     
     std::string customScript;
     
@@ -108,6 +142,10 @@ struct Config {
     std::vector<std::string> rtps;
     
     std::vector<std::string> fontSubs;
+    /* Maximum number of opened font sizes kept around */
+    int fontCacheSize;
+    /* Remember the family names of the fonts in "Fonts/" */
+    bool fontIndex;
     
     std::vector<std::string> rubyLoadpaths;
     
@@ -39,9 +39,13 @@
 #include "sharedstate.h"
 #include "glstate.h"
 #include "texpool.h"
+#include "bitmapatlas.h"
+#include "pixelkernels.h"
 #include "shader.h"
 #include "filesystem.h"
 #include "font.h"
+#include "preparequeue.h"
+#include "preloader.h"
 #include "eventthread.h"
 #include "graphics.h"
 #include "system.h"
@@ -103,6 +107,12 @@ static IntRect normalizedRect(const IntRect &rect)
 }
 
 
+static uint32_t *surfaceRow(SDL_Surface *surf, int y)
+{
+    return (uint32_t *) ((uint8_t *) surf->pixels + y * surf->pitch);
+}
+
+
 // libnsgif loading callbacks, taken pretty much straight from their tests
 
 static void *gif_bitmap_create(int width, int height)
@@ -151,7 +161,7 @@ static void gif_bitmap_modified(void *bitmap)
 
 // --------------------
 
-struct BitmapPrivate
+struct BitmapPrivate : public Preparable
 {
     Bitmap *self;
     
@@ -212,10 +222,12 @@ struct BitmapPrivate
         }
     } animation;
     
-    sigslot::connection prepareCon;
-    
     TEXFBO gl;
     
+    /* Set while the pixels live in the shared atlas instead
+     * of 'gl', which then only holds the size (see BitmapAtlas) */
+    BitmapAtlas::Region *atlasRegion = nullptr;
+    
     Font *font;
     
     /* "Mega surfaces" are a hack to allow Tilesets to be used
@@ -238,6 +250,12 @@ struct BitmapPrivate
      * ourselves the expensive blending calculation */
     pixman_region16_t tainted;
 
+    /* Bounding box of everything drawn since the last
+     * 'modified' signal. Stays empty for operations that
+     * don't say where they draw, which then count as
+     * having touched the whole bitmap */
+    IntRect damage;
+
     // For high-resolution texture replacement.
     Bitmap* selfHires = nullptr;
     Bitmap *selfLores = nullptr;
@@ -260,15 +278,12 @@ struct BitmapPrivate
         animation.fps = 0;
         animation.lastFrame = 0;
         
-        prepareCon = shState->prepareDraw.connect(&BitmapPrivate::prepare, this);
-        
         font = &shState->defaultFont();
         pixman_region_init(&tainted);
     }
     
     ~BitmapPrivate()
     {
-        prepareCon.disconnect();
         SDL_FreeFormat(format);
         pixman_region_fini(&tainted);
     }
@@ -282,14 +297,80 @@ struct BitmapPrivate
     }
 
     TEXFBO &getGLTypes() {
+        leaveAtlas();
         return (animation.enabled) ? animation.currentFrame() : gl;
     }
     
+    /* Moves the pixels into the shared atlas, if the bitmap is
+     * small enough and the atlas is enabled */
+    void enterAtlas()
+    {
+        if (animation.enabled || megaSurface || atlasRegion)
+            return;
+        
+        atlasRegion = shState->bitmapAtlas().insert(gl);
+        
+        if (!atlasRegion)
+            return;
+        
+        shState->texPool().release(gl);
+        gl.tex = TEX::ID(0);
+        gl.fbo = FBO::ID(0);
+    }
+    
+    /* Gives the bitmap its own texture back. Everything but
+     * drawing it with a sprite or reading it back needs that */
+    void leaveAtlas()
+    {
+        if (!atlasRegion)
+            return;
+        
+        /* This can happen halfway through setting up a draw
+         * (via bindTexture()), so leave things as they were */
+        FBO::ID fbo = FBO::boundFramebufferID;
+        glState.program.push();
+        glState.blend.pushSet(false);
+        
+        TEXFBO tex = shState->texPool().request(gl.width, gl.height);
+        
+        GLMeta::blitBegin(tex);
+        GLMeta::blitSource(BitmapAtlas::texture(*atlasRegion));
+        GLMeta::blitRectangle(atlasRegion->rect, Vec2i());
+        GLMeta::blitEnd();
+        
+        glState.blend.pop();
+        glState.program.pop();
+        FBO::bind(fbo);
+        
+        shState->bitmapAtlas().remove(atlasRegion);
+        atlasRegion = nullptr;
+        
+        gl = tex;
+    }
+    
+    /* Reads back the whole bitmap, wherever it lives */
+    void readPixels(void *output)
+    {
+        if (atlasRegion)
+        {
+            const IntRect &rect = atlasRegion->rect;
+            FBO::bind(BitmapAtlas::texture(*atlasRegion).fbo);
+            ::gl.ReadPixels(rect.x, rect.y, rect.w, rect.h, GL_RGBA, GL_UNSIGNED_BYTE, output);
+            return;
+        }
+        
+        FBO::bind(getGLTypes().fbo);
+        ::gl.ReadPixels(0, 0, self->width(), self->height(), GL_RGBA, GL_UNSIGNED_BYTE, output);
+    }
+    
     void prepare()
     {
         if (!animation.enabled || !animation.playing) return;
         
         animation.updateTimer();
+        
+        /* Keep ticking for as long as the animation plays */
+        schedulePrepare();
     }
     
     void allocSurface()
@@ -305,8 +386,16 @@ struct BitmapPrivate
         pixman_region_init(&tainted);
     }
     
+    void addDamage(const IntRect &rect)
+    {
+        IntRect norm = normalizedRect(rect);
+        SDL_UnionRect(&damage, &norm, &damage);
+    }
+    
     void addTaintedArea(const IntRect &rect)
     {
+        addDamage(rect);
+        
         IntRect norm = normalizedRect(rect);
         pixman_region_union_rect
         (&tainted, &tainted, norm.x, norm.y, norm.w, norm.h);
@@ -314,6 +403,8 @@ struct BitmapPrivate
     
     void substractTaintedArea(const IntRect &rect)
     {
+        addDamage(rect);
+        
         if (!touchesTaintedArea(rect))
             return;
 
@@ -355,6 +446,7 @@ struct BitmapPrivate
             shader.setTexSize(Vec2i(cframe.width, cframe.height));
             return;
         }
+        leaveAtlas();
         TEX::bind(gl.tex);
         if (selfLores && substituteLoresSize) {
             shader.setTexSize(Vec2i(selfLores->width(), selfLores->height()));
@@ -366,6 +458,7 @@ struct BitmapPrivate
     
     void bindFBO()
     {
+        leaveAtlas();
         FBO::bind((animation.enabled) ? animation.currentFrame().fbo : gl.fbo);
     }
     
@@ -404,7 +497,7 @@ struct BitmapPrivate
         if (surf->format->format == format)
             return;
         
-        SDL_Surface *surfConv = SDL_ConvertSurfaceFormat(surf, format, 0);
+        SDL_Surface *surfConv = PixelKernels::convertSurface(surf, format);
         SDL_FreeSurface(surf);
         surf = surfConv;
     }
@@ -417,7 +510,16 @@ struct BitmapPrivate
             surface = 0;
         }
         
+        IntRect bounds = self->rect();
+        IntRect area = bounds;
+        
+        if (!SDL_RectEmpty(&damage) && !SDL_IntersectRect(&damage, &bounds, &area))
+            area = IntRect();
+        
+        damage = IntRect();
+        
         self->modified();
+        self->modifiedArea(area);
     }
 };
 
@@ -505,6 +607,22 @@ Bitmap::Bitmap(const char *filename)
         }
     }
 
+    TEXFBO preloaded;
+    if (shState->preloader().takeImage(filenameStd, preloaded)) {
+        p = std::make_unique<BitmapPrivate>(this);
+        p->setHires(std::move(hiresBitmap));
+        p->gl = preloaded;
+        if (p->selfHires != nullptr) {
+            p->gl.selfHires = &p->selfHires->getGLTypes();
+        }
+        else {
+            p->enterAtlas();
+        }
+        
+        p->addTaintedArea(rect());
+        return;
+    }
+    
     BitmapOpenHandler handler;
     shState->fileSystem().openRead(handler, filename);
     
@@ -625,11 +743,16 @@ Bitmap::Bitmap(const char *filename)
         p->megaSurface = imgSurf;
         SDL_SetSurfaceBlendMode(p->megaSurface, SDL_BLENDMODE_NONE);
     } else {
-        /* Regular surface */
+        /* Regular surface, small ones go straight into the atlas */
+        BitmapAtlas::Region *region = nullptr;
         TEXFBO tex;
+        
+        if (!hiresBitmap)
+            region = shState->bitmapAtlas().insert(imgSurf->pixels, imgSurf->w, imgSurf->h);
 
         try {
-            tex = shState->texPool().request(imgSurf->w, imgSurf->h);
+            if (!region)
+                tex = shState->texPool().request(imgSurf->w, imgSurf->h);
         }
         catch (const Exception &)
         {
@@ -639,13 +762,21 @@ Bitmap::Bitmap(const char *filename)
         
         p = std::make_unique<BitmapPrivate>(this);
         p->setHires(std::move(hiresBitmap));
-        p->gl = tex;
-        if (p->selfHires != nullptr) {
-            p->gl.selfHires = &p->selfHires->getGLTypes();
-        }
         
-        TEX::bind(p->gl.tex);
-        TEX::uploadImage(p->gl.width, p->gl.height, imgSurf->pixels, GL_RGBA);
+        if (region) {
+            p->atlasRegion = region;
+            p->gl.width = imgSurf->w;
+            p->gl.height = imgSurf->h;
+        }
+        else {
+            p->gl = tex;
+            if (p->selfHires != nullptr) {
+                p->gl.selfHires = &p->selfHires->getGLTypes();
+            }
+            
+            TEX::bind(p->gl.tex);
+            TEX::uploadImage(p->gl.width, p->gl.height, imgSurf->pixels, GL_RGBA);
+        }
         
         SDL_FreeSurface(imgSurf);
     }
@@ -978,7 +1109,16 @@ void Bitmap::stretchBlt(const IntRect &destRect,
         SDL_Surface *blitTemp =
                 SDL_CreateRGBSurface(0, destRect.w, destRect.h, bpp, rMask, gMask, bMask, aMask);
 
-        SDL_BlitScaled(srcSurf, &srcRect, blitTemp, 0);
+        bool srcInside = srcRect.x >= 0 && srcRect.y >= 0 &&
+                         srcRect.x + srcRect.w <= srcSurf->w && srcRect.y + srcRect.h <= srcSurf->h;
+
+        /* Shrinking is done by averaging instead of skipping pixels */
+        if (srcInside && destRect.w <= srcRect.w && destRect.h <= srcRect.h)
+            PixelKernels::boxDownsample((uint32_t *) blitTemp->pixels, blitTemp->pitch / 4, destRect.w, destRect.h,
+                                        surfaceRow(srcSurf, srcRect.y) + srcRect.x, srcSurf->pitch / 4,
+                                        srcRect.w, srcRect.h);
+        else
+            SDL_BlitScaled(srcSurf, &srcRect, blitTemp, 0);
 
         TEX::bind(getGLTypes().tex);
 
@@ -1000,7 +1140,9 @@ void Bitmap::stretchBlt(const IntRect &destRect,
         return;
     }
     
-    if (opacity == 255 && !p->touchesTaintedArea(destRect))
+    bool tainted = p->touchesTaintedArea(destRect);
+    
+    if (opacity == 255 && !tainted)
     {
         /* Fast blit */
         GLMeta::blitBegin(getGLTypes());
@@ -1008,26 +1150,76 @@ void Bitmap::stretchBlt(const IntRect &destRect,
         GLMeta::blitRectangle(sourceRect, destRect);
         GLMeta::blitEnd();
     }
+    else if (!tainted)
+    {
+        /* Everything below destRect is fully transparent, in
+         * which case the blending in BltShader reduces to the
+         * source with its alpha scaled by the opacity */
+        float normOpacity = (float) opacity / 255.0f;
+        
+        SimpleAlphaShader &shader = shState->shaders().simpleAlpha;
+        shader.bind();
+        shader.setTranslation(Vec2i());
+        
+        Quad &quad = shState->gpQuad();
+        quad.setTexPosRect(sourceRect, destRect);
+        quad.setColor(Vec4(1, 1, 1, normOpacity));
+        
+        source.p->bindTexture(shader, false);
+        p->bindFBO();
+        p->pushSetViewport(shader);
+        
+        p->blitQuad(quad);
+        
+        p->popViewport();
+    }
     else
     {
         /* Fragment pipeline */
         float normOpacity = (float) opacity / 255.0f;
         
-        TEXFBO &gpTex = shState->gpTexFBO(destRect.w, destRect.h);
+        TEXFBO destTex = getGLTypes();
+        FloatRect bltSubRect;
         
-        GLMeta::blitBegin(gpTex);
-        GLMeta::blitSource(getGLTypes());
-        GLMeta::blitRectangle(destRect, Vec2i());
-        GLMeta::blitEnd();
+        /* With a texture barrier, every fragment may read back the
+         * texel it is about to overwrite, so the destination can be
+         * sampled in place instead of through a copy. The source
+         * must not be the same texture, as it's read elsewhere */
+        bool inPlace = gl.TextureBarrier && &source != this;
         
-        FloatRect bltSubRect((float) sourceRect.x / source.width(),
-                             (float) sourceRect.y / source.height(),
-                             ((float) source.width() / sourceRect.w) * ((float) destRect.w / gpTex.width),
-                             ((float) source.height() / sourceRect.h) * ((float) destRect.h / gpTex.height));
+        if (inPlace)
+        {
+            float scaleX = ((float) source.width() / sourceRect.w) * ((float) destRect.w / destTex.width);
+            float scaleY = ((float) source.height() / sourceRect.h) * ((float) destRect.h / destTex.height);
+            
+            /* Shifted so that the source rect origin lands on
+             * the destination rect origin */
+            bltSubRect = FloatRect((float) sourceRect.x / source.width() - ((float) destRect.x / destTex.width) / scaleX,
+                                   (float) sourceRect.y / source.height() - ((float) destRect.y / destTex.height) / scaleY,
+                                   scaleX, scaleY);
+            
+            gl.TextureBarrier();
+        }
+        else
+        {
+            TEXFBO &gpTex = shState->gpTexFBO(destRect.w, destRect.h);
+            
+            GLMeta::blitBegin(gpTex);
+            GLMeta::blitSource(destTex);
+            GLMeta::blitRectangle(destRect, Vec2i());
+            GLMeta::blitEnd();
+            
+            bltSubRect = FloatRect((float) sourceRect.x / source.width(),
+                                   (float) sourceRect.y / source.height(),
+                                   ((float) source.width() / sourceRect.w) * ((float) destRect.w / gpTex.width),
+                                   ((float) source.height() / sourceRect.h) * ((float) destRect.h / gpTex.height));
+            
+            destTex = gpTex;
+        }
         
         BltShader &shader = shState->shaders().blt;
         shader.bind();
-        shader.setDestination(gpTex.tex);
+        shader.setDestination(destTex.tex);
         shader.setSubRect(bltSubRect);
         shader.setOpacity(normOpacity);
         
@@ -1195,6 +1387,7 @@ void Bitmap::blur() {
     glState.blend.pushSet(false);
     glState.viewport.pushSet(IntRect(0, 0, width(), height()));
     
+    p->leaveAtlas();
     TEX::bind(p->gl.tex);
     FBO::bind(auxTex.fbo);
     
@@ -1369,33 +1562,24 @@ Color Bitmap::getPixel(int x, int y) const {
         int w = p->selfHires->width() / width();
         int h = p->selfHires->height() / height();
 
-        if (w >= 1 && h >= 1) {
-            double rSum = 0.;
-            double gSum = 0.;
-            double bSum = 0.;
-            double aSum = 0.;
-
-            long long rgbCount = 0;
-            long long aCount = 0;
-
-            for (int thisX = xHires; thisX < xHires+w && thisX < p->selfHires->width(); thisX++) {
-                for (int thisY = yHires; thisY < yHires+h && thisY < p->selfHires->height(); thisY++) {
-                    Color thisColor = p->selfHires->getPixel(thisX, thisY);
-                    if (thisColor.getAlpha() >= 1.0) {
-                        rSum += thisColor.getRed();
-                        gSum += thisColor.getGreen();
-                        bSum += thisColor.getBlue();
-                        rgbCount++;
-                    }
-                    aSum += thisColor.getAlpha();
-                    aCount++;
-                }
-            }
+        if (w >= 1 && h >= 1 && xHires < p->selfHires->width() && yHires < p->selfHires->height()
+            && x >= 0 && y >= 0) {
+            // Reading one pixel does the usual checks and downloads the surface.
+            p->selfHires->getPixel(xHires, yHires);
+
+            SDL_Surface *hiresSurf = p->selfHires->p->surface;
+            w = std::min(w, p->selfHires->width() - xHires);
+            h = std::min(h, p->selfHires->height() - yHires);
 
-            double rAvg = rSum / (double)rgbCount;
-            double gAvg = gSum / (double)rgbCount;
-            double bAvg = bSum / (double)rgbCount;
-            double aAvg = aSum / (double)aCount;
+            PixelKernels::BoxSums sums;
+            PixelKernels::boxSums(surfaceRow(hiresSurf, yHires) + xHires, hiresSurf->pitch / 4, w, h, sums);
+
+            const SDL_PixelFormat *fm = p->selfHires->p->format;
+
+            double rAvg = sums.visible[fm->Rshift / 8] / (double)sums.visibleCount;
+            double gAvg = sums.visible[fm->Gshift / 8] / (double)sums.visibleCount;
+            double bAvg = sums.visible[fm->Bshift / 8] / (double)sums.visibleCount;
+            double aAvg = sums.alpha / (double)(w * h);
 
             return Color(rAvg, gAvg, bAvg, aAvg);
         }
@@ -1408,11 +1592,9 @@ Color Bitmap::getPixel(int x, int y) const {
     {
         p->allocSurface();
         
-        FBO::bind(p->gl.fbo);
-        
         glState.viewport.pushSet(IntRect(0, 0, width(), height()));
         
-        gl.ReadPixels(0, 0, width(), height(), GL_RGBA, GL_UNSIGNED_BYTE, p->surface->pixels);
+        p->readPixels(p->surface->pixels);
         
         glState.viewport.pop();
     }
@@ -1458,6 +1640,7 @@ void Bitmap::setPixel(int x, int y, const Color &color) {
                     (uint8_t) clamp<double>(color.alpha, 0, 255)
             };
 
+    p->leaveAtlas();
     TEX::bind(p->gl.tex);
     TEX::uploadSubImage(x, y, 1, 1, &pixel, GL_RGBA);
 
@@ -1490,8 +1673,7 @@ bool Bitmap::getRaw(void *output, int output_size)
         memcpy(output, src, output_size);
     }
     else {
-        FBO::bind(getGLTypes().fbo);
-        gl.ReadPixels(0,0,width(),height(),GL_RGBA,GL_UNSIGNED_BYTE,output);
+        p->readPixels(output);
     }
     return true;
 }
@@ -1650,77 +1832,36 @@ static void applyShadow(SDL_Surface *&in, const SDL_PixelFormat &fm, const SDL_C
     SDL_Surface *out = SDL_CreateRGBSurface
     (0, in->w+1, in->h+1, fm.BitsPerPixel, fm.Rmask, fm.Gmask, fm.Bmask, fm.Amask);
     
-    float fr = c.r / 255.0f;
-    float fg = c.g / 255.0f;
-    float fb = c.b / 255.0f;
-    
     /* We allocate an output surface one pixel wider and higher than the input,
      * (implicitly) blit a copy of the input with RGB values set to black into
      * it with x/y offset by 1, then blend the input surface over it at origin
      * (0,0) using the bitmap blit equation (see shader/bitmapBlit.frag) */
-
-    for (int y = 0; y < in->h + 1; ++y)
-        for (int x = 0; x < in->w + 1; ++x) {
-            /* src: input pixel, shd: shadow pixel */
-            uint32_t src = 0, shd = 0;
-
-            /* Output pixel location */
-            uint32_t *outP = ((uint32_t *) ((uint8_t *) out->pixels + y * out->pitch)) + x;
-
-            if (y < in->h && x < in->w)
-                src = ((uint32_t *) ((uint8_t *) in->pixels + y * in->pitch))[x];
-
-            if (y > 0 && x > 0)
-                shd = ((uint32_t *) ((uint8_t *) in->pixels + (y - 1) * in->pitch))[x - 1];
-
-            /* Set shadow pixel RGB values to 0 (black) */
-            shd &= fm.Amask;
-
-            if (x == 0 || y == 0) {
-                *outP = src;
-                continue;
-            }
-
-            if (x == in->w || y == in->h) {
-                *outP = shd;
-                continue;
-            }
-
-            /* Input and shadow alpha values */
-            uint8_t srcA, shdA;
-            srcA = (src & fm.Amask) >> fm.Ashift;
-            shdA = (shd & fm.Amask) >> fm.Ashift;
-
-            if (srcA == 255 || shdA == 0) {
-                *outP = src;
-                continue;
-            }
-
-            if (srcA == 0 && shdA == 0) {
-                *outP = 0;
-                continue;
-            }
-
-            float fSrcA = srcA / 255.0f;
-            float fShdA = shdA / 255.0f;
-
-            /* Because opacity == 1, co1 == fSrcA */
-            float co2 = fShdA * (1.0f - fSrcA);
-            /* Result alpha */
-            float fa = fSrcA + co2;
-            /* Temp value to simplify arithmetic below */
-            float co3 = fSrcA / fa;
-
-            /* Result colors */
-            uint8_t r, g, b, a;
-
-            r = clamp<float>(fr * co3, 0, 1) * 255.0f;
-            g = clamp<float>(fg * co3, 0, 1) * 255.0f;
-            b = clamp<float>(fb * co3, 0, 1) * 255.0f;
-            a = clamp<float>(fa, 0, 1) * 255.0f;
-
-            *outP = SDL_MapRGBA(&fm, r, g, b, a);
+    
+    uint32_t color = SDL_MapRGBA(&fm, c.r, c.g, c.b, 0);
+    
+    for (int y = 0; y < in->h + 1; ++y) {
+        uint32_t *outRow = surfaceRow(out, y);
+        
+        /* src: input row, shd: shadow row (only its alpha is used) */
+        const uint32_t *src = (y < in->h) ? surfaceRow(in, y) : 0;
+        const uint32_t *shd = (y > 0) ? surfaceRow(in, y - 1) : 0;
+        
+        if (!shd) {
+            memcpy(outRow, src, in->w * 4);
+            outRow[in->w] = 0;
+            continue;
         }
+        
+        outRow[0] = src ? src[0] : 0;
+        
+        if (src)
+            PixelKernels::shadowCompose(outRow + 1, src + 1, shd, color, in->w - 1);
+        else
+            for (int x = 0; x < in->w - 1; ++x)
+                outRow[x + 1] = shd[x] & fm.Amask;
+        
+        outRow[in->w] = shd[in->w - 1] & fm.Amask;
+    }
     
     /* Store new surface in the input pointer */
     SDL_FreeSurface(in);
@@ -1762,6 +1903,8 @@ void Bitmap::drawText(const IntRect &rect, const char *str, int align) {
     if (str[0] == ' ' && str[1] == '\0')
         return;
     
+    p->leaveAtlas();
+    
     TTF_Font *font = p->font->getSdlFont();
     const Color &fontColor = p->font->getColor();
     const Color &outColor = p->font->getOutColor();
@@ -1785,7 +1928,7 @@ void Bitmap::drawText(const IntRect &rect, const char *str, int align) {
     if (p->font->getShadow())
         applyShadow(txtSurf, *p->format, c);
 
-    /* outline using TTF_Outline and blending it together with SDL_BlitSurface
+    /* outline using TTF_Outline and blending the text over it
      * FIXME: outline is forced to have the same opacity as the font color */
     if (p->font->getOutline()) {
         SDL_Color co = outColor.toSDLColor();
@@ -1804,10 +1947,16 @@ void Bitmap::drawText(const IntRect &rect, const char *str, int align) {
             outline = TTF_RenderUTF8_Blended(font, str, co);
 
         p->ensureFormat(outline, SDL_PIXELFORMAT_ABGR8888);
-        SDL_Rect outRect = {scaledOutlineSize, scaledOutlineSize, txtSurf->w, txtSurf->h};
 
-        SDL_SetSurfaceBlendMode(txtSurf, SDL_BLENDMODE_BLEND);
-        SDL_BlitSurface(txtSurf, NULL, outline, &outRect);
+        /* Same as an SDL_BLENDMODE_BLEND blit of the text
+         * offset by the outline size, clipped to the outline */
+        int blendW = std::min(txtSurf->w, outline->w - scaledOutlineSize);
+        int blendH = std::min(txtSurf->h, outline->h - scaledOutlineSize);
+
+        for (int y = 0; y < blendH; ++y)
+            PixelKernels::blendOver(surfaceRow(outline, y + scaledOutlineSize) + scaledOutlineSize,
+                                    surfaceRow(txtSurf, y), std::max(blendW, 0));
+
         SDL_FreeSurface(txtSurf);
         txtSurf = outline;
         /* reset outline to 0 */
@@ -2128,6 +2277,7 @@ void Bitmap::play() {
     }
 
     p->animation.play();
+    p->schedulePrepare();
 }
 
 bool Bitmap::isPlaying() const
@@ -2171,6 +2321,7 @@ void Bitmap::gotoAndPlay(int frame) {
     p->animation.stop();
     p->animation.seek(frame);
     p->animation.play();
+    p->schedulePrepare();
 }
 
 int Bitmap::numFrames() const
@@ -2218,6 +2369,8 @@ int Bitmap::addFrame(Bitmap &source, int position) {
     
     // Convert the bitmap into an animated bitmap if it isn't already one
     if (!p->animation.enabled) {
+        p->leaveAtlas();
+        
         p->animation.width = p->gl.width;
         p->animation.height = p->gl.height;
         p->animation.enabled = true;
@@ -2346,7 +2499,10 @@ void Bitmap::setAnimationFPS(float FPS) {
     bool restart = p->animation.playing;
     p->animation.stop();
     p->animation.fps = (FPS < 0) ? 0 : FPS;
-    if (restart) p->animation.play();
+    if (restart) {
+        p->animation.play();
+        p->schedulePrepare();
+    }
 }
 
 std::vector<TEXFBO> &Bitmap::getFrames() const
@@ -2401,6 +2557,22 @@ void Bitmap::bindTex(ShaderBase &shader)
     p->bindTexture(shader);
 }
 
+bool Bitmap::bindAtlasTex(ShaderBase &shader, Vec2i &offset, Vec2i &pageSize)
+{
+    if (!p->atlasRegion)
+        return false;
+
+    TEXFBO &page = BitmapAtlas::texture(*p->atlasRegion);
+
+    offset = Vec2i(p->atlasRegion->rect.x, p->atlasRegion->rect.y);
+    pageSize = Vec2i(page.width, page.height);
+
+    TEX::bind(page.tex);
+    shader.setTexSize(pageSize);
+
+    return true;
+}
+
 void Bitmap::taintArea(const IntRect &rect)
 {
     if (hasHires()) {
@@ -2455,6 +2627,8 @@ void Bitmap::releaseResources()
                 shState->texPool().release(tex);
         }
     }
+    else if (shState != nullptr && p->atlasRegion)
+        shState->bitmapAtlas().remove(p->atlasRegion);
     else if (shState != nullptr)
         shState->texPool().release(p->gl);
 }
@@ -176,11 +176,21 @@ public:
 	 * texture size uniform in shader */
 	void bindTex(ShaderBase &shader);
 
+	/* If the bitmap lives in the shared atlas, binds the atlas
+	 * page and sets its size in the shader instead, and returns
+	 * where inside of the page the bitmap is. Returns false
+	 * without binding anything otherwise */
+	bool bindAtlasTex(ShaderBase &shader, Vec2i &offset, Vec2i &pageSize);
+
 	/* Adds 'rect' to tainted area */
 	void taintArea(const IntRect &rect);
 
 	sigslot::signal<> modified;
 
+	/* Emitted right after 'modified' with the part of the
+	 * bitmap that changed, for users that keep copies of it */
+	sigslot::signal<const IntRect&> modifiedArea;
+
 	static int maxSize();
     
     bool invalid() const;
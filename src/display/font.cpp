@@ -20,6 +20,7 @@
 */
 
 #include "font.h"
+#include "fontindex.h"
 
 #include "sharedstate.h"
 #include "filesystem.h"
@@ -34,6 +35,9 @@
 #include <utility>
 #include <algorithm>
 #include <cctype>
+#include <list>
+#include <thread>
+#include <string.h>
 
 #ifdef MKXPZ_BUILD_XCODE
 #include "filesystem/filesystem.h"
@@ -79,10 +83,47 @@ static SDL_RWops *openBundledFont()
 #endif
 }
 
+static void readWholeFile(SDL_RWops *ops, std::string &out)
+{
+	Sint64 size = SDL_RWsize(ops);
+
+	if (size > 0)
+	{
+		out.resize(size);
+		out.resize(SDL_RWread(ops, &out[0], 1, size));
+	}
+
+	SDL_RWclose(ops);
+}
+
 
 
 typedef std::pair<std::string, int> FontKey;
 
+/* Contents of one font file, shared by all sizes opened from it */
+struct FontData
+{
+	const void *mem;
+	size_t size;
+
+	/* Storage, unless 'mem' points at static data */
+	std::string bytes;
+
+	/* Number of pooled fonts reading from this */
+	size_t refs;
+
+	FontData()
+	    : mem(0), size(0), refs(0)
+	{}
+};
+
+struct PooledFont
+{
+	TTF_Font *font;
+	std::string dataKey;
+	std::list<FontKey>::iterator lruIter;
+};
+
 struct FontSet
 {
 	/* 'Regular' style */
@@ -102,9 +143,221 @@ struct SharedFontStatePrivate
 	 * font filenames located in "Fonts/" */
 	BoostHash<std::string, FontSet> sets;
 
-	/* Pool of already opened fonts; once opened, they are reused
-	 * and never closed until the termination of the program */
-	BoostHash<FontKey, TTF_Font*> pool;
+	/* Pool of already opened fonts; the least recently
+	 * used ones are closed once 'poolCapacity' is exceeded */
+	BoostHash<FontKey, PooledFont> pool;
+
+	/* Most recently used at the front */
+	std::list<FontKey> lru;
+	size_t poolCapacity;
+
+	/* Maps: physical font filename ("" for the built-in font),
+	 * To: its contents, read through once */
+	BoostHash<std::string, FontData*> data;
+
+	/* Bumped whenever a pooled font gets closed */
+	unsigned int generation;
+
+	/* Every font file found in "Fonts/", in enumeration order,
+	 * and the names read from it (empty until known) */
+	std::vector<SharedFontState::FontFile> files;
+	std::vector<FontIndex::Entry> names;
+
+	FontIndex index;
+	std::string indexFile;
+
+	/* Reads the names of files not in the index */
+	FileSystem *fs;
+	std::thread scanThread;
+	std::vector<size_t> pending;
+
+	void addToSet(std::string family, const std::string &style,
+	              const std::string &filename)
+	{
+		std::transform(family.begin(), family.end(), family.begin(),
+			[](unsigned char c){ return std::tolower(c); });
+
+		FontSet &set = sets[family];
+
+		if (style == "Regular")
+			set.regular = filename;
+		else
+			set.other = filename;
+	}
+
+	void scanPending()
+	{
+		for (size_t i = 0; i < pending.size(); ++i)
+		{
+			FontIndex::Entry &entry = names[pending[i]];
+			SDL_RWops *ops = SDL_AllocRW();
+
+			try
+			{
+				fs->openReadRaw(*ops, files[pending[i]].path.c_str(), true);
+			}
+			catch (const Exception &)
+			{
+				SDL_FreeRW(ops);
+				continue;
+			}
+
+			if (!FontIndex::readNames(*ops, entry.family, entry.style))
+				entry.family.clear();
+
+			SDL_RWclose(ops);
+		}
+	}
+
+	/* Waits for the background scan, then rebuilds the
+	 * font sets with every file in order */
+	void finishScan()
+	{
+		if (!scanThread.joinable())
+			return;
+
+		scanThread.join();
+
+		for (size_t i = 0; i < pending.size(); ++i)
+		{
+			FontIndex::Entry &entry = names[pending[i]];
+
+			if (!entry.family.empty())
+				continue;
+
+			/* Not something the name table reader understands,
+			 * let FreeType have a go at it */
+			SDL_RWops *ops = SDL_AllocRW();
+
+			try
+			{
+				fs->openReadRaw(*ops, files[pending[i]].path.c_str(), true);
+			}
+			catch (const Exception &)
+			{
+				SDL_FreeRW(ops);
+				continue;
+			}
+
+			TTF_Font *font = TTF_OpenFontRW(ops, 1, 0);
+
+			if (!font)
+				continue;
+
+			const char *family = TTF_FontFaceFamilyName(font);
+			const char *style = TTF_FontFaceStyleName(font);
+
+			if (family && style)
+			{
+				entry.family = family;
+				entry.style = style;
+			}
+
+			TTF_CloseFont(font);
+		}
+
+		sets.clear();
+		index.clear();
+
+		for (size_t i = 0; i < files.size(); ++i)
+		{
+			if (names[i].family.empty())
+				continue;
+
+			addToSet(names[i].family, names[i].style, files[i].path);
+			index.insert(files[i].path, names[i]);
+		}
+
+		if (!indexFile.empty())
+			index.save(indexFile);
+
+		pending.clear();
+	}
+
+	SharedFontState::Stats stats;
+
+	FontData *acquireData(const std::string &path)
+	{
+		if (data.contains(path))
+		{
+			FontData *d = data[path];
+			++d->refs;
+
+			return d;
+		}
+
+		SDL_RWops *ops = 0;
+
+		if (!path.empty())
+		{
+			ops = SDL_AllocRW();
+			shState->fileSystem().openReadRaw(*ops, path.c_str(), true);
+		}
+#ifdef MKXPZ_BUILD_XCODE
+		else
+		{
+			ops = openBundledFont();
+		}
+#endif
+
+		FontData *d = new FontData;
+
+		if (ops)
+		{
+			readWholeFile(ops, d->bytes);
+		}
+#ifndef MKXPZ_BUILD_XCODE
+		else
+		{
+			d->mem = BNDL_F_D(BUNDLED_FONT);
+			d->size = BNDL_F_L(BUNDLED_FONT);
+		}
+#endif
+
+		if (!d->bytes.empty())
+		{
+			d->mem = d->bytes.data();
+			d->size = d->bytes.size();
+		}
+
+		d->refs = 1;
+		data.insert(path, d);
+
+		stats.dataBytes += d->bytes.size();
+		++stats.dataCount;
+
+		return d;
+	}
+
+	void releaseData(const std::string &path)
+	{
+		FontData *d = data[path];
+
+		if (--d->refs > 0)
+			return;
+
+		stats.dataBytes -= d->bytes.size();
+		--stats.dataCount;
+
+		data.remove(path);
+		delete d;
+	}
+
+	void evict()
+	{
+		FontKey key = lru.back();
+		PooledFont &entry = pool[key];
+
+		TTF_CloseFont(entry.font);
+		releaseData(entry.dataKey);
+
+		lru.pop_back();
+		pool.remove(key);
+
+		++generation;
+		++stats.evictions;
+		--stats.openFonts;
+	}
     
     /* Internal default font family that is used anytime an
      * empty/invalid family is requested */
@@ -114,6 +367,16 @@ struct SharedFontStatePrivate
 SharedFontState::SharedFontState(const Config &conf)
 {
 	p = new SharedFontStatePrivate;
+	p->poolCapacity = conf.fontCacheSize;
+	p->generation = 0;
+	p->fs = 0;
+
+	if (conf.fontIndex && !conf.customDataPath.empty())
+	{
+		p->indexFile = conf.customDataPath + "/fonts.idx";
+		p->index.load(p->indexFile);
+	}
+	memset(&p->stats, 0, sizeof(p->stats));
 
 	/* Parse font substitutions */
 	for (size_t i = 0; i < conf.fontSubs.size(); ++i)
@@ -133,40 +396,68 @@ SharedFontState::SharedFontState(const Config &conf)
 
 SharedFontState::~SharedFontState()
 {
-	BoostHash<FontKey, TTF_Font*>::const_iterator iter;
+	if (p->scanThread.joinable())
+		p->scanThread.join();
+
+	BoostHash<FontKey, PooledFont>::const_iterator iter;
 	for (iter = p->pool.cbegin(); iter != p->pool.cend(); ++iter)
-		TTF_CloseFont(iter->second);
+		TTF_CloseFont(iter->second.font);
+
+	BoostHash<std::string, FontData*>::const_iterator diter;
+	for (diter = p->data.cbegin(); diter != p->data.cend(); ++diter)
+		delete diter->second;
 
 	delete p;
 }
 
-void SharedFontState::initFontSetCB(SDL_RWops &ops,
-                                    const std::string &filename)
+void SharedFontState::initFontSets(FileSystem &fs,
+                                   const std::vector<FontFile> &files)
 {
-	TTF_Font *font = TTF_OpenFontRW(&ops, 0, 0);
+	p->files = files;
+	p->names.resize(files.size());
 
-	if (!font)
-		return;
+	for (size_t i = 0; i < files.size(); ++i)
+	{
+		const FontFile &file = files[i];
+		FontIndex::Entry &entry = p->names[i];
 
-	std::string family = TTF_FontFaceFamilyName(font);
-	std::string style = TTF_FontFaceStyleName(font);
+		entry.size = file.size;
+		entry.mtime = file.mtime;
 
-	std::transform(family.begin(), family.end(), family.begin(),
-		[](unsigned char c){ return std::tolower(c); });
+		if (file.mtime >= 0 &&
+		    p->index.lookup(file.path, file.size, file.mtime, entry))
+		{
+			p->addToSet(entry.family, entry.style, file.path);
+		}
+		else
+		{
+			entry.family.clear();
+			p->pending.push_back(i);
+		}
+	}
 
-	TTF_CloseFont(font);
+	if (!p->pending.empty())
+	{
+		p->fs = &fs;
+		p->scanThread = std::thread(&SharedFontStatePrivate::scanPending, p);
+	}
+	else if (!p->indexFile.empty() && p->index.size() != files.size())
+	{
+		/* Only removals since last time */
+		p->index.clear();
 
-	FontSet &set = p->sets[family];
+		for (size_t i = 0; i < files.size(); ++i)
+			p->index.insert(files[i].path, p->names[i]);
 
-	if (style == "Regular")
-		set.regular = filename;
-	else
-		set.other = filename;
+		p->index.save(p->indexFile);
+	}
 }
 
 _TTF_Font *SharedFontState::getFont(std::string family,
                                     int size)
 {
+	p->finishScan();
+
 	std::transform(family.begin(), family.end(), family.begin(),
 		[](unsigned char c){ return std::tolower(c); });
 
@@ -188,43 +479,66 @@ _TTF_Font *SharedFontState::getFont(std::string family,
 
 	FontKey key(family, size);
 
-	TTF_Font *font = p->pool.value(key);
-
-	if (font)
-		return font;
+	if (p->pool.contains(key))
+	{
+		PooledFont &entry = p->pool[key];
 
-	/* Not in pool; open new handle */
-	SDL_RWops *ops;
+		/* Move to the front */
+		p->lru.splice(p->lru.begin(), p->lru, entry.lruIter);
+		++p->stats.hits;
 
-	if (family.empty())
-	{
-		/* Built-in font */
-		ops = openBundledFont();
+		return entry.font;
 	}
-	else
-	{
-		/* Use 'other' path as alternative in case
-		 * we have no 'regular' styled font asset */
-		const char *path = !req.regular.empty()
-		                 ? req.regular.c_str() : req.other.c_str();
 
-		ops = SDL_AllocRW();
-		shState->fileSystem().openReadRaw(*ops, path, true);
-	}
+	/* Not in pool; open new handle on the (shared) file contents.
+	 * Use 'other' path as alternative in case we have no 'regular'
+	 * styled font asset */
+	std::string dataKey;
+
+	if (!family.empty())
+		dataKey = !req.regular.empty() ? req.regular : req.other;
+
+	FontData *data = p->acquireData(dataKey);
+	SDL_RWops *ops = SDL_RWFromConstMem(data->mem, data->size);
 
 	// FIXME 0.9 is guesswork at this point
 //	float gamma = (96.0/45.0)*(5.0/14.0)*(size-5);
 //	font = TTF_OpenFontRW(ops, 1, gamma /** .90*/);
-	font = TTF_OpenFontRW(ops, 1, size* 0.90f);
+	TTF_Font *font = TTF_OpenFontRW(ops, 1, size* 0.90f);
 
 	if (!font)
+	{
+		p->releaseData(dataKey);
 		throw Exception(Exception::SDLError, "%s", SDL_GetError());
+	}
+
+	++p->stats.misses;
+	++p->stats.openFonts;
 
-	p->pool.insert(key, font);
+	if (p->poolCapacity > 0 && p->lru.size() >= p->poolCapacity)
+		p->evict();
+
+	p->lru.push_front(key);
+
+	PooledFont entry;
+	entry.font = font;
+	entry.dataKey = dataKey;
+	entry.lruIter = p->lru.begin();
+	p->pool.insert(key, entry);
 
 	return font;
 }
 
+unsigned int SharedFontState::generation() const
+{
+	return p->generation;
+}
+
+SharedFontState::Stats SharedFontState::stats() const
+{
+	return p->stats;
+}
+
 bool SharedFontState::fontPresent(std::string family) const
 {
 	std::transform(family.begin(), family.end(), family.begin(),
@@ -234,6 +548,15 @@ bool SharedFontState::fontPresent(std::string family) const
 	if (p->subs.contains(family))
 		family = p->subs[family];
 
+	if (!p->sets.contains(family))
+	{
+		/* Might be among the fonts still being scanned */
+		p->finishScan();
+
+		if (!p->sets.contains(family))
+			return false;
+	}
+
 	const FontSet &set = p->sets[family];
 
 	return !(set.regular.empty() && set.other.empty());
@@ -314,6 +637,9 @@ struct FontPrivate
 	 * (when it is queried by a Bitmap), prior it is
 	 * set to null */
 	TTF_Font *sdlFont;
+	/* SharedFontState generation 'sdlFont' was obtained in;
+	 * if the pool closed anything since, it must be refetched */
+	unsigned int sdlFontGen;
     
     bool isSolid;
 
@@ -328,6 +654,7 @@ struct FontPrivate
 	      colorTmp(*defaultColor),
 	      outColorTmp(*defaultOutColor),
 	      sdlFont(0),
+	      sdlFontGen(0),
           isSolid(false)
 	{}
 
@@ -343,6 +670,7 @@ struct FontPrivate
 	      colorTmp(*other.color),
 	      outColorTmp(*other.outColor),
 	      sdlFont(other.sdlFont),
+	      sdlFontGen(other.sdlFontGen),
           isSolid(false)
 	{}
 
@@ -515,9 +843,13 @@ void Font::initDefaults(const SharedFontState &sfs)
 
 _TTF_Font *Font::getSdlFont()
 {
-	if (!p->sdlFont)
-		p->sdlFont = shState->fontState().getFont(p->name.c_str(),
-		                                          p->size);
+	SharedFontState &sfs = shState->fontState();
+
+	if (!p->sdlFont || p->sdlFontGen != sfs.generation())
+	{
+		p->sdlFont = sfs.getFont(p->name.c_str(), p->size);
+		p->sdlFontGen = sfs.generation();
+	}
 
 	int style = TTF_STYLE_NORMAL;
 
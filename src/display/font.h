@@ -25,12 +25,13 @@
 #include "etc.h"
 #include "util.h"
 
+#include <stdint.h>
 #include <vector>
 #include <string>
 
-struct SDL_RWops;
 struct _TTF_Font;
 struct Config;
+class FileSystem;
 
 struct SharedFontStatePrivate;
 
@@ -40,16 +41,44 @@ public:
 	SharedFontState(const Config &conf);
 	~SharedFontState();
 
-	/* Called from FileSystem during font cache initialization
-	 * (when "Fonts/" is scanned for available assets).
-	 * 'ops' is an opened handle to a possible font file,
-	 * 'filename' is the corresponding path */
-	void initFontSetCB(SDL_RWops &ops,
-	                   const std::string &filename);
+	struct FontFile
+	{
+		std::string path;
+		int64_t size;
+		/* -1 if unknown */
+		int64_t mtime;
+	};
 
+	/* Called from FileSystem during font cache initialization
+	 * (when "Fonts/" is scanned for available assets) with
+	 * every possible font file. Names of files in the font
+	 * index are taken from there; all others are read on a
+	 * background thread, which lookups wait for as needed */
+	void initFontSets(FileSystem &fs,
+	                  const std::vector<FontFile> &files);
+
+	/* The returned font stays valid until the next call,
+	 * or for as long as generation() doesn't change */
 	_TTF_Font *getFont(std::string family,
 	                   int size);
 
+	unsigned int generation() const;
+
+	struct Stats
+	{
+		/* Opened (family, size) pairs */
+		size_t openFonts;
+		/* Font file contents held in memory */
+		size_t dataBytes;
+		size_t dataCount;
+
+		size_t hits;
+		size_t misses;
+		size_t evictions;
+	};
+
+	Stats stats() const;
+
 	bool fontPresent(std::string family) const;
 
 	static _TTF_Font *openBundled(int size);
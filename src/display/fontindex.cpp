@@ -0,0 +1,360 @@
+/*
+** fontindex.cpp
+**
+** This file is part of mkxp.
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "fontindex.h"
+
+#include "debugwriter.h"
+#include "serial-util.h"
+
+#include <SDL_rwops.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#define FONT_INDEX_MAGIC "MKXPFNT1"
+
+/* sfnt name table reading */
+
+#define SFNT_TAG(a, b, c, d) \
+	(((uint32_t) (a) << 24) | ((uint32_t) (b) << 16) | ((uint32_t) (c) << 8) | (uint32_t) (d))
+
+enum
+{
+	NameFamily = 1,
+	NameStyle = 2,
+	NameTypoFamily = 16,
+	NameTypoStyle = 17
+};
+
+static uint16_t be16(const uint8_t *p)
+{
+	return (p[0] << 8) | p[1];
+}
+
+static uint32_t be32(const uint8_t *p)
+{
+	return ((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16) | ((uint32_t) p[2] << 8) | p[3];
+}
+
+static bool readAt(SDL_RWops &ops, Sint64 offset, void *dst, size_t size)
+{
+	if (SDL_RWseek(&ops, offset, RW_SEEK_SET) != offset)
+		return false;
+
+	return SDL_RWread(&ops, dst, 1, size) == size;
+}
+
+struct NameRecord
+{
+	uint16_t platform;
+	uint16_t encoding;
+	uint16_t language;
+	uint16_t name;
+	uint16_t length;
+	uint16_t offset;
+};
+
+/* Same preference as FreeType's tt_face_get_name(): an English
+ * Windows record, then a Macintosh one (English, else Roman),
+ * then a Unicode platform one. Returns -1 if there is none */
+static int pickRecord(const std::vector<NameRecord> &recs, uint16_t nameId)
+{
+	int win = -1, apple = -1, appleRoman = -1, unicode = -1;
+
+	for (size_t i = 0; i < recs.size(); ++i)
+	{
+		const NameRecord &rec = recs[i];
+
+		if (rec.name != nameId || rec.length == 0)
+			continue;
+
+		switch (rec.platform)
+		{
+		case 0 :
+		case 2 :
+			unicode = i;
+			break;
+
+		case 1 :
+			if (rec.language == 0)
+				apple = i;
+			else if (rec.encoding == 0)
+				appleRoman = i;
+			break;
+
+		case 3 :
+			if ((rec.language & 0x3FF) == 0x009 && (rec.encoding <= 1 || rec.encoding == 10))
+			{
+				if (win == -1 || rec.language == 0x409)
+					win = i;
+			}
+			break;
+		}
+	}
+
+	if (win >= 0)
+		return win;
+
+	if (apple >= 0)
+		return apple;
+
+	if (appleRoman >= 0)
+		return appleRoman;
+
+	return unicode;
+}
+
+/* FreeType only produces ASCII names, substituting '?' for
+ * everything else; do the same so index entries match what
+ * SDL_ttf reports */
+static std::string decodeName(const NameRecord &rec, const uint8_t *data)
+{
+	std::string out;
+	bool utf16 = rec.platform != 1;
+	size_t step = utf16 ? 2 : 1;
+
+	for (size_t i = 0; i + step <= rec.length; i += step)
+	{
+		unsigned code = utf16 ? be16(data + i) : data[i];
+
+		if (code == 0)
+			break;
+
+		if (code < 32 || code > 127)
+			code = '?';
+
+		out += (char) code;
+	}
+
+	return out;
+}
+
+bool FontIndex::readNames(SDL_RWops &ops,
+                          std::string &family, std::string &style)
+{
+	uint8_t header[12];
+
+	if (!readAt(ops, 0, header, sizeof(header)))
+		return false;
+
+	Sint64 fontOffset = 0;
+
+	/* Collections: use the first face, like TTF_OpenFontRW */
+	if (be32(header) == SFNT_TAG('t', 't', 'c', 'f'))
+	{
+		fontOffset = be32(header + 8);
+
+		if (!readAt(ops, fontOffset, header, sizeof(header)))
+			return false;
+	}
+
+	uint32_t version = be32(header);
+
+	if (version != 0x00010000 &&
+	    version != SFNT_TAG('O', 'T', 'T', 'O') &&
+	    version != SFNT_TAG('t', 'r', 'u', 'e'))
+		return false;
+
+	uint16_t tableCount = be16(header + 4);
+	std::vector<uint8_t> tables(tableCount * 16);
+
+	if (tableCount == 0 || !readAt(ops, fontOffset + 12, &tables[0], tables.size()))
+		return false;
+
+	uint32_t nameOffset = 0, nameLength = 0;
+
+	for (uint16_t i = 0; i < tableCount; ++i)
+	{
+		const uint8_t *rec = &tables[i * 16];
+
+		if (be32(rec) == SFNT_TAG('n', 'a', 'm', 'e'))
+		{
+			nameOffset = be32(rec + 8);
+			nameLength = be32(rec + 12);
+			break;
+		}
+	}
+
+	/* Name tables are small, anything beyond this is garbage */
+	if (nameLength < 6 || nameLength > 0x100000)
+		return false;
+
+	std::vector<uint8_t> name(nameLength);
+
+	if (!readAt(ops, nameOffset, &name[0], nameLength))
+		return false;
+
+	uint16_t recCount = be16(&name[2]);
+	uint16_t storage = be16(&name[4]);
+
+	if (6 + (size_t) recCount * 12 > nameLength)
+		return false;
+
+	std::vector<NameRecord> recs(recCount);
+
+	for (uint16_t i = 0; i < recCount; ++i)
+	{
+		const uint8_t *p = &name[6 + i * 12];
+		NameRecord &rec = recs[i];
+
+		rec.platform = be16(p);
+		rec.encoding = be16(p + 2);
+		rec.language = be16(p + 4);
+		rec.name = be16(p + 6);
+		rec.length = be16(p + 8);
+		rec.offset = be16(p + 10);
+
+		/* Drop records pointing outside the table */
+		if ((size_t) storage + rec.offset + rec.length > nameLength)
+			rec.length = 0;
+	}
+
+	/* The typographic names take precedence when present */
+	int familyRec = pickRecord(recs, NameTypoFamily);
+	if (familyRec < 0)
+		familyRec = pickRecord(recs, NameFamily);
+
+	int styleRec = pickRecord(recs, NameTypoStyle);
+	if (styleRec < 0)
+		styleRec = pickRecord(recs, NameStyle);
+
+	if (familyRec < 0 || styleRec < 0)
+		return false;
+
+	const NameRecord &fr = recs[familyRec];
+	const NameRecord &sr = recs[styleRec];
+
+	family = decodeName(fr, &name[storage + fr.offset]);
+	style = decodeName(sr, &name[storage + sr.offset]);
+
+	return !family.empty() && !style.empty();
+}
+
+/* Index file */
+
+bool FontIndex::load(const std::string &file)
+{
+	entries.clear();
+
+	FILE *f = fopen(file.c_str(), "rb");
+
+	if (!f)
+		return false;
+
+	std::string buf;
+	char chunk[0x4000];
+	size_t n;
+
+	while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0)
+		buf.append(chunk, n);
+
+	fclose(f);
+
+	const size_t magicLen = strlen(FONT_INDEX_MAGIC);
+
+	if (buf.size() < magicLen || memcmp(buf.data(), FONT_INDEX_MAGIC, magicLen))
+		return false;
+
+	SerialReader r = { buf.data() + magicLen, buf.data() + buf.size(), true };
+
+	uint32_t count = r.u32();
+
+	for (uint32_t i = 0; r.ok && i < count; ++i)
+	{
+		std::string path = r.str();
+
+		Entry entry;
+		entry.size = r.i64();
+		entry.mtime = r.i64();
+		entry.family = r.str();
+		entry.style = r.str();
+
+		if (r.ok)
+			entries.insert(path, entry);
+	}
+
+	if (!r.ok)
+		entries.clear();
+
+	return r.ok;
+}
+
+void FontIndex::save(const std::string &file) const
+{
+	std::string buf(FONT_INDEX_MAGIC);
+	std::string body;
+	uint32_t count = 0;
+
+	BoostHash<std::string, Entry>::const_iterator iter;
+	for (iter = entries.cbegin(); iter != entries.cend(); ++iter, ++count)
+	{
+		putStr(body, iter->first);
+		putI64(body, iter->second.size);
+		putI64(body, iter->second.mtime);
+		putStr(body, iter->second.family);
+		putStr(body, iter->second.style);
+	}
+
+	putU32(buf, count);
+	buf += body;
+
+	FILE *f = fopen(file.c_str(), "wb");
+
+	if (!f)
+	{
+		Debug() << "Unable to write font index" << file;
+		return;
+	}
+
+	fwrite(buf.data(), 1, buf.size(), f);
+	fclose(f);
+}
+
+bool FontIndex::lookup(const std::string &path, int64_t size, int64_t mtime,
+                       Entry &out) const
+{
+	if (!entries.contains(path))
+		return false;
+
+	out = entries.value(path);
+
+	return out.size == size && out.mtime == mtime;
+}
+
+void FontIndex::insert(const std::string &path, const Entry &entry)
+{
+	entries.insert(path, entry);
+}
+
+void FontIndex::clear()
+{
+	entries.clear();
+}
+
+size_t FontIndex::size() const
+{
+	size_t count = 0;
+
+	BoostHash<std::string, Entry>::const_iterator iter;
+	for (iter = entries.cbegin(); iter != entries.cend(); ++iter)
+		++count;
+
+	return count;
+}
@@ -0,0 +1,67 @@
+/*
+** fontindex.h
+**
+** This file is part of mkxp.
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef FONTINDEX_H
+#define FONTINDEX_H
+
+#include "boost-hash.h"
+
+#include <stdint.h>
+#include <string>
+
+struct SDL_RWops;
+
+/* Family and style names of the font files found in "Fonts/",
+ * remembered across launches. An entry is only trusted as long
+ * as the file's size and modification time stay the same. */
+class FontIndex
+{
+public:
+	struct Entry
+	{
+		int64_t size;
+		int64_t mtime;
+
+		std::string family;
+		std::string style;
+	};
+
+	/* Returns false (leaving the index empty)
+	 * if the file is missing or unreadable */
+	bool load(const std::string &file);
+	void save(const std::string &file) const;
+
+	bool lookup(const std::string &path, int64_t size, int64_t mtime,
+	            Entry &out) const;
+	void insert(const std::string &path, const Entry &entry);
+	void clear();
+	size_t size() const;
+
+	/* Reads the family and style names straight from the
+	 * sfnt 'name' table, picking the same records FreeType
+	 * would. Returns false for anything it can't make sense
+	 * of, in which case the font should be opened normally */
+	static bool readNames(SDL_RWops &ops,
+	                      std::string &family, std::string &style);
+
+private:
+	BoostHash<std::string, Entry> entries;
+};
+
+#endif // FONTINDEX_H
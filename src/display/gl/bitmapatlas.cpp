@@ -0,0 +1,461 @@
+/*
+** bitmapatlas.cpp
+**
+** This file is part of mkxp.
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "bitmapatlas.h"
+
+#include "texpool.h"
+#include "gl-meta.h"
+#include "glstate.h"
+#include "sharedstate.h"
+#include "exception.h"
+
+#include <algorithm>
+#include <string.h>
+
+#define PAGE_SIZE 2048
+
+/* Kept free to the right of and below each region, so
+ * that sampling right at a sprite's edge can't pick up
+ * its neighbour */
+#define PADDING 1
+
+struct SkylineNode
+{
+	int x, y, w;
+};
+
+typedef std::vector<SkylineNode> Skyline;
+
+/* Whether a 'w' x 'h' rectangle can sit on the skyline
+ * starting at node 'i', and at which height it would */
+static bool fitsAt(const Skyline &sky, size_t i, int w, int h, int size, int &y)
+{
+	if (sky[i].x + w > size)
+		return false;
+
+	y = sky[i].y;
+
+	for (int left = w; left > 0; left -= sky[i++].w)
+	{
+		y = std::max(y, sky[i].y);
+
+		if (y + h > size)
+			return false;
+	}
+
+	return true;
+}
+
+/* Bottom-left skyline packing: takes the spot whose top edge
+ * ends up lowest, ties going to the narrowest node */
+static bool skylinePlace(Skyline &sky, int w, int h, int size, IntRect &rect)
+{
+	size_t best = sky.size();
+	int bestTop = size + 1;
+	int bestWidth = size + 1;
+	int bestY = 0;
+
+	for (size_t i = 0; i < sky.size(); ++i)
+	{
+		int y;
+
+		if (!fitsAt(sky, i, w, h, size, y))
+			continue;
+
+		if (y + h < bestTop || (y + h == bestTop && sky[i].w < bestWidth))
+		{
+			best = i;
+			bestTop = y + h;
+			bestWidth = sky[i].w;
+			bestY = y;
+		}
+	}
+
+	if (best == sky.size())
+		return false;
+
+	rect = IntRect(sky[best].x, bestY, w, h);
+
+	SkylineNode node = { rect.x, bestY + h, w };
+	sky.insert(sky.begin() + best, node);
+
+	/* Cut away what the new node now covers */
+	for (size_t i = best + 1; i < sky.size();)
+	{
+		int prevEnd = sky[i-1].x + sky[i-1].w;
+
+		if (sky[i].x >= prevEnd)
+			break;
+
+		int shrink = prevEnd - sky[i].x;
+		sky[i].x += shrink;
+		sky[i].w -= shrink;
+
+		if (sky[i].w > 0)
+			break;
+
+		sky.erase(sky.begin() + i);
+	}
+
+	for (size_t i = 0; i + 1 < sky.size();)
+	{
+		if (sky[i].y == sky[i+1].y)
+		{
+			sky[i].w += sky[i+1].w;
+			sky.erase(sky.begin() + i + 1);
+		}
+		else
+		{
+			++i;
+		}
+	}
+
+	return true;
+}
+
+static uint64_t paddedArea(const IntRect &rect)
+{
+	return (uint64_t) (rect.w + PADDING) * (rect.h + PADDING);
+}
+
+struct BitmapAtlas::Page
+{
+	TEXFBO tex;
+	Skyline skyline;
+
+	std::vector<Region*> regions;
+
+	/* Area handed out since the page was last packed,
+	 * and how much of it is still in use */
+	uint64_t usedArea;
+	uint64_t liveArea;
+
+	/* Set when repacking didn't work out, cleared
+	 * once a region is removed */
+	bool stuck;
+
+	void reset(int size)
+	{
+		SkylineNode node = { 0, 0, size };
+		skyline.assign(1, node);
+
+		usedArea = liveArea = 0;
+		stuck = false;
+	}
+
+	bool place(int w, int h, int size, IntRect &rect)
+	{
+		if (!skylinePlace(skyline, w + PADDING, h + PADDING, size, rect))
+			return false;
+
+		rect.w = w;
+		rect.h = h;
+
+		usedArea += paddedArea(rect);
+		liveArea += paddedArea(rect);
+
+		return true;
+	}
+};
+
+BitmapAtlas::BitmapAtlas(TexPool &texPool, int maxSize)
+    : texPool(texPool),
+      maxSize(maxSize),
+      pageSize(0)
+{
+	memset(&st, 0, sizeof(st));
+}
+
+BitmapAtlas::~BitmapAtlas()
+{
+	for (size_t i = 0; i < pages.size(); ++i)
+	{
+		for (size_t j = 0; j < pages[i]->regions.size(); ++j)
+			delete pages[i]->regions[j];
+
+		texPool.release(pages[i]->tex);
+		delete pages[i];
+	}
+}
+
+bool BitmapAtlas::enabled() const
+{
+	return maxSize > 0;
+}
+
+bool BitmapAtlas::fits(int width, int height) const
+{
+	return enabled() && width <= maxSize && height <= maxSize;
+}
+
+BitmapAtlas::Region *BitmapAtlas::insert(const void *pixels, int width, int height)
+{
+	if (!fits(width, height))
+		return 0;
+
+	IntRect rect;
+	Page *page = allocate(width, height, rect);
+
+	if (!page)
+		return 0;
+
+	TEX::bind(page->tex.tex);
+	TEX::uploadSubImage(rect.x, rect.y, width, height, pixels, GL_RGBA);
+
+	Region *region = new Region { page, rect };
+	page->regions.push_back(region);
+
+	++st.regionCount;
+	st.liveBytes += (uint64_t) width * height * 4;
+
+	return region;
+}
+
+BitmapAtlas::Region *BitmapAtlas::insert(TEXFBO &source)
+{
+	if (!fits(source.width, source.height))
+		return 0;
+
+	IntRect rect;
+	Page *page = allocate(source.width, source.height, rect);
+
+	if (!page)
+		return 0;
+
+	GLMeta::blitBegin(page->tex);
+	GLMeta::blitSource(source);
+	GLMeta::blitRectangle(IntRect(0, 0, rect.w, rect.h), Vec2i(rect.x, rect.y));
+	GLMeta::blitEnd();
+
+	Region *region = new Region { page, rect };
+	page->regions.push_back(region);
+
+	++st.regionCount;
+	st.liveBytes += (uint64_t) rect.w * rect.h * 4;
+
+	return region;
+}
+
+void BitmapAtlas::remove(Region *region)
+{
+	Page *page = region->page;
+
+	page->regions.erase(std::find(page->regions.begin(), page->regions.end(), region));
+	page->liveArea -= paddedArea(region->rect);
+	page->stuck = false;
+
+	--st.regionCount;
+	st.liveBytes -= (uint64_t) region->rect.w * region->rect.h * 4;
+
+	delete region;
+
+	if (page->regions.empty())
+		releasePage(page);
+}
+
+TEXFBO &BitmapAtlas::texture(const Region &region)
+{
+	return region.page->tex;
+}
+
+void BitmapAtlas::compact()
+{
+	if (pages.empty())
+		return;
+
+	const uint64_t pageArea = (uint64_t) pageSize * pageSize;
+
+	/* Only bother once a quarter of a page is wasted */
+	Page *worst = 0;
+	uint64_t worstWaste = pageArea / 4;
+
+	for (size_t i = 0; i < pages.size(); ++i)
+	{
+		Page *page = pages[i];
+		uint64_t waste = page->usedArea - page->liveArea;
+
+		if (!page->stuck && waste > worstWaste)
+		{
+			worst = page;
+			worstWaste = waste;
+		}
+	}
+
+	if (!worst)
+		return;
+
+	/* Mostly empty pages are better off given up */
+	if (worst->liveArea < pageArea / 4 && pages.size() > 1)
+		if (migrate(worst))
+			return;
+
+	if (!repack(worst))
+		worst->stuck = true;
+}
+
+const BitmapAtlas::Stats &BitmapAtlas::stats() const
+{
+	return st;
+}
+
+BitmapAtlas::Page *BitmapAtlas::allocate(int width, int height, IntRect &rect)
+{
+	for (size_t i = 0; i < pages.size(); ++i)
+		if (pages[i]->place(width, height, pageSize, rect))
+			return pages[i];
+
+	Page *page = newPage();
+
+	if (!page || !page->place(width, height, pageSize, rect))
+		return 0;
+
+	return page;
+}
+
+BitmapAtlas::Page *BitmapAtlas::newPage()
+{
+	if (pageSize == 0)
+	{
+		pageSize = std::min(PAGE_SIZE, glState.caps.maxTexSize);
+		maxSize = std::min(maxSize, pageSize / 2);
+	}
+
+	Page *page = new Page;
+
+	try
+	{
+		page->tex = texPool.request(pageSize, pageSize);
+	}
+	catch (const Exception &)
+	{
+		delete page;
+		return 0;
+	}
+
+	page->reset(pageSize);
+	pages.push_back(page);
+
+	++st.pageCount;
+	st.pageBytes += (uint64_t) pageSize * pageSize * 4;
+
+	return page;
+}
+
+void BitmapAtlas::releasePage(Page *page)
+{
+	pages.erase(std::find(pages.begin(), pages.end(), page));
+	texPool.release(page->tex);
+
+	--st.pageCount;
+	st.pageBytes -= (uint64_t) pageSize * pageSize * 4;
+
+	delete page;
+}
+
+/* Moves the page's regions into the free space of other pages,
+ * and releases it if that worked out for all of them */
+bool BitmapAtlas::migrate(Page *page)
+{
+	std::vector<Region*> regions = page->regions;
+
+	for (size_t i = 0; i < regions.size(); ++i)
+	{
+		Region *region = regions[i];
+		IntRect rect;
+		Page *target = 0;
+
+		for (size_t j = 0; j < pages.size() && !target; ++j)
+			if (pages[j] != page && pages[j]->place(region->rect.w, region->rect.h, pageSize, rect))
+				target = pages[j];
+
+		if (!target)
+			return false;
+
+		GLMeta::blitBegin(target->tex);
+		GLMeta::blitSource(page->tex);
+		GLMeta::blitRectangle(region->rect, Vec2i(rect.x, rect.y));
+		GLMeta::blitEnd();
+
+		page->regions.erase(std::find(page->regions.begin(), page->regions.end(), region));
+		page->liveArea -= paddedArea(region->rect);
+
+		region->page = target;
+		region->rect = rect;
+		target->regions.push_back(region);
+
+		++st.moves;
+	}
+
+	releasePage(page);
+
+	return true;
+}
+
+/* Packs the page's regions anew into a fresh texture,
+ * tallest first, which leaves the least gaps */
+bool BitmapAtlas::repack(Page *page)
+{
+	std::vector<Region*> order = page->regions;
+
+	std::stable_sort(order.begin(), order.end(), [](const Region *a, const Region *b)
+	{
+		return a->rect.h > b->rect.h;
+	});
+
+	Page packed;
+	packed.reset(pageSize);
+
+	std::vector<IntRect> rects(order.size());
+
+	for (size_t i = 0; i < order.size(); ++i)
+		if (!packed.place(order[i]->rect.w, order[i]->rect.h, pageSize, rects[i]))
+			return false;
+
+	try
+	{
+		packed.tex = texPool.request(pageSize, pageSize);
+	}
+	catch (const Exception &)
+	{
+		return false;
+	}
+
+	GLMeta::blitBegin(packed.tex);
+	GLMeta::blitSource(page->tex);
+
+	for (size_t i = 0; i < order.size(); ++i)
+	{
+		GLMeta::blitRectangle(order[i]->rect, Vec2i(rects[i].x, rects[i].y));
+		order[i]->rect = rects[i];
+	}
+
+	GLMeta::blitEnd();
+
+	texPool.release(page->tex);
+
+	page->tex = packed.tex;
+	page->skyline.swap(packed.skyline);
+	page->usedArea = packed.usedArea;
+	page->liveArea = packed.liveArea;
+
+	++st.repacks;
+	st.moves += order.size();
+
+	return true;
+}
@@ -0,0 +1,110 @@
+/*
+** bitmapatlas.h
+**
+** This file is part of mkxp.
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BITMAPATLAS_H
+#define BITMAPATLAS_H
+
+#include "gl-util.h"
+#include "etc-internal.h"
+
+#include <stdint.h>
+#include <vector>
+
+class TexPool;
+
+/* Shared textures that small, unmodified bitmaps (typically
+ * character sheets and icons loaded from files) live in, so
+ * that sprites showing different ones draw from the same
+ * texture instead of rebinding for each of them.
+ *
+ * Pages are requested from the TexPool and filled with a
+ * skyline packer. Space freed by removed regions is only
+ * reclaimed by compact(), which repacks (or empties into other
+ * pages) one fragmented page per call, and is meant to be
+ * called once per frame. Pages that end up empty go back to
+ * the pool right away. */
+class BitmapAtlas
+{
+public:
+	struct Page;
+
+	/* Owned by the atlas, stays valid until removed. Both
+	 * 'page' and 'rect' change when it's moved by compact() */
+	struct Region
+	{
+		Page *page;
+		IntRect rect;
+	};
+
+	struct Stats
+	{
+		uint32_t pageCount;
+		uint32_t regionCount;
+
+		/* Pixel data of all regions, in bytes */
+		uint64_t liveBytes;
+		/* Size of all pages, in bytes */
+		uint64_t pageBytes;
+
+		uint64_t repacks;
+		uint64_t moves;
+	};
+
+	/* Bitmaps up to 'maxSize' pixels in both dimensions are
+	 * taken in. A 'maxSize' of 0 disables the atlas */
+	BitmapAtlas(TexPool &texPool, int maxSize);
+	~BitmapAtlas();
+
+	bool enabled() const;
+	bool fits(int width, int height) const;
+
+	/* Copy the image into a free spot. Return null if it
+	 * doesn't fit, or no page could be allocated for it */
+	Region *insert(const void *pixels, int width, int height);
+	Region *insert(TEXFBO &source);
+
+	void remove(Region *region);
+
+	/* The page texture 'region' currently lives in */
+	static TEXFBO &texture(const Region &region);
+
+	void compact();
+
+	const Stats &stats() const;
+
+private:
+	Page *allocate(int width, int height, IntRect &rect);
+	Page *newPage();
+	void releasePage(Page *page);
+
+	bool migrate(Page *page);
+	bool repack(Page *page);
+
+	TexPool &texPool;
+
+	int maxSize;
+	/* Decided when the first page is created */
+	int pageSize;
+
+	std::vector<Page*> pages;
+
+	Stats st;
+};
+
+#endif // BITMAPATLAS_H
@@ -177,6 +177,49 @@ void initGLFunctions()
         GL_VAO_FUN;
     }
     
+    /* Program binary entrypoints */
+    if (HAVE_EXT(ARB_get_program_binary) || (gles && glMajor >= 3))
+    {
+#undef EXT_SUFFIX
+#define EXT_SUFFIX ""
+        GL_PROGRAM_BINARY_FUN;
+        GL_PROGRAM_PARAMETER_FUN;
+    }
+    else if (HAVE_EXT(OES_get_program_binary))
+    {
+#undef EXT_SUFFIX
+#define EXT_SUFFIX "OES"
+        GL_PROGRAM_BINARY_FUN;
+    }
+    
+    /* Sync object entrypoints */
+    if (HAVE_EXT(ARB_sync) || (gles && glMajor >= 3))
+    {
+#undef EXT_SUFFIX
+#define EXT_SUFFIX ""
+        GL_SYNC_FUN;
+    }
+    else if (HAVE_EXT(APPLE_sync))
+    {
+#undef EXT_SUFFIX
+#define EXT_SUFFIX "APPLE"
+        GL_SYNC_FUN;
+    }
+    
+    /* Texture barrier entrypoints */
+    if (HAVE_EXT(ARB_texture_barrier))
+    {
+#undef EXT_SUFFIX
+#define EXT_SUFFIX ""
+        GL_TEXTURE_BARRIER_FUN;
+    }
+    else if (HAVE_EXT(NV_texture_barrier))
+    {
+#undef EXT_SUFFIX
+#define EXT_SUFFIX "NV"
+        GL_TEXTURE_BARRIER_FUN;
+    }
+    
     /* Debug callback entrypoints */
     if (HAVE_EXT(KHR_debug))
     {
@@ -204,4 +247,14 @@ void initGLFunctions()
     
     if (!gles || glMajor >= 3 || HAVE_EXT(OES_texture_npot))
         gl.npot_repeat = true;
+    
+    /* Drivers may expose the entrypoints without
+     * actually supporting any binary format */
+    if (gl.GetProgramBinary && gl.ProgramBinary)
+    {
+        GLint formats = 0;
+        gl.GetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        
+        gl.program_binary = formats > 0;
+    }
 }
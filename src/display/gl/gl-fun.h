@@ -29,6 +29,8 @@
 #include <SDL_opengl.h>
 #endif
 
+#include <stdint.h>
+
 /* Etc */
 typedef GLenum (APIENTRYP _PFNGLGETERRORPROC) (void);
 typedef void (APIENTRYP _PFNGLCLEARCOLORPROC) (GLclampf red, GLclampf green, GLclampf blue, GLclampf alpha);
@@ -45,6 +47,7 @@ typedef void (APIENTRYP _PFNGLBLENDFUNCPROC) (GLenum sfactor, GLenum dfactor);
 typedef void (APIENTRYP _PFNGLBLENDFUNCSEPARATEPROC) (GLenum sfactorRGB, GLenum dfactorRGB, GLenum sfactorAlpha, GLenum dfactorAlpha);
 typedef void (APIENTRYP _PFNGLBLENDEQUATIONPROC) (GLenum mode);
 typedef void (APIENTRYP _PFNGLDRAWELEMENTSPROC) (GLenum mode, GLsizei count, GLenum type, const GLvoid *indices);
+typedef void (APIENTRYP _PFNGLFLUSHPROC) (void);
 
 /* Texture */
 typedef void (APIENTRYP _PFNGLGENTEXTURESPROC) (GLsizei n, GLuint *textures);
@@ -111,6 +114,20 @@ typedef void (APIENTRYP _PFNGLGENVERTEXARRAYSPROC) (GLsizei n, GLuint* arrays);
 typedef void (APIENTRYP _PFNGLDELETEVERTEXARRAYSPROC) (GLsizei n, const GLuint* arrays);
 typedef void (APIENTRYP _PFNGLBINDVERTEXARRAYPROC) (GLuint array);
 
+/* Program binary */
+typedef void (APIENTRYP _PFNGLGETPROGRAMBINARYPROC) (GLuint program, GLsizei bufSize, GLsizei *length, GLenum *binaryFormat, void *binary);
+typedef void (APIENTRYP _PFNGLPROGRAMBINARYPROC) (GLuint program, GLenum binaryFormat, const void *binary, GLsizei length);
+typedef void (APIENTRYP _PFNGLPROGRAMPARAMETERIPROC) (GLuint program, GLenum pname, GLint value);
+
+/* Sync objects */
+typedef struct __GLsync *_GLsync;
+typedef _GLsync (APIENTRYP _PFNGLFENCESYNCPROC) (GLenum condition, GLbitfield flags);
+typedef GLenum (APIENTRYP _PFNGLCLIENTWAITSYNCPROC) (_GLsync sync, GLbitfield flags, uint64_t timeout);
+typedef void (APIENTRYP _PFNGLDELETESYNCPROC) (_GLsync sync);
+
+/* Texture barrier */
+typedef void (APIENTRYP _PFNGLTEXTUREBARRIERPROC) (void);
+
 /* GLES only */
 typedef void (APIENTRYP _PFNGLRELEASESHADERCOMPILERPROC) (void);
 
@@ -123,11 +140,25 @@ typedef void (APIENTRYP _PFNGLRELEASESHADERCOMPILERPROC) (void);
 #define GL_UNPACK_SKIP_ROWS 0x0CF3
 #endif
 
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+
+#ifndef GL_SYNC_GPU_COMMANDS_COMPLETE
+#define GL_SYNC_GPU_COMMANDS_COMPLETE 0x9117
+#define GL_SYNC_FLUSH_COMMANDS_BIT 0x00000001
+#define GL_TIMEOUT_EXPIRED 0x911B
+#define GL_WAIT_FAILED 0x911D
+#endif
+
 #define GL_20_FUN \
 	/* Etc */ \
 	GL_FUN(GetError, _PFNGLGETERRORPROC) \
 	GL_FUN(ClearColor, _PFNGLCLEARCOLORPROC) \
 	GL_FUN(Clear, _PFNGLCLEARPROC) \
+	GL_FUN(Flush, _PFNGLFLUSHPROC) \
 	GL_FUN(GetString, _PFNGLGETSTRINGPROC) \
 	GL_FUN(GetIntegerv, _PFNGLGETINTEGERVPROC) \
 	GL_FUN(PixelStorei, _PFNGLPIXELSTOREIPROC) \
@@ -202,6 +233,22 @@ typedef void (APIENTRYP _PFNGLRELEASESHADERCOMPILERPROC) (void);
 	GL_FUN(DeleteVertexArrays, _PFNGLDELETEVERTEXARRAYSPROC) \
 	GL_FUN(BindVertexArray, _PFNGLBINDVERTEXARRAYPROC)
 
+#define GL_PROGRAM_BINARY_FUN \
+	GL_FUN(GetProgramBinary, _PFNGLGETPROGRAMBINARYPROC) \
+	GL_FUN(ProgramBinary, _PFNGLPROGRAMBINARYPROC)
+
+/* Not part of the OES extension */
+#define GL_PROGRAM_PARAMETER_FUN \
+	GL_FUN(ProgramParameteri, _PFNGLPROGRAMPARAMETERIPROC)
+
+#define GL_SYNC_FUN \
+	GL_FUN(FenceSync, _PFNGLFENCESYNCPROC) \
+	GL_FUN(ClientWaitSync, _PFNGLCLIENTWAITSYNCPROC) \
+	GL_FUN(DeleteSync, _PFNGLDELETESYNCPROC)
+
+#define GL_TEXTURE_BARRIER_FUN \
+	GL_FUN(TextureBarrier, _PFNGLTEXTUREBARRIERPROC)
+
 #define GL_DEBUG_KHR_FUN \
 	GL_FUN(DebugMessageCallback, _PFNGLDEBUGMESSAGECALLBACKPROC)
 
@@ -218,12 +265,17 @@ struct GLFunctions
 	GL_FBO_FUN
 	GL_FBO_BLIT_FUN
 	GL_VAO_FUN
+	GL_PROGRAM_BINARY_FUN
+	GL_PROGRAM_PARAMETER_FUN
+	GL_SYNC_FUN
+	GL_TEXTURE_BARRIER_FUN
 	GL_DEBUG_KHR_FUN
 	GL_GREMEMDY_FUN
 
 	bool glsles;
 	bool unpack_subimage;
 	bool npot_repeat;
+	bool program_binary;
 
 #undef GL_FUN
 };
@@ -27,9 +27,18 @@
 #include "config.h"
 #include "etc.h"
 
+GLCounters glCounters;
+
+namespace TEX
+{
+	ID boundIDs[ShadowedUnits];
+	unsigned activeUnit;
+}
+
 namespace FBO
 {
 	ID boundFramebufferID;
+	ID boundReadFramebufferID;
 }
 
 namespace GLMeta
@@ -74,6 +83,26 @@ void subRectImageEnd()
 
 #define HAVE_NATIVE_VAO gl.GenVertexArrays
 
+/* Native VAOs are left bound after drawing, so drawing
+ * the same one again doesn't need any GL calls */
+static GLuint boundVAO = 0;
+
+static void bindNativeVAO(GLuint vao)
+{
+	if (vao == boundVAO)
+	{
+		++glCounters.skippedCalls;
+		return;
+	}
+
+	boundVAO = vao;
+	++glCounters.vertexArrayBinds;
+	gl.BindVertexArray(vao);
+
+	/* Part of the VAO's state */
+	IBO::invalidate();
+}
+
 static void vaoBindRes(VAO &vao)
 {
 	VBO::bind(vao.vbo);
@@ -93,10 +122,8 @@ void vaoInit(VAO &vao, bool keepBound)
 	if (HAVE_NATIVE_VAO)
 	{
 		gl.GenVertexArrays(1, &vao.nativeVAO);
-		gl.BindVertexArray(vao.nativeVAO);
+		bindNativeVAO(vao.nativeVAO);
 		vaoBindRes(vao);
-		if (!keepBound)
-			gl.BindVertexArray(0);
 	}
 	else
 	{
@@ -110,32 +137,40 @@ void vaoInit(VAO &vao, bool keepBound)
 
 void vaoFini(VAO &vao)
 {
-	if (HAVE_NATIVE_VAO)
-		gl.DeleteVertexArrays(1, &vao.nativeVAO);
+	if (!HAVE_NATIVE_VAO)
+		return;
+
+	/* GL falls back to the default VAO */
+	if (boundVAO == vao.nativeVAO)
+	{
+		boundVAO = 0;
+		IBO::invalidate();
+	}
+
+	gl.DeleteVertexArrays(1, &vao.nativeVAO);
 }
 
 void vaoBind(VAO &vao)
 {
 	if (HAVE_NATIVE_VAO)
-		gl.BindVertexArray(vao.nativeVAO);
+		bindNativeVAO(vao.nativeVAO);
 	else
 		vaoBindRes(vao);
 }
 
 void vaoUnbind(VAO &vao)
 {
+	/* Native VAOs stay bound until another one is needed.
+	 * Nothing but vaoInit() changes their state, except for
+	 * rebinding the global IBO that all of them share */
 	if (HAVE_NATIVE_VAO)
-	{
-		gl.BindVertexArray(0);
-	}
-	else
-	{
-		for (size_t i = 0; i < vao.attrCount; ++i)
-			gl.DisableVertexAttribArray(vao.attr[i].index);
+		return;
 
-		VBO::unbind();
-		IBO::unbind();
-	}
+	for (size_t i = 0; i < vao.attrCount; ++i)
+		gl.DisableVertexAttribArray(vao.attr[i].index);
+
+	VBO::unbind();
+	IBO::unbind();
 }
 
 #define HAVE_NATIVE_BLIT gl.BlitFramebuffer
@@ -144,8 +179,16 @@ static void _blitBegin(FBO::ID fbo, const Vec2i &size)
 {
 	if (HAVE_NATIVE_BLIT)
 	{
-		FBO::boundFramebufferID = fbo;
-		gl.BindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo.gl);
+		if (FBO::boundFramebufferID == fbo)
+		{
+			++glCounters.skippedCalls;
+		}
+		else
+		{
+			FBO::boundFramebufferID = fbo;
+			++glCounters.framebufferBinds;
+			gl.BindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo.gl);
+		}
 	}
 	else
 	{
@@ -240,7 +283,16 @@ void blitSource(TEXFBO &source)
 
 	if (HAVE_NATIVE_BLIT)
 	{
-		gl.BindFramebuffer(GL_READ_FRAMEBUFFER, source.fbo.gl);
+		if (FBO::boundReadFramebufferID == source.fbo)
+		{
+			++glCounters.skippedCalls;
+		}
+		else
+		{
+			FBO::boundReadFramebufferID = source.fbo;
+			++glCounters.framebufferBinds;
+			gl.BindFramebuffer(GL_READ_FRAMEBUFFER, source.fbo.gl);
+		}
 	}
 	else
 	{
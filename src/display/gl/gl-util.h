@@ -25,6 +25,32 @@
 #include "gl-fun.h"
 #include "etc-internal.h"
 
+#include <stdint.h>
+
+/* Number of GL calls made since the last reset, which Graphics
+ * does once per frame. 'skippedCalls' counts the binds and
+ * uniform uploads that were dropped because they wouldn't have
+ * changed anything */
+struct GLCounters
+{
+	uint32_t drawCalls;
+	uint32_t textureBinds;
+	uint32_t framebufferBinds;
+	uint32_t bufferBinds;
+	uint32_t vertexArrayBinds;
+	uint32_t programBinds;
+	uint32_t uniformUploads;
+	uint32_t skippedCalls;
+
+	uint32_t binds() const
+	{
+		return textureBinds + framebufferBinds + bufferBinds
+		     + vertexArrayBinds + programBinds;
+	}
+};
+
+extern GLCounters glCounters;
+
 /* Struct wrapping GLuint for some light type safety */
 #define DEF_GL_ID \
 struct ID \
@@ -53,6 +79,15 @@ namespace TEX
 {
 	DEF_GL_ID
 
+	/* Texture units whose bindings are shadowed */
+	enum { ShadowedUnits = 8 };
+
+	/* What GL has bound right now, so that redundant
+	 * calls can be skipped. All binds and deletions
+	 * have to go through here to keep this in sync */
+	extern ID boundIDs[ShadowedUnits];
+	extern unsigned activeUnit;
+
 	inline ID gen()
 	{
 		ID id;
@@ -63,11 +98,36 @@ namespace TEX
 
 	static inline void del(ID id)
 	{
+		/* GL unbinds deleted textures from every unit */
+		for (size_t i = 0; i < ShadowedUnits; ++i)
+			if (boundIDs[i] == id)
+				boundIDs[i] = ID(0);
+
 		gl.DeleteTextures(1, &id.gl);
 	}
 
+	static inline void setActiveUnit(unsigned unit)
+	{
+		if (unit == activeUnit)
+		{
+			++glCounters.skippedCalls;
+			return;
+		}
+
+		activeUnit = unit;
+		gl.ActiveTexture(GL_TEXTURE0 + unit);
+	}
+
 	static inline void bind(ID id)
 	{
+		if (boundIDs[activeUnit] == id)
+		{
+			++glCounters.skippedCalls;
+			return;
+		}
+
+		boundIDs[activeUnit] = id;
+		++glCounters.textureBinds;
 		gl.BindTexture(GL_TEXTURE_2D, id.gl);
 	}
 
@@ -109,7 +169,10 @@ namespace FBO
 {
 	DEF_GL_ID
 
+	/* The draw and read bindings, which only differ
+	 * in between GLMeta::blitBegin() and blitEnd() */
 	extern ID boundFramebufferID;
+	extern ID boundReadFramebufferID;
 
 	inline ID gen()
 	{
@@ -121,12 +184,26 @@ namespace FBO
 
 	static inline void del(ID id)
 	{
+		if (boundFramebufferID == id)
+			boundFramebufferID = ID(0);
+
+		if (boundReadFramebufferID == id)
+			boundReadFramebufferID = ID(0);
+
 		gl.DeleteFramebuffers(1, &id.gl);
 	}
 
 	static inline void bind(ID id)
 	{
+		if (boundFramebufferID == id && boundReadFramebufferID == id)
+		{
+			++glCounters.skippedCalls;
+			return;
+		}
+
 		boundFramebufferID = id;
+		boundReadFramebufferID = id;
+		++glCounters.framebufferBinds;
 		gl.BindFramebuffer(GL_FRAMEBUFFER, id.gl);
 	}
 
@@ -151,6 +228,20 @@ struct GenericBO
 {
 	DEF_GL_ID
 
+	/* Binding shadowed per target; ~0 means unknown */
+	static GLuint &boundID()
+	{
+		static GLuint id = 0;
+		return id;
+	}
+
+	/* For when GL changed the binding behind our back,
+	 * eg. the element array buffer on VAO switches */
+	static inline void invalidate()
+	{
+		boundID() = ~0u;
+	}
+
 	static inline ID gen()
 	{
 		ID id;
@@ -161,11 +252,22 @@ struct GenericBO
 
 	static inline void del(ID id)
 	{
+		if (boundID() == id.gl)
+			boundID() = 0;
+
 		gl.DeleteBuffers(1, &id.gl);
 	}
 
 	static inline void bind(ID id)
 	{
+		if (boundID() == id.gl)
+		{
+			++glCounters.skippedCalls;
+			return;
+		}
+
+		boundID() = id.gl;
+		++glCounters.bufferBinds;
 		gl.BindBuffer(target, id.gl);
 	}
 
@@ -198,6 +300,13 @@ typedef struct GenericBO<GL_ELEMENT_ARRAY_BUFFER> IBO;
 
 #undef DEF_GL_ID
 
+/* Every indexed draw goes through here to be counted */
+static inline void drawElements(GLsizei count, GLenum type, const GLvoid *indices)
+{
+	++glCounters.drawCalls;
+	gl.DrawElements(GL_TRIANGLES, count, type, indices);
+}
+
 /* Convenience struct wrapping a framebuffer
  * and a 2D texture as its target */
 struct TEXFBO
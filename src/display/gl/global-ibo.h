@@ -66,9 +66,10 @@ struct GlobalIBO
 				buffer.push_back(i * 4 + indTemp[j]);
 		}
 
+		/* Left bound, as unbinding would detach it from
+		 * whichever VAO is still bound */
 		IBO::bind(ibo);
 		IBO::uploadData(buffer.size() * sizeof(index_t), dataPtr(buffer));
-		IBO::unbind();
 	}
 };
 
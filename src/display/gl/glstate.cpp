@@ -77,6 +77,12 @@ void GLBlendMode::apply(const BlendType &value) {
     gl.BlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ZERO, GL_ONE);
     break;
 
+  case BlendPremultiplied:
+    gl.BlendEquation(GL_FUNC_ADD);
+    gl.BlendFuncSeparate(GL_ONE, GL_ONE_MINUS_SRC_ALPHA, GL_ONE,
+                         GL_ONE_MINUS_SRC_ALPHA);
+    break;
+
   case BlendNormal:
     gl.BlendEquation(GL_FUNC_ADD);
     gl.BlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE,
@@ -101,7 +107,10 @@ void GLViewport::apply(const IntRect &value) {
   gl.Viewport(value.x, value.y, value.w, value.h);
 }
 
-void GLProgram::apply(const unsigned int &value) { gl.UseProgram(value); }
+void GLProgram::apply(const unsigned int &value) {
+  ++glCounters.programBinds;
+  gl.UseProgram(value);
+}
 
 GLState::Caps::Caps() { gl.GetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTexSize); }
 
@@ -0,0 +1,226 @@
+/*
+** programcache.cpp
+**
+** This file is part of mkxp.
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "programcache.h"
+
+#include "debugwriter.h"
+
+#include <string.h>
+
+#define PROGRAM_CACHE_MAGIC "MKXPPRG1"
+
+/* Sanity limit for a single binary */
+#define PROGRAM_MAX_BINARY_SIZE (16 * 1024 * 1024)
+
+ProgramCache *ProgramCache::instance = 0;
+
+static std::string driverIdentity()
+{
+	std::string id;
+	const GLenum names[] = { GL_VENDOR, GL_RENDERER, GL_VERSION };
+
+	for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); ++i)
+	{
+		const char *str = (const char*) gl.GetString(names[i]);
+
+		if (str)
+			id += str;
+
+		id += '\n';
+	}
+
+	return id;
+}
+
+static bool readExact(FILE *f, void *dst, size_t size)
+{
+	return fread(dst, 1, size, f) == size;
+}
+
+ProgramCache::ProgramCache(const std::string &path)
+    : out(0)
+{
+	instance = this;
+
+	if (path.empty() || !gl.program_binary)
+		return;
+
+	this->path = path;
+	id = driverIdentity();
+
+	bool stale = true;
+
+	FILE *f = fopen(path.c_str(), "rb");
+
+	if (f)
+	{
+		char magic[8];
+		uint32_t idLen;
+
+		if (readExact(f, magic, sizeof(magic)) &&
+		    !memcmp(magic, PROGRAM_CACHE_MAGIC, sizeof(magic)) &&
+		    readExact(f, &idLen, sizeof(idLen)) &&
+		    idLen == id.size())
+		{
+			std::string fileId(idLen, '\0');
+
+			if (readExact(f, &fileId[0], idLen) && fileId == id)
+				stale = false;
+		}
+
+		while (!stale)
+		{
+			uint64_t key;
+			uint32_t format, len;
+
+			if (!readExact(f, &key, sizeof(key)) ||
+			    !readExact(f, &format, sizeof(format)) ||
+			    !readExact(f, &len, sizeof(len)))
+				break;
+
+			Entry entry;
+			entry.format = format;
+
+			if (len == 0 || len > PROGRAM_MAX_BINARY_SIZE)
+			{
+				stale = true;
+				break;
+			}
+
+			entry.binary.resize(len);
+
+			if (!readExact(f, &entry.binary[0], len))
+			{
+				stale = true;
+				break;
+			}
+
+			entries.insert(key, entry);
+		}
+
+		fclose(f);
+	}
+
+	if (!stale)
+	{
+		out = fopen(path.c_str(), "ab");
+		return;
+	}
+
+	/* Different driver or damaged file, start over */
+	entries.clear();
+	rewrite();
+}
+
+ProgramCache::~ProgramCache()
+{
+	if (out)
+		fclose(out);
+
+	if (instance == this)
+		instance = 0;
+}
+
+bool ProgramCache::load(GLuint program, uint64_t key)
+{
+	if (!entries.contains(key))
+		return false;
+
+	const Entry &entry = entries[key];
+
+	gl.ProgramBinary(program, entry.format, entry.binary.data(), entry.binary.size());
+
+	GLint success;
+	gl.GetProgramiv(program, GL_LINK_STATUS, &success);
+
+	if (success)
+		return true;
+
+	/* The driver may reject binaries at any time (eg. after an
+	 * update that didn't change its version string), in which
+	 * case the other entries won't load either. Start over */
+	entries.clear();
+	rewrite();
+
+	return false;
+}
+
+void ProgramCache::store(GLuint program, uint64_t key)
+{
+	if (!out)
+		return;
+
+	GLint len = 0;
+	gl.GetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &len);
+
+	if (len <= 0 || len > PROGRAM_MAX_BINARY_SIZE)
+		return;
+
+	Entry entry;
+	entry.binary.resize(len);
+
+	GLsizei written = 0;
+	gl.GetProgramBinary(program, len, &written, &entry.format, &entry.binary[0]);
+
+	if (written <= 0)
+		return;
+
+	entry.binary.resize(written);
+
+	append(key, entry);
+	entries.insert(key, entry);
+}
+
+void ProgramCache::rewrite()
+{
+	if (out)
+		fclose(out);
+
+	out = fopen(path.c_str(), "wb");
+
+	if (!out)
+	{
+		Debug() << "Unable to write shader cache" << path;
+		return;
+	}
+
+	uint32_t idLen = id.size();
+
+	fwrite(PROGRAM_CACHE_MAGIC, 1, strlen(PROGRAM_CACHE_MAGIC), out);
+	fwrite(&idLen, sizeof(idLen), 1, out);
+	fwrite(id.data(), 1, idLen, out);
+
+	for (BoostHash<uint64_t, Entry>::const_iterator iter = entries.cbegin();
+	     iter != entries.cend(); ++iter)
+		append(iter->first, iter->second);
+
+	fflush(out);
+}
+
+void ProgramCache::append(uint64_t key, const Entry &entry)
+{
+	uint32_t format = entry.format;
+	uint32_t len = entry.binary.size();
+
+	fwrite(&key, sizeof(key), 1, out);
+	fwrite(&format, sizeof(format), 1, out);
+	fwrite(&len, sizeof(len), 1, out);
+	fwrite(entry.binary.data(), 1, len, out);
+	fflush(out);
+}
@@ -0,0 +1,71 @@
+/*
+** programcache.h
+**
+** This file is part of mkxp.
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PROGRAMCACHE_H
+#define PROGRAMCACHE_H
+
+#include "gl-fun.h"
+#include "boost-hash.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+
+/* On-disk cache of linked shader program binaries.
+ *
+ * The whole file is tied to the GL driver that produced it
+ * (vendor, renderer and version strings) and thrown away as
+ * soon as any of those change. Entries are keyed by a hash
+ * over the complete vertex and fragment shader sources.
+ *
+ * While one exists, Shader::init() goes through it. */
+class ProgramCache
+{
+public:
+	/* An empty path, or a driver without binary
+	 * support, makes for an inert cache */
+	ProgramCache(const std::string &path);
+	~ProgramCache();
+
+	static ProgramCache *current() { return instance; }
+
+	/* Attempts to restore a linked program, returns false
+	 * if there is no usable binary for "key" */
+	bool load(GLuint program, uint64_t key);
+	void store(GLuint program, uint64_t key);
+
+private:
+	struct Entry
+	{
+		GLenum format;
+		std::string binary;
+	};
+
+	void rewrite();
+	void append(uint64_t key, const Entry &entry);
+
+	std::string path;
+	std::string id;
+	BoostHash<uint64_t, Entry> entries;
+	FILE *out;
+
+	static ProgramCache *instance;
+};
+
+#endif // PROGRAMCACHE_H
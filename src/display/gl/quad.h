@@ -137,7 +137,7 @@ struct Quad
 		}
 
 		GLMeta::vaoBind(vao);
-		gl.DrawElements(GL_TRIANGLES, 6, _GL_INDEX_TYPE, 0);
+		drawElements(6, _GL_INDEX_TYPE, 0);
 		GLMeta::vaoUnbind(vao);
 	}
 };
@@ -105,7 +105,7 @@ struct QuadArray
 		GLMeta::vaoBind(vao);
 
 		const char *_offset = (const char*) 0 + offset * 6 * sizeof(index_t);
-		gl.DrawElements(GL_TRIANGLES, count * 6, _GL_INDEX_TYPE, _offset);
+		drawElements(count * 6, _GL_INDEX_TYPE, _offset);
 
 		GLMeta::vaoUnbind(vao);
 	}
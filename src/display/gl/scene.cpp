@@ -47,11 +47,13 @@ void Scene::insert(SceneElement &element)
 		if (element < *e)
 		{
 			elements.insertBefore(element.link, *iter);
+			invalidateCache();
 			return;
 		}
 	}
 
 	elements.append(element.link);
+	invalidateCache();
 }
 
 void Scene::insertAfter(SceneElement &element, SceneElement &after)
@@ -65,11 +67,13 @@ void Scene::insertAfter(SceneElement &element, SceneElement &after)
 		if (element < *e)
 		{
 			elements.insertBefore(element.link, *iter);
+			invalidateCache();
 			return;
 		}
 	}
 
 	elements.append(element.link);
+	invalidateCache();
 }
 
 void Scene::reinsert(SceneElement &element)
@@ -89,15 +93,29 @@ void Scene::notifyGeometryChange()
 }
 
 void Scene::composite()
+{
+	compositeElements(elements.begin(), elements.end());
+}
+
+void Scene::compositeElements(IntruListLink<SceneElement> *first,
+                              IntruListLink<SceneElement> *last)
 {
 	IntruListLink<SceneElement> *iter;
+	IntRect bounds;
 
-	for (iter = elements.begin(); iter != elements.end(); iter = iter->next)
+	for (iter = first; iter != last; iter = iter->next)
 	{
 		SceneElement *e = iter->data;
 
-		if (e->visible)
-			e->draw();
+		if (!e->visible)
+			continue;
+
+		/* Skip whatever would end up entirely
+		 * outside the screen / viewport */
+		if (e->getBounds(bounds) && !bounds.intersects(geometry.rect))
+			continue;
+
+		e->draw();
 	}
 }
 
@@ -158,7 +176,11 @@ void SceneElement::setVisible(bool value)
 {
 	aboutToAccess();
 
+	if (visible == value)
+		return;
+
 	visible = value;
+	notifyChanged();
 }
 
 bool SceneElement::operator<(const SceneElement &o) const
@@ -197,6 +219,9 @@ void SceneElement::setSpriteY(int value)
 
 void SceneElement::unlink()
 {
-	if (scene)
-		scene->elements.remove(link);
+	if (!scene)
+		return;
+
+	scene->elements.remove(link);
+	scene->invalidateCache();
 }
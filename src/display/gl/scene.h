@@ -61,6 +61,10 @@ public:
 
 	const Geometry &getGeometry() const { return geometry; }
 
+	/* Called whenever anything about the elements of this
+	 * scene changed that would make them draw differently */
+	virtual void invalidateCache() {}
+
 protected:
 	void insert(SceneElement &element);
 	void insertAfter(SceneElement &element, SceneElement &after);
@@ -69,6 +73,10 @@ protected:
 	/* Notify all elements that geometry has changed */
 	void notifyGeometryChange();
 
+	/* Draws the visible elements in [first, last) */
+	void compositeElements(IntruListLink<SceneElement> *first,
+	                       IntruListLink<SceneElement> *last);
+
 	IntruList<SceneElement> elements;
 	Geometry geometry;
 
@@ -91,6 +99,21 @@ public:
 
 	virtual void aboutToAccess() const = 0;
 
+	/* Tells the parent scene that this element would now
+	 * draw differently, so any output it cached is stale */
+	void notifyChanged()
+	{
+		if (scene)
+			scene->invalidateCache();
+	}
+
+	/* Whether draw() currently depends on nothing but the
+	 * element's own state (and the scene geometry), ie. its
+	 * output can be kept around until notifyChanged() is called.
+	 * It must also blend normally so it can be composited
+	 * premultiplied */
+	virtual bool isCacheable() const { return false; }
+
 protected:
 	/* A bit about OpenGL state:
 	 *
@@ -107,14 +130,21 @@ protected:
 	 * cleanup (and therefore you should expect dirty state).
 	 * Do NOT touch the FBO::Draw binding. If you have to do work
 	 * immediately before drawing that touches this (such as flushing
-	 * Bitmaps), use the 'prepareDraw' signal in SharedState that
-	 * will fire immediately before each frame draw.
+	 * Bitmaps), derive from Preparable and schedule yourself on
+	 * the PrepareQueue in SharedState, which is drained
+	 * immediately before each frame draw.
 	 */
 	virtual void draw() = 0;
 
 	// FIXME: This should be a signal
 	virtual void onGeometryChange(const Scene::Geometry &) {}
 
+	/* Conservative bounds of everything draw() would touch, in
+	 * the same space as the parent scene's geometry rect.
+	 * Elements entirely outside that rect aren't drawn.
+	 * Return false if they can't be determined cheaply */
+	virtual bool getBounds(IntRect & /* bounds */) { return false; }
+
 	/* Compares two elements in terms of their display priority;
 	 * elements with lower priority are drawn earlier */
 	bool operator<(const SceneElement &o) const;
@@ -152,4 +182,16 @@ private:
 #define ABOUT_TO_ACCESS_DISP \
 	void aboutToAccess() const { guardDisposed(); }
 
+/* DEF_ATTR_SIMPLE for elements, telling the scene on change */
+#define DEF_ATTR_SIMPLE_NOTIFY(klass, name, type, location) \
+	DEF_ATTR_RD_SIMPLE(klass, name, type, location) \
+	void klass :: set##name(type value) \
+{ \
+	guardDisposed(); \
+	if (location == value) \
+		return; \
+	location = value; \
+	notifyChanged(); \
+}
+
 #endif // SCENE_H
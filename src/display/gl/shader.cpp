@@ -24,6 +24,8 @@
 #include "graphics.h"
 #include "sharedstate.h"
 #include "glstate.h"
+#include "programcache.h"
+#include "fnv1a.h"
 #include "exception.h"
 
 #include <assert.h>
@@ -128,12 +130,15 @@ Shader::~Shader()
 
 void Shader::bind()
 {
+	if (glState.program.get() == program)
+		++glCounters.skippedCalls;
+
 	glState.program.set(program);
 }
 
 void Shader::unbind()
 {
-	gl.ActiveTexture(GL_TEXTURE0);
+	TEX::setActiveUnit(0);
 	glState.program.set(0);
 }
 
@@ -143,15 +148,16 @@ std::string &Shader::commonHeader() {
 }
 #endif
 
-static void setupShaderSource(GLuint shader, GLenum type,
-                              const unsigned char *body, int bodySize)
+/* Fills in the pieces making up the full source of
+ * a shader, returns their count (at most 4) */
+static GLsizei shaderSourcePieces(GLenum type,
+                                  const unsigned char *body, int bodySize,
+                                  const GLchar *shaderSrc[], GLint shaderSrcSize[])
 {
 	static const char glesDefine[] = "#define GLSLES\n";
 	static const char fragDefine[] = "#define FRAGMENT_SHADER\n";
 
-	const GLchar *shaderSrc[4];
-	GLint shaderSrcSize[4];
-	size_t i = 0;
+	GLsizei i = 0;
 
 	if (gl.glsles)
 	{
@@ -180,7 +186,33 @@ static void setupShaderSource(GLuint shader, GLenum type,
 	shaderSrcSize[i] = bodySize;
 	++i;
 
-	gl.ShaderSource(shader, i, shaderSrc, shaderSrcSize);
+	return i;
+}
+
+static void setupShaderSource(GLuint shader, GLenum type,
+                              const unsigned char *body, int bodySize)
+{
+	const GLchar *shaderSrc[4];
+	GLint shaderSrcSize[4];
+
+	GLsizei count = shaderSourcePieces(type, body, bodySize, shaderSrc, shaderSrcSize);
+
+	gl.ShaderSource(shader, count, shaderSrc, shaderSrcSize);
+}
+
+static uint64_t hashShaderSource(uint64_t seed, GLenum type,
+                                 const unsigned char *body, int bodySize)
+{
+	const GLchar *shaderSrc[4];
+	GLint shaderSrcSize[4];
+
+	GLsizei count = shaderSourcePieces(type, body, bodySize, shaderSrc, shaderSrcSize);
+
+	for (GLsizei i = 0; i < count; ++i)
+		seed = fnv1a(seed, shaderSrc[i], shaderSrcSize[i]);
+
+	/* Separates the vertex from the fragment source */
+	return fnv1a(seed, &type, sizeof(type));
 }
 
 void Shader::init(const unsigned char *vert, int vertSize,
@@ -190,6 +222,19 @@ void Shader::init(const unsigned char *vert, int vertSize,
 {
 	GLint success;
 
+	ProgramCache *cache = ProgramCache::current();
+	uint64_t cacheKey = 0;
+
+	if (cache)
+	{
+		cacheKey = hashShaderSource(fnv1aSeed, GL_VERTEX_SHADER, vert, vertSize);
+		cacheKey = hashShaderSource(cacheKey, GL_FRAGMENT_SHADER, frag, fragSize);
+
+		/* Attribute bindings are part of the binary */
+		if (cache->load(program, cacheKey))
+			return;
+	}
+
 	/* Compile vertex shader */
 	setupShaderSource(vertShader, GL_VERTEX_SHADER, vert, vertSize);
 	gl.CompileShader(vertShader);
@@ -226,6 +271,9 @@ void Shader::init(const unsigned char *vert, int vertSize,
 	gl.BindAttribLocation(program, TexCoord, "texCoord");
 	gl.BindAttribLocation(program, Color, "color");
 
+	if (cache && gl.ProgramParameteri)
+		gl.ProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+
 	gl.LinkProgram(program);
 
 	gl.GetProgramiv(program, GL_LINK_STATUS, &success);
@@ -237,6 +285,9 @@ void Shader::init(const unsigned char *vert, int vertSize,
 	                    "GLSL: An error occured while linking program '%s' (vertex '%s', fragment '%s')",
 	                    programName, vertName, fragName);
 	}
+
+	if (cache)
+		cache->store(program, cacheKey);
 }
 
 void Shader::initFromFile(const char *_vertFile, const char *_fragFile,
@@ -251,24 +302,86 @@ void Shader::initFromFile(const char *_vertFile, const char *_fragFile,
 	     _vertFile, _fragFile, programName);
 }
 
+bool Shader::uniformChanged(GLint location, const void *data, size_t size)
+{
+	/* Not used by the program, GL would ignore it anyway */
+	if (location < 0)
+	{
+		++glCounters.skippedCalls;
+		return false;
+	}
+
+	if (location >= MaxShadowedUniforms || size > sizeof(UniformValue::data))
+	{
+		++glCounters.uniformUploads;
+		return true;
+	}
+
+	if ((size_t) location >= uniformValues.size())
+		uniformValues.resize(location + 1);
+
+	UniformValue &value = uniformValues[location];
+
+	if (value.size == size && memcmp(value.data, data, size) == 0)
+	{
+		++glCounters.skippedCalls;
+		return false;
+	}
+
+	memcpy(value.data, data, size);
+	value.size = size;
+
+	++glCounters.uniformUploads;
+
+	return true;
+}
+
+void Shader::setFloatUniform(GLint location, float value)
+{
+	if (uniformChanged(location, &value, sizeof(value)))
+		gl.Uniform1f(location, value);
+}
+
+void Shader::setIntUniform(GLint location, int value)
+{
+	if (uniformChanged(location, &value, sizeof(value)))
+		gl.Uniform1i(location, value);
+}
+
+void Shader::setIntArrayUniform(GLint location, const int *values, int count)
+{
+	if (uniformChanged(location, values, sizeof(int) * count))
+		gl.Uniform1iv(location, count, values);
+}
+
 void Shader::setVec2Uniform(GLint location, const Vec2 &vec)
 {
-    gl.Uniform2f(location, vec.x, vec.y);
+	const GLfloat value[] = { vec.x, vec.y };
+
+	if (uniformChanged(location, value, sizeof(value)))
+		gl.Uniform2f(location, vec.x, vec.y);
 }
 
 void Shader::setVec4Uniform(GLint location, const Vec4 &vec)
 {
-	gl.Uniform4f(location, vec.x, vec.y, vec.z, vec.w);
+	const GLfloat value[] = { vec.x, vec.y, vec.z, vec.w };
+
+	if (uniformChanged(location, value, sizeof(value)))
+		gl.Uniform4f(location, vec.x, vec.y, vec.z, vec.w);
 }
 
-void Shader::setTexUniform(GLint location, unsigned unitIndex, TEX::ID texture)
+void Shader::setMat4Uniform(GLint location, const float value[16])
 {
-	GLenum texUnit = GL_TEXTURE0 + unitIndex;
+	if (uniformChanged(location, value, sizeof(float) * 16))
+		gl.UniformMatrix4fv(location, 1, GL_FALSE, value);
+}
 
-	gl.ActiveTexture(texUnit);
-	gl.BindTexture(GL_TEXTURE_2D, texture.gl);
-	gl.Uniform1i(location, unitIndex);
-	gl.ActiveTexture(GL_TEXTURE0);
+void Shader::setTexUniform(GLint location, unsigned unitIndex, TEX::ID texture)
+{
+	TEX::setActiveUnit(unitIndex);
+	TEX::bind(texture);
+	setIntUniform(location, unitIndex);
+	TEX::setActiveUnit(0);
 }
 
 void ShaderBase::GLProjMat::apply(const Vec2i &value)
@@ -286,6 +399,7 @@ void ShaderBase::GLProjMat::apply(const Vec2i &value)
 		-1, -1, -1,  1
 	};
 
+	++glCounters.uniformUploads;
 	gl.UniformMatrix4fv(u_mat, 1, GL_FALSE, mat);
 }
 
@@ -293,6 +407,7 @@ void ShaderBase::init()
 {
 	GET_U(texSizeInv);
 	GET_U(translation);
+	GET_U(texOffset);
 
 	projMat.u_mat = gl.GetUniformLocation(program, "projMat");
 }
@@ -316,12 +431,17 @@ bool ShaderBase::framebufferScalingAllowed()
 
 void ShaderBase::setTexSize(const Vec2i &value)
 {
-	gl.Uniform2f(u_texSizeInv, 1.f / value.x, 1.f / value.y);
+	setVec2Uniform(u_texSizeInv, Vec2(1.f / value.x, 1.f / value.y));
 }
 
 void ShaderBase::setTranslation(const Vec2i &value)
 {
-	gl.Uniform2f(u_translation, value.x, value.y);
+	setVec2Uniform(u_translation, Vec2(value.x, value.y));
+}
+
+void ShaderBase::setTexOffset(const Vec2i &value)
+{
+	setVec2Uniform(u_texOffset, Vec2(value.x, value.y));
 }
 
 
@@ -351,7 +471,7 @@ SimpleShader::SimpleShader()
 
 void SimpleShader::setTexOffsetX(int value)
 {
-	gl.Uniform1f(u_texOffsetX, value);
+	setFloatUniform(u_texOffsetX, value);
 }
 
 
@@ -382,7 +502,7 @@ SimpleSpriteShader::SimpleSpriteShader()
 
 void SimpleSpriteShader::setSpriteMat(const float value[16])
 {
-	gl.UniformMatrix4fv(u_spriteMat, 1, GL_FALSE, value);
+	setMat4Uniform(u_spriteMat, value);
 }
 
 
@@ -398,12 +518,12 @@ AlphaSpriteShader::AlphaSpriteShader()
 
 void AlphaSpriteShader::setSpriteMat(const float value[16])
 {
-	gl.UniformMatrix4fv(u_spriteMat, 1, GL_FALSE, value);
+	setMat4Uniform(u_spriteMat, value);
 }
 
 void AlphaSpriteShader::setAlpha(float value)
 {
-	gl.Uniform1f(u_alpha, value);
+	setFloatUniform(u_alpha, value);
 }
 
 
@@ -437,12 +557,12 @@ void TransShader::setTransMap(TEX::ID tex)
 
 void TransShader::setProg(float value)
 {
-	gl.Uniform1f(u_prog, value);
+	setFloatUniform(u_prog, value);
 }
 
 void TransShader::setVague(float value)
 {
-	gl.Uniform1f(u_vague, value);
+	setFloatUniform(u_vague, value);
 }
 
 
@@ -469,7 +589,7 @@ void SimpleTransShader::setFrozenScene(TEX::ID tex)
 
 void SimpleTransShader::setProg(float value)
 {
-	gl.Uniform1f(u_prog, value);
+	setFloatUniform(u_prog, value);
 }
 
 
@@ -498,7 +618,7 @@ SpriteShader::SpriteShader()
 
 void SpriteShader::setSpriteMat(const float value[16])
 {
-	gl.UniformMatrix4fv(u_spriteMat, 1, GL_FALSE, value);
+	setMat4Uniform(u_spriteMat, value);
 }
 
 void SpriteShader::setTone(const Vec4 &tone)
@@ -513,43 +633,43 @@ void SpriteShader::setColor(const Vec4 &color)
 
 void SpriteShader::setOpacity(float value)
 {
-	gl.Uniform1f(u_opacity, value);
+	setFloatUniform(u_opacity, value);
 }
 
 void SpriteShader::setBushDepth(float value)
 {
-	gl.Uniform1f(u_bushDepth, value);
+	setFloatUniform(u_bushDepth, value);
 }
 
 void SpriteShader::setBushOpacity(float value)
 {
-	gl.Uniform1f(u_bushOpacity, value);
+	setFloatUniform(u_bushOpacity, value);
 }
 
 void SpriteShader::setPattern(const TEX::ID pattern, const Vec2 &dimensions)
 {
     setTexUniform(u_pattern, 1, pattern);
-    gl.Uniform2f(u_patternSizeInv, 1.f / dimensions.x, 1.f / dimensions.y);
+    setVec2Uniform(u_patternSizeInv, Vec2(1.f / dimensions.x, 1.f / dimensions.y));
 }
 
 void SpriteShader::setPatternBlendType(int blendType)
 {
-    gl.Uniform1i(u_patternBlendType, blendType);
+    setIntUniform(u_patternBlendType, blendType);
 }
 
 void SpriteShader::setPatternTile(bool value)
 {
-    gl.Uniform1i(u_patternTile, value);
+    setIntUniform(u_patternTile, value);
 }
 
 void SpriteShader::setShouldRenderPattern(bool value)
 {
-    gl.Uniform1i(u_renderPattern, value);
+    setIntUniform(u_renderPattern, value);
 }
 
 void SpriteShader::setPatternOpacity(float value)
 {
-    gl.Uniform1f(u_patternOpacity, value);
+    setFloatUniform(u_patternOpacity, value);
 }
 
 void SpriteShader::setPatternScroll(const Vec2 &scroll)
@@ -564,7 +684,7 @@ void SpriteShader::setPatternZoom(const Vec2 &zoom)
 
 void SpriteShader::setInvert(bool value)
 {
-    gl.Uniform1i(u_invert, value);
+    setIntUniform(u_invert, value);
 }
 
 
@@ -597,7 +717,7 @@ void PlaneShader::setFlash(const Vec4 &flash)
 
 void PlaneShader::setOpacity(float value)
 {
-	gl.Uniform1f(u_opacity, value);
+	setFloatUniform(u_opacity, value);
 }
 
 
@@ -619,7 +739,7 @@ bool GrayShader::framebufferScalingAllowed()
 
 void GrayShader::setGray(float value)
 {
-	gl.Uniform1f(u_gray, value);
+	setFloatUniform(u_gray, value);
 }
 
 
@@ -649,17 +769,17 @@ void TilemapShader::setColor(const Vec4 &color)
 
 void TilemapShader::setOpacity(float value)
 {
-	gl.Uniform1f(u_opacity, value);
+	setFloatUniform(u_opacity, value);
 }
 
 void TilemapShader::setAniIndex(int value)
 {
-	gl.Uniform1i(u_aniIndex, value);
+	setIntUniform(u_aniIndex, value);
 }
 
 void TilemapShader::setATFrames(int values[7])
 {
-	gl.Uniform1iv(u_atFrames, 7, values);
+	setIntArrayUniform(u_atFrames, values, 7);
 }
 
 
@@ -675,7 +795,7 @@ FlashMapShader::FlashMapShader()
 
 void FlashMapShader::setAlpha(float value)
 {
-	gl.Uniform1f(u_alpha, value);
+	setFloatUniform(u_alpha, value);
 }
 
 
@@ -690,7 +810,7 @@ HueShader::HueShader()
 
 void HueShader::setHueAdjust(float value)
 {
-	gl.Uniform1f(u_hueAdjust, value);
+	setFloatUniform(u_hueAdjust, value);
 }
 
 
@@ -705,7 +825,7 @@ SimpleMatrixShader::SimpleMatrixShader()
 
 void SimpleMatrixShader::setMatrix(const float value[16])
 {
-	gl.UniformMatrix4fv(u_matrix, 1, GL_FALSE, value);
+	setMat4Uniform(u_matrix, value);
 }
 
 
@@ -735,7 +855,7 @@ TilemapVXShader::TilemapVXShader()
 
 void TilemapVXShader::setAniOffset(const Vec2 &value)
 {
-	gl.Uniform2f(u_aniOffset, value.x, value.y);
+	setVec2Uniform(u_aniOffset, Vec2(value.x, value.y));
 }
 
 
@@ -753,7 +873,7 @@ BltShader::BltShader()
 
 void BltShader::setSource()
 {
-	gl.Uniform1i(u_source, 0);
+	setIntUniform(u_source, 0);
 }
 
 void BltShader::setDestination(const TEX::ID value)
@@ -763,12 +883,12 @@ void BltShader::setDestination(const TEX::ID value)
 
 void BltShader::setSubRect(const FloatRect &value)
 {
-	gl.Uniform4f(u_subRect, value.x, value.y, value.w, value.h);
+	setVec4Uniform(u_subRect, Vec4(value.x, value.y, value.w, value.h));
 }
 
 void BltShader::setOpacity(float value)
 {
-	gl.Uniform1f(u_opacity, value);
+	setFloatUniform(u_opacity, value);
 }
 
 #ifdef ENABLE_LANVZOS3
@@ -783,7 +903,7 @@ BicubicShader::BicubicShader()
 	GET_U(bc);
 
 	// TODO: Maybe expose this as a setting?
-	gl.Uniform2f(u_bc, 0.0, 0.5);
+	setVec2Uniform(u_bc, Vec2(0.0, 0.5));
 }
 
 Lanczos3Shader::Lanczos3Shader()
@@ -799,7 +919,7 @@ Lanczos3Shader::Lanczos3Shader()
 void Lanczos3Shader::setTexSize(const Vec2i &value)
 {
 	ShaderBase::setTexSize(value);
-	gl.Uniform2f(u_sourceSize, (float)value.x, (float)value.y);
+	setVec2Uniform(u_sourceSize, Vec2((float)value.x, (float)value.y));
 }
 
 #endif
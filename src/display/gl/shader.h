@@ -26,6 +26,8 @@
 #include "gl-util.h"
 #include "glstate.h"
 
+#include <vector>
+
 class Shader
 {
 public:
@@ -52,14 +54,35 @@ protected:
 	void initFromFile(const char *vertFile, const char *fragFile,
 	                  const char *programName);
 
-	static void setVec4Uniform(GLint location, const Vec4 &vec);
-    static void setVec2Uniform(GLint location, const Vec2 &vec);
-	static void setTexUniform(GLint location, unsigned unitIndex, TEX::ID texture);
+	/* These skip the GL call if the uniform
+	 * already holds the same value */
+	void setFloatUniform(GLint location, float value);
+	void setIntUniform(GLint location, int value);
+	void setIntArrayUniform(GLint location, const int *values, int count);
+	void setVec4Uniform(GLint location, const Vec4 &vec);
+	void setVec2Uniform(GLint location, const Vec2 &vec);
+	void setMat4Uniform(GLint location, const float value[16]);
+	void setTexUniform(GLint location, unsigned unitIndex, TEX::ID texture);
 
 	GLuint vertShader, fragShader;
 	GLuint program;
     
 private:
+	bool uniformChanged(GLint location, const void *data, size_t size);
+
+	/* Last uploaded value per uniform location (which
+	 * drivers hand out starting at 0). Larger ones, or
+	 * larger values, are always uploaded */
+	enum { MaxShadowedUniforms = 64 };
+
+	struct UniformValue
+	{
+		unsigned char data[sizeof(float) * 16];
+		size_t size;
+	};
+
+	std::vector<UniformValue> uniformValues;
+
 #ifdef MKXPZ_BUILD_XCODE
     static std::string shaderCommon;
 #endif
@@ -88,12 +111,13 @@ public:
 
 	void setTexSize(const Vec2i &value);
 	void setTranslation(const Vec2i &value);
+	void setTexOffset(const Vec2i &value);
 
 protected:
 	void init();
 	virtual bool framebufferScalingAllowed();
 
-	GLint u_texSizeInv, u_translation;
+	GLint u_texSizeInv, u_translation, u_texOffset;
 };
 
 class FlatColorShader : public ShaderBase
@@ -353,6 +377,42 @@ protected:
 
 #endif
 
+/* Holds a shader that is only compiled (or loaded from
+ * the program cache) the first time it is asked for.
+ * Converts to a reference to the shader itself */
+template<class S>
+class LazyShader
+{
+public:
+	LazyShader()
+	    : shader(0)
+	{}
+
+	~LazyShader()
+	{
+		delete shader;
+	}
+
+	S &get()
+	{
+		if (!shader)
+			shader = new S();
+
+		return *shader;
+	}
+
+	operator S&()
+	{
+		return get();
+	}
+
+private:
+	LazyShader(const LazyShader&);
+	LazyShader &operator=(const LazyShader&);
+
+	S *shader;
+};
+
 /* Global object containing all available shaders */
 struct ShaderSet
 {
@@ -365,18 +425,21 @@ struct ShaderSet
 	SpriteShader sprite;
 	PlaneShader plane;
 	GrayShader gray;
-	TilemapShader tilemap;
-	FlashMapShader flashMap;
 	TransShader trans;
 	SimpleTransShader simpleTrans;
-	HueShader hue;
 	BltShader blt;
-	SimpleMatrixShader simpleMatrix;
-	BlurShader blur;
-	TilemapVXShader tilemapVX;
+
+	/* Only needed by some games, or only by specific
+	 * Bitmap operations / scaling modes */
+	LazyShader<TilemapShader> tilemap;
+	LazyShader<FlashMapShader> flashMap;
+	LazyShader<TilemapVXShader> tilemapVX;
+	LazyShader<HueShader> hue;
+	LazyShader<SimpleMatrixShader> simpleMatrix;
+	LazyShader<BlurShader> blur;
 #ifdef ENABLE_LANVZOS3
-	BicubicShader bicubic;
-	Lanczos3Shader lanczos3;
+	LazyShader<BicubicShader> bicubic;
+	LazyShader<Lanczos3Shader> lanczos3;
 #endif
 };
 
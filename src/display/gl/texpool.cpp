@@ -28,118 +28,222 @@
 
 #include <list>
 #include <utility>
+#include <algorithm>
 #include <assert.h>
 #include <string.h>
 
 typedef std::pair<uint16_t, uint16_t> Size;
 
-static uint32_t byteCount(Size &s)
+/* Textures are bucketed by their dimensions rounded up
+ * to a multiple of this, so that e.g. a 200x198 request
+ * can be served by a released 192x192 texture */
+#define SIZE_CLASS_STEP 64
+
+static uint64_t byteCount(const TEXFBO &obj)
+{
+	return (uint64_t) obj.width * obj.height * 4;
+}
+
+/* Shared by all pools, as the textures it covers live
+ * as long as the ones they're made for (eg. Graphics) */
+static uint64_t externalBytes = 0;
+
+static Size sizeClass(int width, int height)
 {
-	return s.first * s.second * 4;
+	return Size((width + SIZE_CLASS_STEP - 1) / SIZE_CLASS_STEP,
+	            (height + SIZE_CLASS_STEP - 1) / SIZE_CLASS_STEP);
 }
 
+struct CacheNode;
+
+/* Sorted by release time, most recent first */
+typedef std::list<CacheNode> PrioList;
+
+/* All cached TexFBOs of one size class */
+typedef std::list<PrioList::iterator> Bucket;
+
 struct CacheNode
 {
 	TEXFBO obj;
-	std::list<TEXFBO>::iterator prioIter;
+	Bucket::iterator bucketIter;
+};
 
-	bool operator==(const CacheNode &o) const
+struct TexPoolPrivate
+{
+	BoostHash<Size, Bucket> poolHash;
+
+	PrioList priorityQueue;
+
+	TexPool::Stats stats;
+
+	/* Has this pool been disabled? */
+	bool disabled;
+
+	TexPoolPrivate(uint64_t maxMemSize, uint64_t vramBudget)
+	    : disabled(false)
 	{
-		return obj == o.obj;
+		memset(&stats, 0, sizeof(stats));
+		stats.cacheBudget = maxMemSize;
+		stats.vramBudget = vramBudget;
 	}
-};
 
-typedef std::list<CacheNode> CNodeList;
+	/* How much memory the cache may currently occupy. With a VRAM
+	 * budget, live textures take precedence over cached ones */
+	uint64_t cacheLimit() const
+	{
+		if (stats.vramBudget == 0)
+			return stats.cacheBudget;
 
-struct TexPoolPrivate
-{
-	/* Contains all cached TexFBOs, grouped by size */
-	BoostHash<Size, CNodeList> poolHash;
+		uint64_t used = stats.liveBytes + externalBytes;
 
-	/* Contains all cached TexFBOs, sorted by release time */
-	std::list<TEXFBO> priorityQueue;
+		if (used >= stats.vramBudget)
+			return 0;
 
-	/* Maximal allowed cache memory */
-	const uint32_t maxMemSize;
+		return std::min(stats.cacheBudget, stats.vramBudget - used);
+	}
 
-	/* Current amound of memory consumed by the cache */
-	uint32_t memSize;
+	void addLive(const TEXFBO &obj)
+	{
+		stats.liveBytes += byteCount(obj);
+		++stats.liveCount;
 
-	/* Current amount of TexFBOs cached */
-	uint16_t objCount;
+		stats.peakLiveBytes = std::max(stats.peakLiveBytes, stats.liveBytes);
+	}
 
-	/* Has this pool been disabled? */
-	bool disabled;
+	void removeLive(const TEXFBO &obj)
+	{
+		stats.liveBytes -= std::min(stats.liveBytes, byteCount(obj));
+
+		if (stats.liveCount > 0)
+			--stats.liveCount;
+	}
+
+	/* Takes the node out of both the priority queue and its bucket */
+	TEXFBO unlink(PrioList::iterator node)
+	{
+		TEXFBO obj = node->obj;
+		Size cls = sizeClass(obj.width, obj.height);
+
+		Bucket &bucket = poolHash[cls];
+		bucket.erase(node->bucketIter);
 
-	TexPoolPrivate(uint32_t maxMemSize)
-	    : maxMemSize(maxMemSize),
-	      memSize(0),
-	      objCount(0),
-	      disabled(false)
-	{}
+		if (bucket.empty())
+			poolHash.remove(cls);
+
+		priorityQueue.erase(node);
+
+		stats.cachedBytes -= byteCount(obj);
+		--stats.cachedCount;
+
+		return obj;
+	}
+
+	/* Delete least recently released objects until
+	 * "extra" more bytes fit into the cache */
+	void trim(uint64_t extra)
+	{
+		while (!priorityQueue.empty() && stats.cachedBytes + extra > cacheLimit())
+		{
+			TEXFBO obj = unlink(std::prev(priorityQueue.end()));
+			TEXFBO::fini(obj);
+
+			++stats.evictions;
+
+//			Debug() << "TexPool: <!-> (" << obj.width << obj.height << ")";
+		}
+	}
 };
 
-TexPool::TexPool(uint32_t maxMemSize)
+TexPool::TexPool(uint64_t maxMemSize, uint64_t vramBudget)
 {
-	p = new TexPoolPrivate(maxMemSize);
+	p = new TexPoolPrivate(maxMemSize, vramBudget);
 }
 
 TexPool::~TexPool()
 {
-	std::list<TEXFBO>::iterator iter;
+	PrioList::iterator iter;
 
 	for (iter = p->priorityQueue.begin();
 	     iter != p->priorityQueue.end();
 	     ++iter)
 	{
-		TEXFBO obj = *iter;
-		TEXFBO::fini(obj);
-		--p->objCount;
+		TEXFBO::fini(iter->obj);
 	}
 
-	assert(p->objCount == 0);
-
 	delete p;
 }
 
 TEXFBO TexPool::request(int width, int height)
 {
-	CacheNode cnode;
-	Size size(width, height);
+	int maxSize = glState.caps.maxTexSize;
+	if (width > maxSize || height > maxSize)
+		throw Exception(Exception::MKXPError,
+		                "Texture dimensions [%d, %d] exceed hardware capabilities",
+		                width, height);
 
-	/* See if we can statisfy request from cache */
-	CNodeList &bucket = p->poolHash[size];
+	Size cls = sizeClass(width, height);
 
-	if (!bucket.empty())
+	/* See if we can statisfy request from cache */
+	if (p->poolHash.contains(cls))
 	{
-		/* Found one! */
-		cnode = bucket.back();
-		bucket.pop_back();
-
-		p->priorityQueue.erase(cnode.prioIter);
-
-		p->memSize -= byteCount(size);
-		--p->objCount;
+		Bucket &bucket = p->poolHash[cls];
+
+		/* Prefer an exact fit, otherwise take the most recently
+		 * released texture of this class and re-specify its storage.
+		 * That still spares us generating and linking a new TEX/FBO */
+		Bucket::iterator pick = bucket.begin();
+
+		for (Bucket::iterator iter = bucket.begin(); iter != bucket.end(); ++iter)
+		{
+			const TEXFBO &cand = (*iter)->obj;
+
+			if (cand.width == width && cand.height == height)
+			{
+				pick = iter;
+				break;
+			}
+		}
+
+		TEXFBO obj = p->unlink(*pick);
+		bool resized = obj.width != width || obj.height != height;
+
+		if (resized)
+		{
+			TEXFBO::allocEmpty(obj, width, height);
+			++p->stats.resizedHits;
+		}
+		else
+		{
+			++p->stats.hits;
+		}
+
+		p->addLive(obj);
+
+		/* The new storage may be larger than what was cached */
+		if (resized)
+			p->trim(0);
 
 //		Debug() << "TexPool: <?+> (" << width << height << ")";
 
-		return cnode.obj;
+		return obj;
 	}
 
-	int maxSize = glState.caps.maxTexSize;
-	if (width > maxSize || height > maxSize)
-		throw Exception(Exception::MKXPError,
-		                "Texture dimensions [%d, %d] exceed hardware capabilities",
-		                width, height);
-
 	/* Nope, create it instead */
-	TEXFBO::init(cnode.obj);
-	TEXFBO::allocEmpty(cnode.obj, width, height);
-	TEXFBO::linkFBO(cnode.obj);
+	TEXFBO obj;
+	TEXFBO::init(obj);
+	TEXFBO::allocEmpty(obj, width, height);
+	TEXFBO::linkFBO(obj);
+
+	++p->stats.misses;
+	p->addLive(obj);
+
+	/* The new texture counts against the VRAM budget,
+	 * make room for it by dropping cached ones */
+	p->trim(0);
 
 //	Debug() << "TexPool: <?-> (" << width << height << ")";
 
-	return cnode.obj;
+	return obj;
 }
 
 void TexPool::release(TEXFBO &obj)
@@ -150,6 +254,8 @@ void TexPool::release(TEXFBO &obj)
 		return;
 	}
 
+	p->removeLive(obj);
+
 	if (p->disabled)
 	{
 		/* If we're disabled, delete without caching */
@@ -158,54 +264,32 @@ void TexPool::release(TEXFBO &obj)
 		return;
 	}
 
-	Size size(obj.width, obj.height);
-
-	uint32_t newMemSize = p->memSize + byteCount(size);
+	uint64_t size = byteCount(obj);
 
 	/* If caching this object would spill over the allowed memory budget,
 	 * delete least used objects until we're good again */
-	while (newMemSize > p->maxMemSize)
-	{
-		if (p->objCount == 0)
-			break;
-
-//		Debug() << "TexPool: <!~> Size:" << p->memSize;
-
-		/* Retrieve object with lowest priority for deletion */
-		CacheNode last;
-		last.obj = p->priorityQueue.back();
-		Size removedSize(last.obj.width, last.obj.height);
-
-		CNodeList &bucket = p->poolHash[removedSize];
-
-		std::list<CacheNode>::iterator toRemove =
-		        std::find(bucket.begin(), bucket.end(), last);
-		assert(toRemove != bucket.end());
-		bucket.erase(toRemove);
-
-		p->priorityQueue.pop_back();
+	p->trim(size);
 
-		TEXFBO::fini(last.obj);
-
-		newMemSize -= byteCount(removedSize);
-		--p->objCount;
-
-//		Debug() << "TexPool: <!-> (" << last.obj.width << last.obj.height << ")";
+	/* Doesn't fit even into an empty cache */
+	if (size > p->cacheLimit())
+	{
+		TEXFBO::fini(obj);
+		++p->stats.evictions;
+		return;
 	}
 
-	p->memSize = newMemSize;
-
 	/* Retain object */
-	p->priorityQueue.push_front(obj);
-	CacheNode cnode;
-	cnode.obj = obj;
-	cnode.prioIter = p->priorityQueue.begin();
-	CNodeList &bucket = p->poolHash[size];
-	bucket.push_back(cnode);
+	p->priorityQueue.push_front(CacheNode());
+	PrioList::iterator node = p->priorityQueue.begin();
+	node->obj = obj;
+
+	Bucket &bucket = p->poolHash[sizeClass(obj.width, obj.height)];
+	node->bucketIter = bucket.insert(bucket.begin(), node);
 
-	++p->objCount;
+	p->stats.cachedBytes += size;
+	++p->stats.cachedCount;
 
-//	Debug() << "TexPool: <!+> (" << obj.width << obj.height << ") Current size:" << p->memSize;
+//	Debug() << "TexPool: <!+> (" << obj.width << obj.height << ") Current size:" << p->stats.cachedBytes;
 }
 
 void TexPool::disable()
@@ -213,4 +297,22 @@ void TexPool::disable()
 	p->disabled = true;
 }
 
+const TexPool::Stats &TexPool::stats() const
+{
+	p->stats.externalBytes = externalBytes;
+
+	return p->stats;
+}
+
+void TexPool::account(uint64_t bytes, int sign)
+{
+	if (sign > 0)
+		externalBytes += bytes;
+	else
+		externalBytes -= std::min(externalBytes, bytes);
+}
 
+void TexPool::account(const TEXFBO &obj, int sign)
+{
+	account(byteCount(obj), sign);
+}
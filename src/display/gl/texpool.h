@@ -29,7 +29,37 @@ struct TexPoolPrivate;
 class TexPool
 {
 public:
-	TexPool(uint32_t maxMemSize = 20000000 /* 20 MB */);
+	struct Stats
+	{
+		/* Textures handed out by the pool and not yet released */
+		uint64_t liveBytes;
+		uint64_t peakLiveBytes;
+		uint32_t liveCount;
+
+		/* Released textures kept around for reuse */
+		uint64_t cachedBytes;
+		uint32_t cachedCount;
+
+		/* Textures allocated outside the pool (screen buffers,
+		 * shared scratch textures), see account() */
+		uint64_t externalBytes;
+
+		/* Requests served by an exact size match / by re-specifying
+		 * a cached texture of the same size class / by a new texture */
+		uint64_t hits;
+		uint64_t resizedHits;
+		uint64_t misses;
+
+		/* Cached textures deleted to stay within budget */
+		uint64_t evictions;
+
+		uint64_t cacheBudget;
+		/* 0 = unlimited */
+		uint64_t vramBudget;
+	};
+
+	TexPool(uint64_t maxMemSize = 20000000 /* 20 MB */,
+	        uint64_t vramBudget = 0);
 	~TexPool();
 
 	TEXFBO request(int width, int height);
@@ -37,6 +67,14 @@ public:
 
 	void disable();
 
+	const Stats &stats() const;
+
+	/* Textures that don't come from the pool still count against
+	 * the VRAM budget. Call with sign = +1 after allocating storage
+	 * for them and with -1 before deleting or re-specifying it */
+	static void account(uint64_t bytes, int sign);
+	static void account(const TEXFBO &obj, int sign);
+
 private:
 	TexPoolPrivate *p;
 };
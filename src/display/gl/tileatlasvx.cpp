@@ -257,17 +257,58 @@ createShadowSet()
 	return surf;
 }
 
-static void doBlit(Bitmap *bm, const IntRect &src, const Vec2i &dst)
+static void doBlit(Bitmap *bm, const IntRect &src, const Vec2i &dst, const IntRect &area)
 {
 	/* Translate tile to pixel units */
 	IntRect _src(src.x*32, src.y*32, src.w*32, src.h*32);
 	Vec2i _dst(dst.x*32, dst.y*32);
 	IntRect bmr(0, 0, bm->width(), bm->height());
+	IntRect piece;
 
-	if (!SDL_IntersectRect(&_src, &bmr, &_src))
+	if (!SDL_IntersectRect(&_src, &bmr, &piece))
 		return;
 
-	GLMeta::blitRectangle(_src, _dst);
+	if (!SDL_IntersectRect(&piece, &area, &piece))
+		return;
+
+	GLMeta::blitRectangle(piece, Vec2i(_dst.x + piece.x - _src.x,
+	                                   _dst.y + piece.y - _src.y));
+}
+
+/* Runs the blits of one bitmap, limited to 'area' of it */
+static void blitPart(Bitmap *bm, int bmIndex, const IntRect &area)
+{
+	const Blit *blits;
+	size_t blitsN;
+
+	switch (bmIndex)
+	{
+#define PART_BLITS(part) \
+	case BM_##part : \
+		blits = blits##part; \
+		blitsN = blits##part##N; \
+		break;
+
+	PART_BLITS(A1)
+	PART_BLITS(A2)
+	PART_BLITS(A3)
+	PART_BLITS(A4)
+	PART_BLITS(A5)
+	PART_BLITS(B)
+	PART_BLITS(C)
+	PART_BLITS(D)
+	PART_BLITS(E)
+
+#undef PART_BLITS
+
+	default :
+		return;
+	}
+
+	GLMeta::blitSource(bm->getGLTypes());
+
+	for (size_t i = 0; i < blitsN; ++i)
+		doBlit(bm, blits[i].src, blits[i].dst, area);
 }
 
 void build(TEXFBO &tf, Bitmap *bitmaps[BM_COUNT])
@@ -311,32 +352,28 @@ void build(TEXFBO &tf, Bitmap *bitmaps[BM_COUNT])
 		SDL_FreeSurface(shadow);
 	}
 
-	Bitmap *bm;
-
-#define EXEC_BLITS(part) \
-	if (!nullOrDisposed(bm = bitmaps[BM_##part])) \
-	{ \
-		GLMeta::blitSource(bm->getGLTypes()); \
-		for (size_t i = 0; i < blits##part##N; ++i) \
-		{\
-			const IntRect &src = blits##part[i].src; \
-			const Vec2i &dst = blits##part[i].dst; \
-			doBlit(bm, src, dst); \
-		} \
+	for (int i = 0; i < BM_COUNT; ++i)
+	{
+		Bitmap *bm = bitmaps[i];
+
+		if (!nullOrDisposed(bm))
+			blitPart(bm, i, bm->rect());
 	}
 
-	EXEC_BLITS(A1);
-	EXEC_BLITS(A2);
-	EXEC_BLITS(A3);
-	EXEC_BLITS(A4);
-	EXEC_BLITS(A5);
-	EXEC_BLITS(B);
-	EXEC_BLITS(C);
-	EXEC_BLITS(D);
-	EXEC_BLITS(E);
+	GLMeta::blitEnd();
+}
+
+void update(TEXFBO &tf, Bitmap *bitmap, int bmIndex, const IntRect &area)
+{
+	assert(tf.width == ATLASVX_W && tf.height == ATLASVX_H);
 
-#undef EXEC_BLITS
+	if (nullOrDisposed(bitmap))
+		return;
 
+	/* The shadow set and other parts stay as they are,
+	 * blits only ever copy without blending */
+	GLMeta::blitBegin(tf, true);
+	blitPart(bitmap, bmIndex, area);
 	GLMeta::blitEnd();
 }
 
@@ -25,6 +25,7 @@
 #include <stdlib.h>
 
 struct FloatRect;
+struct IntRect;
 struct TEXFBO;
 class Bitmap;
 class Table;
@@ -58,6 +59,10 @@ struct Reader
 
 void build(TEXFBO &tf, Bitmap *bitmaps[BM_COUNT]);
 
+/* Re-blits 'area' (in pixels) of the bitmap at index
+ * 'bmIndex' into an atlas previously assembled by build() */
+void update(TEXFBO &tf, Bitmap *bitmap, int bmIndex, const IntRect &area);
+
 void readTiles(Reader &reader, const Table &data,
                const Table *flags, int ox, int oy, int w, int h);
 }
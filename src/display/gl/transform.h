@@ -51,6 +51,7 @@
 
 #include <math.h>
 #include <string.h>
+#include <algorithm>
 
 class Transform
 {
@@ -122,6 +123,41 @@ public:
 		return matrix;
 	}
 
+	/* Axis aligned box enclosing 'rect' after transformation,
+	 * rounded outwards */
+	IntRect mapBounds(const FloatRect &rect)
+	{
+		const float *m = getMatrix();
+
+		const float xs[] = { rect.x, rect.x + rect.w, rect.x, rect.x + rect.w };
+		const float ys[] = { rect.y, rect.y, rect.y + rect.h, rect.y + rect.h };
+
+		float minX = 0, minY = 0, maxX = 0, maxY = 0;
+
+		for (int i = 0; i < 4; ++i)
+		{
+			float tx = m[0] * xs[i] + m[4] * ys[i] + m[12];
+			float ty = m[1] * xs[i] + m[5] * ys[i] + m[13];
+
+			if (i == 0)
+			{
+				minX = maxX = tx;
+				minY = maxY = ty;
+				continue;
+			}
+
+			minX = std::min(minX, tx);
+			minY = std::min(minY, ty);
+			maxX = std::max(maxX, tx);
+			maxY = std::max(maxY, ty);
+		}
+
+		int x = (int) floorf(minX);
+		int y = (int) floorf(minY);
+
+		return IntRect(x, y, (int) ceilf(maxX) - x, (int) ceilf(maxY) - y);
+	}
+
 private:
 	void updateMatrix()
 	{
@@ -36,11 +36,15 @@
 #include "gl-util.h"
 #include "glstate.h"
 #include "intrulist.h"
+#include "preparequeue.h"
+#include "preloader.h"
+#include "renderthread.h"
 #include "quad.h"
 #include "scene.h"
 #include "shader.h"
 #include "sharedstate.h"
 #include "texpool.h"
+#include "bitmapatlas.h"
 #include "theoraplay/theoraplay.h"
 #include "util.h"
 #include "input.h"
@@ -54,16 +58,22 @@
 #include <SDL_thread.h>
 
 #ifdef MKXPZ_STEAM
-#include "steamshim_child.h"
+#include "steamshimasync.h"
 #endif
 
 #include <algorithm>
 #include <errno.h>
+#include <string.h>
 #include <sys/time.h>
 #include <unistd.h>
 #include <time.h>
 #include <cmath>
 #include <climits>
+#include <thread>
+
+#ifdef __linux__
+#include <sys/prctl.h>
+#endif
 
 
 #define DEF_SCREEN_W (rgssVer == 1 ? 640 : 544)
@@ -444,14 +454,17 @@ struct PingPong {
             TEXFBO::init(rt[i]);
             TEXFBO::allocEmpty(rt[i], screenW, screenH);
             TEXFBO::linkFBO(rt[i]);
+            TexPool::account(rt[i], +1);
             gl.ClearColor(0, 0, 0, 1);
             FBO::clear();
         }
     }
     
     ~PingPong() {
-        for (int i = 0; i < 2; ++i)
+        for (int i = 0; i < 2; ++i) {
+            TexPool::account(rt[i], -1);
             TEXFBO::fini(rt[i]);
+        }
     }
     
     TEXFBO &backBuffer() { return rt[srcInd]; }
@@ -463,8 +476,11 @@ struct PingPong {
         screenW = width;
         screenH = height;
         
-        for (int i = 0; i < 2; ++i)
+        for (int i = 0; i < 2; ++i) {
+            TexPool::account(rt[i], -1);
             TEXFBO::allocEmpty(rt[i], width, height);
+            TexPool::account(rt[i], +1);
+        }
     }
     
     void startRender() { bind(); }
@@ -503,7 +519,7 @@ public:
         const int w = geometry.rect.w;
         const int h = geometry.rect.h;
         
-        shState->prepareDraw();
+        shState->prepareQueue().drain();
         
         pp.startRender();
         
@@ -658,6 +674,14 @@ private:
 /* Nanoseconds per second */
 #define NS_PER_S 1000000000
 
+/* Final stretch of a frame wait that is spun rather than
+ * slept through; Windows sleeps at 1ms granularity at best */
+#ifdef _WIN32
+#define SPIN_MS 2
+#else
+#define SPIN_MS 1
+#endif
+
 struct FPSLimiter {
     uint64_t lastTickCount;
     
@@ -675,6 +699,15 @@ struct FPSLimiter {
     
     bool disabled;
     
+    /* Sleep through the entire wait instead of spinning
+     * for the last stretch of it (see delayTicks) */
+    bool powerSaving;
+    
+    /* How long before the deadline sleeping stops */
+    const uint64_t spinTicks;
+    
+    bool timerSlackSet;
+    
     /* Data for frame timing adjustment */
     struct {
         /* Last tick count */
@@ -689,7 +722,8 @@ struct FPSLimiter {
     FPSLimiter(uint16_t desiredFPS)
     : lastTickCount(SDL_GetPerformanceCounter()),
     tickFreq(SDL_GetPerformanceFrequency()), tickFreqMS(tickFreq / 1000),
-    tickFreqNS((double)tickFreq / NS_PER_S), disabled(false) {
+    tickFreqNS((double)tickFreq / NS_PER_S), disabled(false),
+    powerSaving(false), spinTicks(tickFreqMS * SPIN_MS), timerSlackSet(false) {
         setDesiredFPS(desiredFPS);
         
         adj.last = SDL_GetPerformanceCounter();
@@ -744,7 +778,51 @@ struct FPSLimiter {
     
 private:
     void delayTicks(uint64_t ticks) {
-#if defined(HAVE_NANOSLEEP)
+        if (powerSaving) {
+            sleepTicks(ticks);
+            return;
+        }
+        
+#ifdef __linux__
+        /* The default timer slack (50us) adds up to
+         * needless wakeup jitter, we'll be spinning anyway */
+        if (!timerSlackSet) {
+            prctl(PR_SET_TIMERSLACK, 1, 0, 0, 0);
+            timerSlackSet = true;
+        }
+#endif
+        
+        const uint64_t deadline = SDL_GetPerformanceCounter() + ticks;
+        
+        /* Sleep coarsely, then yield until the deadline
+         * for precision no OS sleep reliably gives us */
+        if (ticks > spinTicks)
+            sleepTicks(ticks - spinTicks);
+        
+        while (SDL_GetPerformanceCounter() < deadline)
+            std::this_thread::yield();
+    }
+    
+    void sleepTicks(uint64_t ticks) {
+#if defined(__linux__)
+        /* Absolute deadline, so being interrupted
+         * doesn't make us oversleep */
+        struct timespec req;
+        uint64_t nsec = ticks / tickFreqNS;
+        clock_gettime(CLOCK_MONOTONIC, &req);
+        nsec += req.tv_nsec;
+        req.tv_sec += nsec / NS_PER_S;
+        req.tv_nsec = nsec % NS_PER_S;
+        
+        int err;
+        while ((err = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &req, 0)) == EINTR)
+            ;
+        
+        if (err) {
+            Debug() << "clock_nanosleep failed. errno:" << err;
+            SDL_Delay(ticks / tickFreqMS);
+        }
+#elif defined(HAVE_NANOSLEEP)
         struct timespec req;
         uint64_t nsec = ticks / tickFreqNS;
         req.tv_sec = nsec / NS_PER_S;
@@ -768,6 +846,92 @@ private:
     }
 };
 
+/* Distribution of wall clock times between presented frames (or
+ * any other per-frame delay fed through add()), in fixed size
+ * buckets so it can run for the whole session */
+struct FrameTimeStats {
+    /* 50us wide buckets up to 100ms, the
+     * last one takes everything beyond */
+    static const int BUCKET_US = 50;
+    static const int BUCKET_COUNT = 100000 / BUCKET_US + 1;
+    
+    uint32_t buckets[BUCKET_COUNT];
+    uint64_t count;
+    double totalMS;
+    double minMS;
+    double maxMS;
+    
+    uint64_t lastTick;
+    const double tickFreqMS;
+    
+    FrameTimeStats()
+    : lastTick(0), tickFreqMS(SDL_GetPerformanceFrequency() / 1000.0) {
+        reset();
+    }
+    
+    void reset() {
+        memset(buckets, 0, sizeof(buckets));
+        count = 0;
+        totalMS = 0;
+        minMS = 0;
+        maxMS = 0;
+    }
+    
+    /* Don't count the time until the next frame,
+     * eg. after loading stalls */
+    void skipNext() { lastTick = 0; }
+    
+    void add(double ms) {
+        int i = std::min<int>(ms * 1000 / BUCKET_US, BUCKET_COUNT - 1);
+        
+        ++buckets[i];
+        minMS = count ? std::min(minMS, ms) : ms;
+        ++count;
+        totalMS += ms;
+        maxMS = std::max(maxMS, ms);
+    }
+    
+    /* Adds the time since the previous call */
+    void record() {
+        uint64_t now = SDL_GetPerformanceCounter();
+        
+        if (lastTick != 0)
+            add((now - lastTick) / tickFreqMS);
+        
+        lastTick = now;
+    }
+    
+    /* Middle of the bucket the percentile falls in */
+    double percentile(double pct) const {
+        if (count == 0)
+            return 0;
+        
+        uint64_t target = (uint64_t)ceil(pct / 100 * count);
+        uint64_t seen = 0;
+        
+        for (int i = 0; i < BUCKET_COUNT - 1; ++i) {
+            seen += buckets[i];
+            
+            if (seen >= target && seen > 0)
+                return (i + 0.5) * BUCKET_US / 1000.0;
+        }
+        
+        return maxMS;
+    }
+    
+    /* The report printed at the end of headless runs */
+    void print() const {
+        if (count == 0)
+            return;
+        
+        Debug() << "Frame time stats  :" << count << "frames," << totalMS / 1000 << "s";
+        Debug() << "Frame time (ms)   : avg" << totalMS / count
+                << "min" << minMS << "max" << maxMS;
+        Debug() << "Frame time (ms)   : p50" << percentile(50)
+                << "p95" << percentile(95) << "p99" << percentile(99);
+    }
+};
+
 struct GraphicsPrivate {
     /* Screen resolution, ie. the resolution at which
      * RGSS renders at (settable with Graphics.resize_screen).
@@ -803,6 +967,15 @@ struct GraphicsPrivate {
     
     
     FPSLimiter fpsLimiter;
+    FrameTimeStats frameStats;
+    FrameTimeStats inputLatency;
+    
+    /* GL calls made during the last presented frame */
+    GLCounters lastFrameGL;
+    
+    /* Wait for the next frame after presenting rather than
+     * before, so scripts read input right before drawing */
+    bool lateInputSampling;
     
     // Can be set from Ruby. Takes priority over config setting.
     bool useFrameSkip;
@@ -825,6 +998,9 @@ struct GraphicsPrivate {
     SDL_mutex *glResourceLock;
     bool multithreadedMode;
     
+    /* Presents frames when pipelined rendering is on */
+    std::unique_ptr<RenderThread> renderThread;
+    
     /* Global list of all live Disposables
      * (disposed on reset) */
     IntruList<Disposable> dispList;
@@ -835,7 +1011,8 @@ struct GraphicsPrivate {
     screen(scRes.x, scRes.y), threadData(rtData),
     glCtx(SDL_GL_GetCurrentContext()), multithreadedMode(true),
     frameRate(DEF_FRAMERATE), frameCount(0), brightness(255),
-    fpsLimiter(frameRate), useFrameSkip(rtData->config.frameSkip), frozen(false),
+    fpsLimiter(frameRate), lastFrameGL(),
+    lateInputSampling(rtData->config.lateInputSampling), useFrameSkip(rtData->config.frameSkip), frozen(false),
     last_update(0), last_avg_update(0), backingScaleFactor(1), integerScaleFactor(0, 0),
     integerScaleActive(rtData->config.integerScaling.active),
     integerLastMileScaling(rtData->config.integerScaling.lastMileScaling) {
@@ -854,14 +1031,28 @@ struct GraphicsPrivate {
         TEXFBO::init(frozenScene);
         TEXFBO::allocEmpty(frozenScene, scRes.x, scRes.y);
         TEXFBO::linkFBO(frozenScene);
+        TexPool::account(frozenScene, +1);
         
         FloatRect screenRect(0, 0, scRes.x, scRes.y);
         screenQuad.setTexPosRect(screenRect, screenRect);
         
         fpsLimiter.resetFrameAdjust();
+        
+        if (rtData->presentContext) {
+            if (RenderThread::supported())
+                renderThread.reset(new RenderThread(rtData, rtData->presentContext.release(),
+                                                    rtData->config.maxFramesInFlight));
+            else
+                Debug() << "Pipelined rendering needs framebuffer blits and sync objects, disabling";
+        }
     }
     
     ~GraphicsPrivate() {
+        /* Let queued frames go out before their buffers go away */
+        renderThread.reset();
+        
+        TexPool::account(frozenScene, -1);
+        TexPool::account(integerScaleBuffer, -1);
         TEXFBO::fini(frozenScene);
         TEXFBO::fini(integerScaleBuffer);
         SDL_DestroyMutex(avgFPSLock);
@@ -937,11 +1128,13 @@ struct GraphicsPrivate {
     
     void rebuildIntegerScaleBuffer()
     {
+        TexPool::account(integerScaleBuffer, -1);
         TEXFBO::fini(integerScaleBuffer);
         TEXFBO::init(integerScaleBuffer);
         TEXFBO::allocEmpty(integerScaleBuffer, scRes.x * integerScaleFactor.x,
                            scRes.y * integerScaleFactor.y);
         TEXFBO::linkFBO(integerScaleBuffer);
+        TexPool::account(integerScaleBuffer, +1);
     }
     
     bool integerScaleStepApplicable() const
@@ -992,12 +1185,48 @@ struct GraphicsPrivate {
     }
     
     void swapGLBuffer() {
-        fpsLimiter.delay();
-        SDL_GL_SwapWindow(threadData->window);
+        if (!lateInputSampling)
+            fpsLimiter.delay();
+        
+        presentFrame();
+        
+        /* Uses up some of the time the limiter would wait anyway */
+        shState->preloader().commitUploads(threadData->config.preloadUploadBudget);
+        shState->bitmapAtlas().compact();
+        
+        lastFrameGL = glCounters;
+        glCounters = GLCounters();
         
         ++frameCount;
+        frameStats.record();
+        
+        uint64_t pressTicks = shState->input().takePendingPressTicks();
+        if (pressTicks)
+            inputLatency.add((SDL_GetPerformanceCounter() - pressTicks) / inputLatency.tickFreqMS);
+        
+        if (threadData->config.virtualClock)
+            shState->advanceVirtualClock(1.0 / frameRate);
         
         threadData->ethread->notifyFrame();
+        
+        if (lateInputSampling)
+            fpsLimiter.delay();
+    }
+    
+    /* Everything meant for the window goes through these two, as
+     * with pipelined rendering it's drawn into a buffer instead */
+    void blitBeginScreen(const Vec2i &size) {
+        if (renderThread)
+            GLMeta::blitBegin(renderThread->beginFrame(winSize));
+        else
+            GLMeta::blitBeginScreen(size);
+    }
+    
+    void presentFrame() {
+        if (renderThread)
+            renderThread->submitFrame();
+        else
+            SDL_GL_SwapWindow(threadData->window);
     }
     
     void compositeToBuffer(TEXFBO &buffer) {
@@ -1036,7 +1265,7 @@ struct GraphicsPrivate {
         // maybe unspaghetti this later
         if (integerScaleStepApplicable() && !integerLastMileScaling)
         {
-            GLMeta::blitBeginScreen(winSize);
+            blitBeginScreen(winSize);
             GLMeta::blitSource(screen.getPP().frontBuffer());
             
             FBO::clear();
@@ -1060,7 +1289,7 @@ struct GraphicsPrivate {
             GLMeta::blitEnd();
         }
         
-        GLMeta::blitBeginScreen(winSize);
+        blitBeginScreen(winSize);
         //GLMeta::blitSource(screen.getPP().frontBuffer());
         
         Vec2i sourceSize;
@@ -1141,9 +1370,18 @@ Graphics::Graphics(RGSSThreadData *data) : p(std::make_unique<GraphicsPrivate>(d
     } else if (data->config.fixedFramerate < 0) {
         p->fpsLimiter.disabled = true;
     }
+    
+    p->fpsLimiter.powerSaving = (data->config.framePacing == "power");
+    
+    /* Headless runs are benchmarks, don't hold them back */
+    if (data->config.headless)
+        p->fpsLimiter.disabled = true;
 }
 
-Graphics::~Graphics() = default;
+Graphics::~Graphics() {
+    if (p->threadData->config.headless)
+        p->frameStats.print();
+}
 
 double Graphics::getDelta() {
     return shState->runTime() - p->last_update;
@@ -1173,8 +1411,7 @@ void Graphics::update(bool checkForShutdown) {
     
     
 #ifdef MKXPZ_STEAM
-    if (STEAMSHIM_alive())
-        STEAMSHIM_pump();
+    SteamShimAsync::pump();
 #endif
     
     if (p->frozen)
@@ -1185,6 +1422,8 @@ void Graphics::update(bool checkForShutdown) {
             /* Skip frame */
             p->fpsLimiter.delay();
             ++p->frameCount;
+            if (p->threadData->config.virtualClock)
+                shState->advanceVirtualClock(1.0 / p->frameRate);
             p->threadData->ethread->notifyFrame();
             
             return;
@@ -1300,9 +1539,9 @@ void Graphics::transition(int duration, const char *filename, int vague) {
         
         /* Then blit it flipped and scaled to the screen */
         FBO::unbind();
-        FBO::clear();
         
-        GLMeta::blitBeginScreen(Vec2i(p->winSize));
+        p->blitBeginScreen(Vec2i(p->winSize));
+        FBO::clear();
         GLMeta::blitSource(transBuffer);
         p->metaBlitBufferFlippedScaled();
         GLMeta::blitEnd();
@@ -1317,7 +1556,10 @@ void Graphics::transition(int duration, const char *filename, int vague) {
     p->frozen = false;
 }
 
-void Graphics::frameReset() {p->fpsLimiter.resetFrameAdjust();}
+void Graphics::frameReset() {
+    p->fpsLimiter.resetFrameAdjust();
+    p->frameStats.skipNext();
+}
 
 static void guardDisposed() {}
 
@@ -1342,6 +1584,36 @@ double Graphics::averageFrameRate() {
     return p->averageFPS();
 }
 
+static Graphics::PacingStats histogramStats(const FrameTimeStats &h) {
+    Graphics::PacingStats stats;
+    
+    stats.count = h.count;
+    stats.mean = h.count ? h.totalMS / h.count : 0;
+    stats.p50 = h.percentile(50);
+    stats.p99 = h.percentile(99);
+    stats.max = h.maxMS;
+    
+    return stats;
+}
+
+Graphics::PacingStats Graphics::pacingStats() const {
+    return histogramStats(p->frameStats);
+}
+
+Graphics::PacingStats Graphics::inputLatencyStats() const {
+    return histogramStats(p->inputLatency);
+}
+
+GLCounters Graphics::glStats() const {
+    return p->lastFrameGL;
+}
+
+void Graphics::resetPacingStats() {
+    p->frameStats.reset();
+    p->frameStats.skipNext();
+    p->inputLatency.reset();
+}
+
 void Graphics::wait(int duration) {
     for (int i = 0; i < duration; ++i) {
         p->checkShutDownReset();
@@ -1359,7 +1631,7 @@ void Graphics::fadeout(int duration) {
         setBrightness(diff + (curr / duration) * i);
         
         if (p->frozen) {
-            GLMeta::blitBeginScreen(p->scSize);
+            p->blitBeginScreen(p->scSize);
             GLMeta::blitSource(p->frozenScene);
             
             FBO::clear();
@@ -1384,7 +1656,7 @@ void Graphics::fadein(int duration) {
         setBrightness(curr + (diff / duration) * i);
         
         if (p->frozen) {
-            GLMeta::blitBeginScreen(p->scSize);
+            p->blitBeginScreen(p->scSize);
             GLMeta::blitSource(p->frozenScene);
             
             FBO::clear();
@@ -1470,7 +1742,9 @@ void Graphics::resizeScreen(int width, int height) {
     if (p->integerScaleActive)
         p->rebuildIntegerScaleBuffer();
     
+    TexPool::account(p->frozenScene, -1);
     TEXFBO::allocEmpty(p->frozenScene, width, height);
+    TexPool::account(p->frozenScene, +1);
     
     FloatRect screenRect(0, 0, width, height);
     p->screenQuad.setTexPosRect(screenRect, screenRect);
@@ -1564,6 +1838,8 @@ void Graphics::reset() {
     
     p->dispList.clear();
     
+    shState->preloader().clear();
+    
     /* Reset attributes (frame count not included) */
     p->fpsLimiter.resetFrameAdjust();
     p->frozen = false;
@@ -1692,8 +1968,6 @@ void Graphics::repaintWait(const AtomicFlag &exitCond, bool checkReset) {
     
     /* Repaint the screen with the last good frame we drew */
     TEXFBO &lastFrame = p->screen.getPP().frontBuffer();
-    GLMeta::blitBeginScreen(p->winSize);
-    GLMeta::blitSource(lastFrame);
     
     while (!exitCond) {
         shState->checkShutdown();
@@ -1701,15 +1975,17 @@ void Graphics::repaintWait(const AtomicFlag &exitCond, bool checkReset) {
         if (checkReset)
             shState->checkReset();
         
+        p->blitBeginScreen(p->winSize);
+        GLMeta::blitSource(lastFrame);
         FBO::clear();
         p->metaBlitBufferFlippedScaled();
-        SDL_GL_SwapWindow(p->threadData->window);
+        GLMeta::blitEnd();
+        
+        p->presentFrame();
         p->fpsLimiter.delay();
         
         p->threadData->ethread->notifyFrame();
     }
-    
-    GLMeta::blitEnd();
 }
 
 void Graphics::lock(bool force) {
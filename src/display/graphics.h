@@ -25,6 +25,7 @@
 #include "util.h"
 
 #include <memory>
+#include <stdint.h>
 
 class Scene;
 class Bitmap;
@@ -34,6 +35,7 @@ struct GraphicsPrivate;
 struct AtomicFlag;
 struct THEORAPLAY_VideoFrame;
 struct Movie;
+struct GLCounters;
 
 class Graphics
 {
@@ -88,6 +90,27 @@ public:
     DECL_ATTR( LastMileScaling, bool )
     DECL_ATTR( Threadsafe, bool )
     double averageFrameRate();
+    
+    /* Intervals between presented frames, in milliseconds */
+    struct PacingStats {
+        uint64_t count;
+        double mean;
+        double p50;
+        double p99;
+        double max;
+    };
+    
+    PacingStats pacingStats() const;
+    
+    /* From a button press being received to the first frame
+     * presented after Input.update consumed it */
+    PacingStats inputLatencyStats() const;
+    
+    /* Resets both of the above */
+    void resetPacingStats();
+    
+    /* GL calls made while drawing the last presented frame */
+    GLCounters glStats() const;
 
 	/* <internal> */
 	Scene *getScreen() const;
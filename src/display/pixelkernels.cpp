@@ -0,0 +1,1023 @@
+/*
+** pixelkernels.cpp
+**
+** This file is part of mkxp.
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "pixelkernels.h"
+
+#include <SDL_cpuinfo.h>
+#include <SDL_surface.h>
+
+#include <algorithm>
+#include <atomic>
+#include <string.h>
+#include <vector>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define KERNELS_X86
+#include <immintrin.h>
+#if defined(__GNUC__) || defined(__clang__)
+#define TARGET_SSE2 __attribute__((target("sse2")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_SSE2
+#define TARGET_AVX2
+#endif
+#endif
+
+/* The float division the shadow needs only exists on AArch64 */
+#if defined(__aarch64__) || defined(_M_ARM64)
+#define KERNELS_NEON
+#include <arm_neon.h>
+#endif
+
+using namespace PixelKernels;
+
+/* Block sums are gathered in 32 bit lanes, which can take
+ * this many alpha weighted values before overflowing */
+#define BOX_CHUNK 16384
+
+struct Kernels
+{
+	const char *name;
+
+	void (*blendOver)(uint32_t *dst, const uint32_t *src, size_t count);
+	void (*swizzleRB)(uint32_t *dst, const uint32_t *src, size_t count);
+	void (*shadowCompose)(uint32_t *dst, const uint32_t *src, const uint32_t *shadow,
+	                      uint32_t color, size_t count);
+
+	/* Adds one row of at most BOX_CHUNK pixels to 'sums' */
+	void (*boxRow)(const uint32_t *pixels, int width, BoxSums &sums);
+
+	/* Adds each pixel's alpha weighted colour channels and
+	 * its alpha to the four 'acc' values at its position */
+	void (*weightRow)(const uint32_t *pixels, int width, uint32_t *acc);
+};
+
+/* Exact x / 255 for x up to 255 * 255, rounded to nearest */
+static inline uint32_t div255(uint32_t x)
+{
+	x += 128;
+
+	return (x + (x >> 8)) >> 8;
+}
+
+static inline uint32_t blendPixel(uint32_t d, uint32_t s)
+{
+	uint32_t a = s >> 24;
+	uint32_t out = 0;
+
+	/* Alpha follows the same equation with a source value of 255 */
+	s |= 0xFF000000;
+
+	for (int shift = 0; shift < 32; shift += 8)
+	{
+		uint32_t sc = (s >> shift) & 0xFF;
+		uint32_t dc = (d >> shift) & 0xFF;
+
+		out |= div255(sc * a + dc * (255 - a)) << shift;
+	}
+
+	return out;
+}
+
+static inline uint32_t swizzlePixel(uint32_t p)
+{
+	return (p & 0xFF00FF00) | ((p & 0xFF) << 16) | ((p >> 16) & 0xFF);
+}
+
+static inline float clampUnit(float v)
+{
+	if (v < 0.0f)
+		return 0.0f;
+
+	if (v > 1.0f)
+		return 1.0f;
+
+	return v;
+}
+
+static inline uint32_t shadowPixel(uint32_t src, uint32_t shadow, const float fc[3])
+{
+	uint32_t srcA = src >> 24;
+	uint32_t shdA = shadow >> 24;
+
+	if (srcA == 255 || shdA == 0)
+		return src;
+
+	float fSrcA = srcA / 255.0f;
+	float fShdA = shdA / 255.0f;
+
+	/* Because opacity == 1, co1 == fSrcA */
+	float co2 = fShdA * (1.0f - fSrcA);
+	/* Result alpha */
+	float fa = fSrcA + co2;
+	/* Temp value to simplify arithmetic below */
+	float co3 = fSrcA / fa;
+
+	uint32_t out = (uint32_t) (clampUnit(fa) * 255.0f) << 24;
+
+	for (int i = 0; i < 3; ++i)
+		out |= (uint32_t) (clampUnit(fc[i] * co3) * 255.0f) << (i * 8);
+
+	return out;
+}
+
+static void colorChannels(uint32_t color, float fc[3])
+{
+	for (int i = 0; i < 3; ++i)
+		fc[i] = ((color >> (i * 8)) & 0xFF) / 255.0f;
+}
+
+/* Folds the 32 bit lanes gathered by a SIMD boxRow into 'sums'.
+ * Visible pixels were counted in the alpha lane */
+static void flushBox(const uint32_t weighted[4], const uint32_t visible[4], BoxSums &sums)
+{
+	for (int i = 0; i < 3; ++i)
+	{
+		sums.weighted[i] += weighted[i];
+		sums.visible[i] += visible[i];
+	}
+
+	sums.alpha += weighted[3];
+	sums.visibleCount += visible[3];
+}
+
+/* Scalar */
+
+static void blendOverScalar(uint32_t *dst, const uint32_t *src, size_t count)
+{
+	for (size_t i = 0; i < count; ++i)
+		dst[i] = blendPixel(dst[i], src[i]);
+}
+
+static void swizzleRBScalar(uint32_t *dst, const uint32_t *src, size_t count)
+{
+	for (size_t i = 0; i < count; ++i)
+		dst[i] = swizzlePixel(src[i]);
+}
+
+static void shadowComposeScalar(uint32_t *dst, const uint32_t *src, const uint32_t *shadow,
+                                uint32_t color, size_t count)
+{
+	float fc[3];
+	colorChannels(color, fc);
+
+	for (size_t i = 0; i < count; ++i)
+		dst[i] = shadowPixel(src[i], shadow[i], fc);
+}
+
+static void boxRowScalar(const uint32_t *pixels, int width, BoxSums &sums)
+{
+	for (int x = 0; x < width; ++x)
+	{
+		uint32_t p = pixels[x];
+		uint32_t a = p >> 24;
+
+		for (int i = 0; i < 3; ++i)
+		{
+			uint32_t c = (p >> (i * 8)) & 0xFF;
+
+			sums.weighted[i] += c * a;
+
+			if (a != 0)
+				sums.visible[i] += c;
+		}
+
+		sums.alpha += a;
+
+		if (a != 0)
+			++sums.visibleCount;
+	}
+}
+
+static void weightRowScalar(const uint32_t *pixels, int width, uint32_t *acc)
+{
+	for (int x = 0; x < width; ++x, acc += 4)
+	{
+		uint32_t p = pixels[x];
+		uint32_t a = p >> 24;
+
+		for (int i = 0; i < 3; ++i)
+			acc[i] += ((p >> (i * 8)) & 0xFF) * a;
+
+		acc[3] += a;
+	}
+}
+
+static const Kernels scalarKernels =
+{
+	"scalar",
+	blendOverScalar,
+	swizzleRBScalar,
+	shadowComposeScalar,
+	boxRowScalar,
+	weightRowScalar
+};
+
+#ifdef KERNELS_X86
+
+/* SSE2 */
+
+TARGET_SSE2
+static inline __m128i div255SSE2(__m128i x)
+{
+	x = _mm_add_epi16(x, _mm_set1_epi16(128));
+
+	return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+}
+
+/* Each pixel's alpha in all four of its 16 bit lanes */
+TARGET_SSE2
+static inline __m128i alpha16SSE2(__m128i p16)
+{
+	return _mm_shufflehi_epi16(_mm_shufflelo_epi16(p16, _MM_SHUFFLE(3, 3, 3, 3)),
+	                           _MM_SHUFFLE(3, 3, 3, 3));
+}
+
+TARGET_SSE2
+static void blendOverSSE2(uint32_t *dst, const uint32_t *src, size_t count)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i full = _mm_set1_epi16(255);
+	const __m128i alphaMask = _mm_set1_epi32(0xFF000000);
+
+	size_t i = 0;
+
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128i s = _mm_loadu_si128((const __m128i*) (src + i));
+		__m128i d = _mm_loadu_si128((const __m128i*) (dst + i));
+
+		__m128i aLo = alpha16SSE2(_mm_unpacklo_epi8(s, zero));
+		__m128i aHi = alpha16SSE2(_mm_unpackhi_epi8(s, zero));
+
+		s = _mm_or_si128(s, alphaMask);
+
+		__m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(s, zero), aLo),
+		                           _mm_mullo_epi16(_mm_unpacklo_epi8(d, zero), _mm_sub_epi16(full, aLo)));
+		__m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(s, zero), aHi),
+		                           _mm_mullo_epi16(_mm_unpackhi_epi8(d, zero), _mm_sub_epi16(full, aHi)));
+
+		_mm_storeu_si128((__m128i*) (dst + i), _mm_packus_epi16(div255SSE2(lo), div255SSE2(hi)));
+	}
+
+	blendOverScalar(dst + i, src + i, count - i);
+}
+
+TARGET_SSE2
+static void swizzleRBSSE2(uint32_t *dst, const uint32_t *src, size_t count)
+{
+	const __m128i keep = _mm_set1_epi32(0xFF00FF00);
+	const __m128i low = _mm_set1_epi32(0xFF);
+
+	size_t i = 0;
+
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128i p = _mm_loadu_si128((const __m128i*) (src + i));
+
+		__m128i r = _mm_or_si128(_mm_and_si128(p, keep),
+		                         _mm_or_si128(_mm_slli_epi32(_mm_and_si128(p, low), 16),
+		                                      _mm_and_si128(_mm_srli_epi32(p, 16), low)));
+
+		_mm_storeu_si128((__m128i*) (dst + i), r);
+	}
+
+	swizzleRBScalar(dst + i, src + i, count - i);
+}
+
+TARGET_SSE2
+static void shadowComposeSSE2(uint32_t *dst, const uint32_t *src, const uint32_t *shadow,
+                              uint32_t color, size_t count)
+{
+	float fc[3];
+	colorChannels(color, fc);
+
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 f255 = _mm_set1_ps(255.0f);
+	const __m128i i255 = _mm_set1_epi32(255);
+	const __m128i izero = _mm_setzero_si128();
+
+	size_t i = 0;
+
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128i s = _mm_loadu_si128((const __m128i*) (src + i));
+		__m128i srcA = _mm_srli_epi32(s, 24);
+		__m128i shdA = _mm_srli_epi32(_mm_loadu_si128((const __m128i*) (shadow + i)), 24);
+
+		__m128 fSrcA = _mm_div_ps(_mm_cvtepi32_ps(srcA), f255);
+		__m128 fShdA = _mm_div_ps(_mm_cvtepi32_ps(shdA), f255);
+
+		__m128 co2 = _mm_mul_ps(fShdA, _mm_sub_ps(one, fSrcA));
+		__m128 fa = _mm_add_ps(fSrcA, co2);
+		/* Lanes dividing by zero are copied from 'src' below */
+		__m128 co3 = _mm_div_ps(fSrcA, fa);
+
+		__m128i out = _mm_slli_epi32(_mm_cvttps_epi32(
+			_mm_mul_ps(_mm_min_ps(_mm_max_ps(fa, zero), one), f255)), 24);
+
+		for (int c = 0; c < 3; ++c)
+		{
+			__m128 v = _mm_mul_ps(_mm_set1_ps(fc[c]), co3);
+			v = _mm_mul_ps(_mm_min_ps(_mm_max_ps(v, zero), one), f255);
+
+			/* Shift counts have to be immediates */
+			__m128i ch = _mm_cvttps_epi32(v);
+			if (c == 1)
+				ch = _mm_slli_epi32(ch, 8);
+			else if (c == 2)
+				ch = _mm_slli_epi32(ch, 16);
+
+			out = _mm_or_si128(out, ch);
+		}
+
+		__m128i copy = _mm_or_si128(_mm_cmpeq_epi32(srcA, i255), _mm_cmpeq_epi32(shdA, izero));
+		out = _mm_or_si128(_mm_and_si128(copy, s), _mm_andnot_si128(copy, out));
+
+		_mm_storeu_si128((__m128i*) (dst + i), out);
+	}
+
+	shadowComposeScalar(dst + i, src + i, shadow + i, color, count - i);
+}
+
+/* What each pixel's 16 bit lanes get multiplied with for alpha
+ * weighting: its alpha for the colour channels, 1 for alpha */
+TARGET_SSE2
+static inline __m128i weights16SSE2(__m128i p16)
+{
+	const __m128i colorLanes = _mm_set_epi16(0, -1, -1, -1, 0, -1, -1, -1);
+	const __m128i alphaOne = _mm_set_epi16(1, 0, 0, 0, 1, 0, 0, 0);
+
+	return _mm_or_si128(_mm_and_si128(alpha16SSE2(p16), colorLanes), alphaOne);
+}
+
+/* Widens the 16 bit lanes of two pixels and adds them up */
+TARGET_SSE2
+static inline __m128i addPixels16SSE2(__m128i acc, __m128i p16)
+{
+	const __m128i zero = _mm_setzero_si128();
+
+	acc = _mm_add_epi32(acc, _mm_unpacklo_epi16(p16, zero));
+
+	return _mm_add_epi32(acc, _mm_unpackhi_epi16(p16, zero));
+}
+
+TARGET_SSE2
+static void boxRowSSE2(const uint32_t *pixels, int width, BoxSums &sums)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i colorMask = _mm_set1_epi32(0x00FFFFFF);
+	const __m128i countOne = _mm_set1_epi32(0x01000000);
+
+	__m128i weighted = zero;
+	__m128i visible = zero;
+
+	int x = 0;
+
+	for (; x + 4 <= width; x += 4)
+	{
+		__m128i p = _mm_loadu_si128((const __m128i*) (pixels + x));
+		/* Colour channels of visible pixels, with 1 for alpha to count them */
+		__m128i pv = _mm_andnot_si128(_mm_cmpeq_epi32(_mm_srli_epi32(p, 24), zero),
+		                              _mm_or_si128(_mm_and_si128(p, colorMask), countOne));
+
+		__m128i lo = _mm_unpacklo_epi8(p, zero);
+		__m128i hi = _mm_unpackhi_epi8(p, zero);
+
+		weighted = addPixels16SSE2(weighted, _mm_mullo_epi16(lo, weights16SSE2(lo)));
+		weighted = addPixels16SSE2(weighted, _mm_mullo_epi16(hi, weights16SSE2(hi)));
+
+		/* 8 bit values can be paired up before widening */
+		visible = addPixels16SSE2(visible, _mm_add_epi16(_mm_unpacklo_epi8(pv, zero),
+		                                                  _mm_unpackhi_epi8(pv, zero)));
+	}
+
+	uint32_t w[4], v[4];
+	_mm_storeu_si128((__m128i*) w, weighted);
+	_mm_storeu_si128((__m128i*) v, visible);
+
+	flushBox(w, v, sums);
+
+	boxRowScalar(pixels + x, width - x, sums);
+}
+
+TARGET_SSE2
+static void weightRowSSE2(const uint32_t *pixels, int width, uint32_t *acc)
+{
+	const __m128i zero = _mm_setzero_si128();
+
+	int x = 0;
+
+	for (; x + 4 <= width; x += 4)
+	{
+		__m128i p = _mm_loadu_si128((const __m128i*) (pixels + x));
+
+		__m128i lo = _mm_unpacklo_epi8(p, zero);
+		__m128i hi = _mm_unpackhi_epi8(p, zero);
+
+		lo = _mm_mullo_epi16(lo, weights16SSE2(lo));
+		hi = _mm_mullo_epi16(hi, weights16SSE2(hi));
+
+		__m128i w[4] =
+		{
+			_mm_unpacklo_epi16(lo, zero), _mm_unpackhi_epi16(lo, zero),
+			_mm_unpacklo_epi16(hi, zero), _mm_unpackhi_epi16(hi, zero)
+		};
+
+		for (int i = 0; i < 4; ++i)
+		{
+			__m128i *a = (__m128i*) (acc + (x + i) * 4);
+			_mm_storeu_si128(a, _mm_add_epi32(_mm_loadu_si128(a), w[i]));
+		}
+	}
+
+	weightRowScalar(pixels + x, width - x, acc + x * 4);
+}
+
+static const Kernels sse2Kernels =
+{
+	"sse2",
+	blendOverSSE2,
+	swizzleRBSSE2,
+	shadowComposeSSE2,
+	boxRowSSE2,
+	weightRowSSE2
+};
+
+/* AVX2. Unpacking and packing work within 128 bit halves,
+ * so the SSE2 approach carries over unchanged */
+
+TARGET_AVX2
+static inline __m256i div255AVX2(__m256i x)
+{
+	x = _mm256_add_epi16(x, _mm256_set1_epi16(128));
+
+	return _mm256_srli_epi16(_mm256_add_epi16(x, _mm256_srli_epi16(x, 8)), 8);
+}
+
+TARGET_AVX2
+static inline __m256i alpha16AVX2(__m256i p16)
+{
+	return _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(p16, _MM_SHUFFLE(3, 3, 3, 3)),
+	                              _MM_SHUFFLE(3, 3, 3, 3));
+}
+
+TARGET_AVX2
+static void blendOverAVX2(uint32_t *dst, const uint32_t *src, size_t count)
+{
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i full = _mm256_set1_epi16(255);
+	const __m256i alphaMask = _mm256_set1_epi32(0xFF000000);
+
+	size_t i = 0;
+
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256i s = _mm256_loadu_si256((const __m256i*) (src + i));
+		__m256i d = _mm256_loadu_si256((const __m256i*) (dst + i));
+
+		__m256i aLo = alpha16AVX2(_mm256_unpacklo_epi8(s, zero));
+		__m256i aHi = alpha16AVX2(_mm256_unpackhi_epi8(s, zero));
+
+		s = _mm256_or_si256(s, alphaMask);
+
+		__m256i lo = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(s, zero), aLo),
+		                              _mm256_mullo_epi16(_mm256_unpacklo_epi8(d, zero), _mm256_sub_epi16(full, aLo)));
+		__m256i hi = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(s, zero), aHi),
+		                              _mm256_mullo_epi16(_mm256_unpackhi_epi8(d, zero), _mm256_sub_epi16(full, aHi)));
+
+		_mm256_storeu_si256((__m256i*) (dst + i), _mm256_packus_epi16(div255AVX2(lo), div255AVX2(hi)));
+	}
+
+	blendOverSSE2(dst + i, src + i, count - i);
+}
+
+TARGET_AVX2
+static void swizzleRBAVX2(uint32_t *dst, const uint32_t *src, size_t count)
+{
+	const __m256i order = _mm256_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+	                                       2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+
+	size_t i = 0;
+
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256i p = _mm256_loadu_si256((const __m256i*) (src + i));
+		_mm256_storeu_si256((__m256i*) (dst + i), _mm256_shuffle_epi8(p, order));
+	}
+
+	swizzleRBSSE2(dst + i, src + i, count - i);
+}
+
+TARGET_AVX2
+static void shadowComposeAVX2(uint32_t *dst, const uint32_t *src, const uint32_t *shadow,
+                              uint32_t color, size_t count)
+{
+	float fc[3];
+	colorChannels(color, fc);
+
+	const __m256 one = _mm256_set1_ps(1.0f);
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 f255 = _mm256_set1_ps(255.0f);
+	const __m256i i255 = _mm256_set1_epi32(255);
+	const __m256i izero = _mm256_setzero_si256();
+
+	size_t i = 0;
+
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256i s = _mm256_loadu_si256((const __m256i*) (src + i));
+		__m256i srcA = _mm256_srli_epi32(s, 24);
+		__m256i shdA = _mm256_srli_epi32(_mm256_loadu_si256((const __m256i*) (shadow + i)), 24);
+
+		__m256 fSrcA = _mm256_div_ps(_mm256_cvtepi32_ps(srcA), f255);
+		__m256 fShdA = _mm256_div_ps(_mm256_cvtepi32_ps(shdA), f255);
+
+		__m256 co2 = _mm256_mul_ps(fShdA, _mm256_sub_ps(one, fSrcA));
+		__m256 fa = _mm256_add_ps(fSrcA, co2);
+		__m256 co3 = _mm256_div_ps(fSrcA, fa);
+
+		__m256i out = _mm256_slli_epi32(_mm256_cvttps_epi32(
+			_mm256_mul_ps(_mm256_min_ps(_mm256_max_ps(fa, zero), one), f255)), 24);
+
+		for (int c = 0; c < 3; ++c)
+		{
+			__m256 v = _mm256_mul_ps(_mm256_set1_ps(fc[c]), co3);
+			v = _mm256_mul_ps(_mm256_min_ps(_mm256_max_ps(v, zero), one), f255);
+
+			__m256i ch = _mm256_cvttps_epi32(v);
+			if (c == 1)
+				ch = _mm256_slli_epi32(ch, 8);
+			else if (c == 2)
+				ch = _mm256_slli_epi32(ch, 16);
+
+			out = _mm256_or_si256(out, ch);
+		}
+
+		__m256i copy = _mm256_or_si256(_mm256_cmpeq_epi32(srcA, i255), _mm256_cmpeq_epi32(shdA, izero));
+		out = _mm256_blendv_epi8(out, s, copy);
+
+		_mm256_storeu_si256((__m256i*) (dst + i), out);
+	}
+
+	shadowComposeSSE2(dst + i, src + i, shadow + i, color, count - i);
+}
+
+TARGET_AVX2
+static inline __m256i weights16AVX2(__m256i p16)
+{
+	const __m256i colorLanes = _mm256_set_epi16(0, -1, -1, -1, 0, -1, -1, -1,
+	                                            0, -1, -1, -1, 0, -1, -1, -1);
+	const __m256i alphaOne = _mm256_set_epi16(1, 0, 0, 0, 1, 0, 0, 0,
+	                                          1, 0, 0, 0, 1, 0, 0, 0);
+
+	return _mm256_or_si256(_mm256_and_si256(alpha16AVX2(p16), colorLanes), alphaOne);
+}
+
+TARGET_AVX2
+static inline __m256i addPixels16AVX2(__m256i acc, __m256i p16)
+{
+	const __m256i zero = _mm256_setzero_si256();
+
+	acc = _mm256_add_epi32(acc, _mm256_unpacklo_epi16(p16, zero));
+
+	return _mm256_add_epi32(acc, _mm256_unpackhi_epi16(p16, zero));
+}
+
+/* Both halves of a lane hold the same channels */
+TARGET_AVX2
+static inline __m128i foldAVX2(__m256i v)
+{
+	return _mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+}
+
+TARGET_AVX2
+static void boxRowAVX2(const uint32_t *pixels, int width, BoxSums &sums)
+{
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i colorMask = _mm256_set1_epi32(0x00FFFFFF);
+	const __m256i countOne = _mm256_set1_epi32(0x01000000);
+
+	__m256i weighted = zero;
+	__m256i visible = zero;
+
+	int x = 0;
+
+	for (; x + 8 <= width; x += 8)
+	{
+		__m256i p = _mm256_loadu_si256((const __m256i*) (pixels + x));
+		__m256i pv = _mm256_andnot_si256(_mm256_cmpeq_epi32(_mm256_srli_epi32(p, 24), zero),
+		                                 _mm256_or_si256(_mm256_and_si256(p, colorMask), countOne));
+
+		__m256i lo = _mm256_unpacklo_epi8(p, zero);
+		__m256i hi = _mm256_unpackhi_epi8(p, zero);
+
+		weighted = addPixels16AVX2(weighted, _mm256_mullo_epi16(lo, weights16AVX2(lo)));
+		weighted = addPixels16AVX2(weighted, _mm256_mullo_epi16(hi, weights16AVX2(hi)));
+
+		visible = addPixels16AVX2(visible, _mm256_add_epi16(_mm256_unpacklo_epi8(pv, zero),
+		                                                     _mm256_unpackhi_epi8(pv, zero)));
+	}
+
+	uint32_t w[4], v[4];
+	_mm_storeu_si128((__m128i*) w, foldAVX2(weighted));
+	_mm_storeu_si128((__m128i*) v, foldAVX2(visible));
+
+	flushBox(w, v, sums);
+
+	boxRowSSE2(pixels + x, width - x, sums);
+}
+
+/* Widens from memory instead of unpacking, as the
+ * results have to come out in pixel order */
+TARGET_AVX2
+static void weightRowAVX2(const uint32_t *pixels, int width, uint32_t *acc)
+{
+	int x = 0;
+
+	for (; x + 4 <= width; x += 4)
+	{
+		__m256i p16 = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*) (pixels + x)));
+		__m256i w = _mm256_mullo_epi16(p16, weights16AVX2(p16));
+
+		__m256i *a = (__m256i*) (acc + x * 4);
+		_mm256_storeu_si256(a, _mm256_add_epi32(_mm256_loadu_si256(a),
+		                    _mm256_cvtepu16_epi32(_mm256_castsi256_si128(w))));
+		_mm256_storeu_si256(a + 1, _mm256_add_epi32(_mm256_loadu_si256(a + 1),
+		                    _mm256_cvtepu16_epi32(_mm256_extracti128_si256(w, 1))));
+	}
+
+	weightRowScalar(pixels + x, width - x, acc + x * 4);
+}
+
+static const Kernels avx2Kernels =
+{
+	"avx2",
+	blendOverAVX2,
+	swizzleRBAVX2,
+	shadowComposeAVX2,
+	boxRowAVX2,
+	weightRowAVX2
+};
+
+#endif // KERNELS_X86
+
+#ifdef KERNELS_NEON
+
+/* Each pixel's alpha in all four of its bytes */
+static inline uint8x16_t alpha8NEON(uint8x16_t p)
+{
+	return vreinterpretq_u8_u32(vmulq_n_u32(vshrq_n_u32(vreinterpretq_u32_u8(p), 24), 0x01010101));
+}
+
+/* Exact x / 255, same rounding as div255() */
+static inline uint8x8_t div255NEON(uint16x8_t x)
+{
+	return vraddhn_u16(x, vrshrq_n_u16(x, 8));
+}
+
+static void blendOverNEON(uint32_t *dst, const uint32_t *src, size_t count)
+{
+	const uint8x16_t alphaMask = vreinterpretq_u8_u32(vdupq_n_u32(0xFF000000));
+
+	size_t i = 0;
+
+	for (; i + 4 <= count; i += 4)
+	{
+		uint8x16_t s = vld1q_u8((const uint8_t*) (src + i));
+		uint8x16_t d = vld1q_u8((const uint8_t*) (dst + i));
+
+		uint8x16_t a = alpha8NEON(s);
+		uint8x16_t ia = vmvnq_u8(a);
+
+		s = vorrq_u8(s, alphaMask);
+
+		uint16x8_t lo = vmull_u8(vget_low_u8(s), vget_low_u8(a));
+		lo = vmlal_u8(lo, vget_low_u8(d), vget_low_u8(ia));
+
+		uint16x8_t hi = vmull_u8(vget_high_u8(s), vget_high_u8(a));
+		hi = vmlal_u8(hi, vget_high_u8(d), vget_high_u8(ia));
+
+		vst1q_u8((uint8_t*) (dst + i), vcombine_u8(div255NEON(lo), div255NEON(hi)));
+	}
+
+	blendOverScalar(dst + i, src + i, count - i);
+}
+
+static void swizzleRBNEON(uint32_t *dst, const uint32_t *src, size_t count)
+{
+	const uint32x4_t keep = vdupq_n_u32(0xFF00FF00);
+	const uint32x4_t low = vdupq_n_u32(0xFF);
+
+	size_t i = 0;
+
+	for (; i + 4 <= count; i += 4)
+	{
+		uint32x4_t p = vld1q_u32(src + i);
+
+		uint32x4_t r = vorrq_u32(vandq_u32(p, keep),
+		                         vorrq_u32(vshlq_n_u32(vandq_u32(p, low), 16),
+		                                   vandq_u32(vshrq_n_u32(p, 16), low)));
+
+		vst1q_u32(dst + i, r);
+	}
+
+	swizzleRBScalar(dst + i, src + i, count - i);
+}
+
+static void shadowComposeNEON(uint32_t *dst, const uint32_t *src, const uint32_t *shadow,
+                              uint32_t color, size_t count)
+{
+	float fc[3];
+	colorChannels(color, fc);
+
+	const float32x4_t one = vdupq_n_f32(1.0f);
+	const float32x4_t zero = vdupq_n_f32(0.0f);
+	const float32x4_t f255 = vdupq_n_f32(255.0f);
+
+	size_t i = 0;
+
+	for (; i + 4 <= count; i += 4)
+	{
+		uint32x4_t s = vld1q_u32(src + i);
+		uint32x4_t srcA = vshrq_n_u32(s, 24);
+		uint32x4_t shdA = vshrq_n_u32(vld1q_u32(shadow + i), 24);
+
+		float32x4_t fSrcA = vdivq_f32(vcvtq_f32_u32(srcA), f255);
+		float32x4_t fShdA = vdivq_f32(vcvtq_f32_u32(shdA), f255);
+
+		float32x4_t co2 = vmulq_f32(fShdA, vsubq_f32(one, fSrcA));
+		float32x4_t fa = vaddq_f32(fSrcA, co2);
+		float32x4_t co3 = vdivq_f32(fSrcA, fa);
+
+		uint32x4_t out = vshlq_n_u32(vcvtq_u32_f32(
+			vmulq_f32(vminq_f32(vmaxq_f32(fa, zero), one), f255)), 24);
+
+		for (int c = 0; c < 3; ++c)
+		{
+			float32x4_t v = vmulq_f32(vdupq_n_f32(fc[c]), co3);
+			v = vmulq_f32(vminq_f32(vmaxq_f32(v, zero), one), f255);
+
+			out = vorrq_u32(out, vshlq_u32(vcvtq_u32_f32(v), vdupq_n_s32(c * 8)));
+		}
+
+		uint32x4_t copy = vorrq_u32(vceqq_u32(srcA, vdupq_n_u32(255)), vceqq_u32(shdA, vdupq_n_u32(0)));
+
+		vst1q_u32(dst + i, vbslq_u32(copy, s, out));
+	}
+
+	shadowComposeScalar(dst + i, src + i, shadow + i, color, count - i);
+}
+
+/* Two pixels widened to 16 bits and weighted by their alpha,
+ * which itself gets multiplied with 1 */
+static inline uint16x8_t weighted16NEON(uint8x8_t p, uint8x8_t a)
+{
+	const uint16x8_t alphaLanes = vreinterpretq_u16_u64(vdupq_n_u64(0xFFFF000000000000ULL));
+
+	uint16x8_t weights = vbslq_u16(alphaLanes, vdupq_n_u16(1), vmovl_u8(a));
+
+	return vmulq_u16(vmovl_u8(p), weights);
+}
+
+static void boxRowNEON(const uint32_t *pixels, int width, BoxSums &sums)
+{
+	uint32x4_t weighted = vdupq_n_u32(0);
+	uint32x4_t visible = vdupq_n_u32(0);
+
+	int x = 0;
+
+	for (; x + 4 <= width; x += 4)
+	{
+		uint8x16_t p = vld1q_u8((const uint8_t*) (pixels + x));
+		uint32x4_t p32 = vreinterpretq_u32_u8(p);
+		uint32x4_t hidden = vceqq_u32(vshrq_n_u32(p32, 24), vdupq_n_u32(0));
+		uint8x16_t pv = vreinterpretq_u8_u32(vbicq_u32(vorrq_u32(vandq_u32(p32, vdupq_n_u32(0x00FFFFFF)),
+		                                                         vdupq_n_u32(0x01000000)), hidden));
+		uint8x16_t a = alpha8NEON(p);
+
+		uint16x8_t wLo = weighted16NEON(vget_low_u8(p), vget_low_u8(a));
+		uint16x8_t wHi = weighted16NEON(vget_high_u8(p), vget_high_u8(a));
+		weighted = vaddq_u32(weighted, vaddl_u16(vget_low_u16(wLo), vget_high_u16(wLo)));
+		weighted = vaddq_u32(weighted, vaddl_u16(vget_low_u16(wHi), vget_high_u16(wHi)));
+
+		uint16x8_t v16 = vaddl_u8(vget_low_u8(pv), vget_high_u8(pv));
+		visible = vaddq_u32(visible, vaddl_u16(vget_low_u16(v16), vget_high_u16(v16)));
+	}
+
+	uint32_t w[4], v[4];
+	vst1q_u32(w, weighted);
+	vst1q_u32(v, visible);
+
+	flushBox(w, v, sums);
+
+	boxRowScalar(pixels + x, width - x, sums);
+}
+
+static void weightRowNEON(const uint32_t *pixels, int width, uint32_t *acc)
+{
+	int x = 0;
+
+	for (; x + 4 <= width; x += 4)
+	{
+		uint8x16_t p = vld1q_u8((const uint8_t*) (pixels + x));
+		uint8x16_t a = alpha8NEON(p);
+
+		uint16x8_t wLo = weighted16NEON(vget_low_u8(p), vget_low_u8(a));
+		uint16x8_t wHi = weighted16NEON(vget_high_u8(p), vget_high_u8(a));
+
+		uint32_t *out = acc + x * 4;
+		vst1q_u32(out,      vaddw_u16(vld1q_u32(out),      vget_low_u16(wLo)));
+		vst1q_u32(out + 4,  vaddw_u16(vld1q_u32(out + 4),  vget_high_u16(wLo)));
+		vst1q_u32(out + 8,  vaddw_u16(vld1q_u32(out + 8),  vget_low_u16(wHi)));
+		vst1q_u32(out + 12, vaddw_u16(vld1q_u32(out + 12), vget_high_u16(wHi)));
+	}
+
+	weightRowScalar(pixels + x, width - x, acc + x * 4);
+}
+
+static const Kernels neonKernels =
+{
+	"neon",
+	blendOverNEON,
+	swizzleRBNEON,
+	shadowComposeNEON,
+	boxRowNEON,
+	weightRowNEON
+};
+
+#endif // KERNELS_NEON
+
+static const Kernels *findKernels(const char *name)
+{
+#ifdef KERNELS_X86
+	if (SDL_HasAVX2() && (!name || !strcmp(name, avx2Kernels.name)))
+		return &avx2Kernels;
+
+	if (SDL_HasSSE2() && (!name || !strcmp(name, sse2Kernels.name)))
+		return &sse2Kernels;
+#endif
+
+#ifdef KERNELS_NEON
+	if (SDL_HasNEON() && (!name || !strcmp(name, neonKernels.name)))
+		return &neonKernels;
+#endif
+
+	if (!name || !strcmp(name, scalarKernels.name))
+		return &scalarKernels;
+
+	return 0;
+}
+
+static std::atomic<const Kernels*> &active()
+{
+	static std::atomic<const Kernels*> kernels(findKernels(0));
+
+	return kernels;
+}
+
+static inline const Kernels &k()
+{
+	return *active().load(std::memory_order_relaxed);
+}
+
+const char *PixelKernels::isa()
+{
+	return k().name;
+}
+
+bool PixelKernels::selectIsa(const char *name)
+{
+	const Kernels *kernels = findKernels(name);
+
+	if (!kernels)
+		return false;
+
+	active().store(kernels);
+
+	return true;
+}
+
+void PixelKernels::blendOver(uint32_t *dst, const uint32_t *src, size_t count)
+{
+	k().blendOver(dst, src, count);
+}
+
+void PixelKernels::swizzleRB(uint32_t *dst, const uint32_t *src, size_t count)
+{
+	k().swizzleRB(dst, src, count);
+}
+
+void PixelKernels::shadowCompose(uint32_t *dst, const uint32_t *src, const uint32_t *shadow,
+                                 uint32_t color, size_t count)
+{
+	k().shadowCompose(dst, src, shadow, color, count);
+}
+
+void PixelKernels::boxSums(const uint32_t *pixels, size_t stride,
+                           int width, int height, BoxSums &sums)
+{
+	const Kernels &kernels = k();
+
+	memset(&sums, 0, sizeof(sums));
+
+	for (int y = 0; y < height; ++y)
+		for (int x = 0; x < width; x += BOX_CHUNK)
+			kernels.boxRow(pixels + y * stride + x, std::min(width - x, BOX_CHUNK), sums);
+}
+
+void PixelKernels::boxDownsample(uint32_t *dst, size_t dstStride, int dstWidth, int dstHeight,
+                                 const uint32_t *src, size_t srcStride, int srcWidth, int srcHeight)
+{
+	const Kernels &kernels = k();
+
+	/* Column sums of the source rows making up one destination row,
+	 * folded into 64 bit totals every BOX_CHUNK rows */
+	std::vector<uint32_t> columns(srcWidth * 4);
+	std::vector<uint64_t> totals(dstWidth * 4);
+
+	for (int dy = 0; dy < dstHeight; ++dy)
+	{
+		int y0 = (int64_t) dy * srcHeight / dstHeight;
+		int y1 = (int64_t) (dy + 1) * srcHeight / dstHeight;
+
+		std::fill(totals.begin(), totals.end(), 0);
+
+		for (int y = y0; y < y1; y += BOX_CHUNK)
+		{
+			std::fill(columns.begin(), columns.end(), 0);
+
+			for (int row = y; row < std::min(y1, y + BOX_CHUNK); ++row)
+				kernels.weightRow(src + row * srcStride, srcWidth, columns.data());
+
+			for (int dx = 0; dx < dstWidth; ++dx)
+			{
+				int x0 = (int64_t) dx * srcWidth / dstWidth;
+				int x1 = (int64_t) (dx + 1) * srcWidth / dstWidth;
+
+				for (int x = x0; x < x1; ++x)
+					for (int i = 0; i < 4; ++i)
+						totals[dx * 4 + i] += columns[x * 4 + i];
+			}
+		}
+
+		for (int dx = 0; dx < dstWidth; ++dx)
+		{
+			int x0 = (int64_t) dx * srcWidth / dstWidth;
+			int x1 = (int64_t) (dx + 1) * srcWidth / dstWidth;
+
+			const uint64_t *sum = &totals[dx * 4];
+			uint64_t count = (uint64_t) (x1 - x0) * (y1 - y0);
+			uint32_t out = 0;
+
+			if (sum[3] > 0)
+			{
+				out = (uint32_t) ((sum[3] + count / 2) / count) << 24;
+
+				for (int i = 0; i < 3; ++i)
+					out |= (uint32_t) ((sum[i] + sum[3] / 2) / sum[3]) << (i * 8);
+			}
+
+			dst[dy * dstStride + dx] = out;
+		}
+	}
+}
+
+SDL_Surface *PixelKernels::convertSurface(SDL_Surface *surf, uint32_t format)
+{
+	uint32_t from = surf->format->format;
+
+	bool swizzle = (from == SDL_PIXELFORMAT_ABGR8888 && format == SDL_PIXELFORMAT_ARGB8888) ||
+	               (from == SDL_PIXELFORMAT_ARGB8888 && format == SDL_PIXELFORMAT_ABGR8888);
+
+	if (!swizzle || SDL_MUSTLOCK(surf))
+		return SDL_ConvertSurfaceFormat(surf, format, 0);
+
+	SDL_Surface *conv = SDL_CreateRGBSurfaceWithFormat(0, surf->w, surf->h, 32, format);
+
+	if (!conv)
+		return 0;
+
+	for (int y = 0; y < surf->h; ++y)
+		swizzleRB((uint32_t*) ((uint8_t*) conv->pixels + y * conv->pitch),
+		          (const uint32_t*) ((const uint8_t*) surf->pixels + y * surf->pitch), surf->w);
+
+	return conv;
+}
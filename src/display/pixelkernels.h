@@ -0,0 +1,87 @@
+/*
+** pixelkernels.h
+**
+** This file is part of mkxp.
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PIXELKERNELS_H
+#define PIXELKERNELS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct SDL_Surface;
+
+/* Loops over 32 bit pixels for the software side of Bitmap,
+ * with SSE2, AVX2 and NEON versions picked at runtime.
+ *
+ * Pixels are expected to carry straight (not premultiplied)
+ * alpha in their top byte. The other three channels are all
+ * treated alike, so ABGR8888 and ARGB8888 both work. */
+namespace PixelKernels
+{
+	/* "avx2", "sse2", "neon" or "scalar" */
+	const char *isa();
+
+	/* Switch to the named version (or the best one if null),
+	 * mostly for benchmarking. Returns false and changes nothing
+	 * if the CPU or build doesn't support it */
+	bool selectIsa(const char *name);
+
+	/* Blend 'src' over 'dst' with the same equation as
+	 * SDL_BLENDMODE_BLEND:
+	 *   dstRGB = srcRGB * srcA + dstRGB * (1 - srcA)
+	 *   dstA   = srcA + dstA * (1 - srcA) */
+	void blendOver(uint32_t *dst, const uint32_t *src, size_t count);
+
+	/* Swap the first and third byte of each pixel, converting
+	 * between ABGR8888 and ARGB8888. 'dst' may equal 'src' */
+	void swizzleRB(uint32_t *dst, const uint32_t *src, size_t count);
+
+	/* Put 'color' shaped by the alpha of 'src' over a black
+	 * shadow with the alpha of 'shadow', like the bitmap blit
+	 * shader does at full opacity. Pixels of 'src' that are
+	 * opaque, or have no shadow below them, are copied as is */
+	void shadowCompose(uint32_t *dst, const uint32_t *src, const uint32_t *shadow,
+	                   uint32_t color, size_t count);
+
+	struct BoxSums
+	{
+		/* Colour channels weighted by alpha, in byte order */
+		uint64_t weighted[3];
+		uint64_t alpha;
+
+		/* Colour channels of pixels that aren't fully transparent */
+		uint64_t visible[3];
+		uint64_t visibleCount;
+	};
+
+	/* Sum up a 'width' x 'height' block, 'stride' given in pixels */
+	void boxSums(const uint32_t *pixels, size_t stride,
+	             int width, int height, BoxSums &sums);
+
+	/* Shrink 'src' into 'dst', which mustn't be larger in either
+	 * dimension. Every destination pixel averages the source
+	 * pixels it covers, weighted by their alpha */
+	void boxDownsample(uint32_t *dst, size_t dstStride, int dstWidth, int dstHeight,
+	                   const uint32_t *src, size_t srcStride, int srcWidth, int srcHeight);
+
+	/* Like SDL_ConvertSurfaceFormat, but going through swizzleRB
+	 * for conversions between ABGR8888 and ARGB8888 */
+	SDL_Surface *convertSurface(SDL_Surface *surf, uint32_t format);
+}
+
+#endif // PIXELKERNELS_H
@@ -33,6 +33,7 @@
 #include "etc-internal.h"
 #include "shader.h"
 #include "glstate.h"
+#include "preparequeue.h"
 
 #include "sigslot/signal.hpp"
 
@@ -42,7 +43,7 @@ static float fwrap(float value, float range)
 	return res < 0 ? res + range : res;
 }
 
-struct PlanePrivate
+struct PlanePrivate : public Preparable
 {
 	Bitmap *bitmap;
 
@@ -56,14 +57,17 @@ struct PlanePrivate
 
 	Scene::Geometry sceneGeo;
 
+	/* Mark the viewport cache stale on change */
+	BitmapWatch bitmapWatch;
+	sigslot::connection colorCon;
+	sigslot::connection toneCon;
+
 	bool quadSourceDirty;
 
 	SimpleQuadArray qArray;
 
 	EtcTemps tmp;
 
-	sigslot::connection prepareCon;
-
 	PlanePrivate()
 	    : bitmap(0),
 	      opacity(255),
@@ -74,15 +78,31 @@ struct PlanePrivate
 	      zoomX(1), zoomY(1),
 	      quadSourceDirty(false)
 	{
-		prepareCon = shState->prepareDraw.connect
-		        (&PlanePrivate::prepare, this);
-
 		qArray.resize(1);
 	}
 
 	~PlanePrivate()
 	{
-		prepareCon.disconnect();
+		bitmapWatch.disconnect();
+		colorCon.disconnect();
+		toneCon.disconnect();
+	}
+
+	void updateCacheCons(SceneElement *self)
+	{
+		colorCon.disconnect();
+		toneCon.disconnect();
+
+		colorCon = color->valueChanged.connect
+		        (&SceneElement::notifyChanged, self);
+		toneCon = tone->valueChanged.connect
+		        (&SceneElement::notifyChanged, self);
+	}
+
+	void markQuadSourceDirty()
+	{
+		quadSourceDirty = true;
+		schedulePrepare();
 	}
 
 	void updateQuadSource()
@@ -150,6 +170,7 @@ Plane::Plane(Viewport *viewport)
     : ViewportElement(viewport)
 {
 	p = new PlanePrivate();
+	p->updateCacheCons(this);
 
 	onGeometryChange(scene->getGeometry());
 }
@@ -161,7 +182,8 @@ DEF_ATTR_RD_SIMPLE(Plane, ZoomX,     float,   p->zoomX)
 DEF_ATTR_RD_SIMPLE(Plane, ZoomY,     float,   p->zoomY)
 DEF_ATTR_RD_SIMPLE(Plane, BlendType, int,     p->blendType)
 
-DEF_ATTR_SIMPLE(Plane, Opacity,   int,     p->opacity)
+DEF_ATTR_SIMPLE_NOTIFY(Plane, Opacity, int, p->opacity)
+
 DEF_ATTR_SIMPLE(Plane, Color,     Color&, *p->color)
 DEF_ATTR_SIMPLE(Plane, Tone,      Tone&,  *p->tone)
 
@@ -175,6 +197,8 @@ void Plane::setBitmap(Bitmap *value)
 	guardDisposed();
 
 	p->bitmap = value;
+	p->bitmapWatch.set(value, this);
+	notifyChanged();
 
 	if (!value)
 		return;
@@ -190,7 +214,8 @@ void Plane::setOX(int value)
 	        return;
 
 	p->ox = value;
-	p->quadSourceDirty = true;
+	p->markQuadSourceDirty();
+	notifyChanged();
 }
 
 void Plane::setOY(int value)
@@ -201,7 +226,8 @@ void Plane::setOY(int value)
 	        return;
 
 	p->oy = value;
-	p->quadSourceDirty = true;
+	p->markQuadSourceDirty();
+	notifyChanged();
 }
 
 void Plane::setZoomX(float value)
@@ -212,7 +238,8 @@ void Plane::setZoomX(float value)
 	        return;
 
 	p->zoomX = value;
-	p->quadSourceDirty = true;
+	p->markQuadSourceDirty();
+	notifyChanged();
 }
 
 void Plane::setZoomY(float value)
@@ -223,7 +250,8 @@ void Plane::setZoomY(float value)
 	        return;
 
 	p->zoomY = value;
-	p->quadSourceDirty = true;
+	p->markQuadSourceDirty();
+	notifyChanged();
 }
 
 void Plane::setBlendType(int value)
@@ -235,20 +263,24 @@ void Plane::setBlendType(int value)
 	default :
 	case BlendNormal :
 		p->blendType = BlendNormal;
-		return;
+		break;
 	case BlendAddition :
 		p->blendType = BlendAddition;
-		return;
+		break;
 	case BlendSubstraction :
 		p->blendType = BlendSubstraction;
-		return;
+		break;
 	}
+
+	notifyChanged();
 }
 
 void Plane::initDynAttribs()
 {
 	p->color = new Color;
 	p->tone = new Tone;
+
+	p->updateCacheCons(this);
 }
 
 void Plane::draw()
@@ -300,13 +332,24 @@ void Plane::draw()
 	glState.blendMode.pop();
 }
 
+bool Plane::isCacheable() const
+{
+	if (p->blendType != BlendNormal)
+		return false;
+
+	if (!nullOrDisposed(p->bitmap) && p->bitmap->isAnimated())
+		return false;
+
+	return true;
+}
+
 void Plane::onGeometryChange(const Scene::Geometry &geo)
 {
 	if (gl.npot_repeat)
 		Quad::setPosRect(&p->qArray.vertices[0], FloatRect(geo.rect));
 
 	p->sceneGeo = geo;
-	p->quadSourceDirty = true;
+	p->markQuadSourceDirty();
 }
 
 void Plane::releaseResources()
@@ -54,6 +54,7 @@ private:
 
 	void draw();
 	void onGeometryChange(const Scene::Geometry &);
+	bool isCacheable() const;
 
 	void releaseResources();
 	const char *klassName() const { return "plane"; }
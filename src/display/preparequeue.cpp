@@ -0,0 +1,65 @@
+/*
+** preparequeue.cpp
+**
+** This file is part of mkxp.
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "preparequeue.h"
+
+#include "sharedstate.h"
+
+void Preparable::schedulePrepare()
+{
+	shState->prepareQueue().schedule(*this);
+}
+
+PrepareQueue::PrepareQueue()
+    : current(0),
+      count(0)
+{}
+
+PrepareQueue::~PrepareQueue()
+{
+	/* Detach whatever is still scheduled, so the
+	 * links don't touch us when they go away */
+	for (int i = 0; i < 2; ++i)
+		while (!batches[i].isEmpty())
+			batches[i].remove(*batches[i].begin());
+}
+
+void PrepareQueue::schedule(Preparable &obj)
+{
+	if (obj.prepareLink.next)
+		return;
+
+	batches[current].append(obj.prepareLink);
+}
+
+void PrepareQueue::drain()
+{
+	IntruList<Preparable> &batch = batches[current];
+	current ^= 1;
+	count = 0;
+
+	while (!batch.isEmpty())
+	{
+		IntruListLink<Preparable> *link = batch.begin();
+		batch.remove(*link);
+
+		link->data->prepare();
+		++count;
+	}
+}
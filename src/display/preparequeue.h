@@ -0,0 +1,76 @@
+/*
+** preparequeue.h
+**
+** This file is part of mkxp.
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PREPAREQUEUE_H
+#define PREPAREQUEUE_H
+
+#include "intrulist.h"
+
+#include <stddef.h>
+
+/* Something with work to do right before a frame is drawn
+ * (rebuilding vertex data, redrawing cached textures etc.).
+ * Call schedulePrepare() whenever such work comes up; prepare()
+ * then runs once before the next frame. Objects with nothing
+ * to do cost nothing per frame. */
+struct Preparable
+{
+	IntruListLink<Preparable> prepareLink;
+
+	Preparable()
+	    : prepareLink(this)
+	{}
+
+	/* The link takes itself out of the queue */
+	virtual ~Preparable() {}
+
+	virtual void prepare() = 0;
+
+	void schedulePrepare();
+
+private:
+	Preparable(const Preparable &);
+	void operator=(const Preparable &);
+};
+
+/* Everything is scheduled and drained on the thread running
+ * the game scripts, so there is no locking. */
+class PrepareQueue
+{
+public:
+	PrepareQueue();
+	~PrepareQueue();
+
+	/* No-op if 'obj' is already scheduled */
+	void schedule(Preparable &obj);
+
+	/* Objects scheduled while draining end up in
+	 * the next frame's batch */
+	void drain();
+
+	/* Number of objects prepared by the last drain() */
+	size_t lastCount() const { return count; }
+
+private:
+	IntruList<Preparable> batches[2];
+	int current;
+	size_t count;
+};
+
+#endif // PREPAREQUEUE_H
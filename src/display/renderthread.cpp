@@ -0,0 +1,239 @@
+/*
+** renderthread.cpp
+**
+** This file is part of mkxp.
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "renderthread.h"
+
+#include "eventthread.h"
+#include "texpool.h"
+#include "sdl-util.h"
+
+/* How long a single wait on a fence may block, in ns.
+ * Waits are retried, this only bounds each attempt */
+#define SYNC_WAIT_TIMEOUT 100000000
+
+RenderThread::RenderThread(RGSSThreadData *rtData, SDL_GLContext ctx,
+                           int framesInFlight)
+    : rtData(rtData),
+      ctx(ctx),
+      slots(framesInFlight + 1),
+      maxInFlight(framesInFlight),
+      next(0),
+      frameBegun(false),
+      inFlight(0),
+      quit(false)
+{
+	for (size_t i = 0; i < slots.size(); ++i)
+	{
+		Slot &slot = slots[i];
+
+		TEXFBO::init(slot.buffer);
+		TEXFBO::linkFBO(slot.buffer);
+
+		slot.presentFBO = 0;
+		slot.drawn = 0;
+		slot.read = 0;
+	}
+
+	FBO::unbind();
+
+	mutex = SDL_CreateMutex();
+	cond = SDL_CreateCond();
+	thread = createSDLThread<RenderThread, &RenderThread::run>(this, "render");
+}
+
+RenderThread::~RenderThread()
+{
+	SDL_LockMutex(mutex);
+	quit = true;
+	SDL_CondBroadcast(cond);
+	SDL_UnlockMutex(mutex);
+
+	SDL_WaitThread(thread, 0);
+
+	for (size_t i = 0; i < slots.size(); ++i)
+	{
+		Slot &slot = slots[i];
+
+		if (slot.drawn)
+			gl.DeleteSync(slot.drawn);
+
+		if (slot.read)
+			gl.DeleteSync(slot.read);
+
+		TexPool::account(slot.buffer, -1);
+		TEXFBO::fini(slot.buffer);
+	}
+
+	SDL_GL_DeleteContext(ctx);
+
+	SDL_DestroyCond(cond);
+	SDL_DestroyMutex(mutex);
+}
+
+bool RenderThread::supported()
+{
+	return gl.BlitFramebuffer && gl.FenceSync;
+}
+
+TEXFBO &RenderThread::beginFrame(const Vec2i &size)
+{
+	Slot &slot = slots[next];
+
+	if (frameBegun)
+		return slot.buffer;
+
+	/* The render thread may still be reading
+	 * from the last frame drawn into this buffer */
+	waitSync(slot.read);
+
+	if (slot.buffer.width != size.x || slot.buffer.height != size.y)
+	{
+		TexPool::account(slot.buffer, -1);
+		TEXFBO::allocEmpty(slot.buffer, size.x, size.y);
+		TexPool::account(slot.buffer, +1);
+	}
+
+	frameBegun = true;
+
+	return slot.buffer;
+}
+
+void RenderThread::submitFrame()
+{
+	if (!frameBegun)
+		return;
+
+	Slot &slot = slots[next];
+
+	/* The fence has to reach the GPU before
+	 * the other context can wait on it */
+	slot.drawn = gl.FenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	gl.Flush();
+
+	SDL_LockMutex(mutex);
+
+	queue.push_back(next);
+	++inFlight;
+	SDL_CondBroadcast(cond);
+
+	while (inFlight > maxInFlight)
+		SDL_CondWait(cond, mutex);
+
+	SDL_UnlockMutex(mutex);
+
+	next = (next + 1) % slots.size();
+	frameBegun = false;
+}
+
+void RenderThread::finish()
+{
+	SDL_LockMutex(mutex);
+
+	while (inFlight > 0)
+		SDL_CondWait(cond, mutex);
+
+	SDL_UnlockMutex(mutex);
+}
+
+void RenderThread::waitSync(_GLsync &sync)
+{
+	if (!sync)
+		return;
+
+	GLenum result;
+
+	do
+		result = gl.ClientWaitSync(sync, GL_SYNC_FLUSH_COMMANDS_BIT, SYNC_WAIT_TIMEOUT);
+	while (result == GL_TIMEOUT_EXPIRED);
+
+	gl.DeleteSync(sync);
+	sync = 0;
+}
+
+void RenderThread::present(Slot &slot)
+{
+	waitSync(slot.drawn);
+
+	if (!slot.presentFBO)
+	{
+		gl.GenFramebuffers(1, &slot.presentFBO);
+		gl.BindFramebuffer(GL_FRAMEBUFFER, slot.presentFBO);
+		gl.FramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+		                        GL_TEXTURE_2D, slot.buffer.tex.gl, 0);
+	}
+
+	const int w = slot.buffer.width;
+	const int h = slot.buffer.height;
+
+	gl.BindFramebuffer(GL_READ_FRAMEBUFFER, slot.presentFBO);
+	gl.BindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+
+	/* The window may have grown since the frame was drawn */
+	gl.Clear(GL_COLOR_BUFFER_BIT);
+	gl.BlitFramebuffer(0, 0, w, h, 0, 0, w, h, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+
+	/* Swapping flushes, so the fence is visible
+	 * to the game thread right after */
+	slot.read = gl.FenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	SDL_GL_SwapWindow(rtData->window);
+}
+
+void RenderThread::run()
+{
+	SDL_GL_MakeCurrent(rtData->window, ctx);
+
+	/* The swap interval belongs to the context */
+	const Config &conf = rtData->config;
+	SDL_GL_SetSwapInterval(conf.vsync || conf.syncToRefreshrate ? 1 : 0);
+
+	gl.ClearColor(0, 0, 0, 1);
+
+	while (true)
+	{
+		SDL_LockMutex(mutex);
+
+		while (queue.empty() && !quit)
+			SDL_CondWait(cond, mutex);
+
+		/* Everything submitted is still presented on quit */
+		if (queue.empty())
+		{
+			SDL_UnlockMutex(mutex);
+			break;
+		}
+
+		size_t index = queue.front();
+		queue.pop_front();
+
+		SDL_UnlockMutex(mutex);
+
+		present(slots[index]);
+
+		SDL_LockMutex(mutex);
+		--inFlight;
+		SDL_CondBroadcast(cond);
+		SDL_UnlockMutex(mutex);
+	}
+
+	for (size_t i = 0; i < slots.size(); ++i)
+		if (slots[i].presentFBO)
+			gl.DeleteFramebuffers(1, &slots[i].presentFBO);
+
+	SDL_GL_MakeCurrent(rtData->window, 0);
+}
@@ -0,0 +1,106 @@
+/*
+** renderthread.h
+**
+** This file is part of mkxp.
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef RENDERTHREAD_H
+#define RENDERTHREAD_H
+
+#include "gl-util.h"
+
+#include <SDL_video.h>
+#include <SDL_mutex.h>
+#include <SDL_thread.h>
+
+#include <deque>
+#include <vector>
+
+struct RGSSThreadData;
+
+/* Presents finished frames on a separate thread.
+ *
+ * The game thread draws each frame's final, window sized image
+ * into one of a small ring of buffers and submits it; the render
+ * thread, using a second GL context sharing objects with the
+ * first, copies it to the window and swaps. Scripts can thus
+ * start on the next frame while the current one is still waiting
+ * on the swap. Both sides hand buffers over through fences, and
+ * submitFrame() blocks once 'framesInFlight' frames are queued.
+ *
+ * Needs framebuffer blits and sync objects. */
+class RenderThread
+{
+public:
+	/* Takes ownership of 'ctx', which must not be
+	 * current on any thread */
+	RenderThread(RGSSThreadData *rtData, SDL_GLContext ctx,
+	             int framesInFlight);
+	~RenderThread();
+
+	static bool supported();
+
+	/* The buffer the next frame has to be drawn into.
+	 * Calling this again before submitFrame() returns
+	 * the same buffer */
+	TEXFBO &beginFrame(const Vec2i &size);
+	void submitFrame();
+
+	/* Blocks until every submitted frame was presented */
+	void finish();
+
+private:
+	struct Slot
+	{
+		TEXFBO buffer;
+
+		/* Created on the render thread, as FBOs
+		 * aren't shared between contexts */
+		GLuint presentFBO;
+
+		/* Signaled once the game thread finished drawing
+		 * into / the render thread finished reading from
+		 * the buffer */
+		_GLsync drawn;
+		_GLsync read;
+	};
+
+	void run();
+	void present(Slot &slot);
+
+	static void waitSync(_GLsync &sync);
+
+	RGSSThreadData *rtData;
+	SDL_GLContext ctx;
+
+	std::vector<Slot> slots;
+	size_t maxInFlight;
+
+	/* Game thread only */
+	size_t next;
+	bool frameBegun;
+
+	/* Guarded by 'mutex' */
+	std::deque<size_t> queue;
+	size_t inFlight;
+	bool quit;
+
+	SDL_mutex *mutex;
+	SDL_cond *cond;
+	SDL_Thread *thread;
+};
+
+#endif // RENDERTHREAD_H
@@ -34,6 +34,7 @@
 #include "shader.h"
 #include "glstate.h"
 #include "quadarray.h"
+#include "preparequeue.h"
 
 #include <math.h>
 #ifndef M_PI
@@ -44,7 +45,7 @@
 
 #include "sigslot/signal.hpp"
 
-struct SpritePrivate
+struct SpritePrivate : public Preparable
 {
     Bitmap *bitmap;
     
@@ -70,16 +71,28 @@ struct SpritePrivate
     
     bool invert;
     
-    IntRect sceneRect;
-    Vec2i sceneOrig;
+    /* Untransformed area covered by the quad */
+    FloatRect quadRect;
     
-    /* Would this sprite be visible on
-     * the screen if drawn? */
+    /* The source rect lies within the bitmap. Otherwise the
+     * texture coordinates rely on edge clamping, which an
+     * atlas page can't provide (it'd show the neighbours) */
+    bool srcRectInside;
+    
+    /* Is there anything to draw at all? Whether it
+     * ends up on screen is decided by the scene */
     bool isVisible;
     
     Color *color;
     Tone *tone;
     
+    /* Mark the viewport cache stale on change */
+    BitmapWatch bitmapWatch;
+    BitmapWatch patternWatch;
+    sigslot::connection srcRectCacheCon;
+    sigslot::connection colorCon;
+    sigslot::connection toneCon;
+    
     struct
     {
         int amp;
@@ -96,7 +109,6 @@ struct SpritePrivate
     
     EtcTemps tmp;
     
-    sigslot::connection prepareCon;
     
     SpritePrivate()
     : bitmap(0),
@@ -111,18 +123,14 @@ struct SpritePrivate
     patternTile(true),
     patternOpacity(255),
     invert(false),
+    srcRectInside(true),
     isVisible(false),
     color(&tmp.color),
     tone(&tmp.tone)
     
     {
-        sceneRect.x = sceneRect.y = 0;
-        
         updateSrcRectCon();
         
-        prepareCon = shState->prepareDraw.connect
-        (&SpritePrivate::prepare, this);
-        
         patternScroll = Vec2(0,0);
         patternZoom = Vec2(1, 1);
         
@@ -136,7 +144,12 @@ struct SpritePrivate
     ~SpritePrivate()
     {
         srcRectCon.disconnect();
-        prepareCon.disconnect();
+        
+        bitmapWatch.disconnect();
+        patternWatch.disconnect();
+        srcRectCacheCon.disconnect();
+        colorCon.disconnect();
+        toneCon.disconnect();
     }
     
     void recomputeBushDepth()
@@ -165,12 +178,22 @@ struct SpritePrivate
         rect.w = clamp<int>(rect.w, 0, bmSize.x-rect.x);
         rect.h = clamp<int>(rect.h, 0, bmSize.y-rect.y);
         
+        srcRectInside = rect.x >= 0 && rect.y >= 0 &&
+                        rect.x + rect.w <= bmSize.x && rect.y + rect.h <= bmSize.y;
+        
         quad.setTexRect(mirrored ? rect.hFlipped() : rect);
         
-        quad.setPosRect(FloatRect(0, 0, rect.w, rect.h));
+        quadRect = FloatRect(0, 0, rect.w, rect.h);
+        quad.setPosRect(quadRect);
         recomputeBushDepth();
         
+        markWaveDirty();
+    }
+    
+    void markWaveDirty()
+    {
         wave.dirty = true;
+        schedulePrepare();
     }
     
     void updateSrcRectCon()
@@ -182,6 +205,20 @@ struct SpritePrivate
         (&SpritePrivate::onSrcRectChange, this);
     }
     
+    void updateCacheCons(SceneElement *self)
+    {
+        srcRectCacheCon.disconnect();
+        colorCon.disconnect();
+        toneCon.disconnect();
+        
+        srcRectCacheCon = srcRect->valueChanged.connect
+        (&SceneElement::notifyChanged, self);
+        colorCon = color->valueChanged.connect
+        (&SceneElement::notifyChanged, self);
+        toneCon = tone->valueChanged.connect
+        (&SceneElement::notifyChanged, self);
+    }
+    
     void updateVisibility()
     {
         isVisible = false;
@@ -195,31 +232,7 @@ struct SpritePrivate
         if (!opacity)
             return;
         
-        if (wave.active)
-        {
-            /* Don't do expensive wave bounding box
-             * calculations */
-            isVisible = true;
-            return;
-        }
-        
-        /* Compare sprite bounding box against the scene */
-        
-        /* If sprite is zoomed/rotated, just opt out for now
-         * for simplicity's sake */
-        const Vec2 &scale = trans.getScale();
-        if (scale.x != 1 || scale.y != 1 || trans.getRotation() != 0)
-        {
-            isVisible = true;
-            return;
-        }
-        
-        IntRect self;
-        self.setPos(trans.getPositionI() - (trans.getOriginI() + sceneOrig));
-        self.w = bitmap->width();
-        self.h = bitmap->height();
-        
-        isVisible = SDL_HasIntersection(&self, &sceneRect);
+        isVisible = true;
     }
     
     void emitWaveChunk(SVertex *&vert, float phase, int width,
@@ -313,8 +326,6 @@ struct SpritePrivate
             updateWave();
             wave.dirty = false;
         }
-        
-        updateVisibility();
     }
 };
 
@@ -322,6 +333,7 @@ Sprite::Sprite(Viewport *viewport)
 : ViewportElement(viewport)
 {
     p = new SpritePrivate;
+    p->updateCacheCons(this);
     onGeometryChange(scene->getGeometry());
 }
 
@@ -350,18 +362,19 @@ DEF_ATTR_RD_SIMPLE(Sprite, WaveLength, int,     p->wave.length)
 DEF_ATTR_RD_SIMPLE(Sprite, WaveSpeed,  int,     p->wave.speed)
 DEF_ATTR_RD_SIMPLE(Sprite, WavePhase,  float,   p->wave.phase)
 
-DEF_ATTR_SIMPLE(Sprite, BushOpacity, int,     p->bushOpacity)
-DEF_ATTR_SIMPLE(Sprite, Opacity,     int,     p->opacity)
 DEF_ATTR_SIMPLE(Sprite, SrcRect,     Rect&,  *p->srcRect)
 DEF_ATTR_SIMPLE(Sprite, Color,       Color&, *p->color)
 DEF_ATTR_SIMPLE(Sprite, Tone,        Tone&,  *p->tone)
-DEF_ATTR_SIMPLE(Sprite, PatternTile, bool, p->patternTile)
-DEF_ATTR_SIMPLE(Sprite, PatternOpacity, int, p->patternOpacity)
-DEF_ATTR_SIMPLE(Sprite, PatternScrollX, int, p->patternScroll.x)
-DEF_ATTR_SIMPLE(Sprite, PatternScrollY, int, p->patternScroll.y)
-DEF_ATTR_SIMPLE(Sprite, PatternZoomX, float, p->patternZoom.x)
-DEF_ATTR_SIMPLE(Sprite, PatternZoomY, float, p->patternZoom.y)
-DEF_ATTR_SIMPLE(Sprite, Invert,      bool,    p->invert)
+
+DEF_ATTR_SIMPLE_NOTIFY(Sprite, BushOpacity, int,     p->bushOpacity)
+DEF_ATTR_SIMPLE_NOTIFY(Sprite, Opacity,     int,     p->opacity)
+DEF_ATTR_SIMPLE_NOTIFY(Sprite, PatternTile, bool, p->patternTile)
+DEF_ATTR_SIMPLE_NOTIFY(Sprite, PatternOpacity, int, p->patternOpacity)
+DEF_ATTR_SIMPLE_NOTIFY(Sprite, PatternScrollX, int, p->patternScroll.x)
+DEF_ATTR_SIMPLE_NOTIFY(Sprite, PatternScrollY, int, p->patternScroll.y)
+DEF_ATTR_SIMPLE_NOTIFY(Sprite, PatternZoomX, float, p->patternZoom.x)
+DEF_ATTR_SIMPLE_NOTIFY(Sprite, PatternZoomY, float, p->patternZoom.y)
+DEF_ATTR_SIMPLE_NOTIFY(Sprite, Invert,      bool,    p->invert)
 
 void Sprite::setBitmap(Bitmap *bitmap)
 {
@@ -371,6 +384,8 @@ void Sprite::setBitmap(Bitmap *bitmap)
         return;
     
     p->bitmap = bitmap;
+    p->bitmapWatch.set(bitmap, this);
+    notifyChanged();
     
     if (nullOrDisposed(bitmap))
         return;
@@ -381,7 +396,7 @@ void Sprite::setBitmap(Bitmap *bitmap)
     p->onSrcRectChange();
     p->quad.setPosRect(p->srcRect->toFloatRect());
     
-    p->wave.dirty = true;
+    p->markWaveDirty();
 }
 
 void Sprite::setX(int value)
@@ -392,6 +407,7 @@ void Sprite::setX(int value)
         return;
     
     p->trans.setPosition(Vec2(value, getY()));
+    notifyChanged();
 }
 
 void Sprite::setY(int value)
@@ -402,10 +418,11 @@ void Sprite::setY(int value)
         return;
     
     p->trans.setPosition(Vec2(getX(), value));
+    notifyChanged();
     
     if (rgssVer >= 2)
     {
-        p->wave.dirty = true;
+        p->markWaveDirty();
         setSpriteY(value);
     }
 }
@@ -418,6 +435,7 @@ void Sprite::setOX(int value)
         return;
     
     p->trans.setOrigin(Vec2(value, getOY()));
+    notifyChanged();
 }
 
 void Sprite::setOY(int value)
@@ -428,6 +446,7 @@ void Sprite::setOY(int value)
         return;
     
     p->trans.setOrigin(Vec2(getOX(), value));
+    notifyChanged();
 }
 
 void Sprite::setZoomX(float value)
@@ -438,6 +457,7 @@ void Sprite::setZoomX(float value)
         return;
     
     p->trans.setScale(Vec2(value, getZoomY()));
+    notifyChanged();
 }
 
 void Sprite::setZoomY(float value)
@@ -449,9 +469,10 @@ void Sprite::setZoomY(float value)
     
     p->trans.setScale(Vec2(getZoomX(), value));
     p->recomputeBushDepth();
+    notifyChanged();
     
     if (rgssVer >= 2)
-        p->wave.dirty = true;
+        p->markWaveDirty();
 }
 
 void Sprite::setAngle(float value)
@@ -462,6 +483,7 @@ void Sprite::setAngle(float value)
         return;
     
     p->trans.setRotation(value);
+    notifyChanged();
 }
 
 void Sprite::setMirror(bool mirrored)
@@ -473,6 +495,7 @@ void Sprite::setMirror(bool mirrored)
     
     p->mirrored = mirrored;
     p->onSrcRectChange();
+    notifyChanged();
 }
 
 void Sprite::setBushDepth(int value)
@@ -484,6 +507,7 @@ void Sprite::setBushDepth(int value)
     
     p->bushDepth = value;
     p->recomputeBushDepth();
+    notifyChanged();
 }
 
 void Sprite::setBlendType(int type)
@@ -495,14 +519,16 @@ void Sprite::setBlendType(int type)
         default :
         case BlendNormal :
             p->blendType = BlendNormal;
-            return;
+            break;
         case BlendAddition :
             p->blendType = BlendAddition;
-            return;
+            break;
         case BlendSubstraction :
             p->blendType = BlendSubstraction;
-            return;
+            break;
     }
+    
+    notifyChanged();
 }
 
 void Sprite::setPattern(Bitmap *value)
@@ -513,6 +539,8 @@ void Sprite::setPattern(Bitmap *value)
         return;
     
     p->pattern = value;
+    p->patternWatch.set(value, this);
+    notifyChanged();
     
     if (!nullOrDisposed(value))
         value->ensureNonMega();
@@ -527,14 +555,16 @@ void Sprite::setPatternBlendType(int type)
         default :
         case BlendNormal :
             p->patternBlendType = BlendNormal;
-            return;
+            break;
         case BlendAddition :
             p->patternBlendType = BlendAddition;
-            return;
+            break;
         case BlendSubstraction :
             p->patternBlendType = BlendSubstraction;
-            return;
+            break;
     }
+    
+    notifyChanged();
 }
 
 #define DEF_WAVE_SETTER(Name, name, type) \
@@ -544,7 +574,8 @@ guardDisposed(); \
 if (p->wave.name == value) \
 return; \
 p->wave.name = value; \
-p->wave.dirty = true; \
+p->markWaveDirty(); \
+notifyChanged(); \
 }
 
 DEF_WAVE_SETTER(Amp,    amp,    int)
@@ -561,6 +592,7 @@ void Sprite::initDynAttribs()
     p->tone = new Tone;
     
     p->updateSrcRectCon();
+    p->updateCacheCons(this);
 }
 
 /* Flashable */
@@ -571,12 +603,17 @@ void Sprite::update()
     Flashable::update();
     
     p->wave.phase += p->wave.speed / 180;
-    p->wave.dirty = true;
+    p->markWaveDirty();
 }
 
 /* SceneElement */
 void Sprite::draw()
 {
+    /* Done here rather than in prepare() so idle sprites don't
+     * have to be scheduled every frame; it depends on state
+     * (eg. the bitmap being disposed) we aren't notified of */
+    p->updateVisibility();
+    
     if (!p->isVisible)
         return;
     
@@ -585,12 +622,14 @@ void Sprite::draw()
     
     ShaderBase *base;
     
+    bool patterned = p->pattern && !p->pattern->isDisposed();
+    
     bool renderEffect = p->color->hasEffect() ||
     p->tone->hasEffect()  ||
     flashing              ||
     p->bushDepth != 0     ||
     p->invert             ||
-    (p->pattern && !p->pattern->isDisposed());
+    patterned;
     
     if (renderEffect)
     {
@@ -655,7 +694,19 @@ void Sprite::draw()
     
     glState.blendMode.pushSet(p->blendType);
     
-    p->bitmap->bindTex(*base);
+    /* Patterns are laid out relative to the bitmap's own texture */
+    Vec2i atlasOffset, atlasSize;
+    bool atlased = !patterned && p->srcRectInside &&
+                   p->bitmap->bindAtlasTex(*base, atlasOffset, atlasSize);
+    
+    if (!atlased)
+        p->bitmap->bindTex(*base);
+    
+    base->setTexOffset(atlasOffset);
+    
+    /* Bush depth is relative to the bound texture's height */
+    if (atlased && renderEffect)
+        shState->shaders().sprite.setBushDepth((atlasOffset.y + p->efBushDepth * p->bitmap->height()) / atlasSize.y);
     
     if (p->wave.active)
         p->wave.qArray.draw();
@@ -670,9 +721,37 @@ void Sprite::onGeometryChange(const Scene::Geometry &geo)
     /* Offset at which the sprite will be drawn
      * relative to screen origin */
     p->trans.setGlobalOffset(geo.offset());
+}
+
+bool Sprite::isCacheable() const
+{
+    /* Flashes and waves change every frame, and anything
+     * but normal blending can't be composited from a cache */
+    if (flashing || p->wave.amp != 0 || p->blendType != BlendNormal)
+        return false;
+    
+    if (!nullOrDisposed(p->bitmap) && p->bitmap->isAnimated())
+        return false;
+    
+    return true;
+}
+
+bool Sprite::getBounds(IntRect &bounds)
+{
+    FloatRect rect = p->quadRect;
+    
+    /* Wave chunks are shifted sideways by up to the amplitude */
+    if (p->wave.active)
+    {
+        float amp = fabsf(p->wave.amp);
+        
+        rect.x -= amp;
+        rect.w += amp * 2;
+    }
+    
+    bounds = p->trans.mapBounds(rect);
     
-    p->sceneRect.setSize(geo.rect.size());
-    p->sceneOrig = geo.orig;
+    return true;
 }
 
 void Sprite::releaseResources()
@@ -83,6 +83,8 @@ private:
 
 	void draw();
 	void onGeometryChange(const Scene::Geometry &);
+	bool getBounds(IntRect &bounds);
+	bool isCacheable() const;
 
 	void releaseResources();
 	const char *klassName() const { return "sprite"; }
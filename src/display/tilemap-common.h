@@ -184,7 +184,7 @@ struct FlashMap
 		shader.setAlpha(alpha);
 		shader.setTranslation(trans);
 
-		gl.DrawElements(GL_TRIANGLES, count * 6, _GL_INDEX_TYPE, 0);
+		drawElements(count * 6, _GL_INDEX_TYPE, 0);
 
 		glState.blendMode.pop();
 
@@ -39,6 +39,7 @@
 #include "vertex.h"
 #include "tileatlas.h"
 #include "tilemap-common.h"
+#include "preparequeue.h"
 
 #include "sigslot/signal.hpp"
 
@@ -232,7 +233,7 @@ struct ZLayer : public ViewportElement
 	ABOUT_TO_ACCESS_NOOP
 };
 
-struct TilemapPrivate
+struct TilemapPrivate : public Preparable
 {
 	Viewport *viewport;
 
@@ -310,8 +311,10 @@ struct TilemapPrivate
 
 	/* Affected by: autotiles, tileset */
 	bool atlasSizeDirty;
-	/* Affected by: autotiles(.changed), tileset(.changed), allocateAtlas */
+	/* Affected by: autotiles(.disposed), allocateAtlas */
 	bool atlasDirty;
+	/* Affected by: autotiles(.changed), tileset(.changed) */
+	bool atlasDamaged;
 	/* Affected by: mapData(.changed), priorities(.changed) */
 	bool buffersDirty;
 	/* Affected by: ox, oy */
@@ -322,6 +325,11 @@ struct TilemapPrivate
 	/* Resources are sufficient and tilemap is ready to be drawn */
 	bool tilemapReady;
 
+	/* Parts of each autotile and of the tileset drawn to since
+	 * the atlas was last built, in their own coordinates */
+	IntRect autotileDamage[autotileCount];
+	IntRect tilesetDamage;
+
 	/* Change watches */
 	sigslot::connection tilesetCon;
 	sigslot::connection autotilesCon[autotileCount];
@@ -331,9 +339,6 @@ struct TilemapPrivate
 	/* Dispose watches */
 	sigslot::connection autotilesDispCon[autotileCount];
 
-	/* Draw prepare call */
-	sigslot::connection prepareCon;
-
 	NormValue opacity;
 	BlendType blendType;
 	Color *color;
@@ -350,6 +355,7 @@ struct TilemapPrivate
 	      flashAlphaIdx(0),
 	      atlasSizeDirty(false),
 	      atlasDirty(false),
+	      atlasDamaged(false),
 	      buffersDirty(false),
 	      mapViewportDirty(false),
 	      zOrderDirty(false),
@@ -382,8 +388,7 @@ struct TilemapPrivate
 		for (size_t i = 0; i < zlayersMax; ++i)
 			elem.zlayers[i] = new ZLayer(this, viewport);
 
-		prepareCon = shState->prepareDraw.connect
-		        (&TilemapPrivate::prepare, this);
+		schedulePrepare();
 
 		updateFlashMapViewport();
 	}
@@ -410,8 +415,6 @@ struct TilemapPrivate
 		}
 		mapDataCon.disconnect();
 		prioritiesCon.disconnect();
-
-		prepareCon.disconnect();
 	}
 
 	void updateFlashMapViewport()
@@ -490,6 +493,27 @@ struct TilemapPrivate
 		atlasDirty = true;
 	}
 
+	void invalidateAutotileArea(int atInd, const IntRect &area)
+	{
+		SDL_UnionRect(&autotileDamage[atInd], &area, &autotileDamage[atInd]);
+		atlasDamaged = true;
+	}
+
+	void invalidateTilesetArea(const IntRect &area)
+	{
+		/* The atlas layout only depends on the tileset height */
+		int tsH = tileset->height();
+
+		if (tsH - (tsH % 32) != atlas.efTilesetH)
+		{
+			invalidateAtlasSize();
+			return;
+		}
+
+		SDL_UnionRect(&tilesetDamage, &area, &tilesetDamage);
+		atlasDamaged = true;
+	}
+
 	void invalidateBuffers()
 	{
 		buffersDirty = true;
@@ -522,10 +546,8 @@ struct TilemapPrivate
 	/* Assembles atlas from tileset and autotile bitmaps */
 	void buildAtlas()
 	{
-        updateAutotileInfo();
-        tileset->ensureNonAnimated();
-
-		TileAtlas::BlitVec blits = TileAtlas::calcBlits(atlas.efTilesetH, atlas.size);
+		updateAutotileInfo();
+		tileset->ensureNonAnimated();
 
 		/* Clear atlas */
 		FBO::bind(atlas.gl.fbo);
@@ -539,52 +561,133 @@ struct TilemapPrivate
 
 		GLMeta::blitBegin(atlas.gl);
 
-		/* Blit autotiles */
+		for (size_t i = 0; i < atlas.usableATs.size(); ++i)
+		{
+			Bitmap *autotile = autotiles[atlas.usableATs[i]];
+			blitAutotile(atlas.usableATs[i], IntRect(0, 0, autotile->width(), autotile->height()));
+		}
+
+		GLMeta::blitEnd();
+
+		blitTileset(IntRect(0, 0, tileset->width(), tileset->height()));
+
+		clearAtlasDamage();
+	}
+
+	/* Re-blits only the parts of the tileset and autotiles
+	 * that were drawn to since the atlas was last built */
+	void updateAtlas()
+	{
+		GLMeta::blitBegin(atlas.gl);
+
 		for (size_t i = 0; i < atlas.usableATs.size(); ++i)
 		{
 			const uint8_t atInd = atlas.usableATs[i];
-			Bitmap *autotile = autotiles[atInd];
-            autotile->ensureNonAnimated();
 
-			int atW = autotile->width();
-			int atH = autotile->height();
-			int blitW = std::min(atW, atAreaW);
-			int blitH = std::min(atH, autotileH);
+			if (!SDL_RectEmpty(&autotileDamage[atInd]))
+				blitAutotile(atInd, autotileDamage[atInd]);
+		}
 
-			if (autotile->hasHires()) {
-				Debug() << "BUG: High-res Tilemap blit autotiles not implemented";
-			}
+		GLMeta::blitEnd();
 
-			GLMeta::blitSource(autotile->getGLTypes());
+		if (!SDL_RectEmpty(&tilesetDamage))
+		{
+			tileset->ensureNonAnimated();
+			blitTileset(tilesetDamage);
+		}
 
-			if (atW <= autotileW && tiles.animated && !atlas.smallATs[atInd])
-			{
-				/* Static autotile */
-				for (int j = 0; j < atFrames; ++j)
-					GLMeta::blitRectangle(IntRect(0, 0, blitW, blitH),
-					                      Vec2i(autotileW*j, atInd*autotileH));
-			}
-			else
+		clearAtlasDamage();
+	}
+
+	void clearAtlasDamage()
+	{
+		for (int i = 0; i < autotileCount; ++i)
+			autotileDamage[i] = IntRect();
+
+		tilesetDamage = IntRect();
+		atlasDamaged = false;
+	}
+
+	/* Copies 'area' of an autotile (in its own coordinates) to
+	 * every place it occupies in the atlas. Expects to be called
+	 * between GLMeta::blitBegin() and blitEnd() on the atlas */
+	void blitAutotile(uint8_t atInd, const IntRect &area)
+	{
+		Bitmap *autotile = autotiles[atInd];
+		autotile->ensureNonAnimated();
+
+		int atW = autotile->width();
+		int atH = autotile->height();
+		int blitW = std::min(atW, atAreaW);
+		int blitH = std::min(atH, autotileH);
+
+		if (autotile->hasHires()) {
+			Debug() << "BUG: High-res Tilemap blit autotiles not implemented";
+		}
+
+		GLMeta::blitSource(autotile->getGLTypes());
+
+		IntRect bounds(0, 0, blitW, blitH);
+		IntRect piece;
+
+		if (atW <= autotileW && tiles.animated && !atlas.smallATs[atInd])
+		{
+			/* Static autotile */
+			if (!SDL_IntersectRect(&area, &bounds, &piece))
+				return;
+
+			for (int j = 0; j < atFrames; ++j)
+				GLMeta::blitRectangle(piece,
+				                      Vec2i(autotileW*j + piece.x, atInd*autotileH + piece.y));
+		}
+		else
+		{
+			/* Animated autotile */
+			if (atlas.smallATs[atInd])
 			{
-				/* Animated autotile */
-				if (atlas.smallATs[atInd])
+				int frames = atW/32;
+				for (int j = 0; j < atFrames*autotileH/32; ++j)
 				{
-					int frames = atW/32;
-					for (int j = 0; j < atFrames*autotileH/32; ++j)
-					{
-						GLMeta::blitRectangle(IntRect(32*(j % frames), 0, 32, 32),
-						                      Vec2i(autotileW*(j % atFrames), atInd*autotileH + 32*(j / atFrames)));
-					}
+					IntRect cell(32*(j % frames), 0, 32, 32);
+
+					if (!SDL_IntersectRect(&area, &cell, &piece))
+						continue;
+
+					GLMeta::blitRectangle(piece,
+					                      Vec2i(autotileW*(j % atFrames) + piece.x - cell.x,
+					                            atInd*autotileH + 32*(j / atFrames) + piece.y));
 				}
-				else
-					GLMeta::blitRectangle(IntRect(0, 0, blitW, blitH),
-					                      Vec2i(0, atInd*autotileH));
 			}
+			else if (SDL_IntersectRect(&area, &bounds, &piece))
+				GLMeta::blitRectangle(piece,
+				                      Vec2i(piece.x, atInd*autotileH + piece.y));
 		}
+	}
 
-		GLMeta::blitEnd();
+	/* Copies 'area' of the tileset (in its own coordinates)
+	 * to where it is laid out in the atlas */
+	void blitTileset(const IntRect &area)
+	{
+		TileAtlas::BlitVec blits = TileAtlas::calcBlits(atlas.efTilesetH, atlas.size);
+
+		/* Narrow the blits down to what overlaps 'area' */
+		std::vector<IntRect> srcRects;
+		std::vector<Vec2i> dstPos;
+
+		for (size_t i = 0; i < blits.size(); ++i)
+		{
+			const TileAtlas::Blit &blitOp = blits[i];
+			IntRect lane(blitOp.src.x, blitOp.src.y, tsLaneW, blitOp.h);
+			IntRect piece;
+
+			if (!SDL_IntersectRect(&area, &lane, &piece))
+				continue;
+
+			srcRects.push_back(piece);
+			dstPos.push_back(Vec2i(blitOp.dst.x + piece.x - lane.x,
+			                       blitOp.dst.y + piece.y - lane.y));
+		}
 
-		/* Blit tileset */
 		if (tileset->megaSurface())
 		{
 			/* Mega surface tileset */
@@ -604,19 +707,19 @@ struct TilemapPrivate
 
 				Quad &quad = shState->gpQuad();
 
-				for (size_t i = 0; i < blits.size(); ++i)
+				for (size_t i = 0; i < srcRects.size(); ++i)
 				{
-					const TileAtlas::Blit &blitOp = blits[i];
+					const IntRect &src = srcRects[i];
 
 					Vec2i texSize;
-					shState->ensureTexSize(tsLaneW, blitOp.h, texSize);
+					shState->ensureTexSize(src.w, src.h, texSize);
 					shState->bindTex();
-					GLMeta::subRectImageUpload(tsSurf->w, blitOp.src.x, blitOp.src.y,
-					                           0, 0, tsLaneW, blitOp.h, tsSurf, GL_RGBA);
+					GLMeta::subRectImageUpload(tsSurf->w, src.x, src.y,
+					                           0, 0, src.w, src.h, tsSurf, GL_RGBA);
 
 					shader.setTexSize(texSize);
-					quad.setTexRect(FloatRect(0, 0, tsLaneW, blitOp.h));
-					quad.setPosRect(FloatRect(blitOp.dst.x, blitOp.dst.y, tsLaneW, blitOp.h));
+					quad.setTexRect(FloatRect(0, 0, src.w, src.h));
+					quad.setPosRect(FloatRect(dstPos[i].x, dstPos[i].y, src.w, src.h));
 
 					quad.draw();
 				}
@@ -630,12 +733,12 @@ struct TilemapPrivate
 				/* Clean implementation */
 				TEX::bind(atlas.gl.tex);
 
-				for (size_t i = 0; i < blits.size(); ++i)
+				for (size_t i = 0; i < srcRects.size(); ++i)
 				{
-					const TileAtlas::Blit &blitOp = blits[i];
+					const IntRect &src = srcRects[i];
 
-					GLMeta::subRectImageUpload(tsSurf->w, blitOp.src.x, blitOp.src.y,
-					                           blitOp.dst.x, blitOp.dst.y, tsLaneW, blitOp.h, tsSurf, GL_RGBA);
+					GLMeta::subRectImageUpload(tsSurf->w, src.x, src.y,
+					                           dstPos[i].x, dstPos[i].y, src.w, src.h, tsSurf, GL_RGBA);
 				}
 
 				GLMeta::subRectImageEnd();
@@ -652,13 +755,8 @@ struct TilemapPrivate
 			GLMeta::blitBegin(atlas.gl);
 			GLMeta::blitSource(tileset->getGLTypes());
 
-			for (size_t i = 0; i < blits.size(); ++i)
-			{
-				const TileAtlas::Blit &blitOp = blits[i];
-
-				GLMeta::blitRectangle(IntRect(blitOp.src.x, blitOp.src.y, tsLaneW, blitOp.h),
-				                      blitOp.dst);
-			}
+			for (size_t i = 0; i < srcRects.size(); ++i)
+				GLMeta::blitRectangle(srcRects[i], dstPos[i]);
 
 			GLMeta::blitEnd();
 		}
@@ -1007,6 +1105,10 @@ struct TilemapPrivate
 
 	void prepare()
 	{
+		/* Resources may be modified or disposed behind our
+		 * back, so this has to run every frame */
+		schedulePrepare();
+
 		if (!verifyResources())
 		{
 			if (tilemapReady)
@@ -1027,6 +1129,10 @@ struct TilemapPrivate
 			buildAtlas();
 			atlasDirty = false;
 		}
+		else if (atlasDamaged)
+		{
+			updateAtlas();
+		}
 
 		if (mapViewportDirty)
 		{
@@ -1098,7 +1204,7 @@ void GroundLayer::draw()
 
 void GroundLayer::drawInt()
 {
-	gl.DrawElements(GL_TRIANGLES, vboCount, _GL_INDEX_TYPE, (GLvoid*) 0);
+	drawElements(vboCount, _GL_INDEX_TYPE, (GLvoid*) 0);
 }
 
 void GroundLayer::onGeometryChange(const Scene::Geometry &geo)
@@ -1150,7 +1256,7 @@ void ZLayer::draw()
 
 void ZLayer::drawInt()
 {
-	gl.DrawElements(GL_TRIANGLES, vboBatchCount, _GL_INDEX_TYPE, (GLvoid*) vboOffset);
+	drawElements(vboBatchCount, _GL_INDEX_TYPE, (GLvoid*) vboOffset);
 }
 
 int ZLayer::calculateZ(TilemapPrivate *p, int index)
@@ -1189,8 +1295,8 @@ void Tilemap::Autotiles::set(int i, Bitmap *bitmap)
 	p->invalidateAtlasContents();
 
 	p->autotilesCon[i].disconnect();
-	p->autotilesCon[i] = bitmap->modified.connect
-	        (&TilemapPrivate::invalidateAtlasContents, p);
+	p->autotilesCon[i] = bitmap->modifiedArea.connect
+	        ([p = p, i](const IntRect &area) { p->invalidateAutotileArea(i, area); });
 
 	p->autotilesDispCon[i].disconnect();
 	p->autotilesDispCon[i] = bitmap->wasDisposed.connect
@@ -1274,8 +1380,8 @@ void Tilemap::setTileset(Bitmap *value)
 
 	p->invalidateAtlasSize();
 	p->tilesetCon.disconnect();
-	p->tilesetCon = value->modified.connect
-	        (&TilemapPrivate::invalidateAtlasSize, p);
+	p->tilesetCon = value->modifiedArea.connect
+	        (&TilemapPrivate::invalidateTilesetArea, p);
 
 	p->updateAtlasInfo();
 }
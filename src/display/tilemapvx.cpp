@@ -34,6 +34,7 @@
 #include "quadarray.h"
 #include "shader.h"
 #include "tilemap-common.h"
+#include "preparequeue.h"
 
 #include <vector>
 #include "sigslot/signal.hpp"
@@ -51,7 +52,7 @@ static const uint8_t flashAlpha[] =
 
 static elementsN(flashAlpha);
 
-struct TilemapVXPrivate : public ViewportElement, TileAtlasVX::Reader
+struct TilemapVXPrivate : public ViewportElement, TileAtlasVX::Reader, Preparable
 {
 	Bitmap *bitmaps[BM_COUNT];
 
@@ -86,13 +87,17 @@ struct TilemapVXPrivate : public ViewportElement, TileAtlasVX::Reader
 	uint8_t flashAlphaIdx;
 
 	bool atlasDirty;
+	bool atlasDamaged;
 	bool buffersDirty;
 	bool mapViewportDirty;
 
+	/* Parts of each bitmap drawn to since the
+	 * atlas was last built, in their own coordinates */
+	IntRect bmDamage[BM_COUNT];
+
 	sigslot::connection mapDataCon;
 	sigslot::connection flagsCon;
 
-	sigslot::connection prepareCon;
 	sigslot::connection bmChangedCons[BM_COUNT];
 	sigslot::connection bmDisposedCons[BM_COUNT];
 
@@ -126,6 +131,7 @@ struct TilemapVXPrivate : public ViewportElement, TileAtlasVX::Reader
 	      frameIdx(0),
 	      flashAlphaIdx(0),
 	      atlasDirty(true),
+	      atlasDamaged(false),
 	      buffersDirty(false),
 	      mapViewportDirty(false),
 	      above(this, viewport)
@@ -151,8 +157,7 @@ struct TilemapVXPrivate : public ViewportElement, TileAtlasVX::Reader
 
 		onGeometryChange(scene->getGeometry());
 
-		prepareCon = shState->prepareDraw.connect
-			(&TilemapVXPrivate::prepare, this);
+		schedulePrepare();
 	}
 
 	virtual ~TilemapVXPrivate()
@@ -165,8 +170,6 @@ struct TilemapVXPrivate : public ViewportElement, TileAtlasVX::Reader
 			shState->releaseAtlasTex(atlasHires);
 		}
 
-		prepareCon.disconnect();
-
 		mapDataCon.disconnect();
 		flagsCon.disconnect();
 
@@ -182,6 +185,12 @@ struct TilemapVXPrivate : public ViewportElement, TileAtlasVX::Reader
 		atlasDirty = true;
 	}
 
+	void invalidateAtlasArea(int bmIndex, const IntRect &area)
+	{
+		SDL_UnionRect(&bmDamage[bmIndex], &area, &bmDamage[bmIndex]);
+		atlasDamaged = true;
+	}
+
 	void invalidateBuffers()
 	{
 		buffersDirty = true;
@@ -190,6 +199,26 @@ struct TilemapVXPrivate : public ViewportElement, TileAtlasVX::Reader
 	void rebuildAtlas()
 	{
 		TileAtlasVX::build(atlas, bitmaps);
+		clearAtlasDamage();
+	}
+
+	/* Re-blits only what was drawn to the bitmaps
+	 * since the atlas was last built */
+	void updateAtlas()
+	{
+		for (int i = 0; i < BM_COUNT; ++i)
+			if (!SDL_RectEmpty(&bmDamage[i]))
+				TileAtlasVX::update(atlas, bitmaps[i], i, bmDamage[i]);
+
+		clearAtlasDamage();
+	}
+
+	void clearAtlasDamage()
+	{
+		for (int i = 0; i < BM_COUNT; ++i)
+			bmDamage[i] = IntRect();
+
+		atlasDamaged = false;
 	}
 
 	void updateMapViewport()
@@ -257,6 +286,10 @@ struct TilemapVXPrivate : public ViewportElement, TileAtlasVX::Reader
 
 	void prepare()
 	{
+		/* Flash data and resources may change behind
+		 * our back, so this has to run every frame */
+		schedulePrepare();
+
 		if (!mapData)
 			return;
 
@@ -265,6 +298,10 @@ struct TilemapVXPrivate : public ViewportElement, TileAtlasVX::Reader
 			rebuildAtlas();
 			atlasDirty = false;
 		}
+		else if (atlasDamaged)
+		{
+			updateAtlas();
+		}
 
 		if (mapViewportDirty)
 		{
@@ -331,7 +368,7 @@ struct TilemapVXPrivate : public ViewportElement, TileAtlasVX::Reader
 		}
 		GLMeta::vaoBind(vao);
 
-		gl.DrawElements(GL_TRIANGLES, groundQuads*6, _GL_INDEX_TYPE, 0);
+		drawElements(groundQuads*6, _GL_INDEX_TYPE, 0);
 
 		GLMeta::vaoUnbind(vao);
 	}
@@ -355,8 +392,8 @@ struct TilemapVXPrivate : public ViewportElement, TileAtlasVX::Reader
 		}
 		GLMeta::vaoBind(vao);
 
-		gl.DrawElements(GL_TRIANGLES, aboveQuads*6, _GL_INDEX_TYPE,
-		                (GLvoid*) (groundQuads*6*sizeof(index_t)));
+		drawElements(aboveQuads*6, _GL_INDEX_TYPE,
+		             (GLvoid*) (groundQuads*6*sizeof(index_t)));
 
 		GLMeta::vaoUnbind(vao);
 	}
@@ -405,8 +442,8 @@ void TilemapVX::BitmapArray::set(int i, Bitmap *bitmap)
 	p->atlasDirty = true;
 
 	p->bmChangedCons[i].disconnect();
-	p->bmChangedCons[i] = bitmap->modified.connect
-        (&TilemapVXPrivate::invalidateAtlas, p);
+	p->bmChangedCons[i] = bitmap->modifiedArea.connect
+        ([p = p, i](const IntRect &area) { p->invalidateAtlasArea(i, area); });
 
 	p->bmDisposedCons[i].disconnect();
 	p->bmDisposedCons[i] = bitmap->wasDisposed.connect
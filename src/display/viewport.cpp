@@ -22,11 +22,15 @@
 #include "viewport.h"
 
 #include "sharedstate.h"
+#include "bitmap.h"
 #include "etc.h"
 #include "util.h"
 #include "quad.h"
 #include "glstate.h"
 #include "graphics.h"
+#include "shader.h"
+#include "texpool.h"
+#include "config.h"
 
 #include <SDL_rect.h>
 
@@ -46,6 +50,14 @@ struct ViewportPrivate
 	IntRect screenRect;
 	int isOnScreen;
 
+	/* Composited elements kept around between frames */
+	bool cache;
+	TEXFBO cacheTex;
+	Quad cacheQuad;
+	/* First element that isn't part of cacheTex */
+	IntruListLink<SceneElement> *cacheEnd;
+	bool cacheDirty;
+
 	EtcTemps tmp;
 
 	ViewportPrivate(int x, int y, int width, int height, Viewport *self)
@@ -53,7 +65,10 @@ struct ViewportPrivate
 	      rect(&tmp.rect),
 	      color(&tmp.color),
 	      tone(&tmp.tone),
-	      isOnScreen(false)
+	      isOnScreen(false),
+	      cache(false),
+	      cacheEnd(0),
+	      cacheDirty(true)
 	{
 		rect->set(x, y, width, height);
 		updateRectCon();
@@ -62,6 +77,7 @@ struct ViewportPrivate
 	~ViewportPrivate()
 	{
 		rectCon.disconnect();
+		releaseCache();
 	}
 
 	void onRectChange()
@@ -69,6 +85,7 @@ struct ViewportPrivate
 		self->geometry.rect = rect->toIntRect();
 		self->notifyGeometryChange();
 		recomputeOnScreen();
+		cacheDirty = true;
 	}
 
 	void updateRectCon()
@@ -97,6 +114,33 @@ struct ViewportPrivate
 
 		return (rectEffective && colorToneEffective && isOnScreen);
 	}
+
+	void releaseCache()
+	{
+		if (cacheTex.tex == TEX::ID(0) || shState == nullptr)
+			return;
+
+		shState->texPool().release(cacheTex);
+		TEXFBO::clear(cacheTex);
+		cacheDirty = true;
+	}
+
+	void drawCache()
+	{
+		SimpleShader &shader = shState->shaders().simple;
+		shader.bind();
+		shader.applyViewportProj();
+		shader.setTranslation(Vec2i());
+		shader.setTexSize(Vec2i(cacheTex.width, cacheTex.height));
+
+		TEX::bind(cacheTex.tex);
+
+		/* The cache holds the elements blended onto transparent
+		 * black, ie. with their alpha multiplied in already */
+		glState.blendMode.pushSet(BlendPremultiplied);
+		cacheQuad.draw();
+		glState.blendMode.pop();
+	}
 };
 
 Viewport::Viewport(int x, int y, int width, int height)
@@ -151,6 +195,8 @@ DEF_ATTR_SIMPLE(Viewport, Rect,  Rect&,  *p->rect)
 DEF_ATTR_SIMPLE(Viewport, Color, Color&, *p->color)
 DEF_ATTR_SIMPLE(Viewport, Tone,  Tone&,  *p->tone)
 
+DEF_ATTR_RD_SIMPLE(Viewport, Cache, bool, p->cache)
+
 void Viewport::setOX(int value)
 {
 	guardDisposed();
@@ -160,6 +206,7 @@ void Viewport::setOX(int value)
 
 	geometry.orig.x = value;
 	notifyGeometryChange();
+	invalidateCache();
 }
 
 void Viewport::setOY(int value)
@@ -171,6 +218,20 @@ void Viewport::setOY(int value)
 
 	geometry.orig.y = value;
 	notifyGeometryChange();
+	invalidateCache();
+}
+
+void Viewport::setCache(bool value)
+{
+	guardDisposed();
+
+	if (p->cache == value)
+		return;
+
+	p->cache = value;
+
+	if (!value)
+		p->releaseCache();
 }
 
 void Viewport::initDynAttribs()
@@ -197,7 +258,12 @@ void Viewport::composite()
 	glState.scissorTest.pushSet(true);
 	glState.scissorBox.pushSet(p->rect->toIntRect());
 
-	Scene::composite();
+	/* Rendering to a texture of screen size
+	 * doesn't mix with high-res scaling */
+	if (p->cache && !shState->config().enableHires)
+		compositeCached();
+	else
+		Scene::composite();
 
 	/* If any effects are visible, request parent Scene to
 	 * render them. */
@@ -209,6 +275,79 @@ void Viewport::composite()
 	glState.scissorTest.pop();
 }
 
+void Viewport::compositeCached()
+{
+	/* Everything below the first visible element that can't
+	 * be cached is rendered into cacheTex whenever any of it
+	 * changes, the rest is drawn on top as usual */
+	IntruListLink<SceneElement> *end;
+
+	for (end = elements.begin(); end != elements.end(); end = end->next)
+	{
+		SceneElement *e = end->data;
+
+		if (e->visible && !e->isCacheable())
+			break;
+	}
+
+	if (end == elements.begin())
+	{
+		Scene::composite();
+		return;
+	}
+
+	if (end != p->cacheEnd)
+	{
+		p->cacheEnd = end;
+		p->cacheDirty = true;
+	}
+
+	/* We're drawing into whatever the parent scene bound,
+	 * at the same size, so the elements' coordinates and
+	 * scissor boxes carry over unchanged */
+	const IntRect &vp = glState.viewport.get();
+
+	if (p->cacheTex.width != vp.w || p->cacheTex.height != vp.h)
+		p->cacheDirty = true;
+
+	if (p->cacheDirty)
+	{
+		FBO::ID target = FBO::boundFramebufferID;
+
+		if (p->cacheTex.width != vp.w || p->cacheTex.height != vp.h)
+		{
+			p->releaseCache();
+			p->cacheTex = shState->texPool().request(vp.w, vp.h);
+		}
+
+		FBO::bind(p->cacheTex.fbo);
+
+		glState.clearColor.pushSet(Vec4());
+		FBO::clear();
+		glState.clearColor.pop();
+
+		compositeElements(elements.begin(), end);
+
+		FBO::bind(target);
+
+		FloatRect rect(p->rect->toIntRect());
+		p->cacheQuad.setTexPosRect(rect, rect);
+
+		p->cacheDirty = false;
+	}
+
+	p->drawCache();
+
+	compositeElements(end, elements.end());
+}
+
+void Viewport::invalidateCache()
+{
+	/* Children may still outlive a disposed viewport */
+	if (p)
+		p->cacheDirty = true;
+}
+
 /* SceneElement */
 void Viewport::draw()
 {
@@ -219,6 +358,14 @@ void Viewport::onGeometryChange(const Geometry &geo)
 {
 	p->screenRect = geo.rect;
 	p->recomputeOnScreen();
+	p->cacheDirty = true;
+}
+
+bool Viewport::getBounds(IntRect &bounds)
+{
+	/* Children are scissored to our rect */
+	bounds = geometry.rect;
+	return true;
 }
 
 void Viewport::releaseResources()
@@ -226,6 +373,7 @@ void Viewport::releaseResources()
 	unlink();
 
 	delete p;
+	p = 0;
 }
 
 
@@ -246,3 +394,22 @@ void ViewportElement::setViewport(Viewport *viewport)
 	onViewportChange();
 	onGeometryChange(scene->getGeometry());
 }
+
+void BitmapWatch::set(Bitmap *bitmap, SceneElement *element)
+{
+	disconnect();
+
+	if (nullOrDisposed(bitmap))
+		return;
+
+	modifiedCon = bitmap->modified.connect
+	        (&SceneElement::notifyChanged, element);
+	disposedCon = bitmap->wasDisposed.connect
+	        (&SceneElement::notifyChanged, element);
+}
+
+void BitmapWatch::disconnect()
+{
+	modifiedCon.disconnect();
+	disposedCon.disconnect();
+}
@@ -27,6 +27,9 @@
 #include "disposable.h"
 #include "util.h"
 
+#include "sigslot/signal.hpp"
+
+class Bitmap;
 struct ViewportPrivate;
 
 class Viewport : public Scene, public SceneElement, public Flashable, public Disposable
@@ -44,6 +47,7 @@ public:
 	DECL_ATTR( OY,    int    )
 	DECL_ATTR( Color, Color& )
 	DECL_ATTR( Tone,  Tone&  )
+	DECL_ATTR( Cache, bool   )
 
 	void initDynAttribs();
 
@@ -52,8 +56,11 @@ private:
 	void geometryChanged();
 
 	void composite();
+	void compositeCached();
+	void invalidateCache();
 	void draw();
 	void onGeometryChange(const Geometry &);
+	bool getBounds(IntRect &bounds);
 	bool isEffectiveViewport(Rect *&, Color *&, Tone *&) const;
 
 	void releaseResources();
@@ -81,4 +88,17 @@ private:
 	Viewport *m_viewport;
 };
 
+/* Marks an element's viewport cache stale whenever
+ * a bitmap it draws is modified or disposed */
+class BitmapWatch
+{
+public:
+	void set(Bitmap *bitmap, SceneElement *element);
+	void disconnect();
+
+private:
+	sigslot::connection modifiedCon;
+	sigslot::connection disposedCon;
+};
+
 #endif // VIEWPORT_H
@@ -31,6 +31,7 @@
 #include "gl-util.h"
 #include "quad.h"
 #include "quadarray.h"
+#include "preparequeue.h"
 #include "texpool.h"
 #include "glstate.h"
 
@@ -166,7 +167,7 @@ struct QuadChunk
  *   quad array directly to the screen.
  */
 
-struct WindowPrivate
+struct WindowPrivate : public Preparable
 {
 	Bitmap *windowskin;
 
@@ -179,6 +180,11 @@ struct WindowPrivate
 
 	sigslot::connection cursorRectCon;
 
+	/* Mark the viewport cache stale on change */
+	BitmapWatch windowskinWatch;
+	BitmapWatch contentsWatch;
+	sigslot::connection cursorRectCacheCon;
+
 	Vec2i sceneOffset;
 
 	Vec2i position;
@@ -220,6 +226,21 @@ struct WindowPrivate
 			p->drawControls();
 		}
 
+		bool getBounds(IntRect &bounds)
+		{
+			bounds = IntRect(p->position + p->sceneOffset, p->size);
+			return true;
+		}
+
+		bool isCacheable() const
+		{
+			/* Blinking cursor / animated pause sign */
+			if (p->active && !p->cursorRect->isEmpty())
+				return false;
+
+			return !p->pause;
+		}
+
 		void release()
 		{
 			unlink();
@@ -246,8 +267,6 @@ struct WindowPrivate
 
 	EtcTemps tmp;
 
-	sigslot::connection prepareCon;
-
 	WindowPrivate(Viewport *viewport = 0)
 	    : windowskin(0),
 	      contents(0),
@@ -273,8 +292,7 @@ struct WindowPrivate
 		cursorVert.count = 9;
 		pauseAniVert.count = 1;
 
-		prepareCon = shState->prepareDraw.connect
-		        (&WindowPrivate::prepare, this);
+		schedulePrepare();
 	}
 
 	~WindowPrivate()
@@ -282,7 +300,9 @@ struct WindowPrivate
         if (shState != nullptr)
             shState->texPool().release(baseTex);
         cursorRectCon.disconnect();
-        prepareCon.disconnect();
+        cursorRectCacheCon.disconnect();
+        windowskinWatch.disconnect();
+        contentsWatch.disconnect();
     }
 
 	void markControlVertDirty()
@@ -295,6 +315,10 @@ struct WindowPrivate
 		cursorRectCon.disconnect();
 		cursorRectCon = cursorRect->valueChanged.connect
 		        (&WindowPrivate::markControlVertDirty, this);
+
+		cursorRectCacheCon.disconnect();
+		cursorRectCacheCon = cursorRect->valueChanged.connect
+		        (&SceneElement::notifyChanged, &controlsElement);
 	}
 
 	void buildBaseVert()
@@ -698,8 +722,9 @@ void Window::update()
 	p->stepAnimations();
 }
 
-DEF_ATTR_SIMPLE(Window, X,          int,     p->position.x)
-DEF_ATTR_SIMPLE(Window, Y,          int,     p->position.y)
+DEF_ATTR_SIMPLE_NOTIFY(Window, X,   int,     p->position.x)
+DEF_ATTR_SIMPLE_NOTIFY(Window, Y,   int,     p->position.y)
+
 DEF_ATTR_SIMPLE(Window, CursorRect, Rect&,  *p->cursorRect)
 
 DEF_ATTR_RD_SIMPLE(Window, Windowskin,      Bitmap*, p->windowskin)
@@ -720,6 +745,8 @@ void Window::setWindowskin(Bitmap *value)
 	guardDisposed();
 
 	p->windowskin = value;
+	p->windowskinWatch.set(value, this);
+	notifyChanged();
 
 	if (nullOrDisposed(value))
 		return;
@@ -736,6 +763,8 @@ void Window::setContents(Bitmap *value)
 
 	p->contents = value;
 	p->controlsVertDirty = true;
+	p->contentsWatch.set(value, this);
+	notifyChanged();
 
 	if (nullOrDisposed(value))
 		return;
@@ -753,6 +782,8 @@ void Window::setStretch(bool value)
 
 	p->bgStretch = value;
 	p->baseVertDirty = true;
+	p->schedulePrepare();
+	notifyChanged();
 }
 
 void Window::setActive(bool value)
@@ -764,6 +795,7 @@ void Window::setActive(bool value)
 
 	p->active = value;
 	p->cursorAniAlphaIdx = 0;
+	notifyChanged();
 }
 
 void Window::setPause(bool value)
@@ -777,6 +809,7 @@ void Window::setPause(bool value)
 	p->pauseAniAlphaIdx = 0;
 	p->pauseAniQuadIdx = 0;
 	p->controlsVertDirty = true;
+	notifyChanged();
 }
 
 void Window::setWidth(int value)
@@ -788,6 +821,8 @@ void Window::setWidth(int value)
 
 	p->size.x = value;
 	p->baseVertDirty = true;
+	p->schedulePrepare();
+	notifyChanged();
 }
 
 void Window::setHeight(int value)
@@ -799,6 +834,8 @@ void Window::setHeight(int value)
 
 	p->size.y = value;
 	p->baseVertDirty = true;
+	p->schedulePrepare();
+	notifyChanged();
 }
 
 void Window::setOX(int value)
@@ -810,6 +847,7 @@ void Window::setOX(int value)
 
 	p->contentsOffset.x = value;
 	p->controlsVertDirty = true;
+	notifyChanged();
 }
 
 void Window::setOY(int value)
@@ -821,6 +859,7 @@ void Window::setOY(int value)
 
 	p->contentsOffset.y = value;
 	p->controlsVertDirty = true;
+	notifyChanged();
 }
 
 void Window::setOpacity(int value)
@@ -832,6 +871,8 @@ void Window::setOpacity(int value)
 
 	p->opacity = value;
 	p->opacityDirty = true;
+	p->schedulePrepare();
+	notifyChanged();
 }
 
 void Window::setBackOpacity(int value)
@@ -843,6 +884,8 @@ void Window::setBackOpacity(int value)
 
 	p->backOpacity = value;
 	p->opacityDirty = true;
+	p->schedulePrepare();
+	notifyChanged();
 }
 
 void Window::setContentsOpacity(int value)
@@ -854,6 +897,7 @@ void Window::setContentsOpacity(int value)
 
 	p->contentsOpacity = value;
 	p->contentsQuad.setColor(Vec4(1, 1, 1, p->contentsOpacity.norm));
+	notifyChanged();
 }
 
 void Window::initDynAttribs()
@@ -873,6 +917,12 @@ void Window::onGeometryChange(const Scene::Geometry &geo)
 	p->sceneOffset = geo.offset();
 }
 
+bool Window::getBounds(IntRect &bounds)
+{
+	bounds = IntRect(p->position + p->sceneOffset, p->size);
+	return true;
+}
+
 void Window::setZ(int value)
 {
 	ViewportElement::setZ(value);
@@ -63,6 +63,8 @@ private:
 
 	void draw();
 	void onGeometryChange(const Scene::Geometry &);
+	bool getBounds(IntRect &bounds);
+	bool isCacheable() const { return true; }
 	void setZ(int value);
 	void setVisible(bool value);
 
@@ -26,6 +26,7 @@
 #include "etc-internal.h"
 #include "quad.h"
 #include "quadarray.h"
+#include "preparequeue.h"
 #include "sharedstate.h"
 #include "texpool.h"
 #include "tilequad.h"
@@ -148,7 +149,7 @@ static const uint8_t pauseQuad[] =
 
 static elementsN(pauseQuad);
 
-struct WindowVXPrivate
+struct WindowVXPrivate : public Preparable
 {
 	Bitmap *windowskin;
 
@@ -181,7 +182,12 @@ struct WindowVXPrivate
 
 	sigslot::connection cursorRectCon;
 	sigslot::connection toneCon;
-	sigslot::connection prepareCon;
+
+	/* Mark the viewport cache stale on change */
+	BitmapWatch windowskinWatch;
+	BitmapWatch contentsWatch;
+	sigslot::connection cursorRectCacheCon;
+	sigslot::connection toneCacheCon;
 
 	EtcTemps tmp;
 
@@ -261,11 +267,9 @@ struct WindowVXPrivate
 			base.texSizeDirty = true;
 			clipRectDirty = true;
 			ctrlVertDirty = true;
+			schedulePrepare();
 		}
 
-		prepareCon = shState->prepareDraw.connect
-			(&WindowVXPrivate::prepare, this);
-
 		refreshCursorRectCon();
 		refreshToneCon();
 		updateBaseQuad();
@@ -278,17 +282,23 @@ struct WindowVXPrivate
 
         cursorRectCon.disconnect();
         toneCon.disconnect();
-        prepareCon.disconnect();
+
+        windowskinWatch.disconnect();
+        contentsWatch.disconnect();
+        cursorRectCacheCon.disconnect();
+        toneCacheCon.disconnect();
     }
 
 	void invalidateCursorVert()
 	{
 		cursorVertDirty = true;
+		schedulePrepare();
 	}
 
 	void invalidateBaseTex()
 	{
 		base.texDirty = true;
+		schedulePrepare();
 	}
 
 	void refreshCursorRectCon()
@@ -305,6 +315,17 @@ struct WindowVXPrivate
 			(&WindowVXPrivate::invalidateBaseTex, this);
 	}
 
+	void updateCacheCons(SceneElement *self)
+	{
+		cursorRectCacheCon.disconnect();
+		toneCacheCon.disconnect();
+
+		cursorRectCacheCon = cursorRect->valueChanged.connect
+		        (&SceneElement::notifyChanged, self);
+		toneCacheCon = tone->valueChanged.connect
+		        (&SceneElement::notifyChanged, self);
+	}
+
 	void updateBaseTexSize()
 	{
 		if (base.tex.width >= geo.w && base.tex.height >= geo.h)
@@ -637,6 +658,7 @@ struct WindowVXPrivate
 		Quad::setColor(pauseVert, Vec4(1, 1, 1, pauseAlpha[pauseAlphaIdx] / 255.0f));
 
 		ctrlVertArrayDirty = true;
+		schedulePrepare();
 	}
 
 	void updateCursorAlpha()
@@ -650,6 +672,7 @@ struct WindowVXPrivate
 			Quad::setColor(&cursorVert.vertices[i*4], color);
 
 		cursorVertArrayDirty = true;
+		schedulePrepare();
 	}
 
 	void stepAnimations()
@@ -819,6 +842,7 @@ WindowVX::WindowVX(Viewport *viewport)
     : ViewportElement(viewport, DEF_Z, DEF_SPRITE_Y)
 {
 	p = new WindowVXPrivate(0, 0, 0, 0);
+	p->updateCacheCons(this);
 	onGeometryChange(scene->getGeometry());
 }
 
@@ -826,6 +850,7 @@ WindowVX::WindowVX(int x, int y, int width, int height)
     : ViewportElement(0, DEF_Z, DEF_SPRITE_Y)
 {
 	p = new WindowVXPrivate(x, y, width, height);
+	p->updateCacheCons(this);
 	onGeometryChange(scene->getGeometry());
 }
 
@@ -859,10 +884,12 @@ void WindowVX::move(int x, int y, int width, int height)
 		p->base.texSizeDirty = true;
 		p->clipRectDirty = true;
 		p->ctrlVertDirty = true;
+		p->schedulePrepare();
 	}
 
 	p->geo = IntRect(Vec2i(x, y), size);
 	p->updateBaseQuad();
+	notifyChanged();
 }
 
 bool WindowVX::isOpen() const
@@ -879,8 +906,9 @@ bool WindowVX::isClosed() const
 	return p->openness == 0;
 }
 
-DEF_ATTR_SIMPLE(WindowVX, X,          int,     p->geo.x)
-DEF_ATTR_SIMPLE(WindowVX, Y,          int,     p->geo.y)
+DEF_ATTR_SIMPLE_NOTIFY(WindowVX, X, int,     p->geo.x)
+DEF_ATTR_SIMPLE_NOTIFY(WindowVX, Y, int,     p->geo.y)
+
 DEF_ATTR_SIMPLE(WindowVX, CursorRect, Rect&,  *p->cursorRect)
 DEF_ATTR_SIMPLE(WindowVX, Tone,       Tone&,  *p->tone)
 
@@ -909,6 +937,9 @@ void WindowVX::setWindowskin(Bitmap *value)
 
 	p->windowskin = value;
 	p->base.texDirty = true;
+	p->schedulePrepare();
+	p->windowskinWatch.set(value, this);
+	notifyChanged();
 }
 
 void WindowVX::setContents(Bitmap *value)
@@ -919,6 +950,8 @@ void WindowVX::setContents(Bitmap *value)
 		return;
 
 	p->contents = value;
+	p->contentsWatch.set(value, this);
+	notifyChanged();
 
 	if (nullOrDisposed(value))
 		return;
@@ -926,6 +959,7 @@ void WindowVX::setContents(Bitmap *value)
 	FloatRect rect = p->contents->rect();
 	p->contentsQuad.setTexPosRect(rect, rect);
 	p->ctrlVertDirty = true;
+	p->schedulePrepare();
 }
 
 void WindowVX::setActive(bool value)
@@ -938,6 +972,7 @@ void WindowVX::setActive(bool value)
 	p->active = value;
 	p->cursorAlphaIdx = cursorAlphaResetIdx;
 	p->updateCursorAlpha();
+	notifyChanged();
 }
 
 void WindowVX::setArrowsVisible(bool value)
@@ -949,6 +984,8 @@ void WindowVX::setArrowsVisible(bool value)
 
 	p->arrowsVisible = value;
 	p->ctrlVertDirty = true;
+	p->schedulePrepare();
+	notifyChanged();
 }
 
 void WindowVX::setPause(bool value)
@@ -962,6 +999,8 @@ void WindowVX::setPause(bool value)
 	p->pauseAlphaIdx = 0;
 	p->pauseQuadIdx = 0;
 	p->ctrlVertDirty = true;
+	p->schedulePrepare();
+	notifyChanged();
 }
 
 void WindowVX::setWidth(int value)
@@ -977,7 +1016,9 @@ void WindowVX::setWidth(int value)
 	p->base.texSizeDirty = true;
 	p->clipRectDirty = true;
 	p->ctrlVertDirty = true;
+	p->schedulePrepare();
 	p->updateBaseQuad();
+	notifyChanged();
 }
 
 void WindowVX::setHeight(int value)
@@ -993,7 +1034,9 @@ void WindowVX::setHeight(int value)
 	p->base.texSizeDirty = true;
 	p->clipRectDirty = true;
 	p->ctrlVertDirty = true;
+	p->schedulePrepare();
 	p->updateBaseQuad();
+	notifyChanged();
 }
 
 void WindowVX::setOX(int value)
@@ -1005,6 +1048,8 @@ void WindowVX::setOX(int value)
 
 	p->contentsOff.x = value;
 	p->ctrlVertDirty = true;
+	p->schedulePrepare();
+	notifyChanged();
 }
 
 void WindowVX::setOY(int value)
@@ -1016,6 +1061,8 @@ void WindowVX::setOY(int value)
 
 	p->contentsOff.y = value;
 	p->ctrlVertDirty = true;
+	p->schedulePrepare();
+	notifyChanged();
 }
 
 void WindowVX::setPadding(int value)
@@ -1028,6 +1075,8 @@ void WindowVX::setPadding(int value)
 	p->padding = value;
 	p->paddingBottom = value;
 	p->clipRectDirty = true;
+	p->schedulePrepare();
+	notifyChanged();
 }
 
 void WindowVX::setPaddingBottom(int value)
@@ -1039,6 +1088,8 @@ void WindowVX::setPaddingBottom(int value)
 
 	p->paddingBottom = value;
 	p->clipRectDirty = true;
+	p->schedulePrepare();
+	notifyChanged();
 }
 
 void WindowVX::setOpacity(int value)
@@ -1050,6 +1101,7 @@ void WindowVX::setOpacity(int value)
 
 	p->opacity = value;
 	p->base.quad.setColor(Vec4(1, 1, 1, p->opacity.norm));
+	notifyChanged();
 }
 
 void WindowVX::setBackOpacity(int value)
@@ -1061,6 +1113,8 @@ void WindowVX::setBackOpacity(int value)
 
 	p->backOpacity = value;
 	p->base.texDirty = true;
+	p->schedulePrepare();
+	notifyChanged();
 }
 
 void WindowVX::setContentsOpacity(int value)
@@ -1072,6 +1126,7 @@ void WindowVX::setContentsOpacity(int value)
 
 	p->contentsOpacity = value;
 	p->contentsQuad.setColor(Vec4(1, 1, 1, p->contentsOpacity.norm));
+	notifyChanged();
 }
 
 void WindowVX::setOpenness(int value)
@@ -1083,6 +1138,7 @@ void WindowVX::setOpenness(int value)
 
 	p->openness = value;
 	p->updateBaseQuad();
+	notifyChanged();
 }
 
 void WindowVX::initDynAttribs()
@@ -1095,6 +1151,8 @@ void WindowVX::initDynAttribs()
 		p->tone = new Tone;
 		p->refreshToneCon();
 	}
+
+	p->updateCacheCons(this);
 }
 
 void WindowVX::draw()
@@ -1107,6 +1165,21 @@ void WindowVX::onGeometryChange(const Scene::Geometry &geo)
 	p->sceneOffset = geo.offset();
 }
 
+bool WindowVX::isCacheable() const
+{
+	/* Blinking cursor / animated pause sign */
+	if (p->active && !p->cursorRect->isEmpty())
+		return false;
+
+	return !p->pause;
+}
+
+bool WindowVX::getBounds(IntRect &bounds)
+{
+	bounds = IntRect(p->geo.pos() + p->sceneOffset, p->geo.size());
+	return true;
+}
+
 void WindowVX::releaseResources()
 {
 	unlink();
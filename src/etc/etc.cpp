@@ -60,6 +60,8 @@ const Color &Color::operator=(const Color &o)
 	alpha = o.alpha;
 	norm  = o.norm;
 
+	valueChanged();
+
 	return o;
 }
 
@@ -71,30 +73,35 @@ void Color::set(double red, double green, double blue, double alpha)
 	this->alpha = alpha;
 
 	updateInternal();
+	valueChanged();
 }
 
 void Color::setRed(double value)
 {
 	red = value;
 	norm.x = clamp<double>(value, 0, 255) / 255;
+	valueChanged();
 }
 
 void Color::setGreen(double value)
 {
 	green = value;
 	norm.y = clamp<double>(value, 0, 255) / 255;
+	valueChanged();
 }
 
 void Color::setBlue(double value)
 {
 	blue = value;
 	norm.z = clamp<double>(value, 0, 255) / 255;
+	valueChanged();
 }
 
 void Color::setAlpha(double value)
 {
 	alpha = value;
 	norm.w = clamp<double>(value, 0, 255) / 255;
+	valueChanged();
 }
 
 /* Serializable */
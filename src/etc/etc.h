@@ -32,6 +32,8 @@ struct SDL_Color;
 enum BlendType
 {
 	BlendKeepDestAlpha = -1,
+	/* For sources that have their alpha already multiplied in */
+	BlendPremultiplied = -2,
 
 	BlendNormal = 0,
 	BlendAddition = 1,
@@ -89,6 +91,8 @@ struct Color : public Serializable
 
 	/* Normalized (0.0 ~ 1.0) */
 	Vec4 norm;
+
+	sigslot::signal<> valueChanged;
 };
 
 struct Tone : public Serializable
@@ -35,6 +35,7 @@
 
 #include "sharedstate.h"
 #include "graphics.h"
+#include "gl-util.h"
 
 #ifndef MKXPZ_BUILD_XCODE
 #include "settingsmenu.h"
@@ -88,6 +89,30 @@ EventThread::ControllerState EventThread::controllerState;
 EventThread::MouseState EventThread::mouseState;
 EventThread::TouchState EventThread::touchState;
 SDL_atomic_t EventThread::verticalScrollDistance;
+SPSCRing<EventThread::InputEvent, 1024> EventThread::inputEvents;
+MPSCQueue<EventThread::Notification, 256> EventThread::notifications;
+
+/* Events are dropped if the RGSS thread stops reading them
+ * (eg. while a script hangs), the states above still apply */
+static void pushInputEvent(uint8_t type, int code, uint64_t ticks)
+{
+    EventThread::InputEvent ev = { type, code, ticks };
+    EventThread::inputEvents.push(ev);
+}
+
+/* Like input events, these are dropped if the RGSS thread stops
+ * reading them. Only text goes through here, anything stateful
+ * is posted as a message instead (eg. controllerMsg) */
+static void pushNotification(uint8_t type, const char *text = "")
+{
+    EventThread::Notification n;
+    n.type = type;
+    strncpy(n.text, text, sizeof(n.text) - 1);
+    n.text[sizeof(n.text) - 1] = '\0';
+    
+    if (!EventThread::notifications.push(n))
+        Debug() << "Notification queue full, dropping text input";
+}
 
 /* User event codes */
 enum
@@ -126,14 +151,10 @@ EventThread::EventThread()
 : ctrl(0),
 fullscreen(false),
 showCursor(true)
-{
-    textInputLock = SDL_CreateMutex();
-}
+{}
 
 EventThread::~EventThread()
-{
-    SDL_DestroyMutex(textInputLock);
-}
+{}
 
 void EventThread::process(RGSSThreadData &rtData)
 {
@@ -141,6 +162,7 @@ void EventThread::process(RGSSThreadData &rtData)
     SDL_Window *win = rtData.window;
     UnidirMessage<Vec2i> &windowSizeMsg = rtData.windowSizeMsg;
     UnidirMessage<Vec2i> &drawableSizeMsg = rtData.drawableSizeMsg;
+    UnidirMessage<SDL_GameController*> &controllerMsg = rtData.controllerMsg;
     
     initALCFunctions(rtData.alcDev);
     
@@ -177,6 +199,7 @@ void EventThread::process(RGSSThreadData &rtData)
     SDL_JoystickUpdate();
     if (SDL_NumJoysticks() > 0 && SDL_IsGameController(0)) {
             ctrl = SDL_GameControllerOpen(0);
+            controllerMsg.post(ctrl);
     }
     
     char buffer[128];
@@ -197,7 +220,7 @@ void EventThread::process(RGSSThreadData &rtData)
     // for some dumb reason
     SDL_StopTextInput();
     
-    textInputBuffer.clear();
+    pushNotification(Notification::TextClear);
 #ifndef MKXPZ_BUILD_XCODE
     SettingsMenu *sMenu = 0;
 #else
@@ -212,6 +235,8 @@ void EventThread::process(RGSSThreadData &rtData)
             Debug() << "EventThread: Event error";
             break;
         }
+        
+        const uint64_t eventTicks = SDL_GetPerformanceCounter();
 #ifndef MKXPZ_BUILD_XCODE
         if (sMenu && sMenu->onEvent(event))
         {
@@ -298,11 +323,7 @@ void EventThread::process(RGSSThreadData &rtData)
                 break;
                 
             case SDL_TEXTINPUT :
-                lockText(true);
-                if (textInputBuffer.size() < 512) {
-                    textInputBuffer += event.text.text;
-                }
-                lockText(false);
+                pushNotification(Notification::TextInput, event.text.text);
                 break;
                 
             case SDL_QUIT :
@@ -394,6 +415,9 @@ void EventThread::process(RGSSThreadData &rtData)
                 }
                 
                 keyStates[event.key.keysym.scancode] = true;
+                
+                if (!event.key.repeat)
+                    pushInputEvent(InputEvent::KeyDown, event.key.keysym.scancode, eventTicks);
                 break;
                 
             case SDL_KEYUP :
@@ -408,14 +432,17 @@ void EventThread::process(RGSSThreadData &rtData)
                 }
                 
                 keyStates[event.key.keysym.scancode] = false;
+                pushInputEvent(InputEvent::KeyUp, event.key.keysym.scancode, eventTicks);
                 break;
                 
             case SDL_CONTROLLERBUTTONDOWN:
                 controllerState.buttons[event.cbutton.button] = true;
+                pushInputEvent(InputEvent::ControllerDown, event.cbutton.button, eventTicks);
                 break;
                 
             case SDL_CONTROLLERBUTTONUP:
                 controllerState.buttons[event.cbutton.button] = false;
+                pushInputEvent(InputEvent::ControllerUp, event.cbutton.button, eventTicks);
                 break;
                 
             case SDL_CONTROLLERAXISMOTION:
@@ -427,19 +454,23 @@ void EventThread::process(RGSSThreadData &rtData)
                     break;
                 
                 ctrl = SDL_GameControllerOpen(0);
+                controllerMsg.post(ctrl);
                 break;
                 
             case SDL_CONTROLLERDEVICEREMOVED:
                 resetInputStates();
                 ctrl = 0;
+                controllerMsg.post(0);
                 break;
                 
             case SDL_MOUSEBUTTONDOWN :
                 mouseState.buttons[event.button.button] = true;
+                pushInputEvent(InputEvent::MouseDown, event.button.button, eventTicks);
                 break;
                 
             case SDL_MOUSEBUTTONUP :
                 mouseState.buttons[event.button.button] = false;
+                pushInputEvent(InputEvent::MouseUp, event.button.button, eventTicks);
                 break;
                 
             case SDL_MOUSEMOTION :
@@ -503,21 +534,25 @@ void EventThread::process(RGSSThreadData &rtData)
                         if (event.user.code)
                         {
                             SDL_StartTextInput();
-                            lockText(true);
-                            textInputBuffer.clear();
-                            lockText(false);
+                            pushNotification(Notification::TextClear);
                         }
                         else
                         {
                             SDL_StopTextInput();
-                            lockText(true);
-                            textInputBuffer.clear();
-                            lockText(false);
+                            pushNotification(Notification::TextClear);
                         }
                         break;
                         
                     case REQUEST_MESSAGEBOX :
                     {
+                        if (rtData.config.headless)
+                        {
+                            /* Nobody is there to click "OK" */
+                            Debug() << (const char*) event.user.data1;
+                            free(event.user.data1);
+                            msgBoxDone.set();
+                            break;
+                        }
 #ifndef __APPLE__
                         // Try to format the message with additional newlines
                         std::string message = copyWithNewlines((const char*) event.user.data1,
@@ -554,14 +589,34 @@ void EventThread::process(RGSSThreadData &rtData)
                         break;
                         
                     case UPDATE_FPS :
+                    {
+                        /* Optional GL call counts of the last frame */
+                        std::string glStats;
+                        
+                        if (event.user.data1)
+                        {
+                            glStats = (const char*) event.user.data1;
+                            free(event.user.data1);
+                        }
+                        
                         if (rtData.config.printFPS)
-                            Debug() << "FPS:" << event.user.code;
+                        {
+                            if (glStats.empty())
+                                Debug() << "FPS:" << event.user.code;
+                            else
+                                Debug() << "FPS:" << event.user.code << "-" << glStats;
+                        }
                         
                         if (!fps.sendUpdates)
                             break;
                         
-                        snprintf(buffer, sizeof(buffer), "%s - %d FPS",
-                                 rtData.config.windowTitle.c_str(), event.user.code);
+                        if (glStats.empty())
+                            snprintf(buffer, sizeof(buffer), "%s - %d FPS",
+                                     rtData.config.windowTitle.c_str(), event.user.code);
+                        else
+                            snprintf(buffer, sizeof(buffer), "%s - %d FPS - %s",
+                                     rtData.config.windowTitle.c_str(), event.user.code,
+                                     glStats.c_str());
                         
                         /* Updating the window title in fullscreen
                          * mode seems to cause flickering */
@@ -575,6 +630,7 @@ void EventThread::process(RGSSThreadData &rtData)
                         
                         SDL_SetWindowTitle(win, buffer);
                         break;
+                    }
                         
                     case UPDATE_SCREEN_RECT :
                         gameScreen.x = event.user.windowID;
@@ -800,16 +856,6 @@ bool EventThread::getShowCursor() const
     return showCursor;
 }
 
-bool EventThread::getControllerConnected() const
-{
-    return ctrl != 0;
-}
-
-SDL_GameController *EventThread::controller() const
-{
-    return ctrl;
-}
-
 void EventThread::notifyFrame()
 {
 #ifdef MKXPZ_BUILD_XCODE
@@ -825,6 +871,19 @@ void EventThread::notifyFrame()
 #else
     event.user.code = round(shState->graphics().averageFrameRate());
 #endif
+    event.user.data1 = 0;
+    
+    if (shState->config().displayGLStats)
+    {
+        GLCounters stats = shState->graphics().glStats();
+        char buffer[128];
+        
+        snprintf(buffer, sizeof(buffer), "%u draws, %u binds, %u uniforms, %u skipped",
+                 stats.drawCalls, stats.binds(), stats.uniformUploads, stats.skippedCalls);
+        
+        event.user.data1 = strdup(buffer);
+    }
+    
     event.user.type = usrIdStart + UPDATE_FPS;
     SDL_PushEvent(&event);
 }
@@ -842,11 +901,6 @@ void EventThread::notifyGameScreenChange(const SDL_Rect &screen)
     SDL_PushEvent(&event);
 }
 
-void EventThread::lockText(bool lock)
-{
-    lock ? SDL_LockMutex(textInputLock) : SDL_UnlockMutex(textInputLock);
-}
-
 void SyncPoint::haltThreads()
 {
     if (mainSync.locked)
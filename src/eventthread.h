@@ -72,14 +72,55 @@ public:
 		FingerState fingers[MAX_FINGERS];
 	};
 
+	/* Button transitions in the order they happened */
+	struct InputEvent
+	{
+		enum Type
+		{
+			KeyDown,
+			KeyUp,
+			ControllerDown,
+			ControllerUp,
+			MouseDown,
+			MouseUp
+		};
+
+		uint8_t type;
+
+		/* Scancode, controller or mouse button */
+		int code;
+
+		/* SDL_GetPerformanceCounter() at the
+		 * time the event was received */
+		uint64_t ticks;
+	};
+
+	/* Things the RGSS thread needs to know about that
+	 * aren't button presses (see Input::update) */
+	struct Notification
+	{
+		enum Type
+		{
+			TextInput,
+			TextClear
+		};
+
+		uint8_t type;
+
+		/* TextInput: null terminated UTF-8, the same
+		 * size as SDL_TextInputEvent::text */
+		char text[32];
+	};
+
 	static uint8_t keyStates[SDL_NUM_SCANCODES];
     static ControllerState controllerState;
 	static MouseState mouseState;
 	static TouchState touchState;
     static SDL_atomic_t verticalScrollDistance;
-    
-    std::string textInputBuffer;
-    void lockText(bool lock);
+    /* Read by the RGSS thread only (see Input::update) */
+    static SPSCRing<InputEvent, 1024> inputEvents;
+    /* Pushed to from EventThread::process only, read by RGSS */
+    static MPSCQueue<Notification, 256> notifications;
     
 
 	static bool allocUserEvents();
@@ -106,9 +147,6 @@ public:
 
 	bool getFullscreen() const;
 	bool getShowCursor() const;
-    bool getControllerConnected() const;
-    
-    SDL_GameController *controller() const;
 
 	void showMessageBox(const char *body, int flags = 0);
 
@@ -132,8 +170,6 @@ private:
     SDL_GameController *ctrl;
     
 	AtomicFlag msgBoxDone;
-    
-    SDL_mutex *textInputLock;
 
 	struct
 	{
@@ -142,58 +178,37 @@ private:
 };
 
 /* Used to asynchronously inform the RGSS thread
- * about certain value changes */
+ * about certain value changes. Neither side ever
+ * waits on the other (see TripleBuffer) */
 template<typename T>
 struct UnidirMessage
 {
 	UnidirMessage()
-	    : mutex(SDL_CreateMutex()),
-	      current(T())
+	    : current(T())
 	{}
 
-	~UnidirMessage()
-	{
-		SDL_DestroyMutex(mutex);
-	}
-
 	/* Done from the sending side */
 	void post(const T &value)
 	{
-		SDL_LockMutex(mutex);
-
-		changed.set();
 		current = value;
-
-		SDL_UnlockMutex(mutex);
+		buffer.write(value);
 	}
 
 	/* Done from the receiving side */
 	bool poll(T &out) const
 	{
-		if (!changed)
-			return false;
-
-		SDL_LockMutex(mutex);
-
-		out = current;
-		changed.clear();
-
-		SDL_UnlockMutex(mutex);
-
-		return true;
+		return buffer.read(out);
 	}
 
-	/* Done from either */
+	/* Done from the sending side, returns
+	 * the last posted value */
 	void get(T &out) const
 	{
-		SDL_LockMutex(mutex);
 		out = current;
-		SDL_UnlockMutex(mutex);
 	}
 
 private:
-	SDL_mutex *mutex;
-	mutable AtomicFlag changed;
+	mutable TripleBuffer<T> buffer;
 	T current;
 };
 
@@ -251,6 +266,8 @@ struct RGSSThreadData
 	UnidirMessage<Vec2i> windowSizeMsg;
     UnidirMessage<Vec2i> drawableSizeMsg;
 	UnidirMessage<BDescVec> bindingUpdateMsg;
+	/* The opened controller, or null */
+	UnidirMessage<SDL_GameController*> controllerMsg;
 	SyncPoint syncPoint;
 
 	const char *argv0;
@@ -259,6 +276,8 @@ struct RGSSThreadData
 	ALCdevice *alcDev;
 
     GLContext glContext;
+    /* Shares objects with glContext, for pipelined rendering */
+    GLContext presentContext;
 
 	Vec2 sizeResoRatio;
 	Vec2i screenOffset;
@@ -285,7 +304,8 @@ struct RGSSThreadData
 	      refreshRate(refreshRate),
           scale(scalingFactor),
 	      config(newconf),
-          glContext(ctx, &SDL_GL_DeleteContext)
+          glContext(ctx, &SDL_GL_DeleteContext),
+          presentContext(nullptr, &SDL_GL_DeleteContext)
 	{}
 };
 
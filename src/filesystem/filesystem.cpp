@@ -20,6 +20,7 @@
 */
 
 #include "filesystem.h"
+#include "pathindex.h"
 
 #include "util/boost-hash.h"
 #include "util/debugwriter.h"
@@ -33,8 +34,9 @@
 
 #include <physfs.h>
 
+#include <SDL_mutex.h>
+
 #include <algorithm>
-#include <stack>
 #include <stdio.h>
 #include <string.h>
 #include <unistd.h>
@@ -280,6 +282,22 @@ struct FileSystemPrivate {
   /* This is for compatibility with games that take Windows'
    * case insensitivity for granted */
   bool havePathCache;
+
+  /* Search path, in PhysFS order, and what each entry holds */
+  std::vector<PathIndex::Mount> mounts;
+  PathIndex index;
+  std::string indexFile;
+
+  bool allowSymlinks;
+
+  /* Guards pathCache, fileLists and havePathCache. The Preloader
+   * resolves paths through them on its worker threads, while the
+   * RGSS thread may rebuild them at any time (add_search_path) */
+  SDL_mutex *cacheMutex;
+
+  FileSystemPrivate() : havePathCache(false), cacheMutex(SDL_CreateMutex()) {}
+
+  ~FileSystemPrivate() { SDL_DestroyMutex(cacheMutex); }
 };
 
 static void throwPhysfsError(const char *desc) {
@@ -312,7 +330,7 @@ FileSystem::FileSystem(const char *argv0, bool allowSymlinks) : resources(argv0)
     throwPhysfsError("Error registering PhysFS RGSS archiver");
 
   p = std::make_unique<FileSystemPrivate>();
-  p->havePathCache = false;
+  p->allowSymlinks = allowSymlinks;
 
   if (allowSymlinks)
     PHYSFS_permitSymbolicLinks(1);
@@ -336,6 +354,9 @@ void FileSystem::addPath(const char *path, const char *mountpoint, bool reload)
         throw Exception(Exception::PHYSFSError, "Failed to mount %s (%s)", path, PHYSFS_getErrorByCode(err));
     }
     
+    PathIndex::Mount mount = { path, mountpoint ? mountpoint : "" };
+    p->mounts.push_back(mount);
+    
     if (reload) reloadPathCache();
 }
 
@@ -346,12 +367,18 @@ void FileSystem::removePath(const char *path, bool reload) {
         throw Exception(Exception::PHYSFSError, "Failed to unmount %s (%s)", path, PHYSFS_getErrorByCode(err));
     }
     
+    for (size_t i = 0; i < p->mounts.size(); ++i) {
+        if (p->mounts[i].path == path) {
+            p->mounts.erase(p->mounts.begin() + i);
+            break;
+        }
+    }
+    
     if (reload) reloadPathCache();
 }
 
 struct CacheEnumData {
   FileSystemPrivate *p;
-  std::stack<std::vector<std::string> *> fileLists;
 
 #ifdef __APPLE__
   iconv_t nfd2nfc;
@@ -391,69 +418,99 @@ struct CacheEnumData {
   }
 };
 
-static PHYSFS_EnumerateCallbackResult cacheEnumCB(void *d, const char *origdir,
-                                                  const char *fname) {
-  CacheEnumData &data = *static_cast<CacheEnumData *>(d);
+static void buildPathCache(FileSystemPrivate *p) {
+  p->index.update(p->mounts, p->allowSymlinks);
+
+  SDL_LockMutex(p->cacheMutex);
+
+  p->fileLists.clear();
+  p->pathCache.clear();
+  p->fileLists[""];
+
+  CacheEnumData data(p);
+  char dirPath[512];
   char fullPath[512];
 
-  if (!*origdir)
-    snprintf(fullPath, sizeof(fullPath), "%s", fname);
-  else
-    snprintf(fullPath, sizeof(fullPath), "%s/%s", origdir, fname);
+  const std::vector<PathIndex::Source> &sources = p->index.sources();
 
-  /* Deal with OSX' weird UTF-8 standards */
-  data.toNFC(fullPath);
+  for (size_t i = 0; i < sources.size(); ++i) {
+    const PathIndex::Source &src = sources[i];
+    std::map<std::string, PathIndex::Dir>::const_iterator iter;
 
-  std::string mixedCase(fullPath);
-  std::string lowerCase = mixedCase;
-  strTolower(lowerCase);
+    for (iter = src.dirs.begin(); iter != src.dirs.end(); ++iter) {
+      const char *mp = src.mountpoint.c_str();
+      const char *rel = iter->first.c_str();
 
-  PHYSFS_Stat stat;
-  PHYSFS_stat(fullPath, &stat);
+      if (!*mp)
+        snprintf(dirPath, sizeof(dirPath), "%s", rel);
+      else if (!*rel)
+        snprintf(dirPath, sizeof(dirPath), "%s", mp);
+      else
+        snprintf(dirPath, sizeof(dirPath), "%s/%s", mp, rel);
 
-  if (stat.filetype == PHYSFS_FILETYPE_DIRECTORY) {
-    /* Create a new list for this directory */
-    std::vector<std::string> &list = data.p->fileLists[lowerCase];
+      /* Deal with OSX' weird UTF-8 standards */
+      data.toNFC(dirPath);
 
-    /* Iterate over its contents */
-    data.fileLists.push(&list);
-    PHYSFS_enumerate(fullPath, cacheEnumCB, d);
-    data.fileLists.pop();
-  } else {
-    /* Get the file list for the directory we're currently
-     * traversing and append this filename to it */
-    std::vector<std::string> &list = *data.fileLists.top();
+      std::string lowerDir(dirPath);
+      strTolower(lowerDir);
+
+      /* Create the list for this directory even if it's empty */
+      std::vector<std::string> &list = p->fileLists[lowerDir];
+
+      const std::vector<std::string> &files = iter->second.files;
+
+      for (size_t j = 0; j < files.size(); ++j) {
+        if (!*dirPath)
+          snprintf(fullPath, sizeof(fullPath), "%s", files[j].c_str());
+        else
+          snprintf(fullPath, sizeof(fullPath), "%s/%s", dirPath, files[j].c_str());
+
+        data.toNFC(fullPath);
+
+        std::string mixedCase(fullPath);
+        std::string lowerCase = mixedCase;
+        strTolower(lowerCase);
+
+        /* Earlier search paths shadow later ones */
+        if (p->pathCache.contains(lowerCase))
+          continue;
 
-    std::string lowerFilename(fname);
-    strTolower(lowerFilename);
-    list.push_back(lowerFilename);
+        /* Add the lower -> mixed mapping of the file's full path */
+        p->pathCache.insert(lowerCase, mixedCase);
 
-    /* Add the lower -> mixed mapping of the file's full path */
-    data.p->pathCache.insert(lowerCase, mixedCase);
+        /* And the lower case filename to its directory's list */
+        list.push_back(lowerCase.substr(lowerDir.empty() ? 0 : lowerDir.size() + 1));
+      }
+    }
   }
 
-  return PHYSFS_ENUM_OK;
+  p->havePathCache = true;
+
+  SDL_UnlockMutex(p->cacheMutex);
+
+  if (!p->indexFile.empty())
+    p->index.save(p->indexFile);
 }
 
-void FileSystem::createPathCache() {
-  CacheEnumData data(p.get());
-  data.fileLists.push(&p->fileLists[""]);
-  PHYSFS_enumerate("", cacheEnumCB, &data);
+void FileSystem::createPathCache(const std::string &indexFile) {
+  p->indexFile = indexFile;
 
-  p->havePathCache = true;
+  if (!indexFile.empty())
+    p->index.load(indexFile);
+
+  buildPathCache(p.get());
 }
 
 void FileSystem::reloadPathCache() {
     if (!p->havePathCache) return;
     
-    p->fileLists.clear();
-    p->pathCache.clear();
-    createPathCache();
+    /* Only what changed since the last scan is read again */
+    buildPathCache(p.get());
 }
 
 struct FontSetsCBData {
   FileSystemPrivate *p;
-  SharedFontState *sfs;
+  std::vector<SharedFontState::FontFile> files;
 };
 
 static PHYSFS_EnumerateCallbackResult fontSetEnumCB(void *data, const char *dir,
@@ -479,17 +536,13 @@ static PHYSFS_EnumerateCallbackResult fontSetEnumCB(void *data, const char *dir,
   char filename[512];
   snprintf(filename, sizeof(filename), "%s/%s", dir, fname);
 
-  PHYSFS_File *handle = PHYSFS_openRead(filename);
+  PHYSFS_Stat stat;
 
-  if (!handle)
+  if (!PHYSFS_stat(filename, &stat))
     return PHYSFS_ENUM_ERROR;
 
-  SDL_RWops ops;
-  initReadOps(handle, ops, false);
-
-  d->sfs->initFontSetCB(ops, filename);
-
-  SDL_RWclose(&ops);
+  SharedFontState::FontFile file = {filename, stat.filesize, stat.modtime};
+  d->files.push_back(file);
 
   return PHYSFS_ENUM_OK;
 }
@@ -514,9 +567,11 @@ findFontsFolderCB(void *data, const char *, const char *fname) {
 }
 
 void FileSystem::initFontSets(SharedFontState &sfs) {
-  FontSetsCBData d = {p.get(), &sfs};
+  FontSetsCBData d = {p.get()};
 
   PHYSFS_enumerate("", findFontsFolderCB, &d);
+
+  sfs.initFontSets(*this, d.files);
 }
 
 struct OpenReadEnumData {
@@ -527,10 +582,6 @@ struct OpenReadEnumData {
   const char *filename;
   size_t filenameN;
 
-  /* Optional hash to translate full filepaths
-   * (used with path cache) */
-  BoostHash<std::string, std::string> *pathTrans;
-
   /* Number of files we've attempted to read and parse */
   size_t matchCount;
   bool stopSearching;
@@ -540,45 +591,28 @@ struct OpenReadEnumData {
   const char *physfsError;
 
   OpenReadEnumData(FileSystem::OpenHandler &handler, const char *filename,
-                   size_t filenameN,
-                   BoostHash<std::string, std::string> *pathTrans)
+                   size_t filenameN)
       : handler(handler), filename(filename), filenameN(filenameN),
-        pathTrans(pathTrans), matchCount(0), stopSearching(false),
-        physfsError(0) {}
+        matchCount(0), stopSearching(false), physfsError(0) {}
 };
 
-static PHYSFS_EnumerateCallbackResult
-openReadEnumCB(void *d, const char *dirpath, const char *filename) {
-  OpenReadEnumData &data = *static_cast<OpenReadEnumData *>(d);
-  char buffer[512];
-  const char *fullPath;
-
-  if (data.stopSearching)
-    return PHYSFS_ENUM_STOP;
-
+/* Whether 'filename' is the one we're looking for,
+ * with or without extension */
+static bool openReadMatches(const OpenReadEnumData &data, const char *filename) {
   /* If there's not even a partial match, continue searching */
   if (strncmp(filename, data.filename, data.filenameN) != 0)
-    return PHYSFS_ENUM_OK;
-
-  if (!*dirpath) {
-    fullPath = filename;
-  } else {
-    snprintf(buffer, sizeof(buffer), "%s/%s", dirpath, filename);
-    fullPath = buffer;
-  }
+    return false;
 
   char last = filename[data.filenameN];
   /* If fname matches up to a following '.' (meaning the rest is part
    * of the extension), or up to a following '\0' (full match), we've
    * found our file */
-  if (last != '.' && last != '\0')
-    return PHYSFS_ENUM_OK;
-
-  /* If the path cache is active, translate from lower case
-   * to mixed case path */
-  if (data.pathTrans)
-    fullPath = (*data.pathTrans)[fullPath].c_str();
+  return last == '.' || last == '\0';
+}
 
+/* Hands the file at 'fullPath' to the handler */
+static void openReadFile(OpenReadEnumData &data, const char *fullPath,
+                         const char *filename) {
   PHYSFS_File *phys = PHYSFS_openRead(fullPath);
 
   if (!phys) {
@@ -588,7 +622,7 @@ openReadEnumCB(void *d, const char *dirpath, const char *filename) {
     data.stopSearching = true;
     data.physfsError = PHYSFS_getErrorByCode(PHYSFS_getLastErrorCode());
 
-    return PHYSFS_ENUM_ERROR;
+    return;
   }
   initReadOps(phys, data.ops, false);
 
@@ -598,7 +632,30 @@ openReadEnumCB(void *d, const char *dirpath, const char *filename) {
     data.stopSearching = true;
 
   ++data.matchCount;
-  return PHYSFS_ENUM_OK;
+}
+
+static PHYSFS_EnumerateCallbackResult
+openReadEnumCB(void *d, const char *dirpath, const char *filename) {
+  OpenReadEnumData &data = *static_cast<OpenReadEnumData *>(d);
+  char buffer[512];
+  const char *fullPath;
+
+  if (data.stopSearching)
+    return PHYSFS_ENUM_STOP;
+
+  if (!openReadMatches(data, filename))
+    return PHYSFS_ENUM_OK;
+
+  if (!*dirpath) {
+    fullPath = filename;
+  } else {
+    snprintf(buffer, sizeof(buffer), "%s/%s", dirpath, filename);
+    fullPath = buffer;
+  }
+
+  openReadFile(data, fullPath, filename);
+
+  return data.physfsError ? PHYSFS_ENUM_ERROR : PHYSFS_ENUM_OK;
 }
 
 void FileSystem::openRead(OpenHandler &handler, const char *filename) {
@@ -607,7 +664,11 @@ void FileSystem::openRead(OpenHandler &handler, const char *filename) {
     size_t len = strcpySafe(buffer, filename_nm.c_str(), sizeof(buffer), -1);
     char *delim;
 
-    if (p->havePathCache)
+    SDL_LockMutex(p->cacheMutex);
+
+    const bool havePathCache = p->havePathCache;
+
+    if (havePathCache)
         for (size_t i = 0; i < len; ++i)
             buffer[i] = tolower(buffer[i]);
 
@@ -628,16 +689,32 @@ void FileSystem::openRead(OpenHandler &handler, const char *filename) {
     file = delim + 1;
     dir = buffer;
   }
-  OpenReadEnumData data(handler, file, len + buffer - delim - !root,
-                        p->havePathCache ? &p->pathCache : 0);
+  OpenReadEnumData data(handler, file, len + buffer - delim - !root);
+
+  /* Matching files as (mixed case full path, lower case name).
+   * Only collected while holding the lock, opening and
+   * parsing them can take a while */
+  std::vector<std::pair<std::string, std::string>> matches;
 
-  if (p->havePathCache) {
+  if (havePathCache && p->fileLists.contains(dir)) {
     /* Get the list of files contained in this directory
      * and manually iterate over them */
     const std::vector<std::string> &fileList = p->fileLists[dir];
 
-    for (size_t i = 0; i < fileList.size(); ++i)
-      openReadEnumCB(&data, dir, fileList[i].c_str());
+    for (size_t i = 0; i < fileList.size(); ++i) {
+      if (!openReadMatches(data, fileList[i].c_str()))
+        continue;
+
+      std::string lowerPath = root ? fileList[i] : std::string(dir) + "/" + fileList[i];
+      matches.push_back(std::make_pair(p->pathCache.value(lowerPath), fileList[i]));
+    }
+  }
+
+  SDL_UnlockMutex(p->cacheMutex);
+
+  if (havePathCache) {
+    for (size_t i = 0; i < matches.size() && !data.stopSearching; ++i)
+      openReadFile(data, matches[i].first.c_str(), matches[i].second.c_str());
   } else {
     PHYSFS_enumerate(dir, openReadEnumCB, &data);
   }
@@ -675,6 +752,8 @@ const char *FileSystem::desensitize(const char *filename) {
   std::transform(fn_lower.begin(), fn_lower.end(), fn_lower.begin(), [](unsigned char c){
       return std::tolower(c);
   });
+  /* Only the RGSS thread ever writes the cache,
+   * so no need to lock for reading it here */
   if (p->havePathCache && p->pathCache.contains(fn_lower))
     return p->pathCache[fn_lower].c_str();
   return filename;
@@ -44,8 +44,11 @@ public:
 	void addPath(const char *path, const char *mountpoint = 0, bool reload = false);
     void removePath(const char *path, bool reload = false);
 
-	/* Call these after the last 'addPath()' */
-	void createPathCache();
+	/* Call these after the last 'addPath()'.
+	 * If 'indexFile' is given, the index of the search
+	 * paths is kept there and only updated on the next
+	 * run instead of rebuilt from scratch */
+	void createPathCache(const std::string &indexFile = std::string());
     
     void reloadPathCache();
 
@@ -0,0 +1,453 @@
+/*
+** pathindex.cpp
+**
+** This file is part of mkxp.
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "pathindex.h"
+
+#include "util/debugwriter.h"
+#include "util/serial-util.h"
+
+#include <physfs.h>
+
+#ifdef MKXPZ_EXP_FS
+#include <experimental/filesystem>
+namespace fs = std::experimental::filesystem;
+#else
+#include "ghc/filesystem.hpp"
+namespace fs = ghc::filesystem;
+#endif
+
+#include <atomic>
+#include <stdio.h>
+#include <string.h>
+#include <thread>
+
+#define PATH_INDEX_MAGIC "MKXPPIX1"
+
+/* Upper bound on worker threads walking directory trees */
+#define PATH_INDEX_MAX_THREADS 8
+
+typedef std::map<std::string, PathIndex::Dir> DirMap;
+
+static int64_t writeTime(const fs::path &path)
+{
+    std::error_code ec;
+    fs::file_time_type time = fs::last_write_time(path, ec);
+
+    if (ec)
+        return -1;
+
+    return (int64_t) time.time_since_epoch().count();
+}
+
+static std::string joinPath(const std::string &dir, const std::string &name)
+{
+    if (dir.empty())
+        return name;
+
+    return dir + "/" + name;
+}
+
+static void readDir(const fs::path &path, bool followSymlinks, PathIndex::Dir &dir)
+{
+    std::error_code ec;
+    fs::directory_iterator iter(path, ec), end;
+
+    for (; !ec && iter != end; iter.increment(ec))
+    {
+        std::error_code statEc;
+        fs::file_status status = iter->symlink_status(statEc);
+
+        /* PhysFS hides symlinks unless they are permitted */
+        if (fs::is_symlink(status))
+        {
+            if (!followSymlinks)
+                continue;
+
+            status = iter->status(statEc);
+        }
+
+        if (statEc)
+            continue;
+
+        std::string name = iter->path().filename().string();
+
+        if (fs::is_directory(status))
+            dir.dirs.push_back(name);
+        else
+            dir.files.push_back(name);
+    }
+}
+
+struct ScanCounters
+{
+    size_t read;
+    size_t reused;
+};
+
+/* Indexes "rel" and everything below it, taking over the
+ * listing of any directory whose modification time matches
+ * the one recorded in "old" */
+static void scanTree(const fs::path &root, const std::string &rel,
+                     const DirMap *old, DirMap &out,
+                     bool followSymlinks, ScanCounters &counters)
+{
+    fs::path path = rel.empty() ? root : root / fs::path(rel);
+
+    PathIndex::Dir &dir = out[rel];
+    dir.mtime = writeTime(path);
+
+    DirMap::const_iterator prev = old ? old->find(rel) : DirMap::const_iterator();
+
+    if (old && prev != old->end() && dir.mtime != -1 && prev->second.mtime == dir.mtime)
+    {
+        dir.files = prev->second.files;
+        dir.dirs = prev->second.dirs;
+        ++counters.reused;
+    }
+    else
+    {
+        readDir(path, followSymlinks, dir);
+        ++counters.read;
+    }
+
+    /* References into std::map stay valid while inserting */
+    for (size_t i = 0; i < dir.dirs.size(); ++i)
+        scanTree(root, joinPath(rel, dir.dirs[i]), old, out, followSymlinks, counters);
+}
+
+struct ArchiveEnumData
+{
+    const char *realDir;
+    size_t prefixLen;
+    DirMap *dirs;
+};
+
+static PHYSFS_EnumerateCallbackResult archiveEnumCB(void *d, const char *origdir,
+                                                    const char *fname)
+{
+    ArchiveEnumData &data = *static_cast<ArchiveEnumData*>(d);
+
+    std::string fullPath = joinPath(origdir, fname);
+
+    PHYSFS_Stat stat;
+
+    if (!PHYSFS_stat(fullPath.c_str(), &stat))
+        return PHYSFS_ENUM_OK;
+
+    if (stat.filetype == PHYSFS_FILETYPE_DIRECTORY)
+    {
+        PHYSFS_enumerate(fullPath.c_str(), archiveEnumCB, d);
+        return PHYSFS_ENUM_OK;
+    }
+
+    /* The merged tree contains the files of all sources */
+    const char *realDir = PHYSFS_getRealDir(fullPath.c_str());
+
+    if (!realDir || strcmp(realDir, data.realDir))
+        return PHYSFS_ENUM_OK;
+
+    std::string rel(origdir);
+    rel.erase(0, std::min(data.prefixLen, rel.size()));
+
+    if (!rel.empty() && rel[0] == '/')
+        rel.erase(0, 1);
+
+    (*data.dirs)[rel].files.push_back(fname);
+
+    return PHYSFS_ENUM_OK;
+}
+
+PathIndex::PathIndex()
+{
+    memset(&stats, 0, sizeof(stats));
+}
+
+void PathIndex::update(const std::vector<Mount> &mounts, bool followSymlinks)
+{
+    memset(&stats, 0, sizeof(stats));
+
+    std::vector<Source> next(mounts.size());
+    std::vector<const Source*> prev(mounts.size(), (const Source*) 0);
+
+    /* Top level subdirectory walks, run in parallel */
+    struct Job
+    {
+        size_t source;
+        std::string rel;
+        DirMap out;
+        ScanCounters counters;
+    };
+
+    std::vector<Job> jobs;
+    std::vector<size_t> staleArchives;
+
+    for (size_t i = 0; i < mounts.size(); ++i)
+    {
+        Source &src = next[i];
+        src.path = mounts[i].path;
+        src.mountpoint = mounts[i].mountpoint;
+        src.mtime = src.size = -1;
+
+        for (size_t j = 0; j < srcs.size(); ++j)
+            if (srcs[j].path == src.path && srcs[j].mountpoint == src.mountpoint)
+                prev[i] = &srcs[j];
+
+        std::error_code ec;
+        fs::path path(src.path);
+        src.archive = !fs::is_directory(path, ec);
+
+        if (src.archive)
+        {
+            src.mtime = writeTime(path);
+            src.size = (int64_t) fs::file_size(path, ec);
+
+            if (ec)
+                src.size = -1;
+
+            if (prev[i] && prev[i]->archive && src.mtime != -1 &&
+                prev[i]->mtime == src.mtime && prev[i]->size == src.size)
+            {
+                src.dirs = prev[i]->dirs;
+                ++stats.archivesReused;
+            }
+            else
+            {
+                staleArchives.push_back(i);
+            }
+
+            continue;
+        }
+
+        /* Only the root itself here, subtrees are left to the jobs */
+        const DirMap *old = prev[i] && !prev[i]->archive ? &prev[i]->dirs : 0;
+        Dir &root = src.dirs[""];
+        root.mtime = writeTime(path);
+
+        DirMap::const_iterator oldRoot = old ? old->find("") : DirMap::const_iterator();
+
+        if (old && oldRoot != old->end() && root.mtime != -1 && oldRoot->second.mtime == root.mtime)
+        {
+            root.files = oldRoot->second.files;
+            root.dirs = oldRoot->second.dirs;
+            ++stats.dirsReused;
+        }
+        else
+        {
+            readDir(path, followSymlinks, root);
+            ++stats.dirsRead;
+        }
+
+        for (size_t j = 0; j < root.dirs.size(); ++j)
+        {
+            jobs.push_back(Job());
+            jobs.back().source = i;
+            jobs.back().rel = root.dirs[j];
+        }
+    }
+
+    std::atomic<size_t> nextJob(0);
+
+    auto worker = [&]()
+    {
+        size_t j;
+
+        while ((j = nextJob++) < jobs.size())
+        {
+            Job &job = jobs[j];
+            const Source *old = prev[job.source];
+
+            memset(&job.counters, 0, sizeof(job.counters));
+            scanTree(fs::path(next[job.source].path), job.rel,
+                     old && !old->archive ? &old->dirs : 0,
+                     job.out, followSymlinks, job.counters);
+        }
+    };
+
+    size_t threadCount = std::min<size_t>(jobs.size(), PATH_INDEX_MAX_THREADS);
+    unsigned hwThreads = std::thread::hardware_concurrency();
+
+    if (hwThreads > 0)
+        threadCount = std::min<size_t>(threadCount, hwThreads);
+
+    std::vector<std::thread> threads;
+
+    for (size_t t = 1; t < threadCount; ++t)
+        threads.push_back(std::thread(worker));
+
+    worker();
+
+    for (size_t t = 0; t < threads.size(); ++t)
+        threads[t].join();
+
+    for (size_t j = 0; j < jobs.size(); ++j)
+    {
+        Job &job = jobs[j];
+
+        next[job.source].dirs.insert(job.out.begin(), job.out.end());
+        stats.dirsRead += job.counters.read;
+        stats.dirsReused += job.counters.reused;
+    }
+
+    /* Archives are indexed through the merged PhysFS tree, so an
+     * archive behind a changed directory may now own files it
+     * previously didn't (shadowed ones that got deleted) */
+    if (stats.dirsRead > 0)
+    {
+        bool behindDir = false;
+
+        for (size_t i = 0; i < next.size(); ++i)
+        {
+            if (!next[i].archive)
+            {
+                behindDir = true;
+                continue;
+            }
+
+            if (!behindDir || next[i].dirs.empty())
+                continue;
+
+            bool listed = false;
+
+            for (size_t j = 0; j < staleArchives.size(); ++j)
+                listed |= staleArchives[j] == i;
+
+            if (!listed)
+            {
+                next[i].dirs.clear();
+                staleArchives.push_back(i);
+                --stats.archivesReused;
+            }
+        }
+    }
+
+    for (size_t j = 0; j < staleArchives.size(); ++j)
+    {
+        Source &src = next[staleArchives[j]];
+
+        ArchiveEnumData data;
+        data.realDir = src.path.c_str();
+        data.prefixLen = src.mountpoint.size();
+        data.dirs = &src.dirs;
+
+        PHYSFS_enumerate(src.mountpoint.c_str(), archiveEnumCB, &data);
+        ++stats.archivesRead;
+    }
+
+    srcs.swap(next);
+}
+
+/* Serialization */
+
+bool PathIndex::load(const std::string &file)
+{
+    srcs.clear();
+
+    FILE *f = fopen(file.c_str(), "rb");
+
+    if (!f)
+        return false;
+
+    std::string buf;
+    char chunk[0x10000];
+    size_t n;
+
+    while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0)
+        buf.append(chunk, n);
+
+    fclose(f);
+
+    const size_t magicLen = strlen(PATH_INDEX_MAGIC);
+
+    if (buf.size() < magicLen || memcmp(buf.data(), PATH_INDEX_MAGIC, magicLen))
+        return false;
+
+    SerialReader r = { buf.data() + magicLen, buf.data() + buf.size(), true };
+
+    uint32_t sourceCount = r.u32();
+
+    for (uint32_t i = 0; r.ok && i < sourceCount; ++i)
+    {
+        srcs.push_back(Source());
+        Source &src = srcs.back();
+
+        src.path = r.str();
+        src.mountpoint = r.str();
+        src.archive = r.u32() != 0;
+        src.mtime = r.i64();
+        src.size = r.i64();
+
+        uint32_t dirCount = r.u32();
+
+        for (uint32_t j = 0; r.ok && j < dirCount; ++j)
+        {
+            std::string rel = r.str();
+            Dir &dir = src.dirs[rel];
+
+            dir.mtime = r.i64();
+            r.strs(dir.files);
+            r.strs(dir.dirs);
+        }
+    }
+
+    if (!r.ok)
+    {
+        Debug() << "Path cache index" << file << "is damaged, rebuilding";
+        srcs.clear();
+    }
+
+    return r.ok;
+}
+
+void PathIndex::save(const std::string &file) const
+{
+    std::string buf(PATH_INDEX_MAGIC);
+
+    putU32(buf, srcs.size());
+
+    for (size_t i = 0; i < srcs.size(); ++i)
+    {
+        const Source &src = srcs[i];
+
+        putStr(buf, src.path);
+        putStr(buf, src.mountpoint);
+        putU32(buf, src.archive);
+        putI64(buf, src.mtime);
+        putI64(buf, src.size);
+        putU32(buf, src.dirs.size());
+
+        for (DirMap::const_iterator iter = src.dirs.begin(); iter != src.dirs.end(); ++iter)
+        {
+            putStr(buf, iter->first);
+            putI64(buf, iter->second.mtime);
+            putStrs(buf, iter->second.files);
+            putStrs(buf, iter->second.dirs);
+        }
+    }
+
+    FILE *f = fopen(file.c_str(), "wb");
+
+    if (!f)
+    {
+        Debug() << "Unable to write path cache index" << file;
+        return;
+    }
+
+    fwrite(buf.data(), 1, buf.size(), f);
+    fclose(f);
+}
@@ -0,0 +1,97 @@
+/*
+** pathindex.h
+**
+** This file is part of mkxp.
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PATHINDEX_H
+#define PATHINDEX_H
+
+#include <stdint.h>
+#include <map>
+#include <string>
+#include <vector>
+
+/* Listing of every file provided by each mounted search path,
+ * which FileSystem builds its path cache from.
+ *
+ * The index can be saved to disk and brought up to date on the
+ * next launch: directories whose modification time is unchanged
+ * are not read again, and archives are only re-enumerated when
+ * their size or modification time differ. */
+class PathIndex
+{
+public:
+    struct Mount
+    {
+        std::string path;
+        std::string mountpoint;
+    };
+
+    struct Dir
+    {
+        Dir() : mtime(-1) {}
+
+        int64_t mtime;
+
+        /* Mixed case names, as found */
+        std::vector<std::string> files;
+        std::vector<std::string> dirs;
+    };
+
+    struct Source
+    {
+        std::string path;
+        std::string mountpoint;
+
+        bool archive;
+        int64_t mtime;
+        int64_t size;
+
+        /* Keyed by the path relative to the source root,
+         * the root itself being "". Archives only record
+         * the directories that contain files */
+        std::map<std::string, Dir> dirs;
+    };
+
+    struct Stats
+    {
+        size_t dirsRead;
+        size_t dirsReused;
+        size_t archivesRead;
+        size_t archivesReused;
+    };
+
+    PathIndex();
+
+    /* Returns false (leaving the index empty)
+     * if the file is missing or unreadable */
+    bool load(const std::string &file);
+    void save(const std::string &file) const;
+
+    /* Re-indexes the given mounts (in search path order),
+     * reusing whatever is still valid from the current
+     * contents. Directory trees are walked in parallel */
+    void update(const std::vector<Mount> &mounts, bool followSymlinks);
+
+    const std::vector<Source> &sources() const { return srcs; }
+
+private:
+    std::vector<Source> srcs;
+    Stats stats;
+};
+
+#endif // PATHINDEX_H
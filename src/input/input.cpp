@@ -31,6 +31,7 @@
 #include <SDL_keyboard.h>
 #include <SDL_mouse.h>
 #include <SDL_clipboard.h>
+#include <SDL_timer.h>
 
 #include <vector>
 #include <cmath>
@@ -716,6 +717,18 @@ struct InputPrivate
 
     int vScrollDistance;
     
+    /* Button transitions received since the previous update */
+    std::vector<Input::Event> events;
+    
+    /* Receive time of the first press not yet shown on
+     * screen, for measuring input-to-photon latency */
+    uint64_t pendingPressTicks;
+    
+    /* Text typed since it was last cleared, and the controller
+     * in use, as last heard of from the event thread */
+    std::string text;
+    SDL_GameController *controller;
+    
     struct
     {
         int active;
@@ -727,6 +740,49 @@ struct InputPrivate
         int active;
     } dir8Data;
     
+    void drainEvents() {
+        events.clear();
+        
+        const uint64_t now = SDL_GetPerformanceCounter();
+        const double freq = SDL_GetPerformanceFrequency();
+        const double runTime = shState->runTime();
+        
+        EventThread::InputEvent ev;
+        
+        while (EventThread::inputEvents.pop(ev)) {
+            Input::Event out;
+            out.type = ev.type;
+            out.code = ev.code;
+            out.time = runTime - (now - ev.ticks) / freq;
+            
+            events.push_back(out);
+            
+            bool press = (ev.type == EventThread::InputEvent::KeyDown ||
+                          ev.type == EventThread::InputEvent::ControllerDown ||
+                          ev.type == EventThread::InputEvent::MouseDown);
+            
+            if (press && !pendingPressTicks)
+                pendingPressTicks = ev.ticks;
+        }
+    }
+    
+    void drainNotifications() {
+        EventThread::Notification n;
+        
+        while (EventThread::notifications.pop(n)) {
+            switch (n.type) {
+                case EventThread::Notification::TextInput :
+                    if (text.size() < 512)
+                        text += n.text;
+                    break;
+                    
+                case EventThread::Notification::TextClear :
+                    text.clear();
+                    break;
+            }
+        }
+    }
+    
     void recalcRepeatTime(unsigned int fps) {
         // 0 fps would cause a divide by zero segfault later.
         // Bail in that case.
@@ -748,6 +804,8 @@ struct InputPrivate
     InputPrivate(const RGSSThreadData &rtData)
     {
         last_update = 0;
+        pendingPressTicks = 0;
+        controller = 0;
         
         initStaticKbBindings();
         initMsBindings();
@@ -896,6 +954,11 @@ struct InputPrivate
         memset(rawButtonStates, 0, SDL_CONTROLLER_BUTTON_MAX);
     }
     
+    void checkControllerChange(const RGSSThreadData &rtData)
+    {
+        rtData.controllerMsg.poll(controller);
+    }
+    
     void checkBindingChange(const RGSSThreadData &rtData)
     {
         BDescVec d;
@@ -1201,9 +1264,12 @@ void Input::update()
 {
     shState->checkShutdown();
     p->checkBindingChange(shState->rtData());
+    p->checkControllerChange(shState->rtData());
     
     p->swapBuffers();
     p->clearBuffer();
+    p->drainEvents();
+    p->drainNotifications();
     
     ButtonCode repeatCand = None;
     
@@ -1259,6 +1325,17 @@ void Input::update()
     p->last_update = shState->runTime();
 }
 
+const std::vector<Input::Event> &Input::events() const {
+    return p->events;
+}
+
+uint64_t Input::takePendingPressTicks() {
+    uint64_t ticks = p->pendingPressTicks;
+    p->pendingPressTicks = 0;
+    
+    return ticks;
+}
+
 std::vector<std::string> Input::getBindings(ButtonCode code) {
     std::vector<std::string> ret;
     for (const auto &b : p->kbBindings) {
@@ -1457,13 +1534,15 @@ int Input::scrollV()
 
 bool Input::getControllerConnected()
 {
-    return shState->eThread().getControllerConnected();
+    p->drainNotifications();
+    
+    return p->controller != 0;
 }
 
 const char *Input::getControllerName()
 {
     return (getControllerConnected()) ?
-    SDL_GameControllerName(shState->eThread().controller()) :
+    SDL_GameControllerName(p->controller) :
     0;
 }
 
@@ -1472,7 +1551,7 @@ int Input::getControllerPowerLevel()
     if (!getControllerConnected())
         return SDL_JOYSTICK_POWER_UNKNOWN;
     
-    SDL_Joystick *js = SDL_GameControllerGetJoystick(shState->eThread().controller());
+    SDL_Joystick *js = SDL_GameControllerGetJoystick(p->controller);
     return SDL_JoystickCurrentPowerLevel(js);
 }
 
@@ -1488,12 +1567,14 @@ void Input::setTextInputMode(bool mode)
 
 const char *Input::getText()
 {
-    return shState->eThread().textInputBuffer.c_str();
+    p->drainNotifications();
+    
+    return p->text.c_str();
 }
 
 void Input::clearText()
 {
-    shState->eThread().textInputBuffer.clear();
+    p->text.clear();
 }
 
 char *Input::getClipboardText()
@@ -27,6 +27,7 @@
 #include <string>
 #include <vector>
 #include <memory>
+#include <stdint.h>
 
 extern std::unordered_map<int, int> vKeyToScancode;
 extern std::unordered_map<std::string, int> strToScancode;
@@ -57,11 +58,30 @@ public:
         MouseX1 = 41, MouseX2 = 42
 	};
     
+    /* Non-standard extension */
+    struct Event
+    {
+        /* EventThread::InputEvent::Type */
+        int type;
+        int code;
+        
+        /* Receive time, on the same clock as getDelta() */
+        double time;
+    };
+    
     void recalcRepeat(unsigned int fps);
 
     double getDelta();
 	void update();
     
+    /* Everything received before the last update(), in order */
+    const std::vector<Event> &events() const;
+    
+    /* Receive time (SDL performance counter) of the first button
+     * press consumed by update() since the previous call, 0 if
+     * there was none. Used to measure input-to-photon latency */
+    uint64_t takePendingPressTicks();
+    
     std::vector<std::string> getBindings(ButtonCode code);
     
 	bool isPressed(int button);
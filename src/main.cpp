@@ -29,6 +29,7 @@
 #include <SDL_image.h>
 
 #include <assert.h>
+#include <string.h>
 #include <string>
 #include <regex>
 #include <string_view>
@@ -127,6 +128,8 @@ static void printGLInfo() {
 static SDL_GLContext initGL(SDL_Window *win, const Config &conf,
                             RGSSThreadData *threadData);
 
+static SDL_GLContext createPresentContext(SDL_Window *win, SDL_GLContext glCtx);
+
 #ifdef MKXPZ_RUBY_GEM
 std::unique_ptr<ALCcontext, void (*)(ALCcontext *)> startRgssThread(RGSSThreadData *threadData) {
     RgssThreadManager::getInstance().lockRgssThread();
@@ -253,18 +256,6 @@ int main(int argc, char *argv[]) {
     SDL_SetHint(SDL_HINT_OPENGL_ES_DRIVER, "1");
 #endif
 
-    /* initialize SDL first */
-    SDL2::Core sdl(SDL_INIT_VIDEO | SDL_INIT_GAMECONTROLLER);
-    if (!sdl.startedSuccessfully()) {
-      showInitError(sdl.getErrorMessage());
-      return 0;
-    }
-
-    if (!EventThread::allocUserEvents()) {
-        showInitError("Error allocating SDL user events");
-        return 0;
-    }
-
 #ifndef WORKDIR_CURRENT
     std::array<char, 512> dataDir;
 #if defined(__linux__)
@@ -299,13 +290,38 @@ int main(int argc, char *argv[]) {
 #endif
 
 #ifdef MKXPZ_STEAM
-    SteamshimWrapper steam;
+    SteamShimWrapper steam;
     if (!steam.startedSuccessfully()) {
       showInitError(steam.getErrorMessage());
       return 0;
     }
 #endif
 
+    if (conf.headless) {
+        /* SDL's offscreen driver hands out EGL pbuffer/surfaceless
+         * contexts without needing a display. It has to be picked
+         * before video is initialized, as there may be no display
+         * for any other driver to start on */
+        SDL_setenv("SDL_VIDEODRIVER", "offscreen", 1);
+
+        /* Nothing to sync to, render as fast as possible */
+        conf.vsync = false;
+        conf.syncToRefreshrate = false;
+        conf.fullscreen = false;
+    }
+
+    /* initialize SDL once we know which video driver to use */
+    SDL2::Core sdl(SDL_INIT_VIDEO | SDL_INIT_GAMECONTROLLER);
+    if (!sdl.startedSuccessfully()) {
+      showInitError(sdl.getErrorMessage());
+      return 0;
+    }
+
+    if (!EventThread::allocUserEvents()) {
+        showInitError("Error allocating SDL user events");
+        return 0;
+    }
+
     if (conf.windowTitle.empty())
         conf.windowTitle = conf.game.title;
 
@@ -348,6 +364,8 @@ int main(int argc, char *argv[]) {
     if (!showWindow)
         winFlags |= SDL_WINDOW_HIDDEN;
 #endif
+    if (conf.headless)
+        winFlags |= SDL_WINDOW_HIDDEN;
 
 #ifdef GLES2_HEADER
     SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_ES);
@@ -433,6 +451,11 @@ int main(int argc, char *argv[]) {
     RGSSThreadData rtData(&eventThread, argv[0], win.get(), alcDev.get(), mode.refresh_rate,
                           mkxp_sys::getScalingFactor(), conf, glCtx);
 
+#ifndef MKXPZ_INIT_GL_LATER
+    if (conf.pipelinedRendering && glCtx)
+        rtData.presentContext.reset(createPresentContext(win.get(), glCtx));
+#endif
+
     int winW;
     int winH;
     SDL_GetWindowSize(win.get(), &winW, &winH);
@@ -485,6 +508,8 @@ int main(int argc, char *argv[]) {
      * otherwise abandon hope and just end the process as is. */
     if (rtData.rqTermAck)
       SDL_WaitThread(rgssThread, nullptr);
+    else if (conf.headless)
+      Debug() << "The RGSS script seems to be stuck. Forcing quit.";
     else
       SDL_ShowSimpleMessageBox(
           SDL_MESSAGEBOX_ERROR, conf.game.title.c_str(),
@@ -494,8 +519,9 @@ int main(int argc, char *argv[]) {
 
     if (!rtData.rgssErrorMsg.empty()) {
       Debug() << rtData.rgssErrorMsg;
-      SDL_ShowSimpleMessageBox(SDL_MESSAGEBOX_ERROR, conf.game.title.c_str(),
-                               rtData.rgssErrorMsg.c_str(), win.get());
+      if (!conf.headless)
+        SDL_ShowSimpleMessageBox(SDL_MESSAGEBOX_ERROR, conf.game.title.c_str(),
+                                 rtData.rgssErrorMsg.c_str(), win.get());
     }
 
     /* Clean up any remainin events */
@@ -549,3 +575,28 @@ static SDL_GLContext initGL(SDL_Window *win, const Config &conf,
 
     return glCtx;
 }
+
+/* Second context for the render thread. Both end up current on
+ * the window at once, which only GLX and WGL allow (an EGL surface
+ * can only be bound on one thread at a time) */
+static SDL_GLContext createPresentContext(SDL_Window *win, SDL_GLContext glCtx) {
+    const char *driver = SDL_GetCurrentVideoDriver();
+
+    if (!driver || (strcmp(driver, "x11") && strcmp(driver, "windows"))) {
+        Debug() << "Pipelined rendering is not supported with the"
+                << (driver ? driver : "current") << "video driver";
+        return nullptr;
+    }
+
+    SDL_GL_SetAttribute(SDL_GL_SHARE_WITH_CURRENT_CONTEXT, 1);
+    SDL_GLContext ctx = SDL_GL_CreateContext(win);
+    SDL_GL_SetAttribute(SDL_GL_SHARE_WITH_CURRENT_CONTEXT, 0);
+
+    if (!ctx)
+        Debug() << "Could not create render thread context:" << SDL_GetError();
+
+    /* Creating a context makes it current */
+    SDL_GL_MakeCurrent(win, glCtx);
+
+    return ctx;
+}
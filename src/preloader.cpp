@@ -0,0 +1,550 @@
+/*
+** preloader.cpp
+**
+** This file is part of mkxp.
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "preloader.h"
+
+#include "sharedstate.h"
+#include "filesystem.h"
+#include "texpool.h"
+#include "glstate.h"
+#include "pixelkernels.h"
+#include "al-util.h"
+#include "exception.h"
+#include "sdl-util.h"
+
+#include <SDL_image.h>
+#include <SDL_sound.h>
+#include <SDL_cpuinfo.h>
+#include <SDL_timer.h>
+
+#include <algorithm>
+
+/* Frames a finished asset is kept around for without
+ * being picked up before it's dropped */
+#define PRELOAD_EXPIRE_FRAMES 600
+
+#define PRELOAD_MAX_THREADS 4
+
+enum EntryState
+{
+	Queued,
+	Loading,
+	Decoded,
+	Uploaded,
+	Failed,
+	/* Taken or cleared before it was loaded */
+	Dropped
+};
+
+struct Preloader::Entry
+{
+	Kind kind;
+	std::string path;
+
+	EntryState state;
+	unsigned int age;
+
+	/* Image */
+	SDL_Surface *surface;
+	TEXFBO tex;
+
+	SoundData sound;
+	std::string data;
+
+	Entry(Kind kind, const std::string &path)
+	    : kind(kind),
+	      path(path),
+	      state(Queued),
+	      age(0),
+	      surface(0)
+	{}
+
+	~Entry()
+	{
+		if (surface)
+			SDL_FreeSurface(surface);
+	}
+};
+
+struct ImageOpenHandler : FileSystem::OpenHandler
+{
+	SDL_Surface *surface;
+
+	ImageOpenHandler()
+	    : surface(0)
+	{}
+
+	bool tryRead(SDL_RWops &ops, const char *ext)
+	{
+		/* Animations are left to Bitmap */
+		if (IMG_isGIF(&ops))
+		{
+			SDL_RWclose(&ops);
+			return true;
+		}
+
+		surface = IMG_LoadTyped_RW(&ops, 1, ext);
+
+		return surface != 0;
+	}
+};
+
+struct SoundOpenHandler : FileSystem::OpenHandler
+{
+	Preloader::SoundData &out;
+	bool decoded;
+
+	SoundOpenHandler(Preloader::SoundData &out)
+	    : out(out),
+	      decoded(false)
+	{}
+
+	bool tryRead(SDL_RWops &ops, const char *ext)
+	{
+		Sound_Sample *sample = Sound_NewSample(&ops, ext, 0, STREAM_BUF_SIZE);
+
+		if (!sample)
+		{
+			SDL_RWclose(&ops);
+			return false;
+		}
+
+		/* Same as SoundEmitter, minus the AL buffer */
+		uint32_t decBytes = Sound_DecodeAll(sample);
+		uint8_t sampleSize = formatSampleSize(sample->actual.format);
+		uint32_t bytes = (decBytes / sampleSize) * sampleSize;
+
+		const uint8_t *pcm = static_cast<const uint8_t*>(sample->buffer);
+		out.pcm.assign(pcm, pcm + bytes);
+		out.format = sample->actual.format;
+		out.channels = sample->actual.channels;
+		out.rate = sample->actual.rate;
+
+		Sound_FreeSample(sample);
+		decoded = true;
+
+		return true;
+	}
+};
+
+struct ReadAheadOpenHandler : FileSystem::OpenHandler
+{
+	bool tryRead(SDL_RWops &ops, const char *)
+	{
+		std::vector<char> buf(0x10000);
+
+		while (SDL_RWread(&ops, &buf[0], 1, buf.size()) > 0)
+			;
+
+		SDL_RWclose(&ops);
+
+		return true;
+	}
+};
+
+static bool readRaw(FileSystem &fs, const std::string &path, std::string &out)
+{
+	SDL_RWops ops;
+	fs.openReadRaw(ops, path.c_str());
+
+	Sint64 size = SDL_RWsize(&ops);
+	size_t got = 0;
+
+	if (size > 0)
+	{
+		out.resize(size);
+		got = SDL_RWread(&ops, &out[0], 1, size);
+	}
+
+	SDL_RWclose(&ops);
+
+	return size > 0 && got == (size_t) size;
+}
+
+/* Runs on a worker, without the lock held */
+static bool loadEntry(FileSystem &fs, Preloader::Kind kind,
+                      const std::string &path, SDL_Surface *&surface,
+                      Preloader::SoundData &sound, std::string &data)
+{
+	try
+	{
+		switch (kind)
+		{
+		case Preloader::Image :
+		{
+			ImageOpenHandler handler;
+			fs.openRead(handler, path.c_str());
+
+			if (!handler.surface)
+				return false;
+
+			surface = handler.surface;
+
+			if (surface->format->format != SDL_PIXELFORMAT_ABGR8888)
+			{
+				SDL_Surface *conv = PixelKernels::convertSurface(surface, SDL_PIXELFORMAT_ABGR8888);
+				SDL_FreeSurface(surface);
+				surface = conv;
+			}
+
+			return surface != 0;
+		}
+
+		case Preloader::Sound :
+		{
+			SoundOpenHandler handler(sound);
+			fs.openRead(handler, path.c_str());
+
+			return handler.decoded;
+		}
+
+		case Preloader::Data :
+			return readRaw(fs, path, data);
+
+		case Preloader::Stream :
+		{
+			ReadAheadOpenHandler handler;
+			fs.openRead(handler, path.c_str());
+
+			return true;
+		}
+		}
+	}
+	catch (const Exception &)
+	{
+		/* Reported once the asset is actually loaded */
+	}
+
+	return false;
+}
+
+Preloader::Preloader(FileSystem &fs, TexPool &texPool, int threadCount)
+    : fs(fs),
+      texPool(texPool),
+      threadCount(threadCount),
+      quit(false)
+{
+	mutex = SDL_CreateMutex();
+	workCond = SDL_CreateCond();
+	doneCond = SDL_CreateCond();
+}
+
+Preloader::~Preloader()
+{
+	SDL_LockMutex(mutex);
+	quit = true;
+	SDL_CondBroadcast(workCond);
+	SDL_UnlockMutex(mutex);
+
+	for (size_t i = 0; i < threads.size(); ++i)
+		SDL_WaitThread(threads[i], 0);
+
+	clear();
+
+	SDL_DestroyCond(doneCond);
+	SDL_DestroyCond(workCond);
+	SDL_DestroyMutex(mutex);
+}
+
+void Preloader::startThreads()
+{
+	int count = threadCount;
+
+	/* Leave one core to the game itself */
+	if (count <= 0)
+		count = std::min(SDL_GetCPUCount() - 1, PRELOAD_MAX_THREADS);
+
+	count = std::max(count, 1);
+
+	for (int i = 0; i < count; ++i)
+		threads.push_back(createSDLThread<Preloader, &Preloader::workerMain>(this, "preload"));
+}
+
+void Preloader::workerMain()
+{
+	SDL_LockMutex(mutex);
+
+	while (true)
+	{
+		while (queue.empty() && !quit)
+			SDL_CondWait(workCond, mutex);
+
+		if (quit)
+			break;
+
+		EntryPtr entry = queue.front();
+		queue.pop_front();
+
+		if (entry->state != Queued)
+			continue;
+
+		entry->state = Loading;
+
+		SDL_UnlockMutex(mutex);
+
+		/* Nobody else touches the payload while loading */
+		bool ok = loadEntry(fs, entry->kind, entry->path,
+		                    entry->surface, entry->sound, entry->data);
+
+		SDL_LockMutex(mutex);
+
+		entry->state = ok ? Decoded : Failed;
+		SDL_CondBroadcast(doneCond);
+	}
+
+	SDL_UnlockMutex(mutex);
+}
+
+std::string Preloader::keyFor(const std::string &path) const
+{
+	return fs.normalize(path.c_str(), false, false);
+}
+
+void Preloader::request(Kind kind, const std::string &path)
+{
+	std::string key = keyFor(path);
+
+	if (entries.contains(key))
+		return;
+
+	if (threads.empty())
+		startThreads();
+
+	EntryPtr entry = std::make_shared<Entry>(kind, path);
+	entries.insert(key, entry);
+
+	SDL_LockMutex(mutex);
+	queue.push_back(entry);
+	SDL_CondSignal(workCond);
+	SDL_UnlockMutex(mutex);
+}
+
+size_t Preloader::pending()
+{
+	size_t count = 0;
+
+	SDL_LockMutex(mutex);
+
+	BoostHash<std::string, EntryPtr>::const_iterator iter;
+	for (iter = entries.cbegin(); iter != entries.cend(); ++iter)
+	{
+		const Entry &entry = *iter->second;
+
+		if (entry.state == Queued || entry.state == Loading ||
+		    (entry.state == Decoded && entry.kind == Image))
+			++count;
+	}
+
+	SDL_UnlockMutex(mutex);
+
+	return count;
+}
+
+void Preloader::clear()
+{
+	SDL_LockMutex(mutex);
+
+	/* Entries still being loaded are freed by their worker */
+	BoostHash<std::string, EntryPtr>::const_iterator iter;
+	for (iter = entries.cbegin(); iter != entries.cend(); ++iter)
+		drop(*iter->second);
+
+	queue.clear();
+
+	SDL_UnlockMutex(mutex);
+
+	entries.clear();
+}
+
+void Preloader::commitUploads(int budgetMs)
+{
+	if (threads.empty())
+		return;
+
+	std::vector<EntryPtr> decoded;
+	std::vector<std::string> expired;
+
+	SDL_LockMutex(mutex);
+
+	BoostHash<std::string, EntryPtr>::const_iterator iter;
+	for (iter = entries.cbegin(); iter != entries.cend(); ++iter)
+	{
+		Entry &entry = *iter->second;
+
+		if (entry.state == Queued || entry.state == Loading)
+			continue;
+
+		/* Stream read-ahead has nothing to hand over */
+		if (entry.kind == Stream)
+		{
+			expired.push_back(iter->first);
+			continue;
+		}
+
+		if (entry.state == Decoded && entry.kind == Image)
+		{
+			decoded.push_back(iter->second);
+			continue;
+		}
+
+		if (++entry.age > PRELOAD_EXPIRE_FRAMES)
+			expired.push_back(iter->first);
+	}
+
+	SDL_UnlockMutex(mutex);
+
+	/* Decoded images are left alone by the workers,
+	 * so uploading doesn't need to hold them up */
+	const uint64_t start = SDL_GetPerformanceCounter();
+	const uint64_t budget = SDL_GetPerformanceFrequency() * budgetMs / 1000;
+
+	for (size_t i = 0; i < decoded.size(); ++i)
+	{
+		if (i > 0 && SDL_GetPerformanceCounter() - start >= budget)
+			break;
+
+		upload(*decoded[i]);
+	}
+
+	for (size_t i = 0; i < expired.size(); ++i)
+	{
+		SDL_LockMutex(mutex);
+		drop(*entries.value(expired[i]));
+		SDL_UnlockMutex(mutex);
+
+		entries.remove(expired[i]);
+	}
+}
+
+bool Preloader::upload(Entry &entry)
+{
+	SDL_Surface *surf = entry.surface;
+	entry.surface = 0;
+
+	EntryState state = Failed;
+
+	/* Oversized images become mega surfaces in Bitmap */
+	if (surf->w <= glState.caps.maxTexSize && surf->h <= glState.caps.maxTexSize)
+	{
+		try
+		{
+			entry.tex = texPool.request(surf->w, surf->h);
+
+			TEX::bind(entry.tex.tex);
+			TEX::uploadImage(entry.tex.width, entry.tex.height, surf->pixels, GL_RGBA);
+
+			state = Uploaded;
+		}
+		catch (const Exception &)
+		{
+		}
+	}
+
+	SDL_FreeSurface(surf);
+
+	SDL_LockMutex(mutex);
+	entry.state = state;
+	SDL_UnlockMutex(mutex);
+
+	return state == Uploaded;
+}
+
+/* Called with the lock held */
+void Preloader::drop(Entry &entry)
+{
+	if (entry.state == Uploaded)
+		texPool.release(entry.tex);
+
+	if (entry.state != Loading)
+		entry.state = Dropped;
+}
+
+Preloader::EntryPtr Preloader::take(const std::string &key, Kind kind)
+{
+	if (!entries.contains(key))
+		return EntryPtr();
+
+	EntryPtr entry = entries.value(key);
+
+	if (entry->kind != kind)
+		return EntryPtr();
+
+	entries.remove(key);
+
+	SDL_LockMutex(mutex);
+
+	/* Still queued: loading it right away beats waiting
+	 * for the workers to get to it */
+	if (entry->state == Queued)
+		entry->state = Dropped;
+
+	while (entry->state == Loading)
+		SDL_CondWait(doneCond, mutex);
+
+	EntryState state = entry->state;
+
+	SDL_UnlockMutex(mutex);
+
+	if (state == Decoded && kind == Image)
+		state = upload(*entry) ? Uploaded : Failed;
+
+	if (state != Decoded && state != Uploaded)
+		return EntryPtr();
+
+	return entry;
+}
+
+bool Preloader::takeImage(const std::string &path, TEXFBO &tex)
+{
+	EntryPtr entry = take(keyFor(path), Image);
+
+	if (!entry)
+		return false;
+
+	tex = entry->tex;
+
+	return true;
+}
+
+bool Preloader::takeSound(const std::string &path, SoundData &out)
+{
+	EntryPtr entry = take(keyFor(path), Sound);
+
+	if (!entry)
+		return false;
+
+	out.pcm.swap(entry->sound.pcm);
+	out.format = entry->sound.format;
+	out.channels = entry->sound.channels;
+	out.rate = entry->sound.rate;
+
+	return true;
+}
+
+bool Preloader::takeData(const std::string &path, std::string &out)
+{
+	EntryPtr entry = take(keyFor(path), Data);
+
+	if (!entry)
+		return false;
+
+	out.swap(entry->data);
+
+	return true;
+}
@@ -0,0 +1,132 @@
+/*
+** preloader.h
+**
+** This file is part of mkxp.
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PRELOADER_H
+#define PRELOADER_H
+
+#include "boost-hash.h"
+#include "gl-util.h"
+
+#include <SDL_mutex.h>
+#include <SDL_thread.h>
+
+#include <stdint.h>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+class FileSystem;
+class TexPool;
+
+/* Loads assets the game is about to need on worker threads.
+ *
+ * Scripts hand over a list of paths (typically right before a
+ * scene transition), which are read and decoded in the
+ * background. Decoded images are uploaded into textures a few
+ * at a time at the end of each frame, limited by a time budget.
+ * Bitmap, SoundEmitter and load_data then pick up the results
+ * instead of loading the files themselves. Anything not picked
+ * up within a while is dropped again.
+ *
+ * Everything except the workers runs on the RGSS thread. */
+class Preloader
+{
+public:
+	enum Kind
+	{
+		Image,
+		Sound,
+		Data,
+		/* Only read ahead to warm up the OS file cache,
+		 * used for streamed audio */
+		Stream
+	};
+
+	struct SoundData
+	{
+		std::vector<uint8_t> pcm;
+		uint16_t format;
+		uint8_t channels;
+		uint32_t rate;
+	};
+
+	/* 'threadCount' of 0 picks one based on the CPU count.
+	 * Threads are only started on the first request */
+	Preloader(FileSystem &fs, TexPool &texPool, int threadCount);
+	~Preloader();
+
+	/* Paths are looked up exactly as their consumers would
+	 * look them up later. Already known paths are ignored */
+	void request(Kind kind, const std::string &path);
+
+	/* Number of requested assets not yet ready for pickup */
+	size_t pending();
+
+	/* Drops everything, including finished assets */
+	void clear();
+
+	/* Uploads decoded images until 'budgetMs' is used up,
+	 * but at least one. Called once per frame */
+	void commitUploads(int budgetMs);
+
+	/* Hand over a preloaded asset, waiting for it if it's
+	 * still being loaded. Return false if the path wasn't
+	 * requested or failed to load, in which case the caller
+	 * should load it normally (and report any errors) */
+	bool takeImage(const std::string &path, TEXFBO &tex);
+	bool takeSound(const std::string &path, SoundData &out);
+	bool takeData(const std::string &path, std::string &out);
+
+private:
+	struct Entry;
+	typedef std::shared_ptr<Entry> EntryPtr;
+
+	void startThreads();
+	void workerMain();
+
+	std::string keyFor(const std::string &path) const;
+
+	/* Removes and returns the entry for 'key' once it's
+	 * done loading, or null if there is none */
+	EntryPtr take(const std::string &key, Kind kind);
+
+	bool upload(Entry &entry);
+	void drop(Entry &entry);
+
+	FileSystem &fs;
+	TexPool &texPool;
+
+	int threadCount;
+	std::vector<SDL_Thread*> threads;
+
+	/* RGSS thread only */
+	BoostHash<std::string, EntryPtr> entries;
+
+	/* Guarded by 'mutex', as are the entries' states
+	 * and payloads while they're being loaded */
+	std::deque<EntryPtr> queue;
+	bool quit;
+
+	SDL_mutex *mutex;
+	SDL_cond *workCond;
+	SDL_cond *doneCond;
+};
+
+#endif // PRELOADER_H
@@ -28,8 +28,12 @@
 #include "audio.h"
 #include "glstate.h"
 #include "shader.h"
+#include "programcache.h"
 #include "texpool.h"
 #include "font.h"
+#include "preparequeue.h"
+#include "preloader.h"
+#include "bitmapatlas.h"
 #include "eventthread.h"
 #include "gl-util.h"
 #include "global-ibo.h"
@@ -37,6 +41,7 @@
 #include "binding.h"
 #include "exception.h"
 #include "sharedmidistate.h"
+#include "streamcache.h"
 
 #include <unistd.h>
 #include <stdio.h>
@@ -74,22 +79,38 @@ struct SharedStatePrivate
 
 	SharedMidiState midiState;
 
+	/* Outlives the audio streams playing from it */
+	StreamCache streamCache;
+
+	/* Outlives everything that might be scheduled on it */
+	PrepareQueue prepareQueue;
+
 	Graphics graphics;
 	Input input;
 	Audio audio;
 
 	GLState _glState;
 
+	/* Must outlive, and be constructed before, the shaders */
+	ProgramCache programCache;
 	ShaderSet shaders;
 
 	TexPool texPool;
 
+	/* Hands its pages back to the pool on destruction */
+	BitmapAtlas bitmapAtlas;
+
+	/* Hands textures back to the pool on destruction */
+	Preloader preloader;
+
     SharedFontState fontState;
     std::unique_ptr<Font> defaultFont;
 
 	TEX::ID globalTex;
 	int globalTexW, globalTexH;
 	bool globalTexDirty;
+	/* What its storage was last allocated with */
+	uint64_t globalTexBytes;
 
 	TEXFBO gpTexFBO;
 
@@ -100,6 +121,7 @@ struct SharedStatePrivate
 	unsigned int stampCounter;
     
     std::chrono::time_point<std::chrono::steady_clock> startupTime;
+    double virtualTime;
 
 	SharedStatePrivate(RGSSThreadData *threadData)
 	    : bindingData(0),
@@ -109,17 +131,26 @@ struct SharedStatePrivate
 	      rtData(*threadData),
 	      config(threadData->config),
 	      midiState(threadData->config),
+	      streamCache((size_t) threadData->config.streamCacheSize * 1024 * 1024),
 	      graphics(threadData),
 	      input(*threadData),
 	      audio(*threadData),
 	      _glState(threadData->config),
+	      programCache(threadData->config.shaderCache && !threadData->config.customDataPath.empty()
+	                   ? threadData->config.customDataPath + "/shaders.cache" : std::string()),
+	      texPool((uint64_t) threadData->config.texturePoolSize * 1024 * 1024,
+	              (uint64_t) threadData->config.vramBudget * 1024 * 1024),
+	      bitmapAtlas(texPool, threadData->config.enableHires ? 0 : threadData->config.bitmapAtlasMaxSize),
+	      preloader(fileSystem, texPool, threadData->config.preloadThreads),
 	      fontState(threadData->config),
-	      stampCounter(0)
+	      stampCounter(0),
+	      virtualTime(0)
 	{
         
         startupTime = std::chrono::steady_clock::now();
         
-		/* Shaders have been compiled in ShaderSet's constructor */
+		/* Shaders have been compiled in ShaderSet's constructor
+		 * (lazy ones will simply bring the compiler back) */
 		if (gl.ReleaseShaderCompiler)
 			gl.ReleaseShaderCompiler();
 
@@ -139,7 +170,8 @@ struct SharedStatePrivate
 			fileSystem.addPath(config.rtps[i].c_str());
 
 		if (config.pathCache)
-			fileSystem.createPathCache();
+			fileSystem.createPathCache(config.pathCacheIndex && !config.customDataPath.empty()
+			                           ? config.customDataPath + "/pathcache.idx" : std::string());
 
 		fileSystem.initFontSets(fontState);
 
@@ -152,11 +184,14 @@ struct SharedStatePrivate
 		TEX::setSmooth(false);
 		TEX::allocEmpty(globalTexW, globalTexH);
 		globalTexDirty = false;
+		globalTexBytes = (uint64_t) globalTexW * globalTexH * 4;
+		TexPool::account(globalTexBytes, +1);
 
 		TEXFBO::init(gpTexFBO);
 		/* Reuse starting values */
 		TEXFBO::allocEmpty(gpTexFBO, globalTexW, globalTexH);
 		TEXFBO::linkFBO(gpTexFBO);
+		TexPool::account(gpTexFBO, +1);
 
 		/* RGSS3 games will call setup_midi, so there's
 		 * no need to do it on startup */
@@ -166,7 +201,10 @@ struct SharedStatePrivate
 
 	~SharedStatePrivate()
 	{
+		TexPool::account(globalTexBytes, -1);
 		TEX::del(globalTex);
+		TexPool::account(gpTexFBO, -1);
+		TexPool::account(atlasTex, -1);
 		TEXFBO::fini(gpTexFBO);
 		TEXFBO::fini(atlasTex);
 	}
@@ -223,15 +261,19 @@ GSATT(EventThread&, eThread)
 GSATT(RGSSThreadData&, rtData)
 GSATT(Config&, config)
 GSATT(FileSystem&, fileSystem)
+GSATT(PrepareQueue&, prepareQueue)
 GSATT(Graphics&, graphics)
 GSATT(Input&, input)
 GSATT(Audio&, audio)
 GSATT(GLState&, _glState)
 GSATT(ShaderSet&, shaders)
 GSATT(TexPool&, texPool)
+GSATT(BitmapAtlas&, bitmapAtlas)
+GSATT(Preloader&, preloader)
 GSATT(Quad&, gpQuad)
 GSATT(SharedFontState&, fontState)
 GSATT(SharedMidiState&, midiState)
+GSATT(StreamCache&, streamCache)
 
 void SharedState::setBindingData(void *data)
 {
@@ -256,6 +298,10 @@ void SharedState::bindTex()
 	{
 		TEX::allocEmpty(p->globalTexW, p->globalTexH);
 		p->globalTexDirty = false;
+
+		TexPool::account(p->globalTexBytes, -1);
+		p->globalTexBytes = (uint64_t) p->globalTexW * p->globalTexH * 4;
+		TexPool::account(p->globalTexBytes, +1);
 	}
 }
 
@@ -279,6 +325,7 @@ void SharedState::ensureTexSize(int minW, int minH, Vec2i &currentSizeOut)
 TEXFBO &SharedState::gpTexFBO(int minW, int minH)
 {
 	bool needResize = false;
+	uint64_t oldBytes = (uint64_t) p->gpTexFBO.width * p->gpTexFBO.height * 4;
 
 	if (minW > p->gpTexFBO.width)
 	{
@@ -296,6 +343,9 @@ TEXFBO &SharedState::gpTexFBO(int minW, int minH)
 	{
 		TEX::bind(p->gpTexFBO.tex);
 		TEX::allocEmpty(p->gpTexFBO.width, p->gpTexFBO.height);
+
+		TexPool::account(oldBytes, -1);
+		TexPool::account(p->gpTexFBO, +1);
 	}
 
 	return p->gpTexFBO;
@@ -315,6 +365,7 @@ void SharedState::requestAtlasTex(int w, int h, TEXFBO &out)
 		TEXFBO::init(tex);
 		TEXFBO::allocEmpty(tex, w, h);
 		TEXFBO::linkFBO(tex);
+		TexPool::account(tex, +1);
 	}
 
 	out = tex;
@@ -326,6 +377,7 @@ void SharedState::releaseAtlasTex(TEXFBO &tex)
 	if (tex.tex == TEX::ID(0))
 		return;
 
+	TexPool::account(p->atlasTex, -1);
 	TEXFBO::fini(p->atlasTex);
 
 	p->atlasTex = tex;
@@ -359,10 +411,16 @@ Font &SharedState::defaultFont() const
 
 double SharedState::runTime() {
     if (!p) return 0;
+    if (p->config.virtualClock)
+        return p->virtualTime;
     const auto now = std::chrono::steady_clock::now();
     return std::chrono::duration_cast<std::chrono::microseconds>(now - p->startupTime).count() / 1000.0 / 1000.0;
 }
 
+void SharedState::advanceVirtualClock(double seconds) {
+    p->virtualTime += seconds;
+}
+
 unsigned int SharedState::genTimeStamp()
 {
 	return p->stampCounter++;
@@ -44,12 +44,16 @@ class Input;
 class Audio;
 class GLState;
 class TexPool;
+class BitmapAtlas;
 class Font;
 class SharedFontState;
+class PrepareQueue;
+class Preloader;
 struct GlobalIBO;
 struct Config;
 struct Vec2i;
 struct SharedMidiState;
+class StreamCache;
 
 struct SharedState
 {
@@ -76,18 +80,26 @@ struct SharedState
 	ShaderSet &shaders() const;
 
 	TexPool &texPool() const;
+	BitmapAtlas &bitmapAtlas() const;
+	Preloader &preloader() const;
 
 	SharedFontState &fontState() const;
 	Font &defaultFont() const;
 	SharedMidiState &midiState() const;
+	StreamCache &streamCache() const;
 
-	sigslot::signal<> prepareDraw;
+	/* Drained by Graphics right before each frame is drawn */
+	PrepareQueue &prepareQueue() const;
 
 	unsigned int genTimeStamp();
     
     // Returns time since SharedState was constructed in microseconds
     double runTime();
 
+    /* Moves the virtual clock forward (only has an effect
+     * with config.virtualClock, where runTime() follows it) */
+    void advanceVirtualClock(double seconds);
+
 	/* Returns global quad IBO, and ensures it has indices
 	 * for at least minSize quads */
 	void ensureQuadIBO(size_t minSize);
@@ -0,0 +1,44 @@
+/*
+** fnv1a.h
+**
+** This file is part of mkxp.
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef FNV1A_H
+#define FNV1A_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* 64 bit FNV-1a, used to key the on-disk caches. Chain calls
+ * by passing the previous result as "hash", starting from
+ * fnv1aSeed */
+static const uint64_t fnv1aSeed = 0xcbf29ce484222325ULL;
+
+static inline uint64_t fnv1a(uint64_t hash, const void *data, size_t size)
+{
+	const unsigned char *p = static_cast<const unsigned char*>(data);
+
+	for (size_t i = 0; i < size; ++i)
+	{
+		hash ^= p[i];
+		hash *= 0x100000001b3ULL;
+	}
+
+	return hash;
+}
+
+#endif // FNV1A_H
@@ -5,6 +5,7 @@
 #include <SDL_thread.h>
 #include <SDL_rwops.h>
 
+#include <atomic>
 #include <string>
 #include <iostream>
 #include <unistd.h>
@@ -46,6 +47,181 @@ private:
 	mutable SDL_atomic_t atom;
 };
 
+/* Lock-free queue between exactly one producer thread
+ * and one consumer thread. 'N' must be a power of two */
+template<typename T, int N>
+struct SPSCRing
+{
+	SPSCRing()
+	{
+		SDL_AtomicSet(&head, 0);
+		SDL_AtomicSet(&tail, 0);
+	}
+
+	/* Producer only. Returns false if the ring is full */
+	bool push(const T &value)
+	{
+		int t = SDL_AtomicGet(&tail);
+
+		if (t - SDL_AtomicGet(&head) == N)
+			return false;
+
+		items[t & (N-1)] = value;
+		SDL_AtomicSet(&tail, t + 1);
+
+		return true;
+	}
+
+	/* Consumer only. Returns false if the ring is empty */
+	bool pop(T &value)
+	{
+		int h = SDL_AtomicGet(&head);
+
+		if (h == SDL_AtomicGet(&tail))
+			return false;
+
+		value = items[h & (N-1)];
+		SDL_AtomicSet(&head, h + 1);
+
+		return true;
+	}
+
+private:
+	T items[N];
+
+	/* Free running counters, only ever
+	 * written by one side each */
+	SDL_atomic_t head;
+	SDL_atomic_t tail;
+};
+
+/* Lock-free queue that any number of threads may push
+ * to, but only one thread pops from. Every slot carries
+ * a sequence number telling whose turn it is to touch it.
+ * 'N' must be a power of two */
+template<typename T, int N>
+struct MPSCQueue
+{
+	MPSCQueue()
+	    : head(0)
+	{
+		for (int i = 0; i < N; ++i)
+			slots[i].seq.store(i, std::memory_order_relaxed);
+
+		tail.store(0, std::memory_order_relaxed);
+	}
+
+	/* Any thread. Returns false if the queue is full */
+	bool push(const T &value)
+	{
+		unsigned int pos = tail.load(std::memory_order_relaxed);
+
+		while (true)
+		{
+			Slot &slot = slots[pos & (N-1)];
+			int diff = (int) (slot.seq.load(std::memory_order_acquire) - pos);
+
+			if (diff < 0)
+				return false;
+
+			if (diff > 0)
+			{
+				/* Another producer got here first */
+				pos = tail.load(std::memory_order_relaxed);
+				continue;
+			}
+
+			if (!tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				continue;
+
+			slot.value = value;
+			slot.seq.store(pos + 1, std::memory_order_release);
+
+			return true;
+		}
+	}
+
+	/* Consumer only. Returns false if the queue is empty,
+	 * or the next value is still being written */
+	bool pop(T &value)
+	{
+		Slot &slot = slots[head & (N-1)];
+
+		if ((int) (slot.seq.load(std::memory_order_acquire) - (head + 1)) < 0)
+			return false;
+
+		value = slot.value;
+		slot.seq.store(head + N, std::memory_order_release);
+		++head;
+
+		return true;
+	}
+
+private:
+	struct Slot
+	{
+		std::atomic<unsigned int> seq;
+		T value;
+	};
+
+	Slot slots[N];
+
+	std::atomic<unsigned int> tail;
+	unsigned int head;
+};
+
+/* Hands the most recent of a series of values from one
+ * thread to another without locking. Each side owns one
+ * of three slots and swaps it with the shared middle one
+ * when done; values that are overwritten before the
+ * reader gets to them are dropped */
+template<typename T>
+struct TripleBuffer
+{
+	TripleBuffer()
+	    : back(1),
+	      front(2)
+	{
+		middle.store(0, std::memory_order_relaxed);
+	}
+
+	/* Writer only */
+	void write(const T &value)
+	{
+		slots[back] = value;
+		back = middle.exchange(back | Fresh, std::memory_order_acq_rel) & IndexMask;
+	}
+
+	/* Reader only. Returns false if nothing was
+	 * written since the last read */
+	bool read(T &value)
+	{
+		if (!(middle.load(std::memory_order_relaxed) & Fresh))
+			return false;
+
+		front = middle.exchange(front, std::memory_order_acq_rel) & IndexMask;
+		value = slots[front];
+
+		return true;
+	}
+
+private:
+	enum
+	{
+		IndexMask = 3,
+		Fresh = 4
+	};
+
+	T slots[3];
+
+	int back;
+	int front;
+
+	/* Index of the middle slot, plus 'Fresh' if
+	 * the writer put it there */
+	std::atomic<int> middle;
+};
+
 template<class C, void (C::*func)()>
 int __sdlThreadFun(void *obj)
 {
@@ -25,6 +25,9 @@
 #include <stdint.h>
 #include <string.h>
 
+#include <string>
+#include <vector>
+
 #include <SDL_endian.h>
 
 #if SDL_BYTEORDER != SDL_LIL_ENDIAN
@@ -67,4 +70,95 @@ writeDouble(char **dataP, double value)
 	*dataP += 8;
 }
 
+/* Growing buffers for the on-disk index files. Strings
+ * are stored with their length in front */
+
+static inline void
+putU32(std::string &buf, uint32_t value)
+{
+	buf.append((const char*) &value, sizeof(value));
+}
+
+static inline void
+putI64(std::string &buf, int64_t value)
+{
+	buf.append((const char*) &value, sizeof(value));
+}
+
+static inline void
+putStr(std::string &buf, const std::string &str)
+{
+	putU32(buf, str.size());
+	buf.append(str);
+}
+
+static inline void
+putStrs(std::string &buf, const std::vector<std::string> &strs)
+{
+	putU32(buf, strs.size());
+
+	for (size_t i = 0; i < strs.size(); ++i)
+		putStr(buf, strs[i]);
+}
+
+/* Reads back what the put* functions wrote. Running past
+ * "end" clears "ok" and yields empty values from then on */
+struct SerialReader
+{
+	const char *p;
+	const char *end;
+	bool ok;
+
+	bool get(void *dst, size_t size)
+	{
+		if (!ok || (size_t) (end - p) < size)
+			return ok = false;
+
+		memcpy(dst, p, size);
+		p += size;
+
+		return true;
+	}
+
+	uint32_t u32()
+	{
+		uint32_t value = 0;
+		get(&value, sizeof(value));
+
+		return value;
+	}
+
+	int64_t i64()
+	{
+		int64_t value = 0;
+		get(&value, sizeof(value));
+
+		return value;
+	}
+
+	std::string str()
+	{
+		uint32_t len = u32();
+
+		if (!ok || (size_t) (end - p) < len)
+		{
+			ok = false;
+			return std::string();
+		}
+
+		std::string str(p, len);
+		p += len;
+
+		return str;
+	}
+
+	void strs(std::vector<std::string> &out)
+	{
+		uint32_t count = u32();
+
+		for (uint32_t i = 0; ok && i < count; ++i)
+			out.push_back(str());
+	}
+};
+
 #endif // SERIALUTIL_H
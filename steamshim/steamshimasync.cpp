@@ -0,0 +1,634 @@
+/*
+** steamshimasync.cpp
+**
+** This file is part of mkxp.
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "steamshimasync.h"
+
+#include "steamshim_child.h"
+#include "sdl-util.h"
+#include "debugwriter.h"
+
+#include <SDL_mutex.h>
+#include <SDL_thread.h>
+#include <SDL_timer.h>
+
+#include <string.h>
+#include <deque>
+#include <map>
+#include <string>
+#include <unordered_map>
+
+namespace SteamShimAsync
+{
+
+/* How long stat and achievement writes are held back,
+ * so that later writes to the same one can replace them */
+static const Uint32 COALESCE_MS = 100;
+
+/* How often the I/O thread looks at the pipe while it
+ * is waiting for replies, and while it isn't */
+static const Uint32 BUSY_POLL_MS = 1;
+static const Uint32 IDLE_POLL_MS = 100;
+
+/* Steamworks doesn't take longer API names than this */
+static const size_t NAME_MAX_LEN = 128;
+
+enum CommandType
+{
+    RequestStats,
+    StoreStats,
+    SetAchievement,
+    GetAchievement,
+    ResetStats,
+    SetStatI,
+    GetStatI,
+    SetStatF,
+    GetStatF
+};
+
+struct Command
+{
+    int type;
+    int ivalue;
+    float fvalue;
+    char name[NAME_MAX_LEN + 1];
+};
+
+/* RGSS thread -> I/O thread */
+static SPSCRing<Command, 256> outbox;
+static SDL_sem *outboxSem;
+
+/* I/O thread -> RGSS thread */
+static SPSCRing<STEAMSHIM_Event, 256> inbox;
+static SDL_sem *inboxSem;
+
+/* Set while the RGSS thread sleeps on 'inboxSem' */
+static AtomicFlag waiting;
+
+static AtomicFlag stopping;
+static AtomicFlag dead;
+
+static SDL_Thread *thread;
+
+/* Everything below up to the RGSS side is
+ * only ever touched by the I/O thread */
+struct IOState
+{
+    /* Writes not sent yet, by "s:" / "a:" + name */
+    std::map<std::string, Command> pending;
+    Uint32 pendingSince;
+
+    /* Replies that didn't fit into the inbox */
+    std::deque<STEAMSHIM_Event> overflow;
+
+    /* Commands sent that haven't been answered */
+    int outstanding;
+};
+
+static void send(IOState &io, const Command &c)
+{
+    switch (c.type)
+    {
+    case RequestStats :
+        STEAMSHIM_requestStats();
+        break;
+    case StoreStats :
+        STEAMSHIM_storeStats();
+        break;
+    case SetAchievement :
+        STEAMSHIM_setAchievement(c.name, c.ivalue);
+        break;
+    case GetAchievement :
+        STEAMSHIM_getAchievement(c.name);
+        break;
+    case ResetStats :
+        STEAMSHIM_resetStats(c.ivalue);
+        break;
+    case SetStatI :
+        STEAMSHIM_setStatI(c.name, c.ivalue);
+        break;
+    case GetStatI :
+        STEAMSHIM_getStatI(c.name);
+        break;
+    case SetStatF :
+        STEAMSHIM_setStatF(c.name, c.fvalue);
+        break;
+    case GetStatF :
+        STEAMSHIM_getStatF(c.name);
+        break;
+    }
+
+    /* The parent answers every command exactly once */
+    ++io.outstanding;
+}
+
+static void flushWrites(IOState &io)
+{
+    std::map<std::string, Command>::const_iterator iter;
+
+    for (iter = io.pending.begin(); iter != io.pending.end(); ++iter)
+        send(io, iter->second);
+
+    io.pending.clear();
+}
+
+static void handleCommand(IOState &io, const Command &c)
+{
+    switch (c.type)
+    {
+    case SetAchievement :
+    case SetStatI :
+    case SetStatF :
+    {
+        /* An int and a float write to the same stat
+         * replace each other as well */
+        std::string key = (c.type == SetAchievement ? "a:" : "s:");
+        key += c.name;
+
+        if (io.pending.empty())
+            io.pendingSince = SDL_GetTicks();
+
+        io.pending[key] = c;
+        break;
+    }
+
+    default :
+        /* Whatever comes next has to see the writes before it */
+        flushWrites(io);
+        send(io, c);
+    }
+}
+
+static void pumpEvents(IOState &io)
+{
+    bool forwarded = false;
+
+    while (!io.overflow.empty() && inbox.push(io.overflow.front()))
+    {
+        io.overflow.pop_front();
+        forwarded = true;
+    }
+
+    while (const STEAMSHIM_Event *e = STEAMSHIM_pump())
+    {
+        if (e->type == SHIMEVENT_BYE)
+            continue;
+
+        if (io.outstanding > 0)
+            --io.outstanding;
+
+        if (!io.overflow.empty() || !inbox.push(*e))
+            io.overflow.push_back(*e);
+        else
+            forwarded = true;
+    }
+
+    if (forwarded && waiting)
+        SDL_SemPost(inboxSem);
+}
+
+static Uint32 pollInterval(const IOState &io)
+{
+    if (io.outstanding > 0 || !io.overflow.empty())
+        return BUSY_POLL_MS;
+
+    if (!io.pending.empty())
+    {
+        Uint32 held = SDL_GetTicks() - io.pendingSince;
+        return (held < COALESCE_MS) ? COALESCE_MS - held : BUSY_POLL_MS;
+    }
+
+    return IDLE_POLL_MS;
+}
+
+static int ioThread(void*)
+{
+    IOState io;
+    io.pendingSince = 0;
+    io.outstanding = 0;
+
+    while (true)
+    {
+        /* Read this before draining, so that nothing
+         * queued ahead of stop() gets dropped */
+        bool stop = stopping;
+
+        Command c;
+        while (outbox.pop(c))
+            handleCommand(io, c);
+
+        if (!io.pending.empty() &&
+            (stop || SDL_GetTicks() - io.pendingSince >= COALESCE_MS))
+            flushWrites(io);
+
+        pumpEvents(io);
+
+        if (!STEAMSHIM_alive())
+        {
+            dead.set();
+            SDL_SemPost(inboxSem);
+            break;
+        }
+
+        if (stop)
+            break;
+
+        SDL_SemWaitTimeout(outboxSem, pollInterval(io));
+    }
+
+    return 0;
+}
+
+/* RGSS side. The caches hold what we last wrote or heard
+ * back for a name, including that it doesn't exist */
+template<typename T>
+struct Cached
+{
+    bool exists;
+    T value;
+};
+
+struct CachedAchievement
+{
+    bool exists;
+    bool achieved;
+
+    /* Unknown until the parent tells us */
+    bool timeKnown;
+    uint64_t unlockTime;
+};
+
+static std::unordered_map<std::string, Cached<int> > statICache;
+static std::unordered_map<std::string, Cached<float> > statFCache;
+static std::unordered_map<std::string, CachedAchievement> achCache;
+
+static void clearCaches()
+{
+    statICache.clear();
+    statFCache.clear();
+    achCache.clear();
+}
+
+static void handleEvent(const STEAMSHIM_Event &e)
+{
+    switch (e.type)
+    {
+    case SHIMEVENT_STATSRECEIVED :
+    case SHIMEVENT_RESETSTATS :
+        clearCaches();
+
+        if (!e.okay)
+            Debug() << "Steam: Failed to"
+                    << (e.type == SHIMEVENT_RESETSTATS ? "reset" : "receive") << "stats";
+        break;
+
+    case SHIMEVENT_STATSSTORED :
+        if (!e.okay)
+            Debug() << "Steam: Failed to store stats";
+        break;
+
+    case SHIMEVENT_SETACHIEVEMENT :
+        if (!e.okay)
+        {
+            Debug() << "Steam: Failed to set achievement" << e.name;
+            achCache.erase(e.name);
+        }
+        break;
+
+    case SHIMEVENT_SETSTATI :
+    case SHIMEVENT_SETSTATF :
+        if (!e.okay)
+        {
+            Debug() << "Steam: Failed to set stat" << e.name;
+            statICache.erase(e.name);
+            statFCache.erase(e.name);
+        }
+        break;
+
+    case SHIMEVENT_GETACHIEVEMENT :
+    {
+        CachedAchievement &ach = achCache[e.name];
+        ach.exists = e.okay;
+        ach.achieved = e.ivalue;
+        ach.timeKnown = true;
+        ach.unlockTime = e.epochsecs;
+        break;
+    }
+
+    case SHIMEVENT_GETSTATI :
+    {
+        Cached<int> &stat = statICache[e.name];
+        stat.exists = e.okay;
+        stat.value = e.ivalue;
+        break;
+    }
+
+    case SHIMEVENT_GETSTATF :
+    {
+        Cached<float> &stat = statFCache[e.name];
+        stat.exists = e.okay;
+        stat.value = e.fvalue;
+        break;
+    }
+
+    default :
+        break;
+    }
+}
+
+static bool prepare(Command &c, int type, const char *name = "")
+{
+    if (!thread || dead)
+        return false;
+
+    size_t len = strlen(name);
+    if (len > NAME_MAX_LEN)
+        return false;
+
+    c.type = type;
+    c.ivalue = 0;
+    c.fvalue = 0;
+    memcpy(c.name, name, len + 1);
+
+    return true;
+}
+
+static bool post(const Command &c)
+{
+    /* Only fills up if the parent stops reading */
+    while (!outbox.push(c))
+    {
+        if (dead)
+            return false;
+
+        SDL_SemPost(outboxSem);
+        SDL_Delay(1);
+    }
+
+    SDL_SemPost(outboxSem);
+
+    return true;
+}
+
+/* Handles replies until the one we're after arrives */
+static bool await(int type, const char *name, STEAMSHIM_Event &out)
+{
+    waiting.set();
+
+    while (true)
+    {
+        /* Whatever was forwarded before the thread
+         * died is in the inbox by now */
+        bool gone = dead;
+
+        STEAMSHIM_Event e;
+        while (inbox.pop(e))
+        {
+            handleEvent(e);
+
+            if (e.type == type && (!name || !strcmp(e.name, name)))
+            {
+                waiting.clear();
+                out = e;
+
+                return true;
+            }
+        }
+
+        if (gone)
+            break;
+
+        SDL_SemWaitTimeout(inboxSem, 10);
+    }
+
+    waiting.clear();
+
+    return false;
+}
+
+static bool request(const Command &c, int replyType, const char *name,
+                    STEAMSHIM_Event &reply)
+{
+    return post(c) && await(replyType, name, reply) && reply.okay;
+}
+
+void start()
+{
+    if (thread)
+        return;
+
+    stopping.clear();
+    dead.clear();
+
+    outboxSem = SDL_CreateSemaphore(0);
+    inboxSem = SDL_CreateSemaphore(0);
+    thread = SDL_CreateThread(ioThread, "steamshim", 0);
+}
+
+void stop()
+{
+    if (!thread)
+        return;
+
+    stopping.set();
+    SDL_SemPost(outboxSem);
+    SDL_WaitThread(thread, 0);
+    thread = 0;
+
+    SDL_DestroySemaphore(outboxSem);
+    SDL_DestroySemaphore(inboxSem);
+
+    clearCaches();
+}
+
+void pump()
+{
+    if (!thread)
+        return;
+
+    STEAMSHIM_Event e;
+    while (inbox.pop(e))
+        handleEvent(e);
+}
+
+bool requestStats()
+{
+    Command c;
+    STEAMSHIM_Event reply;
+
+    return prepare(c, RequestStats) &&
+           request(c, SHIMEVENT_STATSRECEIVED, 0, reply);
+}
+
+bool setStatI(const char *name, int value)
+{
+    Command c;
+    if (!prepare(c, SetStatI, name))
+        return false;
+
+    c.ivalue = value;
+    if (!post(c))
+        return false;
+
+    Cached<int> &stat = statICache[name];
+    stat.exists = true;
+    stat.value = value;
+    statFCache.erase(name);
+
+    return true;
+}
+
+bool setStatF(const char *name, float value)
+{
+    Command c;
+    if (!prepare(c, SetStatF, name))
+        return false;
+
+    c.fvalue = value;
+    if (!post(c))
+        return false;
+
+    Cached<float> &stat = statFCache[name];
+    stat.exists = true;
+    stat.value = value;
+    statICache.erase(name);
+
+    return true;
+}
+
+bool setAchievement(const char *name, bool achieved)
+{
+    Command c;
+    if (!prepare(c, SetAchievement, name))
+        return false;
+
+    c.ivalue = achieved;
+    if (!post(c))
+        return false;
+
+    CachedAchievement &ach = achCache[name];
+    ach.exists = true;
+    ach.achieved = achieved;
+    ach.timeKnown = !achieved;
+    ach.unlockTime = 0;
+
+    return true;
+}
+
+bool storeStats()
+{
+    Command c;
+
+    return prepare(c, StoreStats) && post(c);
+}
+
+bool getStatI(const char *name, int &value)
+{
+    std::unordered_map<std::string, Cached<int> >::const_iterator iter = statICache.find(name);
+
+    if (iter != statICache.end())
+    {
+        value = iter->second.value;
+        return iter->second.exists;
+    }
+
+    Command c;
+    STEAMSHIM_Event reply;
+
+    if (!prepare(c, GetStatI, name) || !request(c, SHIMEVENT_GETSTATI, name, reply))
+        return false;
+
+    value = reply.ivalue;
+
+    return true;
+}
+
+bool getStatF(const char *name, float &value)
+{
+    std::unordered_map<std::string, Cached<float> >::const_iterator iter = statFCache.find(name);
+
+    if (iter != statFCache.end())
+    {
+        value = iter->second.value;
+        return iter->second.exists;
+    }
+
+    Command c;
+    STEAMSHIM_Event reply;
+
+    if (!prepare(c, GetStatF, name) || !request(c, SHIMEVENT_GETSTATF, name, reply))
+        return false;
+
+    value = reply.fvalue;
+
+    return true;
+}
+
+static bool lookupAchievement(const char *name, bool needTime,
+                              bool &achieved, uint64_t &unlockTime)
+{
+    std::unordered_map<std::string, CachedAchievement>::const_iterator iter = achCache.find(name);
+
+    if (iter != achCache.end() && (iter->second.timeKnown || !needTime))
+    {
+        achieved = iter->second.achieved;
+        unlockTime = iter->second.unlockTime;
+        return iter->second.exists;
+    }
+
+    Command c;
+    STEAMSHIM_Event reply;
+
+    if (!prepare(c, GetAchievement, name) ||
+        !request(c, SHIMEVENT_GETACHIEVEMENT, name, reply))
+        return false;
+
+    achieved = reply.ivalue;
+    unlockTime = reply.epochsecs;
+
+    return true;
+}
+
+bool getAchievement(const char *name, bool &achieved)
+{
+    uint64_t unlockTime;
+
+    return lookupAchievement(name, false, achieved, unlockTime);
+}
+
+bool getAchievement(const char *name, bool &achieved, uint64_t &unlockTime)
+{
+    return lookupAchievement(name, true, achieved, unlockTime);
+}
+
+bool resetStats(bool achievementsToo)
+{
+    Command c;
+    if (!prepare(c, ResetStats))
+        return false;
+
+    c.ivalue = achievementsToo;
+
+    /* Writes still held back go out first,
+     * and then get reset along with the rest */
+    STEAMSHIM_Event reply;
+
+    return request(c, SHIMEVENT_RESETSTATS, 0, reply);
+}
+
+}
@@ -0,0 +1,66 @@
+/*
+** steamshimasync.h
+**
+** This file is part of mkxp.
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+/* Talks to the steamshim parent process from a thread of its own,
+ * so that the game never waits on the pipe for writes. Stat and
+ * achievement writes are merged and sent in batches, and values
+ * read back are cached, so only the first read of each one has to
+ * wait for a round trip.
+ *
+ * Everything but start() and stop() is meant to be called from the
+ * RGSS thread only. Once started, nothing else may call into
+ * steamshim_child directly. */
+namespace SteamShimAsync
+{
+    /* After STEAMSHIM_init() succeeded */
+    void start();
+
+    /* Sends off what is still queued, before STEAMSHIM_deinit() */
+    void stop();
+
+    /* Picks up replies that came in since the last call,
+     * without ever blocking. Called once per frame */
+    void pump();
+
+    /* Waits for the parent to load the user's stats */
+    bool requestStats();
+
+    /* These return right away, false if the shim is gone.
+     * Parent side failures end up in the debug log */
+    bool setStatI(const char *name, int value);
+    bool setStatF(const char *name, float value);
+    bool setAchievement(const char *name, bool achieved);
+    bool storeStats();
+
+    /* Only ask the parent (and wait for it) on a cache miss.
+     * Return false if the stat / achievement doesn't exist */
+    bool getStatI(const char *name, int &value);
+    bool getStatF(const char *name, float &value);
+    bool getAchievement(const char *name, bool &achieved);
+
+    /* 'unlockTime' is in seconds since the epoch, 0 if locked */
+    bool getAchievement(const char *name, bool &achieved, uint64_t &unlockTime);
+
+    /* Waits for the parent, and forgets everything cached */
+    bool resetStats(bool achievementsToo);
+}
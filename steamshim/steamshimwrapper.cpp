@@ -9,16 +9,21 @@
 #include "steamshimwrapper.h"
 
 #include "steamshim_child.h"
+#include "steamshimasync.h"
 
 SteamShimWrapper::SteamShimWrapper() {
-    if (STEAMSHIM_init())
+    if (STEAMSHIM_init()) {
+        SteamShimAsync::start();
         startupSucceeded();
+    }
     else
         startupFailed("Failed to initialize Steamworks. The application cannot "
                       "continue launching.");
 }
 
 SteamShimWrapper::~SteamShimWrapper() {
-    if (startedSuccessfully())
+    if (startedSuccessfully()) {
+        SteamShimAsync::stop();
         STEAMSHIM_deinit();
+    }
 }
\ No newline at end of file
@@ -0,0 +1,537 @@
+# Benchmark suite, driving the engine through a number of typical
+# workloads and reporting frame time percentiles for each of them
+# as JSON, so results can be compared between builds (or stored by
+# CI and diffed over time).
+#
+# Every scenario first runs a few warmup frames, then FRAMES measured
+# ones. A frame is the scenario's own per-frame work (moving sprites,
+# drawing text, ...) plus Graphics.update, as it would be in a game.
+#
+# The easiest way to run it is "meson compile bench" (or
+# tests/bench/run-bench.sh <executable>), which sets up a scratch game
+# folder for it and runs it headlessly. To run it by hand, point the
+# "customScript" field in mkxp.json at it and set MKXPZ_HEADLESS=1.
+# The game folder must be writable, generated assets are put into a
+# "BenchAssets" folder in it and removed again afterwards.
+#
+# Environment variables:
+#   MKXPZ_BENCH_OUTPUT     write the JSON there instead of printing it
+#   MKXPZ_BENCH_FRAMES     measured frames per scenario (default: 300)
+#   MKXPZ_BENCH_SCENARIOS  comma separated subset of scenarios to run
+
+FRAMES = (ENV['MKXPZ_BENCH_FRAMES'] || 300).to_i
+WARMUP = 30
+
+ASSET_DIR = 'BenchAssets'
+
+RGSS1 = Tilemap.method_defined?(:tileset)
+
+def now
+	Process.clock_gettime(Process::CLOCK_MONOTONIC)
+end
+
+def percentile(sorted, p)
+	sorted[[(sorted.size * p).ceil - 1, 0].max]
+end
+
+def to_json(value)
+	case value
+	when Hash
+		'{' + value.map { |k, v| "#{k.to_s.inspect}: #{to_json(v)}" }.join(', ') + '}'
+	when Array
+		'[' + value.map { |v| to_json(v) }.join(', ') + ']'
+	when Float
+		'%.4f' % value
+	when String, Symbol
+		value.to_s.inspect
+	when nil
+		'null'
+	else
+		value.to_s
+	end
+end
+
+def solid_bitmap(w, h, seed)
+	b = Bitmap.new(w, h)
+	b.fill_rect(b.rect, Color.new(seed * 37 % 256, seed * 71 % 256, seed * 113 % 256))
+	b.fill_rect(2, 2, w - 4, h - 4, Color.new(seed * 53 % 256, 128, 255 - seed * 29 % 256, 192))
+	b
+end
+
+# Generated assets
+
+def write_wav(path)
+	rate = 22050
+	samples = (0...rate / 10).map { |i| (Math.sin(i * 440.0 * 2 * Math::PI / rate) * 8000).round }
+	data = samples.pack('s<*')
+
+	File.open(path, 'wb') do |f|
+		f.write(['RIFF', 36 + data.bytesize, 'WAVE'].pack('a4Va4'))
+		f.write(['fmt ', 16, 1, 1, rate, rate * 2, 2, 16].pack('a4VvvVVvv'))
+		f.write(['data', data.bytesize].pack('a4V'))
+		f.write(data)
+	end
+end
+
+# Same (obfuscated) format as Game.rgssad, read by src/crypto/rgssad.cpp
+def write_rgssad(path, files)
+	magic = 0xDEADCAFE
+	advance = lambda do
+		old = magic
+		magic = (magic * 7 + 3) & 0xFFFFFFFF
+		old
+	end
+
+	out = "RGSSAD\0\x01".b
+
+	files.each do |name, data|
+		out << [name.bytesize ^ advance.call].pack('V')
+		out << name.bytes.map { |c| c ^ (advance.call & 0xFF) }.pack('C*')
+		out << [data.bytesize ^ advance.call].pack('V')
+
+		m = magic
+		padded = data.b + "\0" * (-data.bytesize % 4)
+		words = padded.unpack('V*').map do |w|
+			w ^= m
+			m = (m * 7 + 3) & 0xFFFFFFFF
+			w
+		end
+		out << words.pack('V*')[0, data.bytesize]
+	end
+
+	File.open(path, 'wb') { |f| f.write(out) }
+end
+
+ARCHIVE_IMAGES = 64
+
+def setup_assets
+	Dir.mkdir(ASSET_DIR) unless File.directory?(ASSET_DIR)
+	Dir.mkdir("#{ASSET_DIR}/Audio") unless File.directory?("#{ASSET_DIR}/Audio")
+
+	write_wav("#{ASSET_DIR}/Audio/bench_se.wav")
+
+	files = (0...ARCHIVE_IMAGES).map do |i|
+		png = "#{ASSET_DIR}/tmp_#{i}.png"
+		b = solid_bitmap(96 + i % 4 * 32, 128, i)
+		b.to_file(png)
+		b.dispose
+		data = File.open(png, 'rb') { |f| f.read }
+		File.delete(png)
+		["BenchArchive/image_#{i}.png", data]
+	end
+
+	write_rgssad("#{ASSET_DIR}/bench.rgssad", files)
+
+	System.mount(ASSET_DIR)
+	System.mount("#{ASSET_DIR}/bench.rgssad")
+end
+
+def remove_assets
+	System.unmount("#{ASSET_DIR}/bench.rgssad")
+	System.unmount(ASSET_DIR)
+
+	File.delete("#{ASSET_DIR}/bench.rgssad")
+	File.delete("#{ASSET_DIR}/Audio/bench_se.wav")
+	Dir.rmdir("#{ASSET_DIR}/Audio")
+	Dir.rmdir(ASSET_DIR)
+end
+
+# Scenarios. Each returns an object responding to 'frame(i)'
+# and 'dispose'
+
+class SpriteScenario
+	COUNT = 2000
+
+	def initialize
+		@bitmaps = (0...16).map { |i| solid_bitmap(32, 32, i) }
+		@sprites = (0...COUNT).map do |i|
+			s = Sprite.new
+			s.bitmap = @bitmaps[i % 16]
+			s.ox = s.oy = 16
+			s.z = i
+			s
+		end
+	end
+
+	def frame(f)
+		w = Graphics.width
+		h = Graphics.height
+		@sprites.each_with_index do |s, i|
+			s.x = (i * 7 + f * (1 + i % 5)) % w
+			s.y = (i * 13 + f * (1 + i % 3)) % h
+			s.angle = (f + i) % 360 if i % 8 == 0
+			s.opacity = 128 + (f + i) % 128 if i % 4 == 0
+		end
+	end
+
+	def dispose
+		@sprites.each(&:dispose)
+		@bitmaps.each(&:dispose)
+	end
+end
+
+class TilemapScenario
+	SIZE = 200
+
+	def initialize
+		@viewport = Viewport.new(0, 0, Graphics.width, Graphics.height)
+		@tilemap = Tilemap.new(@viewport)
+		@bitmaps = []
+
+		if RGSS1
+			setup_xp
+		else
+			setup_vx
+		end
+	end
+
+	def setup_xp
+		tileset = Bitmap.new(256, 32 * 32)
+		(0...8 * 32).each do |i|
+			tileset.fill_rect(i % 8 * 32, i / 8 * 32, 32, 32,
+			                  Color.new(i * 37 % 256, i * 11 % 256, i * 5 % 256, i % 3 == 0 ? 128 : 255))
+		end
+		@bitmaps << tileset
+		@tilemap.tileset = tileset
+
+		(0...7).each do |i|
+			b = solid_bitmap(96, 128, i)
+			@bitmaps << b
+			@tilemap.autotiles[i] = b
+		end
+
+		priorities = Table.new(384 + 8 * 32)
+		(384...priorities.xsize).each { |id| priorities[id] = id % 11 == 0 ? 1 : 0 }
+		@tilemap.priorities = priorities
+
+		map = Table.new(SIZE, SIZE, 3)
+		(0...SIZE).each do |y|
+			(0...SIZE).each do |x|
+				map[x, y, 0] = 48 + (x + y) % 7 * 48 + (x * y) % 47
+				map[x, y, 1] = (x * 3 + y) % 5 == 0 ? 384 + (x + y * 3) % 256 : 0
+				map[x, y, 2] = (x + y * 7) % 13 == 0 ? 384 + (x * y) % 256 : 0
+			end
+		end
+		@tilemap.map_data = map
+	end
+
+	def setup_vx
+		(0...9).each do |i|
+			b = solid_bitmap(512, 512, i)
+			@bitmaps << b
+			@tilemap.bitmaps[i] = b
+		end
+
+		flags = Table.new(8192)
+		(0...8192).each { |id| flags[id] = id % 17 == 0 ? 0x10 : 0 }
+		@tilemap.flags = flags if @tilemap.respond_to?(:flags=)
+		@tilemap.passages = flags if @tilemap.respond_to?(:passages=)
+
+		map = Table.new(SIZE, SIZE, 4)
+		(0...SIZE).each do |y|
+			(0...SIZE).each do |x|
+				map[x, y, 0] = 2048 + ((x + y) % 16) * 48 + (x * y) % 47
+				map[x, y, 1] = (x * 3 + y) % 5 == 0 ? 1536 + (x + y) % 128 : 0
+				map[x, y, 2] = (x + y * 7) % 13 == 0 ? (x * y) % 256 : 0
+			end
+		end
+		@tilemap.map_data = map
+	end
+
+	def frame(f)
+		# Diagonal scroll, two pixels a frame
+		@tilemap.ox = f * 2 % (SIZE * 32 - Graphics.width)
+		@tilemap.oy = f * 2 % (SIZE * 32 - Graphics.height)
+		@tilemap.update
+	end
+
+	def dispose
+		@tilemap.dispose
+		@viewport.dispose
+		@bitmaps.each(&:dispose)
+	end
+end
+
+class TextScenario
+	WINDOWS = 3
+	LINES = 14
+
+	def initialize
+		@skin = solid_bitmap(192, 128, 3)
+		h = Graphics.height / WINDOWS
+		@windows = (0...WINDOWS).map do |i|
+			w = Window.new
+			w.windowskin = @skin
+			w.x = 0
+			w.y = i * h
+			w.width = Graphics.width
+			w.height = h
+			w.contents = Bitmap.new(w.width - 32, LINES * 24)
+			w
+		end
+	end
+
+	def frame(f)
+		@windows.each_with_index do |w, i|
+			c = w.contents
+			c.clear
+			(0...LINES).each do |l|
+				# Changes every frame, like a counter or a typewriter effect
+				c.draw_text(0, l * 24, c.width, 24, "Window #{i} line #{l}: #{f * 31 + l} gold", l % 3)
+			end
+			w.oy = f % (LINES * 24 - w.height + 32)
+		end
+	end
+
+	def dispose
+		@windows.each do |w|
+			w.contents.dispose
+			w.dispose
+		end
+		@skin.dispose
+	end
+end
+
+# A mostly static menu screen: a few windows of text and a grid of
+# icons that never change, with only a cursor moving over them
+class MenuScenario
+	WINDOWS = 4
+	ICONS = 48
+
+	def initialize
+		@skin = solid_bitmap(192, 128, 5)
+		@icon_bitmaps = (0...8).map { |i| solid_bitmap(24, 24, i) }
+		@viewport = Viewport.new(0, 0, Graphics.width, Graphics.height)
+		@viewport.cache = cached? if @viewport.respond_to?(:cache=)
+
+		w = Graphics.width / 2
+		h = Graphics.height / 2
+		@windows = (0...WINDOWS).map do |i|
+			win = Window.new
+			win.viewport = @viewport
+			win.windowskin = @skin
+			win.x = i % 2 * w
+			win.y = i / 2 * h
+			win.width = w
+			win.height = h
+			win.contents = Bitmap.new(w - 32, h - 32)
+			(0...(h - 32) / 24).each do |l|
+				win.contents.draw_text(0, l * 24, w - 32, 24, "Item #{i * 10 + l}")
+			end
+			win
+		end
+
+		@icons = (0...ICONS).map do |i|
+			s = Sprite.new(@viewport)
+			s.bitmap = @icon_bitmaps[i % 8]
+			s.x = w - 112 + i % 4 * 26
+			s.y = 16 + i / 4 * 26
+			s.z = 200
+			s
+		end
+
+		@cursor_viewport = Viewport.new(0, 0, Graphics.width, Graphics.height)
+		@cursor_viewport.z = 1
+		@cursor = Sprite.new(@cursor_viewport)
+		@cursor.bitmap = solid_bitmap(w - 32, 24, 9)
+		@cursor.opacity = 128
+	end
+
+	def cached?
+		false
+	end
+
+	def frame(f)
+		@cursor.x = 16 + f / 30 % 2 * Graphics.width / 2
+		@cursor.y = 16 + f / 10 % 8 * 24
+	end
+
+	def dispose
+		@cursor.bitmap.dispose
+		@cursor.dispose
+		@cursor_viewport.dispose
+		@icons.each(&:dispose)
+		@windows.each do |w|
+			w.contents.dispose
+			w.dispose
+		end
+		@viewport.dispose
+		@icon_bitmaps.each(&:dispose)
+		@skin.dispose
+	end
+end
+
+# Same, with the static part kept in a Viewport#cache
+class CachedMenuScenario < MenuScenario
+	def cached?
+		true
+	end
+end
+
+class BltScenario
+	BLTS = 500
+	STRETCHES = 50
+
+	def initialize
+		@sources = (0...8).map { |i| solid_bitmap(64, 64, i) }
+		@canvas = Bitmap.new(Graphics.width, Graphics.height)
+		@sprite = Sprite.new
+		@sprite.bitmap = @canvas
+	end
+
+	def frame(f)
+		w = @canvas.width - 64
+		h = @canvas.height - 64
+		@canvas.clear
+		(0...BLTS).each do |i|
+			n = f * BLTS + i
+			@canvas.blt(n * 7 % w, n * 13 % h, @sources[i % 8], @sources[i % 8].rect,
+			            i % 3 == 0 ? 255 : 64 + n % 192)
+		end
+		(0...STRETCHES).each do |i|
+			n = f * STRETCHES + i
+			@canvas.stretch_blt(Rect.new(n * 11 % w, n * 17 % h, 32 + n % 96, 32 + n % 64),
+			                    @sources[i % 8], @sources[i % 8].rect, 128 + n % 128)
+		end
+	end
+
+	def dispose
+		@sprite.dispose
+		@canvas.dispose
+		@sources.each(&:dispose)
+	end
+end
+
+class TableScenario
+	WRITES = 100_000
+
+	def initialize
+		@table = Table.new(300, 300, 3)
+		@copies = []
+	end
+
+	def frame(f)
+		t = @table
+		(0...WRITES).each do |i|
+			n = f * WRITES + i
+			t[n % 300, n / 300 % 300, n % 3] = t[(n + 1) % 300, n / 300 % 300, 0] + 1
+		end
+		# Marshal round trips, as saving and map transfers do
+		@copies << Marshal.load(Marshal.dump(t)) if f % 10 == 0
+		@copies.shift if @copies.size > 4
+		t.resize(300 + f % 2, 300, 3) if f % 50 == 0
+	end
+
+	def dispose
+		@copies.clear
+	end
+end
+
+class SEScenario
+	PER_FRAME = 4
+
+	def frame(f)
+		PER_FRAME.times { |i| Audio.se_play('Audio/bench_se', 80, 50 + (f + i) % 100) }
+		Audio.se_stop if f % 60 == 59
+	end
+
+	def dispose
+		Audio.se_stop
+	end
+end
+
+class ArchiveScenario
+	PER_FRAME = 4
+
+	def initialize
+		@sprites = (0...PER_FRAME).map { Sprite.new }
+	end
+
+	def frame(f)
+		@sprites.each_with_index do |s, i|
+			s.bitmap.dispose if s.bitmap
+			s.bitmap = Bitmap.new("BenchArchive/image_#{(f * PER_FRAME + i) % ARCHIVE_IMAGES}")
+			s.x = i * 128
+		end
+	end
+
+	def dispose
+		@sprites.each do |s|
+			s.bitmap.dispose if s.bitmap
+			s.dispose
+		end
+	end
+end
+
+SCENARIOS = {
+	'sprites'     => SpriteScenario,
+	'tilemap'     => TilemapScenario,
+	'text'        => TextScenario,
+	'blt'         => BltScenario,
+	'menu'        => MenuScenario,
+	'menu_cached' => CachedMenuScenario,
+	'table'       => TableScenario,
+	'se'          => SEScenario,
+	'archive'     => ArchiveScenario,
+}
+
+def run_scenario(name, klass)
+	scenario = klass.new
+	times = []
+	gl = nil
+
+	(WARMUP + FRAMES).times do |f|
+		start = now
+		scenario.frame(f)
+		Graphics.update
+		times << (now - start) * 1000 if f >= WARMUP
+		gl = Graphics.gl_stats if f == WARMUP + FRAMES - 1
+	end
+
+	scenario.dispose
+	GC.start
+	Graphics.update
+
+	sorted = times.sort
+	{
+		:name => name,
+		:frames => FRAMES,
+		:mean_ms => times.inject(:+) / times.size,
+		:p50_ms => percentile(sorted, 0.50),
+		:p95_ms => percentile(sorted, 0.95),
+		:p99_ms => percentile(sorted, 0.99),
+		:max_ms => sorted.last,
+		:gl => gl,
+	}
+rescue StandardError => e
+	{ :name => name, :error => "#{e.class}: #{e.message}" }
+end
+
+wanted = ENV['MKXPZ_BENCH_SCENARIOS']
+wanted = wanted ? wanted.split(',').map(&:strip) : SCENARIOS.keys
+
+setup_assets
+
+Graphics.update
+
+results = wanted.map do |name|
+	klass = SCENARIOS[name]
+	next { :name => name, :error => 'unknown scenario' } unless klass
+	run_scenario(name, klass)
+end
+
+remove_assets
+
+json = to_json({
+	:rgss_version => RGSS1 ? 1 : (defined?(RGSS_VERSION) ? 3 : 2),
+	:resolution => [Graphics.width, Graphics.height],
+	:scenarios => results,
+})
+
+if ENV['MKXPZ_BENCH_OUTPUT']
+	File.open(ENV['MKXPZ_BENCH_OUTPUT'], 'w') { |f| f.write(json + "\n") }
+else
+	System::puts(json)
+end
+
+exit
@@ -0,0 +1,346 @@
+/*
+** messaging-bench.cpp
+**
+** This file is part of mkxp.
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Stress test for the primitives the event and RGSS threads
+ * talk through. Producers hammer a TripleBuffer / MPSCQueue
+ * (and the mutex based versions they replaced) while one
+ * consumer polls them like Graphics::update and Input::update
+ * do, only without pausing between frames. Reports how long
+ * each poll takes, and how long a value sits before the
+ * consumer sees it. Exits with 1 if values go missing, get
+ * duplicated or arrive out of order.
+ *
+ * Usage: messaging-bench [values per producer] [producers] */
+
+#include "sdl-util.h"
+
+#include <SDL_mutex.h>
+#include <SDL_timer.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <deque>
+#include <vector>
+
+struct Message
+{
+	int producer;
+	int seq;
+	Uint64 ticks;
+};
+
+/* UnidirMessage as it used to be */
+struct LockedMessage
+{
+	LockedMessage()
+	    : mutex(SDL_CreateMutex())
+	{}
+
+	~LockedMessage()
+	{
+		SDL_DestroyMutex(mutex);
+	}
+
+	void write(const Message &value)
+	{
+		SDL_LockMutex(mutex);
+		changed.set();
+		current = value;
+		SDL_UnlockMutex(mutex);
+	}
+
+	bool read(Message &out)
+	{
+		if (!changed)
+			return false;
+
+		SDL_LockMutex(mutex);
+		out = current;
+		changed.clear();
+		SDL_UnlockMutex(mutex);
+
+		return true;
+	}
+
+	SDL_mutex *mutex;
+	AtomicFlag changed;
+	Message current;
+};
+
+/* A mutex guarded queue, like the text input buffer was */
+template<int N>
+struct LockedQueue
+{
+	LockedQueue()
+	    : mutex(SDL_CreateMutex())
+	{}
+
+	~LockedQueue()
+	{
+		SDL_DestroyMutex(mutex);
+	}
+
+	bool push(const Message &value)
+	{
+		SDL_LockMutex(mutex);
+		bool room = items.size() < N;
+		if (room)
+			items.push_back(value);
+		SDL_UnlockMutex(mutex);
+
+		return room;
+	}
+
+	bool pop(Message &out)
+	{
+		SDL_LockMutex(mutex);
+		bool any = !items.empty();
+		if (any)
+		{
+			out = items.front();
+			items.pop_front();
+		}
+		SDL_UnlockMutex(mutex);
+
+		return any;
+	}
+
+	SDL_mutex *mutex;
+	std::deque<Message> items;
+};
+
+static int valueCount = 50000;
+static int producerCount = 3;
+
+struct Stats
+{
+	Uint64 pollTicks;
+	Uint64 polls;
+
+	Uint64 latencyTicks;
+	Uint64 maxLatency;
+	Uint64 received;
+
+	bool failed;
+
+	void add(const Message &m, Uint64 now)
+	{
+		Uint64 latency = now - m.ticks;
+		latencyTicks += latency;
+		maxLatency = std::max(maxLatency, latency);
+		++received;
+	}
+};
+
+template<class Channel>
+struct Run
+{
+	Channel channel;
+	SDL_atomic_t producersLeft;
+	SDL_atomic_t nextProducer;
+
+	static int produceLatest(void *data)
+	{
+		Run *run = static_cast<Run*>(data);
+
+		for (int i = 0; i < valueCount; ++i)
+		{
+			Message m = { 0, i, SDL_GetPerformanceCounter() };
+			run->channel.write(m);
+		}
+
+		SDL_AtomicAdd(&run->producersLeft, -1);
+
+		return 0;
+	}
+
+	static int produceQueued(void *data)
+	{
+		Run *run = static_cast<Run*>(data);
+		int producer = SDL_AtomicAdd(&run->nextProducer, 1);
+
+		for (int i = 0; i < valueCount; ++i)
+		{
+			Message m = { producer, i, 0 };
+
+			do
+				m.ticks = SDL_GetPerformanceCounter();
+			while (!run->channel.push(m));
+		}
+
+		SDL_AtomicAdd(&run->producersLeft, -1);
+
+		return 0;
+	}
+};
+
+static double toUs(Uint64 ticks)
+{
+	return ticks * 1000000.0 / SDL_GetPerformanceFrequency();
+}
+
+static void report(const char *name, const Stats &st)
+{
+	printf("%-18s %10.3f %12.3f %12.3f %10llu%s\n", name,
+	       toUs(st.pollTicks) / std::max<Uint64>(st.polls, 1),
+	       toUs(st.latencyTicks) / std::max<Uint64>(st.received, 1),
+	       toUs(st.maxLatency), (unsigned long long) st.received,
+	       st.failed ? "  FAILED" : "");
+}
+
+/* One writer, the reader only ever wants the newest value
+ * (window and drawable size) */
+template<class Channel>
+static Stats runLatest()
+{
+	Run<Channel> *run = new Run<Channel>;
+	SDL_AtomicSet(&run->producersLeft, 1);
+
+	Stats st = Stats();
+	int last = -1;
+
+	SDL_Thread *thread = SDL_CreateThread(Run<Channel>::produceLatest, "producer", run);
+
+	while (true)
+	{
+		bool done = SDL_AtomicGet(&run->producersLeft) == 0;
+
+		Message m;
+		Uint64 start = SDL_GetPerformanceCounter();
+		bool got = run->channel.read(m);
+		Uint64 now = SDL_GetPerformanceCounter();
+
+		st.pollTicks += now - start;
+		++st.polls;
+
+		if (got)
+		{
+			if (m.seq <= last)
+				st.failed = true;
+
+			last = m.seq;
+			st.add(m, now);
+		}
+		else if (done)
+		{
+			break;
+		}
+	}
+
+	SDL_WaitThread(thread, 0);
+
+	/* The final value must always make it through */
+	if (last != valueCount - 1)
+		st.failed = true;
+
+	delete run;
+
+	return st;
+}
+
+/* Several writers, every value has to arrive
+ * (text input, controller hotplug) */
+template<class Channel>
+static Stats runQueued()
+{
+	Run<Channel> *run = new Run<Channel>;
+	SDL_AtomicSet(&run->producersLeft, producerCount);
+	SDL_AtomicSet(&run->nextProducer, 0);
+
+	Stats st = Stats();
+	std::vector<int> next(producerCount, 0);
+	std::vector<SDL_Thread*> threads;
+
+	for (int i = 0; i < producerCount; ++i)
+		threads.push_back(SDL_CreateThread(Run<Channel>::produceQueued, "producer", run));
+
+	while (true)
+	{
+		bool done = SDL_AtomicGet(&run->producersLeft) == 0;
+
+		Message m;
+		Uint64 start = SDL_GetPerformanceCounter();
+		bool got = run->channel.pop(m);
+		Uint64 now = SDL_GetPerformanceCounter();
+
+		st.pollTicks += now - start;
+		++st.polls;
+
+		if (!got)
+		{
+			if (done)
+				break;
+
+			continue;
+		}
+
+		/* Values of one producer must stay in order */
+		if (m.producer < 0 || m.producer >= producerCount)
+		{
+			st.failed = true;
+			continue;
+		}
+
+		if (m.seq != next[m.producer])
+			st.failed = true;
+
+		next[m.producer] = m.seq + 1;
+		st.add(m, now);
+	}
+
+	if (st.received != (Uint64) valueCount * producerCount)
+		st.failed = true;
+
+	for (size_t i = 0; i < threads.size(); ++i)
+		SDL_WaitThread(threads[i], 0);
+
+	delete run;
+
+	return st;
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc > 1)
+		valueCount = std::max(atoi(argv[1]), 1);
+	if (argc > 2)
+		producerCount = std::max(atoi(argv[2]), 1);
+
+	printf("%d values per producer, %d queue producers\n\n", valueCount, producerCount);
+	printf("%-18s %10s %12s %12s %10s\n",
+	       "channel", "poll us", "latency us", "max lat us", "received");
+
+	Stats st[4];
+	st[0] = runLatest<LockedMessage>();
+	st[1] = runLatest<TripleBuffer<Message> >();
+	st[2] = runQueued<LockedQueue<256> >();
+	st[3] = runQueued<MPSCQueue<Message, 256> >();
+
+	report("mutex message", st[0]);
+	report("triple buffer", st[1]);
+	report("mutex queue", st[2]);
+	report("mpsc queue", st[3]);
+
+	for (int i = 0; i < 4; ++i)
+		if (st[i].failed)
+			return 1;
+
+	return 0;
+}
@@ -0,0 +1,159 @@
+/*
+** pixelkernels-bench.cpp
+**
+** This file is part of mkxp.
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Times every PixelKernels function under each implementation
+ * the CPU supports, and checks that they all agree with the
+ * scalar one. Exits with 1 on a mismatch.
+ *
+ * Usage: pixelkernels-bench [iterations] */
+
+#include "pixelkernels.h"
+
+#include <SDL_timer.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+using namespace PixelKernels;
+
+#define WIDTH 1024
+#define HEIGHT 1024
+
+static const char *isas[] = { "scalar", "sse2", "avx2", "neon" };
+
+/* Mix of transparent, opaque and in between pixels,
+ * like antialiased text produces */
+static std::vector<uint32_t> randomPixels(size_t count)
+{
+	std::vector<uint32_t> pixels(count);
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		uint32_t p = (uint32_t) rand() ^ ((uint32_t) rand() << 16);
+
+		switch (rand() % 4)
+		{
+		case 0 : p |= 0xFF000000; break;
+		case 1 : p &= 0x00FFFFFF; break;
+		}
+
+		pixels[i] = p;
+	}
+
+	return pixels;
+}
+
+struct Results
+{
+	std::vector<uint32_t> blend;
+	std::vector<uint32_t> swizzle;
+	std::vector<uint32_t> shadow;
+	std::vector<uint32_t> downsample;
+	BoxSums sums;
+};
+
+static double msSince(Uint64 start, int iterations)
+{
+	return (SDL_GetPerformanceCounter() - start) * 1000.0 /
+	       SDL_GetPerformanceFrequency() / iterations;
+}
+
+int main(int argc, char *argv[])
+{
+	int iterations = argc > 1 ? atoi(argv[1]) : 20;
+	if (iterations < 1)
+		iterations = 1;
+
+	const size_t count = WIDTH * HEIGHT;
+
+	std::vector<uint32_t> src = randomPixels(count);
+	std::vector<uint32_t> dst = randomPixels(count);
+	std::vector<uint32_t> shadow = randomPixels(count);
+
+	Results ref;
+	bool mismatch = false;
+
+	printf("%d x %d pixels, ms per call\n\n", WIDTH, HEIGHT);
+	printf("%-8s %10s %10s %10s %10s %10s\n",
+	       "isa", "blend", "swizzle", "shadow", "boxsums", "downsample");
+
+	for (size_t i = 0; i < sizeof(isas) / sizeof(*isas); ++i)
+	{
+		if (!selectIsa(isas[i]))
+			continue;
+
+		Results res;
+		res.swizzle.resize(count);
+		res.shadow.resize(count);
+		res.downsample.resize(count / 9);
+
+		Uint64 start = SDL_GetPerformanceCounter();
+		for (int j = 0; j < iterations; ++j)
+		{
+			res.blend = dst;
+			blendOver(res.blend.data(), src.data(), count);
+		}
+		double blendMs = msSince(start, iterations);
+
+		start = SDL_GetPerformanceCounter();
+		for (int j = 0; j < iterations; ++j)
+			swizzleRB(res.swizzle.data(), src.data(), count);
+		double swizzleMs = msSince(start, iterations);
+
+		start = SDL_GetPerformanceCounter();
+		for (int j = 0; j < iterations; ++j)
+			shadowCompose(res.shadow.data(), src.data(), shadow.data(), 0x00C08040, count);
+		double shadowMs = msSince(start, iterations);
+
+		start = SDL_GetPerformanceCounter();
+		for (int j = 0; j < iterations; ++j)
+			boxSums(src.data(), WIDTH, WIDTH, HEIGHT, res.sums);
+		double sumsMs = msSince(start, iterations);
+
+		start = SDL_GetPerformanceCounter();
+		for (int j = 0; j < iterations; ++j)
+			boxDownsample(res.downsample.data(), WIDTH / 3, WIDTH / 3, HEIGHT / 3,
+			              src.data(), WIDTH, WIDTH, HEIGHT);
+		double downsampleMs = msSince(start, iterations);
+
+		printf("%-8s %10.3f %10.3f %10.3f %10.3f %10.3f\n",
+		       isas[i], blendMs, swizzleMs, shadowMs, sumsMs, downsampleMs);
+
+		if (i == 0)
+		{
+			ref = res;
+			continue;
+		}
+
+		if (res.blend != ref.blend || res.swizzle != ref.swizzle ||
+		    res.shadow != ref.shadow || res.downsample != ref.downsample ||
+		    memcmp(&res.sums, &ref.sums, sizeof(res.sums)))
+		{
+			fprintf(stderr, "%s: results differ from scalar\n", isas[i]);
+			mismatch = true;
+		}
+	}
+
+	selectIsa(0);
+	printf("\ndefault: %s\n", isa());
+
+	return mismatch ? 1 : 0;
+}
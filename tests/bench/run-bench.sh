@@ -0,0 +1,45 @@
+#!/bin/sh
+# Runs bench.rb headlessly in a scratch game folder.
+#
+# Usage: run-bench.sh <mkxp-z executable> [results.json]
+#
+# MKXPZ_BENCH_RGSS selects the RGSS version to run under (default: 1),
+# the other MKXPZ_BENCH_* variables are passed on to bench.rb.
+
+set -e
+
+if [ -z "$1" ]; then
+	echo "usage: $0 <mkxp-z executable> [results.json]" >&2
+	exit 1
+fi
+
+here=$(cd "$(dirname "$0")" && pwd)
+exe=$(cd "$(dirname "$1")" && pwd)/$(basename "$1")
+
+game=$(mktemp -d)
+trap 'rm -rf "$game"' EXIT
+
+cp "$here/bench.rb" "$game/"
+cat > "$game/mkxp.json" <<JSON
+{
+	"customScript": "bench.rb",
+	"rgssVersion": ${MKXPZ_BENCH_RGSS:-1},
+	"headless": true,
+	"fixedFramerate": -1
+}
+JSON
+
+# Also request headless mode through the environment, which the
+# engine checks before it touches SDL video at all
+SRCDIR="$game" MKXPZ_HEADLESS=1 MKXPZ_BENCH_OUTPUT="$game/results.json" "$exe"
+
+if [ ! -f "$game/results.json" ]; then
+	echo "$0: the benchmark run produced no results" >&2
+	exit 1
+fi
+
+if [ -n "$2" ]; then
+	cp "$game/results.json" "$2"
+fi
+
+cat "$game/results.json"
@@ -0,0 +1,112 @@
+# Conformance test for Bitmap#stretch_blt's blended blits.
+# Semi-transparent blits, and blits onto areas that were already
+# drawn on, don't always go through a copy of the destination:
+#  - onto an untouched area, the source is drawn directly with its
+#    alpha scaled by the opacity
+#  - onto a touched area, with GL_ARB_texture_barrier the destination
+#    is read back from the bitmap's own texture
+# Every case here is rendered once like that, and once through the
+# copy, which a blit from a bitmap onto itself always takes. Both
+# must come out the same.
+#
+# Without texture barrier support, the "tainted" cases compare the
+# copy path against itself and trivially pass.
+#
+# Run it via the "customScript" field in mkxp.json.
+# For unattended (CI) runs, set MKXPZ_HEADLESS=1.
+
+W = 64
+H = 48
+
+# Both paths round differently (shader vs. blending math)
+TOLERANCE = 1
+
+# Opaque gradients with a patch of varying alpha in the middle
+def pattern(w, h, seed)
+	b = Bitmap.new(w, h)
+	h.times do |y|
+		w.times do |x|
+			alpha = (x >= w / 4 && x < w * 3 / 4) ? (x * 255 / w + y * 7 + seed) % 256 : 255
+			b.set_pixel(x, y, Color.new((x * 4 + seed) % 256, (y * 5 + seed * 3) % 256,
+			                            (x * y + seed * 7) % 256, alpha))
+		end
+	end
+	b
+end
+
+def max_diff(a, b, rect)
+	diff = 0
+	rect.height.times do |y|
+		rect.width.times do |x|
+			ca = a.get_pixel(rect.x + x, rect.y + y)
+			cb = b.get_pixel(rect.x + x, rect.y + y)
+			diff = [diff, (ca.red - cb.red).abs, (ca.green - cb.green).abs,
+			        (ca.blue - cb.blue).abs, (ca.alpha - cb.alpha).abs].max
+		end
+	end
+	diff
+end
+
+# The destination is placed to the right of a W*H area,
+# where the reference bitmap keeps its own copy of "src"
+def run_case(desc, src, background, dest, opacity)
+	canvas_w = W + dest.x + dest.width
+	canvas_h = [H, dest.y + dest.height].max
+
+	# Path under test
+	bmp = Bitmap.new(canvas_w, canvas_h)
+	if background
+		bmp.blt(dest.x + W, dest.y, background, background.rect)
+	end
+	target = Rect.new(dest.x + W, dest.y, dest.width, dest.height)
+	bmp.stretch_blt(target, src, src.rect, opacity)
+
+	# Reference, through the copy
+	ref = Bitmap.new(canvas_w, canvas_h)
+	ref.blt(0, 0, src, src.rect)
+	if background
+		ref.blt(dest.x + W, dest.y, background, background.rect)
+	else
+		# Still fully transparent, but no longer untouched
+		ref.set_pixel(target.x, target.y, Color.new(0, 0, 0, 0))
+	end
+	ref.stretch_blt(target, ref, Rect.new(0, 0, W, H), opacity)
+
+	diff = max_diff(bmp, ref, target)
+	ok = diff <= TOLERANCE
+	System::puts("%s %-40s max diff %d" % [ok ? "PASS" : "FAIL", desc, diff])
+
+	bmp.dispose
+	ref.dispose
+
+	ok
+end
+
+src = pattern(W, H, 0)
+background = pattern(W * 2, H * 2, 91)
+
+dests = {
+	"same size" => Rect.new(0, 0, W, H),
+	"offset" => Rect.new(5, 3, W, H),
+	"stretched 2x" => Rect.new(7, 2, W * 2, H * 2),
+}
+
+failed = 0
+total = 0
+
+[32, 128, 200, 255].each do |opacity|
+	dests.each do |name, dest|
+		[false, true].each do |tainted|
+			# Opaque blits onto untouched areas are plain copies
+			next if opacity == 255 && !tainted
+
+			desc = "%s, %s, opacity %d" % [tainted ? "tainted" : "untainted", name, opacity]
+			total += 1
+			failed += 1 unless run_case(desc, src, tainted ? background : nil, dest, opacity)
+		end
+	end
+end
+
+System::puts("%d of %d cases passed" % [total - failed, total])
+
+exit(failed == 0 ? 0 : 1)
@@ -5,6 +5,7 @@
 # Test images are from https://github.com/xinntao/Real-ESRGAN/
 #
 # Run the suite via the "customScript" field in mkxp.json.
+# For unattended (CI) runs, set MKXPZ_HEADLESS=1 and MKXPZ_VIRTUAL_CLOCK=1.
 # Use RGSS v3 for best results.
 
 def dump(bmp, spr, desc)
@@ -5,6 +5,7 @@
 # Test images are from https://github.com/xinntao/Real-ESRGAN/
 #
 # Run the suite via the "customScript" field in mkxp.json.
+# For unattended (CI) runs, set MKXPZ_HEADLESS=1 and MKXPZ_VIRTUAL_CLOCK=1.
 # Use RGSS v3 for best results.
 
 def dump2(bmp, spr, desc)
@@ -75,6 +76,41 @@ spr.zoom_x = 448.0 / 1792.0
 spr.zoom_y = 448.0 / 1792.0
 dump(bmp.hires, spr, "Substituted-Explicit")
 
+# Source rect reaching outside the bitmap (up and left of it).
+# With "bitmapAtlasMaxSize" set, the file-loaded bitmap is packed
+# into an atlas page next to its neighbour; it must still look the
+# same as a bitmap that never was, not show the neighbour's pixels.
+def snap_src_rect(bmp, spr)
+	spr.bitmap = bmp
+	spr.src_rect = Rect.new(-8, -8, bmp.width, bmp.height)
+	Graphics.wait(1)
+	Graphics.snap_to_bitmap
+end
+
+neighbour = Bitmap.new("Graphics/Pictures/atlas-neighbour")
+packed = Bitmap.new("Graphics/Pictures/atlas-edge")
+unpacked_src = Bitmap.new("Graphics/Pictures/atlas-edge")
+unpacked = Bitmap.new(unpacked_src.width, unpacked_src.height)
+unpacked.blt(0, 0, unpacked_src, unpacked_src.rect)
+
+spr.viewport = nil
+spr.zoom_x = 4.0
+spr.zoom_y = 4.0
+shot_packed = snap_src_rect(packed, spr)
+shot_unpacked = snap_src_rect(unpacked, spr)
+shot_packed.to_file("test-results/SrcRect-Outside-atlas-lo.png")
+shot_unpacked.to_file("test-results/SrcRect-Outside-plain-lo.png")
+
+same = true
+(packed.height * 4).times do |y|
+	(packed.width * 4).times do |x|
+		a = shot_packed.get_pixel(x, y)
+		b = shot_unpacked.get_pixel(x, y)
+		same &&= a.red == b.red && a.green == b.green && a.blue == b.blue && a.alpha == b.alpha
+	end
+end
+System::puts((same ? "Finished " : "MISMATCH ") + "SrcRect-Outside")
+
 # Test for null pointer
 spr_null = Sprite.new()
 spr_null.src_rect = Rect.new(0, 0, 448, 640)
@@ -0,0 +1,45 @@
+# Benchmark for the native load_data Marshal reader.
+# Loads every data file of the current project, once through
+# load_data and once through Ruby's Marshal.load, and checks
+# that both produce the same object graphs.
+#
+# Run it from a game directory via the "customScript" field in mkxp.json.
+# For unattended (CI) runs, set MKXPZ_HEADLESS=1.
+
+ROUNDS = 5
+
+files = Dir.glob("Data/*.{rxdata,rvdata,rvdata2}").sort
+files.reject! { |f| File.basename(f) =~ /^Scripts\./ }
+
+def measure
+	start = Process.clock_gettime(Process::CLOCK_MONOTONIC)
+	yield
+	Process.clock_gettime(Process::CLOCK_MONOTONIC) - start
+end
+
+total_native = 0.0
+total_ruby = 0.0
+mismatches = 0
+
+files.each do |f|
+	raw = load_data(f, true)
+
+	native = measure { ROUNDS.times { load_data(f) } }
+	ruby = measure { ROUNDS.times { Marshal.load(load_data(f, true)) } }
+
+	total_native += native
+	total_ruby += ruby
+
+	if Marshal.dump(load_data(f)) != Marshal.dump(Marshal.load(raw))
+		mismatches += 1
+		System::puts("MISMATCH " + f)
+	end
+
+	System::puts("%-32s native %8.2f ms  ruby %8.2f ms" %
+	             [f, native * 1000 / ROUNDS, ruby * 1000 / ROUNDS])
+end
+
+System::puts("%d files, native %.2f ms, ruby %.2f ms, %d mismatches" %
+             [files.size, total_native * 1000 / ROUNDS, total_ruby * 1000 / ROUNDS, mismatches])
+
+exit
@@ -0,0 +1,41 @@
+# Benchmark for the per-frame cost of idle graphics objects.
+# Measures Graphics.update with nothing on screen, then with
+# 10000 idle bitmaps, then additionally with 10000 idle sprites
+# showing them, and prints the overhead each adds per frame.
+# Compare the numbers between builds to see the difference.
+#
+# Run it via the "customScript" field in mkxp.json, with
+# "fixedFramerate": -1 so the frame limiter doesn't get in the way.
+# For unattended (CI) runs, set MKXPZ_HEADLESS=1.
+
+COUNT = 10000
+FRAMES = 300
+
+def measure
+	Graphics.update
+	start = Process.clock_gettime(Process::CLOCK_MONOTONIC)
+	FRAMES.times { Graphics.update }
+	(Process.clock_gettime(Process::CLOCK_MONOTONIC) - start) * 1000 / FRAMES
+end
+
+base = measure
+
+bitmaps = Array.new(COUNT) { Bitmap.new(32, 32) }
+with_bitmaps = measure
+
+sprites = bitmaps.map do |b|
+	s = Sprite.new
+	s.bitmap = b
+	s.x = -64
+	s
+end
+with_sprites = measure
+
+System::puts("empty frame:        %8.3f ms" % base)
+System::puts("%d bitmaps:      %8.3f ms (+%.3f ms)" % [COUNT, with_bitmaps, with_bitmaps - base])
+System::puts("%d sprites:      %8.3f ms (+%.3f ms)" % [COUNT, with_sprites, with_sprites - with_bitmaps])
+
+sprites.each(&:dispose)
+bitmaps.each(&:dispose)
+
+exit
@@ -0,0 +1,444 @@
+/*
+** mock-parent.cpp
+**
+** This file is part of mkxp.
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Stands in for steamshim_parent, so that a steam_ build can
+ * be run and tested without Steam. Speaks the same pipe
+ * protocol, but keeps stats and achievements in memory, and
+ * can hold every reply back to mimic a slow Steam client.
+ * Prints how many of each command it got once the child exits.
+ *
+ * Usage: steamshim-mock [options] <mkxp-z executable> [args]
+ *
+ *   --latency MS        wait MS milliseconds before each reply
+ *   --stat NAME=VALUE   an existing stat (a float if VALUE has a '.')
+ *   --achievement NAME  an existing, locked achievement
+ *
+ * POSIX only. */
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/wait.h>
+
+#include <map>
+#include <string>
+
+/* Must match steamshim_child.c */
+enum ShimCmd
+{
+	SHIMCMD_BYE,
+	SHIMCMD_PUMP,
+	SHIMCMD_REQUESTSTATS,
+	SHIMCMD_STORESTATS,
+	SHIMCMD_SETACHIEVEMENT,
+	SHIMCMD_GETACHIEVEMENT,
+	SHIMCMD_RESETSTATS,
+	SHIMCMD_SETSTATI,
+	SHIMCMD_GETSTATI,
+	SHIMCMD_SETSTATF,
+	SHIMCMD_GETSTATF,
+	SHIMCMD_GETPERSONANAME,
+	SHIMCMD_GETCURRENTGAMELANGUAGE,
+	SHIMCMD_COUNT
+};
+
+enum ShimEvent
+{
+	SHIMEVENT_BYE,
+	SHIMEVENT_STATSRECEIVED,
+	SHIMEVENT_STATSSTORED,
+	SHIMEVENT_SETACHIEVEMENT,
+	SHIMEVENT_GETACHIEVEMENT,
+	SHIMEVENT_RESETSTATS,
+	SHIMEVENT_SETSTATI,
+	SHIMEVENT_GETSTATI,
+	SHIMEVENT_SETSTATF,
+	SHIMEVENT_GETSTATF,
+	SHIMEVENT_GETPERSONANAME,
+	SHIMEVENT_GETCURRENTGAMELANGUAGE
+};
+
+static const char *cmdNames[SHIMCMD_COUNT] =
+{
+	"bye", "pump", "request_stats", "store_stats", "set_achievement",
+	"get_achievement", "reset_stats", "set_stat_i", "get_stat_i",
+	"set_stat_f", "get_stat_f", "get_persona_name", "get_game_language"
+};
+
+struct Stat
+{
+	bool isFloat;
+	int32_t i;
+	float f;
+};
+
+struct Achievement
+{
+	bool achieved;
+	uint64_t unlockTime;
+};
+
+static std::map<std::string, Stat> stats;
+static std::map<std::string, Achievement> achievements;
+
+static int latencyMs = 0;
+static unsigned long cmdCounts[SHIMCMD_COUNT];
+
+static bool writeAll(int fd, const void *data, size_t len)
+{
+	const uint8_t *p = static_cast<const uint8_t*>(data);
+
+	while (len > 0)
+	{
+		ssize_t bw = write(fd, p, len);
+
+		if (bw < 0 && errno == EINTR)
+			continue;
+		if (bw <= 0)
+			return false;
+
+		p += bw;
+		len -= bw;
+	}
+
+	return true;
+}
+
+/* Event, then 'payload', then 'name' if given */
+static bool reply(int fd, ShimEvent event, const void *payload, size_t len,
+                  const char *name = 0)
+{
+	uint8_t buf[256];
+	size_t size = 1;
+
+	buf[size++] = event;
+
+	if (len)
+	{
+		memcpy(buf + size, payload, len);
+		size += len;
+	}
+
+	if (name)
+	{
+		size_t nameLen = strlen(name) + 1;
+		memcpy(buf + size, name, nameLen);
+		size += nameLen;
+	}
+
+	buf[0] = size - 1;
+
+	if (latencyMs > 0)
+	{
+		struct timespec ts = { latencyMs / 1000, (latencyMs % 1000) * 1000000L };
+		while (nanosleep(&ts, &ts) == -1 && errno == EINTR) {}
+	}
+
+	return writeAll(fd, buf, size);
+}
+
+static bool replyOkay(int fd, ShimEvent event, bool okay)
+{
+	uint8_t b = okay;
+	return reply(fd, event, &b, 1);
+}
+
+static bool replyStat(int fd, ShimEvent event, const char *name,
+                      bool okay, const void *value)
+{
+	uint8_t payload[5] = { okay };
+	memcpy(payload + 1, value, 4);
+
+	return reply(fd, event, payload, sizeof(payload), name);
+}
+
+/* Returns false once the child says bye */
+static bool processCommand(const uint8_t *buf, size_t len, int fd)
+{
+	if (len == 0)
+		return true;
+
+	uint8_t cmd = *buf++;
+	len--;
+
+	if (cmd < SHIMCMD_COUNT)
+		cmdCounts[cmd]++;
+
+	/* Names are the last thing in every command */
+	const char *str = (const char*) buf;
+
+	switch (cmd)
+	{
+	case SHIMCMD_BYE :
+		reply(fd, SHIMEVENT_BYE, 0, 0);
+		return false;
+
+	case SHIMCMD_REQUESTSTATS :
+		return replyOkay(fd, SHIMEVENT_STATSRECEIVED, true);
+
+	case SHIMCMD_STORESTATS :
+		return replyOkay(fd, SHIMEVENT_STATSSTORED, true);
+
+	case SHIMCMD_SETACHIEVEMENT :
+	{
+		if (len < 2)
+			return true;
+
+		bool enable = buf[0];
+		const char *name = str + 1;
+
+		std::map<std::string, Achievement>::iterator iter = achievements.find(name);
+		bool okay = (iter != achievements.end());
+
+		if (okay && iter->second.achieved != enable)
+		{
+			iter->second.achieved = enable;
+			iter->second.unlockTime = enable ? time(0) : 0;
+		}
+
+		uint8_t payload[2] = { enable, okay };
+		return reply(fd, SHIMEVENT_SETACHIEVEMENT, payload, 2, name);
+	}
+
+	case SHIMCMD_GETACHIEVEMENT :
+	{
+		std::map<std::string, Achievement>::const_iterator iter = achievements.find(str);
+
+		uint8_t payload[9] = { 2 };
+		uint64_t unlockTime = 0;
+
+		if (iter != achievements.end())
+		{
+			payload[0] = iter->second.achieved;
+			unlockTime = iter->second.unlockTime;
+		}
+
+		memcpy(payload + 1, &unlockTime, sizeof(unlockTime));
+		return reply(fd, SHIMEVENT_GETACHIEVEMENT, payload, sizeof(payload), str);
+	}
+
+	case SHIMCMD_RESETSTATS :
+	{
+		bool alsoAch = len > 0 && buf[0];
+
+		std::map<std::string, Stat>::iterator iter;
+		for (iter = stats.begin(); iter != stats.end(); ++iter)
+			iter->second.i = 0, iter->second.f = 0;
+
+		if (alsoAch)
+		{
+			std::map<std::string, Achievement>::iterator ach;
+			for (ach = achievements.begin(); ach != achievements.end(); ++ach)
+				ach->second.achieved = false, ach->second.unlockTime = 0;
+		}
+
+		uint8_t payload[2] = { alsoAch, 1 };
+		return reply(fd, SHIMEVENT_RESETSTATS, payload, 2);
+	}
+
+	case SHIMCMD_SETSTATI :
+	case SHIMCMD_SETSTATF :
+	{
+		if (len < 5)
+			return true;
+
+		bool isFloat = (cmd == SHIMCMD_SETSTATF);
+		const char *name = str + 4;
+
+		std::map<std::string, Stat>::iterator iter = stats.find(name);
+		bool okay = (iter != stats.end() && iter->second.isFloat == isFloat);
+
+		if (okay)
+		{
+			if (isFloat)
+				memcpy(&iter->second.f, buf, 4);
+			else
+				memcpy(&iter->second.i, buf, 4);
+		}
+
+		return replyStat(fd, isFloat ? SHIMEVENT_SETSTATF : SHIMEVENT_SETSTATI,
+		                 name, okay, buf);
+	}
+
+	case SHIMCMD_GETSTATI :
+	case SHIMCMD_GETSTATF :
+	{
+		bool isFloat = (cmd == SHIMCMD_GETSTATF);
+
+		std::map<std::string, Stat>::const_iterator iter = stats.find(str);
+		bool okay = (iter != stats.end() && iter->second.isFloat == isFloat);
+
+		Stat value = Stat();
+		if (okay)
+			value = iter->second;
+
+		if (isFloat)
+			return replyStat(fd, SHIMEVENT_GETSTATF, str, okay, &value.f);
+		else
+			return replyStat(fd, SHIMEVENT_GETSTATI, str, okay, &value.i);
+	}
+
+	case SHIMCMD_GETPERSONANAME :
+		return reply(fd, SHIMEVENT_GETPERSONANAME, 0, 0, "Mock User");
+
+	case SHIMCMD_GETCURRENTGAMELANGUAGE :
+		return reply(fd, SHIMEVENT_GETCURRENTGAMELANGUAGE, 0, 0, "english");
+
+	default :
+		/* SHIMCMD_PUMP and unknown commands get no reply */
+		return true;
+	}
+}
+
+static void processCommands(int readFd, int writeFd)
+{
+	uint8_t buf[512];
+	size_t br = 0;
+
+	while (true)
+	{
+		ssize_t got = read(readFd, buf + br, sizeof(buf) - br);
+
+		if (got < 0 && errno == EINTR)
+			continue;
+		if (got <= 0)
+			return;
+
+		br += got;
+
+		while (br > 0 && br > buf[0])
+		{
+			size_t len = buf[0];
+
+			if (!processCommand(buf + 1, len, writeFd))
+				return;
+
+			br -= len + 1;
+			memmove(buf, buf + len + 1, br);
+		}
+	}
+}
+
+static bool parseStat(const char *arg)
+{
+	const char *eq = strchr(arg, '=');
+	if (!eq || eq == arg)
+		return false;
+
+	Stat stat = Stat();
+	stat.isFloat = strchr(eq, '.') != 0;
+
+	if (stat.isFloat)
+		stat.f = strtof(eq + 1, 0);
+	else
+		stat.i = strtol(eq + 1, 0, 10);
+
+	stats[std::string(arg, eq - arg)] = stat;
+
+	return true;
+}
+
+static void usage(const char *self)
+{
+	fprintf(stderr, "usage: %s [--latency MS] [--stat NAME=VALUE]... "
+	                "[--achievement NAME]... <mkxp-z executable> [args]\n", self);
+	exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+	int i = 1;
+
+	for (; i < argc && !strncmp(argv[i], "--", 2); ++i)
+	{
+		if (i + 1 >= argc)
+			usage(argv[0]);
+
+		if (!strcmp(argv[i], "--latency"))
+			latencyMs = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "--stat"))
+		{
+			if (!parseStat(argv[++i]))
+				usage(argv[0]);
+		}
+		else if (!strcmp(argv[i], "--achievement"))
+			achievements[argv[++i]] = Achievement();
+		else
+			usage(argv[0]);
+	}
+
+	if (i >= argc)
+		usage(argv[0]);
+
+	/* toChild[0] / fromChild[1] are the child's ends */
+	int toChild[2], fromChild[2];
+	if (pipe(toChild) || pipe(fromChild))
+	{
+		perror("pipe");
+		return 1;
+	}
+
+	char buf[32];
+	snprintf(buf, sizeof(buf), "%d", toChild[0]);
+	setenv("STEAMSHIM_READHANDLE", buf, 1);
+	snprintf(buf, sizeof(buf), "%d", fromChild[1]);
+	setenv("STEAMSHIM_WRITEHANDLE", buf, 1);
+
+	/* A child gone early shouldn't take us down on write */
+	signal(SIGPIPE, SIG_IGN);
+
+	pid_t pid = fork();
+	if (pid < 0)
+	{
+		perror("fork");
+		return 1;
+	}
+
+	if (pid == 0)
+	{
+		close(toChild[1]);
+		close(fromChild[0]);
+		execvp(argv[i], argv + i);
+		perror("execvp");
+		_exit(127);
+	}
+
+	close(toChild[0]);
+	close(fromChild[1]);
+
+	processCommands(fromChild[0], toChild[1]);
+
+	close(toChild[1]);
+	close(fromChild[0]);
+
+	int status = 0;
+	while (waitpid(pid, &status, 0) == -1 && errno == EINTR) {}
+
+	fprintf(stderr, "\nsteamshim-mock: commands received\n");
+	for (int c = 0; c < SHIMCMD_COUNT; ++c)
+		if (cmdCounts[c])
+			fprintf(stderr, "  %-20s %lu\n", cmdNames[c], cmdCounts[c]);
+
+	return WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+}
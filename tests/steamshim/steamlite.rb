@@ -0,0 +1,47 @@
+# Test suite for SteamLite, to be run under the mock steamshim parent:
+#
+#   steamshim-mock --latency 20 --stat KILLS=0 --stat PLAYTIME=0.5 \
+#       --achievement ACH_WIN ./steam_mkxp-z
+#
+# Run it via the "customScript" field in mkxp.json. Writes should take
+# no time at all no matter the latency, and only the first read of
+# every stat should have to wait for it.
+
+def measure
+	start = Process.clock_gettime(Process::CLOCK_MONOTONIC)
+	yield
+	(Process.clock_gettime(Process::CLOCK_MONOTONIC) - start) * 1000
+end
+
+$failed = 0
+
+def check(what, cond)
+	System::puts "#{cond ? "ok  " : "FAIL"} #{what}"
+	$failed += 1 unless cond
+end
+
+ms = measure { 1000.times { |i| SteamLite.set_stat("KILLS", i) } }
+System::puts "1000x set_stat:            %8.3f ms" % ms
+check "set_stat reads back", SteamLite.get_stat_i("KILLS") == 999
+
+ms = measure { SteamLite.get_stat_f("PLAYTIME") }
+System::puts "get_stat_f, first:         %8.3f ms" % ms
+ms = measure { 1000.times { SteamLite.get_stat_f("PLAYTIME") } }
+System::puts "1000x get_stat_f, cached:  %8.3f ms" % ms
+check "get_stat_f", SteamLite.get_stat_f("PLAYTIME") == 0.5
+check "unknown stat is nil", SteamLite.get_stat_i("NOPE").nil?
+
+check "achievement starts locked", SteamLite.get_achievement("ACH_WIN") == false
+check "set_achievement", SteamLite.set_achievement("ACH_WIN")
+check "achievement reads back", SteamLite.get_achievement("ACH_WIN") == true
+unlocked, time = SteamLite.get_achievement_and_unlock_time("ACH_WIN")
+check "unlock time", unlocked && time.is_a?(Time)
+check "unknown achievement is nil", SteamLite.get_achievement("ACH_NONE").nil?
+
+check "store_stats", SteamLite.store_stats
+check "reset_all_stats", SteamLite.reset_all_stats(true)
+check "stat got reset", SteamLite.get_stat_i("KILLS") == 0
+check "achievement got reset", SteamLite.get_achievement("ACH_WIN") == false
+
+System::puts $failed == 0 ? "\nAll passed" : "\n#{$failed} failed"
+exit($failed == 0 ? 0 : 1)